@@ -0,0 +1,84 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "mgallocator.h"
+
+namespace {
+
+// Sizes of the objects decoded from a typical row (values, strings, list and
+// map headers).
+const size_t kSizes[] = {16, 24, 40, 96, 32, 16, 200, 24};
+const size_t kSizeCount = sizeof(kSizes) / sizeof(kSizes[0]);
+
+// Allocates `range(0)` objects per row and releases the whole row at once, as
+// the decoder does between messages.
+void BM_LinearAllocatorRow(benchmark::State &state) {
+  mg_linear_allocator *allocator =
+      mg_linear_allocator_init(&mg_system_allocator, 131072, 4096);
+  mg_linear_allocator_set_limits(allocator, 4194304, 4);
+  const int64_t objects = state.range(0);
+  for (auto _ : state) {
+    for (int64_t i = 0; i < objects; ++i) {
+      benchmark::DoNotOptimize(mg_allocator_malloc(
+          (mg_allocator *)allocator, kSizes[(size_t)i % kSizeCount]));
+    }
+    mg_linear_allocator_reset(allocator);
+  }
+  state.SetItemsProcessed(state.iterations() * objects);
+  mg_linear_allocator_destroy(allocator);
+}
+BENCHMARK(BM_LinearAllocatorRow)->Arg(16)->Arg(1024)->Arg(65536);
+
+// The same pattern with every object allocated and freed separately.
+void BM_SystemAllocatorRow(benchmark::State &state) {
+  const int64_t objects = state.range(0);
+  std::vector<void *> allocated((size_t)objects);
+  for (auto _ : state) {
+    for (int64_t i = 0; i < objects; ++i) {
+      allocated[(size_t)i] = mg_allocator_malloc(
+          &mg_system_allocator, kSizes[(size_t)i % kSizeCount]);
+      benchmark::DoNotOptimize(allocated[(size_t)i]);
+    }
+    for (void *buf : allocated) {
+      mg_allocator_free(&mg_system_allocator, buf);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * objects);
+}
+BENCHMARK(BM_SystemAllocatorRow)->Arg(16)->Arg(1024)->Arg(65536);
+
+// Objects bigger than the separate allocation threshold get blocks of their
+// own.
+void BM_LinearAllocatorLargeObjects(benchmark::State &state) {
+  mg_linear_allocator *allocator =
+      mg_linear_allocator_init(&mg_system_allocator, 131072, 4096);
+  mg_linear_allocator_set_limits(allocator, 4194304, 4);
+  const size_t size = (size_t)state.range(0);
+  for (auto _ : state) {
+    for (int i = 0; i < 16; ++i) {
+      benchmark::DoNotOptimize(
+          mg_allocator_malloc((mg_allocator *)allocator, size));
+    }
+    mg_linear_allocator_reset(allocator);
+  }
+  state.SetItemsProcessed(state.iterations() * 16);
+  mg_linear_allocator_destroy(allocator);
+}
+BENCHMARK(BM_LinearAllocatorLargeObjects)->Arg(8192)->Arg(1 << 20);
+
+}  // namespace
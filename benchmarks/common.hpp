@@ -0,0 +1,236 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "mgclient.h"
+#include "mgconstants.h"
+#include "mgsession.h"
+#include "mgtransport.h"
+
+/// Transport which keeps everything in memory, so that benchmarks measure
+/// encoding and decoding rather than the network. Sent data is appended to
+/// `sent` (unless `discard` is set), and received data is read from `input`,
+/// starting over once all of it has been read.
+struct memory_transport {
+  int (*send)(struct mg_transport *, const char *buf, size_t len);
+  int (*recv)(struct mg_transport *, char *buf, size_t len);
+  void (*destroy)(struct mg_transport *);
+  void (*suspend_until_ready_to_read)(struct mg_transport *);
+  void (*suspend_until_ready_to_write)(struct mg_transport *);
+  ssize_t (*recv_some)(struct mg_transport *, char *buf, size_t len);
+  ssize_t (*try_send)(struct mg_transport *, const char *buf, size_t len);
+  ssize_t (*try_recv)(struct mg_transport *, char *buf, size_t len);
+  int (*send_vector)(struct mg_transport *, const mg_transport_buffer *buffers,
+                     size_t count);
+
+  std::string sent;
+  bool discard = false;
+  std::string input;
+  size_t input_pos = 0;
+};
+
+inline int memory_transport_send(mg_transport *transport, const char *buf,
+                                 size_t len) {
+  auto *self = (memory_transport *)transport;
+  if (!self->discard) {
+    self->sent.append(buf, len);
+  }
+  return 0;
+}
+
+inline ssize_t memory_transport_recv_some(mg_transport *transport, char *buf,
+                                          size_t len) {
+  auto *self = (memory_transport *)transport;
+  if (self->input.empty()) {
+    return -1;
+  }
+  if (self->input_pos == self->input.size()) {
+    self->input_pos = 0;
+  }
+  size_t now = std::min(len, self->input.size() - self->input_pos);
+  memcpy(buf, self->input.data() + self->input_pos, now);
+  self->input_pos += now;
+  return (ssize_t)now;
+}
+
+inline int memory_transport_recv(mg_transport *transport, char *buf,
+                                 size_t len) {
+  size_t received = 0;
+  while (received < len) {
+    ssize_t now =
+        memory_transport_recv_some(transport, buf + received, len - received);
+    if (now < 0) {
+      return -1;
+    }
+    received += (size_t)now;
+  }
+  return 0;
+}
+
+inline void memory_transport_destroy(mg_transport *transport) {
+  delete (memory_transport *)transport;
+}
+
+/// Makes a session on top of a new `memory_transport`, which is owned by the
+/// session.
+inline mg_session *MakeMemorySession(memory_transport **transport,
+                                     int version = 4) {
+  mg_session *session = mg_session_init(&mg_system_allocator);
+  if (!session) {
+    abort();
+  }
+  auto *ttransport = new memory_transport;
+  ttransport->send = memory_transport_send;
+  ttransport->recv = memory_transport_recv;
+  ttransport->destroy = memory_transport_destroy;
+  ttransport->suspend_until_ready_to_read = nullptr;
+  ttransport->suspend_until_ready_to_write = nullptr;
+  ttransport->recv_some = memory_transport_recv_some;
+  ttransport->try_send = nullptr;
+  ttransport->try_recv = nullptr;
+  ttransport->send_vector = nullptr;
+  session->transport = (mg_transport *)ttransport;
+  session->version = version;
+  session->status = MG_SESSION_READY;
+  *transport = ttransport;
+  return session;
+}
+
+/// Value shapes found in real results.
+namespace shapes {
+
+inline mg_value *MakeString(size_t length) {
+  std::string data(length, 'x');
+  for (size_t i = 0; i < length; ++i) {
+    data[i] = (char)('a' + i % 26);
+  }
+  return mg_value_make_string2(mg_string_make2((uint32_t)length, data.data()));
+}
+
+/// A row of `width` columns of mixed scalars: integers, floats, short strings
+/// and booleans.
+inline mg_value *MakeWideRow(uint32_t width) {
+  mg_list *row = mg_list_make_empty(width);
+  for (uint32_t i = 0; i < width; ++i) {
+    mg_value *field;
+    switch (i % 4) {
+      case 0:
+        field = mg_value_make_integer((int64_t)i * 1000003);
+        break;
+      case 1:
+        field = mg_value_make_float(i * 0.5);
+        break;
+      case 2:
+        field = MakeString(12);
+        break;
+      default:
+        field = mg_value_make_bool(i % 8 == 3);
+        break;
+    }
+    mg_list_append(row, field);
+  }
+  return mg_value_make_list(row);
+}
+
+/// A map with `size` entries, keyed like node properties.
+inline mg_value *MakeLargeMap(uint32_t size) {
+  mg_map *map = mg_map_make_empty(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    std::string key = "property_" + std::to_string(i);
+    mg_value *value = i % 2 ? mg_value_make_integer(i) : MakeString(16);
+    mg_map_insert(map, key.c_str(), value);
+  }
+  return mg_value_make_map(map);
+}
+
+}  // namespace shapes
+
+/// Writes a path of `length` relationships through `session`. Paths can't be
+/// sent by the client, so they're encoded by hand.
+inline int WritePath(mg_session *session, uint32_t length) {
+  auto write_properties = [session](uint32_t id) {
+    mg_value *properties = shapes::MakeLargeMap(4);
+    mg_map_insert(properties->map_v, "id", mg_value_make_integer(id));
+    int status = mg_session_write_map(session, properties->map_v);
+    mg_value_destroy(properties);
+    return status;
+  };
+  auto write_list_header = [session](uint32_t size) {
+    MG_RETURN_IF_FAILED(mg_session_write_uint8(session, MG_MARKER_LIST_32));
+    return mg_session_write_uint32(session, size);
+  };
+
+  MG_RETURN_IF_FAILED(mg_session_write_uint8(session, MG_MARKER_TINY_STRUCT3));
+  MG_RETURN_IF_FAILED(mg_session_write_uint8(session, MG_SIGNATURE_PATH));
+  MG_RETURN_IF_FAILED(write_list_header(length + 1));
+  for (uint32_t i = 0; i <= length; ++i) {
+    MG_RETURN_IF_FAILED(
+        mg_session_write_uint8(session, MG_MARKER_TINY_STRUCT3));
+    MG_RETURN_IF_FAILED(mg_session_write_uint8(session, MG_SIGNATURE_NODE));
+    MG_RETURN_IF_FAILED(mg_session_write_integer(session, i));
+    mg_list *labels = mg_list_make_empty(1);
+    mg_list_append(labels, mg_value_make_string("Person"));
+    int labels_status = mg_session_write_list(session, labels);
+    mg_list_destroy(labels);
+    MG_RETURN_IF_FAILED(labels_status);
+    MG_RETURN_IF_FAILED(write_properties(i));
+  }
+  MG_RETURN_IF_FAILED(write_list_header(length));
+  for (uint32_t i = 0; i < length; ++i) {
+    MG_RETURN_IF_FAILED(
+        mg_session_write_uint8(session, MG_MARKER_TINY_STRUCT3));
+    MG_RETURN_IF_FAILED(
+        mg_session_write_uint8(session, MG_SIGNATURE_UNBOUND_RELATIONSHIP));
+    MG_RETURN_IF_FAILED(mg_session_write_integer(session, 100000 + i));
+    MG_RETURN_IF_FAILED(mg_session_write_string(session, "KNOWS"));
+    MG_RETURN_IF_FAILED(write_properties(i));
+  }
+  MG_RETURN_IF_FAILED(write_list_header(2 * length));
+  for (uint32_t i = 1; i <= length; ++i) {
+    MG_RETURN_IF_FAILED(mg_session_write_integer(session, i));
+    MG_RETURN_IF_FAILED(mg_session_write_integer(session, i));
+  }
+  return 0;
+}
+
+/// Returns a complete Bolt message (chunked and terminated) holding the
+/// given value, as written by a session.
+inline std::string EncodeMessage(const mg_value *value) {
+  memory_transport *transport;
+  mg_session *session = MakeMemorySession(&transport);
+  if (mg_session_write_value(session, value) != 0 ||
+      mg_session_flush_message(session) != 0) {
+    abort();
+  }
+  std::string message = transport->sent;
+  mg_session_destroy(session);
+  return message;
+}
+
+inline std::string EncodePathMessage(uint32_t length) {
+  memory_transport *transport;
+  mg_session *session = MakeMemorySession(&transport);
+  if (WritePath(session, length) != 0 ||
+      mg_session_flush_message(session) != 0) {
+    abort();
+  }
+  std::string message = transport->sent;
+  mg_session_destroy(session);
+  return message;
+}
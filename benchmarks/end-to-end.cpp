@@ -0,0 +1,395 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "mgclient.hpp"
+#include "mgsocket.h"
+#include "mock-server.hpp"
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> socket_calls{0};
+
+// Everything the library allocates goes through the allocator of the process,
+// which is set to this one to count the allocations.
+void *counting_malloc(mg_allocator *, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return malloc(size);
+}
+
+void *counting_realloc(mg_allocator *, void *buf, size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return realloc(buf, size);
+}
+
+void counting_free(mg_allocator *, void *buf) { free(buf); }
+
+mg_allocator counting_allocator = {counting_malloc, counting_realloc,
+                                   counting_free};
+
+[[maybe_unused]] const bool initialized = [] {
+  mg_set_allocator(&counting_allocator);
+  return mg_init() == MG_SUCCESS;
+}();
+
+// Counts allocations and socket calls made since the construction, and
+// reports them per `unit` (a result row or a connection).
+class Counters {
+ public:
+  Counters()
+      : allocations_(allocations.load()), socket_calls_(socket_calls.load()) {}
+
+  void Report(benchmark::State &state, const std::string &unit,
+              double units) {
+    state.counters["allocs/" + unit] =
+        (double)(allocations.load() - allocations_) / units;
+#ifdef MG_BENCHMARK_COUNT_SOCKET_CALLS
+    state.counters["syscalls/" + unit] =
+        (double)(socket_calls.load() - socket_calls_) / units;
+#endif
+  }
+
+  void ReportRows(benchmark::State &state, uint64_t rows_per_iteration,
+                  size_t bytes_per_iteration) {
+    double rows = (double)(state.iterations() * rows_per_iteration);
+    state.counters["rows/s"] =
+        benchmark::Counter(rows, benchmark::Counter::kIsRate);
+    Report(state, "row", rows);
+    state.SetBytesProcessed(
+        (int64_t)(state.iterations() * bytes_per_iteration));
+  }
+
+ private:
+  uint64_t allocations_;
+  uint64_t socket_calls_;
+};
+
+mg_list *MakeRow() {
+  mg_value *row = shapes::MakeWideRow(8);
+  mg_list *fields = mg_list_copy(mg_value_list(row));
+  mg_value_destroy(row);
+  return fields;
+}
+
+mg_session *Connect(const MockBoltServer &server, int decode_threads = 0) {
+  mg_session_params *params = mg_session_params_make();
+  mg_session_params_set_host(params, "127.0.0.1");
+  mg_session_params_set_port(params, server.port());
+  mg_session_params_set_decode_threads(params, decode_threads);
+  mg_session *session;
+  int status = mg_connect(params, &session);
+  mg_session_params_destroy(params);
+  if (status != 0) {
+    abort();
+  }
+  return session;
+}
+
+// Arguments: Bolt version.
+void BM_Connect(benchmark::State &state) {
+  mg_list *row = MakeRow();
+  MockBoltServer server((int)state.range(0), row, 0);
+  Counters counters;
+  for (auto _ : state) {
+    mg_session_destroy(Connect(server));
+  }
+  counters.Report(state, "connect", (double)state.iterations());
+  mg_list_destroy(row);
+}
+BENCHMARK(BM_Connect)->Arg(1)->Arg(4)->UseRealTime();
+
+// Runs a query and fetches all of its rows with the C API.
+// Arguments: Bolt version, rows per query, decoding threads.
+void BM_RunPullFetch(benchmark::State &state) {
+  const uint32_t rows = (uint32_t)state.range(1);
+  mg_list *row = MakeRow();
+  MockBoltServer server((int)state.range(0), row, rows);
+  mg_session *session = Connect(server, (int)state.range(2));
+  Counters counters;
+  for (auto _ : state) {
+    if (mg_session_run(session, "MATCH (n) RETURN n", nullptr, nullptr,
+                       nullptr, nullptr) != 0 ||
+        mg_session_pull(session, nullptr) != 0) {
+      state.SkipWithError(mg_session_error(session));
+      break;
+    }
+    mg_result *result;
+    int status;
+    while ((status = mg_session_fetch(session, &result)) == 1) {
+      benchmark::DoNotOptimize(mg_result_row(result));
+    }
+    if (status != 0) {
+      state.SkipWithError(mg_session_error(session));
+      break;
+    }
+  }
+  counters.ReportRows(state, rows, server.result_bytes());
+  mg_session_destroy(session);
+  mg_list_destroy(row);
+}
+BENCHMARK(BM_RunPullFetch)
+    ->ArgsProduct({{1, 4}, {1, 1000, 100000}, {0}})
+    ->Args({4, 100000, 2})
+    ->Args({4, 100000, 4})
+    ->UseRealTime();
+
+// Fetches all rows of a result dumped from the same server as above, so the
+// difference is the cost of receiving them.
+// Arguments: rows per query.
+void BM_ReplayFetch(benchmark::State &state) {
+  const uint32_t rows = (uint32_t)state.range(0);
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "mgclient_benchmark.dump")
+          .string();
+  mg_list *row = MakeRow();
+  {
+    MockBoltServer server(4, row, rows);
+    mg_session *session = Connect(server);
+    mg_result *result;
+    if (mg_session_run(session, "MATCH (n) RETURN n", nullptr, nullptr,
+                       nullptr, nullptr) != 0 ||
+        mg_session_pull(session, nullptr) != 0 ||
+        mg_session_dump(session, path.c_str(), &result) != 0) {
+      abort();
+    }
+    mg_session_destroy(session);
+  }
+  mg_replay *replay;
+  if (mg_replay_open(path.c_str(), &replay) != 0) {
+    abort();
+  }
+  size_t bytes = std::filesystem::file_size(path);
+  Counters counters;
+  for (auto _ : state) {
+    const mg_list *fields;
+    int status;
+    while ((status = mg_replay_fetch(replay, &fields)) == 1) {
+      benchmark::DoNotOptimize(fields);
+    }
+    if (status != 0) {
+      state.SkipWithError(mg_replay_error(replay));
+      break;
+    }
+    mg_replay_rewind(replay);
+  }
+  counters.ReportRows(state, rows, bytes);
+  mg_replay_destroy(replay);
+  std::filesystem::remove(path);
+  mg_list_destroy(row);
+}
+BENCHMARK(BM_ReplayFetch)->Arg(1000)->Arg(100000)->UseRealTime();
+
+// Runs a query with a single large string parameter, such as an uploaded
+// document, and fetches its (empty) result.
+// Arguments: parameter size in bytes.
+void BM_RunLargeParameter(benchmark::State &state) {
+  const size_t size = (size_t)state.range(0);
+  mg_list *row = MakeRow();
+  MockBoltServer server(4, row, 0);
+  mg_session *session = Connect(server);
+  std::string document(size, 'x');
+  mg_map *params = mg_map_make_empty(1);
+  mg_map_insert(params, "document",
+                mg_value_make_string2(
+                    mg_string_make2((uint32_t)size, document.data())));
+  Counters counters;
+  for (auto _ : state) {
+    if (mg_session_run(session, "CREATE (:Document {body: $document})",
+                       params, nullptr, nullptr, nullptr) != 0 ||
+        mg_session_pull(session, nullptr) != 0) {
+      state.SkipWithError(mg_session_error(session));
+      break;
+    }
+    mg_result *result;
+    if (mg_session_fetch(session, &result) != 0) {
+      state.SkipWithError(mg_session_error(session));
+      break;
+    }
+  }
+  counters.Report(state, "query", (double)state.iterations());
+  state.SetBytesProcessed((int64_t)(state.iterations() * size));
+  mg_map_destroy(params);
+  mg_session_destroy(session);
+  mg_list_destroy(row);
+}
+BENCHMARK(BM_RunLargeParameter)
+    ->Arg(64 << 10)
+    ->Arg(1 << 20)
+    ->Arg(16 << 20)
+    ->UseRealTime();
+
+// Runs a query and fetches all of its rows with `mg::Client`.
+// Arguments: rows per query.
+void BM_ClientFetchAll(benchmark::State &state) {
+  const uint32_t rows = (uint32_t)state.range(0);
+  mg_list *row = MakeRow();
+  MockBoltServer server(4, row, rows);
+  mg::Client::Params params;
+  params.port = server.port();
+  std::unique_ptr<mg::Client> client = mg::Client::Connect(params);
+  if (!client) {
+    abort();
+  }
+  Counters counters;
+  for (auto _ : state) {
+    if (!client->Execute("MATCH (n) RETURN n")) {
+      state.SkipWithError("Execute failed");
+      break;
+    }
+    auto result = client->FetchAll();
+    if (!result || result->size() != rows) {
+      state.SkipWithError("FetchAll failed");
+      break;
+    }
+    benchmark::DoNotOptimize(result->data());
+  }
+  counters.ReportRows(state, rows, server.result_bytes());
+  client.reset();
+  mg_list_destroy(row);
+}
+BENCHMARK(BM_ClientFetchAll)->Arg(1000)->Arg(100000)->UseRealTime();
+
+// Same as above, with rows decoded into an arena.
+// Arguments: rows per query.
+void BM_ClientFetchAllArena(benchmark::State &state) {
+  const uint32_t rows = (uint32_t)state.range(0);
+  mg_list *row = MakeRow();
+  MockBoltServer server(4, row, rows);
+  mg::Client::Params params;
+  params.port = server.port();
+  std::unique_ptr<mg::Client> client = mg::Client::Connect(params);
+  if (!client) {
+    abort();
+  }
+  mg::Arena arena;
+  Counters counters;
+  for (auto _ : state) {
+    if (!client->Execute("MATCH (n) RETURN n")) {
+      state.SkipWithError("Execute failed");
+      break;
+    }
+    auto result = client->FetchAll(arena);
+    if (!result || result->size() != rows) {
+      state.SkipWithError("FetchAll failed");
+      break;
+    }
+    benchmark::DoNotOptimize(result->data());
+    arena.Reset();
+  }
+  counters.ReportRows(state, rows, server.result_bytes());
+  client.reset();
+  mg_list_destroy(row);
+}
+BENCHMARK(BM_ClientFetchAllArena)->Arg(1000)->Arg(100000)->UseRealTime();
+
+}  // namespace
+
+// The fields of `MakeRow`, in the order of its columns.
+struct WideRow {
+  int64_t i0;
+  double f1;
+  std::string s2;
+  bool b3;
+  int64_t i4;
+  double f5;
+  std::string s6;
+  bool b7;
+};
+
+template <>
+struct mg::RowBinding<WideRow> {
+  static constexpr auto fields = std::make_tuple(
+      mg::Field("column_0", &WideRow::i0), mg::Field("column_1", &WideRow::f1),
+      mg::Field("column_2", &WideRow::s2), mg::Field("column_3", &WideRow::b3),
+      mg::Field("column_4", &WideRow::i4), mg::Field("column_5", &WideRow::f5),
+      mg::Field("column_6", &WideRow::s6), mg::Field("column_7", &WideRow::b7));
+};
+
+namespace {
+
+// Same as above, with rows read straight into structs.
+// Arguments: rows per query.
+void BM_ClientFetchAllAs(benchmark::State &state) {
+  const uint32_t rows = (uint32_t)state.range(0);
+  mg_list *row = MakeRow();
+  MockBoltServer server(4, row, rows);
+  mg::Client::Params params;
+  params.port = server.port();
+  std::unique_ptr<mg::Client> client = mg::Client::Connect(params);
+  if (!client) {
+    abort();
+  }
+  Counters counters;
+  for (auto _ : state) {
+    if (!client->Execute("MATCH (n) RETURN n")) {
+      state.SkipWithError("Execute failed");
+      break;
+    }
+    auto result = client->FetchAllAs<WideRow>();
+    if (!result || result->size() != rows) {
+      state.SkipWithError("FetchAllAs failed");
+      break;
+    }
+    benchmark::DoNotOptimize(result->data());
+  }
+  counters.ReportRows(state, rows, server.result_bytes());
+  client.reset();
+  mg_list_destroy(row);
+}
+BENCHMARK(BM_ClientFetchAllAs)->Arg(1000)->Arg(100000)->UseRealTime();
+
+}  // namespace
+
+#ifdef MG_BENCHMARK_COUNT_SOCKET_CALLS
+// The library's socket calls are wrapped with `--wrap` to count them.
+extern "C" {
+ssize_t __real_mg_socket_send(int sock, const void *buf, int len);
+ssize_t __real_mg_socket_send_vector(int sock,
+                                     const mg_transport_buffer *buffers,
+                                     size_t count);
+ssize_t __real_mg_socket_receive(int sock, void *buf, int len);
+int __real_mg_socket_poll(struct pollfd *fds, unsigned int nfds, int timeout);
+
+ssize_t __wrap_mg_socket_send(int sock, const void *buf, int len) {
+  socket_calls.fetch_add(1, std::memory_order_relaxed);
+  return __real_mg_socket_send(sock, buf, len);
+}
+
+ssize_t __wrap_mg_socket_send_vector(int sock,
+                                     const mg_transport_buffer *buffers,
+                                     size_t count) {
+  socket_calls.fetch_add(1, std::memory_order_relaxed);
+  return __real_mg_socket_send_vector(sock, buffers, count);
+}
+
+ssize_t __wrap_mg_socket_receive(int sock, void *buf, int len) {
+  socket_calls.fetch_add(1, std::memory_order_relaxed);
+  return __real_mg_socket_receive(sock, buf, len);
+}
+
+int __wrap_mg_socket_poll(struct pollfd *fds, unsigned int nfds, int timeout) {
+  socket_calls.fetch_add(1, std::memory_order_relaxed);
+  return __real_mg_socket_poll(fds, nfds, timeout);
+}
+}
+#endif
@@ -0,0 +1,234 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+/// Bolt server running in the benchmark process. It accepts any number of
+/// connections, answers the handshake with `version`, and responds to every
+/// request with canned messages encoded up front: PULL gets `rows` copies of
+/// `row` followed by a summary, written with as few system calls as possible,
+/// so that the client is always the bottleneck.
+///
+/// The server ignores the content of requests (queries, parameters,
+/// credentials). It talks to the client through plain sockets, so it doesn't
+/// show up in the client's counters.
+class MockBoltServer {
+ public:
+  MockBoltServer(int version, const mg_list *row, uint32_t rows)
+      : version_(version) {
+    memory_transport *transport;
+    mg_session *session = MakeMemorySession(&transport, version);
+
+    mg_map *empty = mg_map_make_empty(0);
+    if (mg_session_send_success_message(session, empty) != 0) {
+      abort();
+    }
+    success_ = std::move(transport->sent);
+    transport->sent.clear();
+
+    mg_map *run_summary = mg_map_make_empty(1);
+    mg_list *fields = mg_list_make_empty(mg_list_size(row));
+    for (uint32_t i = 0; i < mg_list_size(row); ++i) {
+      std::string name = "column_" + std::to_string(i);
+      mg_list_append(fields, mg_value_make_string(name.c_str()));
+    }
+    mg_map_insert(run_summary, "fields", mg_value_make_list(fields));
+    if (mg_session_send_success_message(session, run_summary) != 0) {
+      abort();
+    }
+    run_success_ = std::move(transport->sent);
+    transport->sent.clear();
+
+    if (mg_session_send_record_message(session, row) != 0) {
+      abort();
+    }
+    std::string record = std::move(transport->sent);
+    transport->sent.clear();
+    pull_response_.reserve(record.size() * rows + success_.size());
+    for (uint32_t i = 0; i < rows; ++i) {
+      pull_response_ += record;
+    }
+    result_bytes_ = pull_response_.size();
+    pull_response_ += success_;
+
+    mg_map_destroy(run_summary);
+    mg_map_destroy(empty);
+    mg_session_destroy(session);
+
+    listener_ = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listener_, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener_, 16) != 0 ||
+        getsockname(listener_, (struct sockaddr *)&addr, &addr_len) != 0) {
+      abort();
+    }
+    port_ = ntohs(addr.sin_port);
+    acceptor_ = std::thread([this] { Accept(); });
+  }
+
+  MockBoltServer(const MockBoltServer &) = delete;
+  MockBoltServer &operator=(const MockBoltServer &) = delete;
+
+  ~MockBoltServer() {
+    stopping_ = true;
+    // Wakes up the acceptor.
+    shutdown(listener_, SHUT_RDWR);
+    acceptor_.join();
+    close(listener_);
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (int sockfd : connections_) {
+      shutdown(sockfd, SHUT_RDWR);
+    }
+    for (auto &thread : handlers_) {
+      thread.join();
+    }
+  }
+
+  uint16_t port() const { return port_; }
+
+  /// Bytes of RECORD messages sent in response to a single PULL.
+  size_t result_bytes() const { return result_bytes_; }
+
+ private:
+  void Accept() {
+    while (!stopping_) {
+      int sockfd = accept(listener_, nullptr, nullptr);
+      if (sockfd < 0) {
+        continue;
+      }
+      int one = 1;
+      setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      std::lock_guard<std::mutex> guard(mutex_);
+      connections_.push_back(sockfd);
+      handlers_.emplace_back([this, sockfd] {
+        Serve(sockfd);
+        close(sockfd);
+      });
+    }
+  }
+
+  static bool ReadAll(int sockfd, char *buf, size_t len) {
+    while (len > 0) {
+      ssize_t now = recv(sockfd, buf, len, 0);
+      if (now <= 0) {
+        return false;
+      }
+      buf += now;
+      len -= (size_t)now;
+    }
+    return true;
+  }
+
+  static bool WriteAll(int sockfd, const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t now =
+          send(sockfd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (now <= 0) {
+        return false;
+      }
+      sent += (size_t)now;
+    }
+    return true;
+  }
+
+  // Reads the next request and returns its signature, or -1 when the client
+  // is gone.
+  static int ReadRequest(int sockfd) {
+    std::vector<char> message;
+    while (true) {
+      uint16_t chunk_size;
+      if (!ReadAll(sockfd, (char *)&chunk_size, 2)) {
+        return -1;
+      }
+      chunk_size = ntohs(chunk_size);
+      if (chunk_size == 0) {
+        break;
+      }
+      size_t end = message.size();
+      message.resize(end + chunk_size);
+      if (!ReadAll(sockfd, message.data() + end, chunk_size)) {
+        return -1;
+      }
+    }
+    return message.size() >= 2 ? (uint8_t)message[1] : -1;
+  }
+
+  void Serve(int sockfd) {
+    char handshake[20];
+    if (!ReadAll(sockfd, handshake, sizeof(handshake))) {
+      return;
+    }
+    uint32_t version = htonl(version_ == 1 ? 1 : 0x0104);
+    if (!WriteAll(sockfd, std::string((const char *)&version, 4))) {
+      return;
+    }
+    while (true) {
+      int signature = ReadRequest(sockfd);
+      const std::string *response;
+      switch (signature) {
+        case -1:
+          return;
+        case MG_SIGNATURE_MESSAGE_RUN:
+          response = &run_success_;
+          break;
+        case MG_SIGNATURE_MESSAGE_PULL:
+          response = &pull_response_;
+          break;
+        default:
+          response = &success_;
+          break;
+      }
+      if (!WriteAll(sockfd, *response)) {
+        return;
+      }
+    }
+  }
+
+  int version_;
+  std::string success_;
+  std::string run_success_;
+  std::string pull_response_;
+  size_t result_bytes_;
+
+  int listener_;
+  uint16_t port_;
+  std::atomic<bool> stopping_{false};
+  std::thread acceptor_;
+  std::mutex mutex_;
+  std::vector<int> connections_;
+  std::vector<std::thread> handlers_;
+};
@@ -0,0 +1,208 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <functional>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "common.hpp"
+
+namespace {
+
+// Encodes `value` into a message over and over. The transport throws the
+// output away, so this measures the encoder and the chunking.
+void Encode(benchmark::State &state, mg_value *value) {
+  memory_transport *transport;
+  mg_session *session = MakeMemorySession(&transport);
+  transport->discard = true;
+  size_t message_size = EncodeMessage(value).size();
+  for (auto _ : state) {
+    if (mg_session_write_value(session, value) != 0 ||
+        mg_session_flush_message(session) != 0) {
+      state.SkipWithError(mg_session_error(session));
+      break;
+    }
+  }
+  state.SetBytesProcessed((int64_t)(state.iterations() * message_size));
+  mg_session_destroy(session);
+  mg_value_destroy(value);
+}
+
+// Receives `message` over and over and decodes the value in it, including
+// putting the chunks together and releasing the previous value.
+void Decode(benchmark::State &state, const std::string &message) {
+  memory_transport *transport;
+  mg_session *session = MakeMemorySession(&transport);
+  transport->input = message;
+  for (auto _ : state) {
+    mg_value *value;
+    if (mg_session_receive_message(session) != 0 ||
+        mg_session_read_value(session, &value) != 0) {
+      state.SkipWithError(mg_session_error(session));
+      break;
+    }
+    benchmark::DoNotOptimize(value);
+  }
+  state.SetBytesProcessed((int64_t)(state.iterations() * message.size()));
+  mg_session_destroy(session);
+}
+
+// Receives `message` once and skips the value in it over and over, as when
+// indexing a lazily decoded row.
+void Skip(benchmark::State &state, const std::string &message) {
+  memory_transport *transport;
+  mg_session *session = MakeMemorySession(&transport);
+  transport->input = message;
+  if (mg_session_receive_message(session) != 0) {
+    state.SkipWithError(mg_session_error(session));
+  }
+  for (auto _ : state) {
+    session->in_cursor = 0;
+    if (mg_session_skip_value(session) != 0) {
+      state.SkipWithError(mg_session_error(session));
+      break;
+    }
+    benchmark::DoNotOptimize(session->in_cursor);
+  }
+  state.SetBytesProcessed((int64_t)(state.iterations() * message.size()));
+  mg_session_destroy(session);
+}
+
+void BM_EncodeWideRow(benchmark::State &state) {
+  Encode(state, shapes::MakeWideRow((uint32_t)state.range(0)));
+}
+BENCHMARK(BM_EncodeWideRow)->Arg(16)->Arg(256);
+
+void BM_DecodeWideRow(benchmark::State &state) {
+  mg_value *row = shapes::MakeWideRow((uint32_t)state.range(0));
+  std::string message = EncodeMessage(row);
+  mg_value_destroy(row);
+  Decode(state, message);
+}
+BENCHMARK(BM_DecodeWideRow)->Arg(16)->Arg(256);
+
+void BM_SkipWideRow(benchmark::State &state) {
+  mg_value *row = shapes::MakeWideRow((uint32_t)state.range(0));
+  std::string message = EncodeMessage(row);
+  mg_value_destroy(row);
+  Skip(state, message);
+}
+BENCHMARK(BM_SkipWideRow)->Arg(16)->Arg(256);
+
+// A list of `size` small integers, such as counts or enum-like codes.
+void BM_SkipSmallIntegers(benchmark::State &state) {
+  const uint32_t size = (uint32_t)state.range(0);
+  mg_list *list = mg_list_make_empty(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    mg_list_append(list, mg_value_make_integer(i % 100));
+  }
+  mg_value *value = mg_value_make_list(list);
+  std::string message = EncodeMessage(value);
+  mg_value_destroy(value);
+  Skip(state, message);
+}
+BENCHMARK(BM_SkipSmallIntegers)->Arg(16)->Arg(4096);
+
+// A list of `size` node ids.
+void BM_DecodeIdList(benchmark::State &state) {
+  const uint32_t size = (uint32_t)state.range(0);
+  mg_list *list = mg_list_make_empty(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    mg_list_append(list, mg_value_make_integer((int64_t)i * 1000003));
+  }
+  mg_value *value = mg_value_make_list(list);
+  std::string message = EncodeMessage(value);
+  mg_value_destroy(value);
+  Decode(state, message);
+}
+BENCHMARK(BM_DecodeIdList)->Arg(16)->Arg(16384);
+
+// An embedding vector of `size` floats.
+void BM_DecodeEmbedding(benchmark::State &state) {
+  const uint32_t size = (uint32_t)state.range(0);
+  mg_list *list = mg_list_make_empty(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    mg_list_append(list, mg_value_make_float(1.0 / (i + 1)));
+  }
+  mg_value *value = mg_value_make_list(list);
+  std::string message = EncodeMessage(value);
+  mg_value_destroy(value);
+  Decode(state, message);
+}
+BENCHMARK(BM_DecodeEmbedding)->Arg(16)->Arg(1536);
+
+void BM_EncodeLargeMap(benchmark::State &state) {
+  Encode(state, shapes::MakeLargeMap((uint32_t)state.range(0)));
+}
+BENCHMARK(BM_EncodeLargeMap)->Arg(64)->Arg(4096);
+
+void BM_DecodeLargeMap(benchmark::State &state) {
+  mg_value *map = shapes::MakeLargeMap((uint32_t)state.range(0));
+  std::string message = EncodeMessage(map);
+  mg_value_destroy(map);
+  Decode(state, message);
+}
+BENCHMARK(BM_DecodeLargeMap)->Arg(64)->Arg(4096);
+
+void BM_EncodeLongString(benchmark::State &state) {
+  Encode(state, shapes::MakeString((size_t)state.range(0)));
+}
+BENCHMARK(BM_EncodeLongString)->Arg(1 << 10)->Arg(1 << 20);
+
+void BM_DecodeLongString(benchmark::State &state) {
+  mg_value *string = shapes::MakeString((size_t)state.range(0));
+  std::string message = EncodeMessage(string);
+  mg_value_destroy(string);
+  Decode(state, message);
+}
+BENCHMARK(BM_DecodeLongString)->Arg(1 << 10)->Arg(1 << 20);
+
+void BM_DecodeDeepPath(benchmark::State &state) {
+  Decode(state, EncodePathMessage((uint32_t)state.range(0)));
+}
+BENCHMARK(BM_DecodeDeepPath)->Arg(8)->Arg(512);
+
+}  // namespace
+
+// Encodes a RUN message with a few parameters, as when running the same
+// statement over and over.
+// Arguments: statement length, whether the statement is prepared.
+void BM_EncodeRun(benchmark::State &state) {
+  memory_transport *transport;
+  mg_session *session = MakeMemorySession(&transport);
+  transport->discard = true;
+  std::string statement((size_t)state.range(0), ' ');
+  mg_prepared_query *prepared =
+      state.range(1) ? mg_prepared_query_make(statement.c_str()) : nullptr;
+  mg_value *params = shapes::MakeLargeMap(4);
+  mg_map *extra = mg_map_make_empty(0);
+  for (auto _ : state) {
+    int status = prepared ? mg_session_send_prepared_run_message(
+                                session, prepared, params->map_v, extra)
+                          : mg_session_send_run_message(
+                                session, statement.c_str(), params->map_v,
+                                extra);
+    if (status != 0) {
+      state.SkipWithError(mg_session_error(session));
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  mg_map_destroy(extra);
+  mg_value_destroy(params);
+  mg_prepared_query_destroy(prepared);
+  mg_session_destroy(session);
+}
+BENCHMARK(BM_EncodeRun)->ArgsProduct({{64, 4096}, {0, 1}});
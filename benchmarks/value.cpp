@@ -0,0 +1,156 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "common.hpp"
+#include "mgclient.hpp"
+
+namespace {
+
+// Copies the fields of a decoded row into `mg::Value`s, as
+// `mg::Client::FetchOne` does.
+void BM_RowToValues(benchmark::State &state) {
+  mg_value *row = shapes::MakeWideRow((uint32_t)state.range(0));
+  const mg_list *fields = mg_value_list(row);
+  for (auto _ : state) {
+    std::vector<mg::Value> values;
+    values.reserve(mg_list_size(fields));
+    for (uint32_t i = 0; i < mg_list_size(fields); ++i) {
+      values.emplace_back(mg_list_at(fields, i));
+    }
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  mg_value_destroy(row);
+}
+BENCHMARK(BM_RowToValues)->Arg(16)->Arg(256);
+
+// Reads every entry of a decoded map through the non-owning wrappers, without
+// copying.
+void BM_ConstMapIteration(benchmark::State &state) {
+  mg_value *map = shapes::MakeLargeMap((uint32_t)state.range(0));
+  mg::ConstMap wrapper(mg_value_map(map));
+  for (auto _ : state) {
+    int64_t sum = 0;
+    size_t length = 0;
+    for (const auto [key, value] : wrapper) {
+      length += key.size();
+      if (value.type() == mg::Value::Type::Int) {
+        sum += value.ValueInt();
+      } else {
+        length += value.ValueString().size();
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+    benchmark::DoNotOptimize(length);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  mg_value_destroy(map);
+}
+BENCHMARK(BM_ConstMapIteration)->Arg(64)->Arg(4096);
+
+// Builds query parameters from C++ values.
+void BM_BuildParams(benchmark::State &state) {
+  const int64_t size = state.range(0);
+  std::vector<std::string> keys;
+  for (int64_t i = 0; i < size; ++i) {
+    keys.push_back("param_" + std::to_string(i));
+  }
+  for (auto _ : state) {
+    mg::Map params((size_t)size);
+    for (int64_t i = 0; i < size; ++i) {
+      if (i % 2) {
+        params.InsertUnsafe(keys[(size_t)i], mg::Value(i));
+      } else {
+        params.InsertUnsafe(keys[(size_t)i], mg::Value(keys[(size_t)i]));
+      }
+    }
+    benchmark::DoNotOptimize(params.ptr());
+  }
+  state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_BuildParams)->Arg(8)->Arg(1024);
+
+// Sends the rows of a bulk insert as a RUN parameter, either built as an
+// `mg::Map` or written with `mg::ParamWriter`.
+// Arguments: rows, whether `mg::ParamWriter` is used.
+void BM_EncodeBulkParams(benchmark::State &state) {
+  const int64_t rows = state.range(0);
+  std::vector<std::tuple<int64_t, std::string>> data;
+  for (int64_t i = 0; i < rows; ++i) {
+    data.emplace_back(i, "node_" + std::to_string(i));
+  }
+  memory_transport *transport;
+  mg_session *session = MakeMemorySession(&transport);
+  transport->discard = true;
+  mg_map *extra = mg_map_make_empty(0);
+  auto write_params = [](mg_param_writer *writer, void *rows) {
+    mg::ParamWriter param_writer(writer);
+    param_writer.BeginMap(1);
+    param_writer.Write("rows");
+    param_writer.Write(*(decltype(data) *)rows);
+    return param_writer.status();
+  };
+  for (auto _ : state) {
+    int status;
+    if (state.range(1)) {
+      status = mg_session_send_streamed_run_message(
+          session, "UNWIND $rows AS row CREATE (:Node {id: row[0]})", nullptr,
+          write_params, &data, extra);
+    } else {
+      mg::List list((size_t)rows);
+      for (const auto &[id, name] : data) {
+        mg::List row(2);
+        row.Append(mg::Value(id));
+        row.Append(mg::Value(name));
+        list.Append(mg::Value(std::move(row)));
+      }
+      mg::Map params(1);
+      params.InsertUnsafe("rows", mg::Value(std::move(list)));
+      status = mg_session_send_run_message(
+          session, "UNWIND $rows AS row CREATE (:Node {id: row[0]})",
+          params.ptr(), extra);
+    }
+    if (status != 0) {
+      state.SkipWithError(mg_session_error(session));
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * rows);
+  mg_map_destroy(extra);
+  mg_session_destroy(session);
+}
+BENCHMARK(BM_EncodeBulkParams)->ArgsProduct({{1000, 100000}, {0, 1}});
+
+// Compares two equal decoded values, which walks both of them completely.
+void BM_ValueEquality(benchmark::State &state) {
+  mg_value *first = shapes::MakeLargeMap((uint32_t)state.range(0));
+  mg_value *second = mg_value_copy(first);
+  mg::ConstValue a(first);
+  mg::ConstValue b(second);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a == b);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  mg_value_destroy(first);
+  mg_value_destroy(second);
+}
+BENCHMARK(BM_ValueEquality)->Arg(64)->Arg(4096);
+
+}  // namespace
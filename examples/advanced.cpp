@@ -1,5 +1,6 @@
 #include <iostream>
 #include <numeric>
+#include <type_traits>
 
 #include "mgclient.hpp"
 
@@ -12,38 +13,36 @@ void ClearDatabaseData(mg::Client *client) {
 }
 
 std::string MgValueToString(const mg::ConstValue &value) {
-  std::string value_str = "";
-  if (value.type() == mg::Value::Type::Int) {
-    value_str = std::to_string(value.ValueInt());
-  } else if (value.type() == mg::Value::Type::String) {
-    value_str = value.ValueString();
-  } else if (value.type() == mg::Value::Type::Bool) {
-    value_str = std::to_string(value.ValueBool());
-  } else if (value.type() == mg::Value::Type::Double) {
-    value_str = std::to_string(value.ValueDouble());
-  } else if (value.type() == mg::Value::Type::Point2d) {
-    auto point2d = value.ValuePoint2d();
-    value_str += "Point2D({ srid:" + std::to_string(point2d.srid()) +
-                 ", x:" + std::to_string(point2d.x()) +
-                 ", y:" + std::to_string(point2d.y()) + " })";
-  } else if (value.type() == mg::Value::Type::Point3d) {
-    auto point3d = value.ValuePoint3d();
-    value_str += "Point3D({ srid:" + std::to_string(point3d.srid()) +
-                 ", x:" + std::to_string(point3d.x()) +
-                 ", y:" + std::to_string(point3d.y()) +
-                 ", z:" + std::to_string(point3d.z()) + " })";
-  } else if (value.type() == mg::Value::Type::List) {
-    value_str += "[";
-    for (auto item : value.ValueList()) {
-      value_str += MgValueToString(item) + ",";
-    }
-    value_str += "]";
-  } else {
-    std::cerr << "Uncovered converstion from data type to a string"
-              << std::endl;
-    std::exit(1);
-  }
-  return value_str;
+  return mg::Visit(
+      [](const auto &v) -> std::string {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, int64_t> || std::is_same_v<T, bool> ||
+                      std::is_same_v<T, double>) {
+          return std::to_string(v);
+        } else if constexpr (std::is_same_v<T, std::string_view>) {
+          return std::string(v);
+        } else if constexpr (std::is_same_v<T, mg::ConstPoint2d>) {
+          return "Point2D({ srid:" + std::to_string(v.srid()) +
+                 ", x:" + std::to_string(v.x()) +
+                 ", y:" + std::to_string(v.y()) + " })";
+        } else if constexpr (std::is_same_v<T, mg::ConstPoint3d>) {
+          return "Point3D({ srid:" + std::to_string(v.srid()) +
+                 ", x:" + std::to_string(v.x()) +
+                 ", y:" + std::to_string(v.y()) +
+                 ", z:" + std::to_string(v.z()) + " })";
+        } else if constexpr (std::is_same_v<T, mg::ConstList>) {
+          std::string value_str = "[";
+          for (auto item : v) {
+            value_str += MgValueToString(item) + ",";
+          }
+          return value_str + "]";
+        } else {
+          std::cerr << "Uncovered converstion from data type to a string"
+                    << std::endl;
+          std::exit(1);
+        }
+      },
+      value);
 }
 
 int main(int argc, char *argv[]) {
@@ -132,6 +132,7 @@ extern "C" {
 ///         ...).
 ///       - copy functions.
 
+#include <stddef.h>
 #include <stdint.h>
 
 /// Client software version.
@@ -149,6 +150,49 @@ MGCLIENT_EXPORT int mg_init(void);
 /// Should be called at the end of each process using the client.
 MGCLIENT_EXPORT void mg_finalize(void);
 
+/// Functions used by the library to allocate memory.
+///
+/// Each function receives the allocator it was called through as `self`, so
+/// an allocator with state can be a bigger struct starting with these members.
+/// `realloc` is given NULL `buf` to allocate new memory, and `free` may be
+/// given NULL, which it should ignore, just like their standard counterparts.
+typedef struct mg_allocator {
+  void *(*malloc)(struct mg_allocator *self, size_t size);
+  void *(*realloc)(struct mg_allocator *self, void *buf, size_t size);
+  void (*free)(struct mg_allocator *self, void *buf);
+} mg_allocator;
+
+/// Sets the allocator used by the library in the whole process, instead of
+/// `malloc` and friends. NULL restores the standard functions.
+///
+/// The allocator is used for everything the library allocates outside of
+/// sessions with an allocator of their own: values made or copied with the
+/// \c mg_*_make and \c mg_*_copy functions (also through the C++ wrapper),
+/// session parameters, prepared queries, sessions made by \ref mg_connect and
+/// the SSL state shared by the process. Memory is always freed through the
+/// allocator that allocated it, so the allocator has to be set before the
+/// library allocates anything (preferably before \ref mg_init), and it has to
+/// stay in place until everything is destroyed (after \ref mg_finalize).
+MGCLIENT_EXPORT void mg_set_allocator(mg_allocator *allocator);
+
+/// Sets the allocator used by the library in the calling thread, which takes
+/// precedence over the one set by \ref mg_set_allocator. NULL goes back to
+/// that one.
+///
+/// This allows every thread to use an allocator of its own, such as a pool
+/// without any locking. Sessions made by \ref mg_connect keep using the
+/// allocator that was in place when they were made, no matter which thread
+/// uses them afterwards. Other objects (values, session parameters, prepared
+/// queries) don't remember their allocator, so they have to be destroyed by
+/// a thread with the same allocator as the one which made them. The
+/// allocator has to outlive all the objects it allocated.
+///
+/// Decoding threads of a session (see `decode_threads` in \ref
+/// mg_session_params) never use the allocator of the session, but the one
+/// set by \ref mg_set_allocator, so that an allocator without locking is
+/// only ever used by a single thread.
+MGCLIENT_EXPORT void mg_set_thread_allocator(mg_allocator *allocator);
+
 /// An enum listing all the types as specified by Bolt protocol.
 enum mg_value_type {
   MG_VALUE_TYPE_NULL,
@@ -612,6 +656,21 @@ MGCLIENT_EXPORT uint32_t mg_list_size(const mg_list *list);
 ///         bounds, \c NULL is returned.
 MGCLIENT_EXPORT const mg_value *mg_list_at(const mg_list *list, uint32_t pos);
 
+/// Returns elements of list \p list as an array of \ref mg_list_size integers,
+/// if all of them are integers and the list was received from the server.
+///
+/// Such lists (node ids, counts, ...) are decoded into a packed array, which is
+/// faster to work with than individual values of \ref mg_list_at. The array is
+/// owned by the list.
+///
+/// \return A pointer to the array, or NULL if the list wasn't received from
+///         the server or some of its elements aren't integers.
+MGCLIENT_EXPORT const int64_t *mg_list_integers(const mg_list *list);
+
+/// Same as \ref mg_list_integers, for lists of only floats, such as embedding
+/// vectors.
+MGCLIENT_EXPORT const double *mg_list_floats(const mg_list *list);
+
 /// Creates a copy of the given list.
 ///
 /// \return A pointer to the copy or NULL if an error occurred.
@@ -738,6 +797,32 @@ MGCLIENT_EXPORT const mg_value *mg_map_at(const mg_map *map,
 MGCLIENT_EXPORT const mg_value *mg_map_at2(const mg_map *map, uint32_t key_size,
                                            const char *key_data);
 
+/// Looks up the position of the given key in a map.
+///
+/// Maps with many entries keep a hash index of their keys, so the lookup
+/// doesn't have to compare the given key with every key in the map.
+///
+/// \param map     The map instance to be queried.
+/// \param key_str A null-terminated string representing the key to be looked-up
+///                in the map.
+///
+/// \return If the key is found in the map, its position is returned, to be used
+///         with \ref mg_map_key_at and \ref mg_map_value_at. Otherwise, the
+///         size of the map is returned.
+MGCLIENT_EXPORT uint32_t mg_map_find(const mg_map *map, const char *key_str);
+
+/// Looks up the position of the given key in a map.
+///
+/// \param map      The map instance to be queried.
+/// \param key_size The length of the string representing the key to be
+///                 looked-up in the map.
+/// \param key_data Bytes constituting the key string.
+///
+/// \return If the key is found in the map, its position is returned. Otherwise,
+///         the size of the map is returned.
+MGCLIENT_EXPORT uint32_t mg_map_find2(const mg_map *map, uint32_t key_size,
+                                      const char *key_data);
+
 /// Returns the number of key-value pairs in map \p map.
 MGCLIENT_EXPORT uint32_t mg_map_size(const mg_map *map);
 
@@ -764,6 +849,12 @@ MGCLIENT_EXPORT void mg_map_destroy(mg_map *map);
 /// Returns the ID of node \p node.
 MGCLIENT_EXPORT int64_t mg_node_id(const mg_node *node);
 
+/// Returns the element ID of node \p node.
+///
+/// Element IDs are sent only since Bolt 5, so NULL is returned for nodes
+/// received in earlier versions.
+MGCLIENT_EXPORT const mg_string *mg_node_element_id(const mg_node *node);
+
 /// Returns the number of labels of node \p node.
 MGCLIENT_EXPORT uint32_t mg_node_label_count(const mg_node *node);
 
@@ -794,6 +885,20 @@ MGCLIENT_EXPORT int64_t mg_relationship_start_id(const mg_relationship *rel);
 /// Returns the ID of the end node of relationship \p rel.
 MGCLIENT_EXPORT int64_t mg_relationship_end_id(const mg_relationship *rel);
 
+/// Returns the element ID of the relationship \p rel, or NULL before Bolt 5.
+MGCLIENT_EXPORT const mg_string *
+mg_relationship_element_id(const mg_relationship *rel);
+
+/// Returns the element ID of the start node of relationship \p rel, or NULL
+/// before Bolt 5.
+MGCLIENT_EXPORT const mg_string *
+mg_relationship_start_element_id(const mg_relationship *rel);
+
+/// Returns the element ID of the end node of relationship \p rel, or NULL
+/// before Bolt 5.
+MGCLIENT_EXPORT const mg_string *
+mg_relationship_end_element_id(const mg_relationship *rel);
+
 /// Returns the type of the relationship \p rel.
 MGCLIENT_EXPORT const mg_string *mg_relationship_type(
     const mg_relationship *rel);
@@ -815,6 +920,11 @@ MGCLIENT_EXPORT void mg_relationship_destroy(mg_relationship *rel);
 MGCLIENT_EXPORT int64_t
 mg_unbound_relationship_id(const mg_unbound_relationship *rel);
 
+/// Returns the element ID of the unbound relationship \p rel, or NULL before
+/// Bolt 5.
+MGCLIENT_EXPORT const mg_string *
+mg_unbound_relationship_element_id(const mg_unbound_relationship *rel);
+
 /// Returns the type of the unbound relationship \p rel.
 MGCLIENT_EXPORT const mg_string *mg_unbound_relationship_type(
     const mg_unbound_relationship *rel);
@@ -1077,6 +1187,16 @@ MGCLIENT_EXPORT void mg_point_3d_destroy(mg_point_3d *point_3d);
 /// Success code.
 #define MG_SUCCESS (0)
 
+/// Returned by a non-blocking \ref mg_session when the call can't make progress
+/// until the session socket becomes readable. See \ref
+/// mg_session_set_nonblocking.
+#define MG_WANT_READ (2)
+
+/// Returned by a non-blocking \ref mg_session when the call can't make progress
+/// until the session socket becomes writable. See \ref
+/// mg_session_set_nonblocking.
+#define MG_WANT_WRITE (3)
+
 /// Failed to send data to server.
 #define MG_ERROR_SEND_FAILED (-1)
 
@@ -1123,7 +1243,8 @@ MGCLIENT_EXPORT void mg_point_3d_destroy(mg_point_3d *point_3d);
 /// Invalid usage of the library.
 #define MG_ERROR_BAD_CALL (-15)
 
-/// Maximum container size allowed by Bolt exceeded.
+/// Maximum container size allowed by Bolt, or the maximum message size of the
+/// session, exceeded.
 #define MG_ERROR_SIZE_EXCEEDED (-16)
 
 /// An error occurred during SSL connection negotiation.
@@ -1133,6 +1254,19 @@ MGCLIENT_EXPORT void mg_point_3d_destroy(mg_point_3d *point_3d);
 /// negotiation.
 #define MG_ERROR_TRUST_CALLBACK (-18)
 
+/// Waiting for the server to respond to a query took longer than the query
+/// timeout of the session. See \ref mg_session_set_query_timeout.
+#define MG_ERROR_TIMEOUT (-19)
+
+/// The query was cancelled by \ref mg_session_cancel.
+#define MG_ERROR_CANCELLED (-20)
+
+/// Failed to open, read or write a file.
+#define MG_ERROR_FILE_FAILURE (-21)
+
+/// The value has a different type than the one requested.
+#define MG_ERROR_TYPE_MISMATCH (-22)
+
 // Unable to initialize the socket (both create and connect).
 #define MG_ERROR_SOCKET (-100)
 
@@ -1148,6 +1282,12 @@ enum mg_sslmode {
 #endif
 };
 
+/// Determines how a session does its network I/O.
+enum mg_io_backend {
+  MG_IO_BACKEND_SOCKET,    ///< Separate socket system calls (default).
+  MG_IO_BACKEND_IO_URING,  ///< Batched system calls through an io_uring.
+};
+
 /// An object encapsulating a Bolt session.
 typedef struct mg_session mg_session;
 
@@ -1170,6 +1310,29 @@ typedef struct mg_session mg_session;
 ///
 ///      Port number to connect to at the server host.
 ///
+///  - connect_timeout
+///
+///      Time in milliseconds to wait for the TCP connection to be established,
+///      across all addresses of the host. When a host has several addresses
+///      (e.g. both IPv6 and IPv4), they are tried in parallel: the next
+///      attempt starts as soon as the previous one fails or after 250 ms, and
+///      the first connection established is used. Zero or negative value
+///      (default) means that attempts are bounded only by the timeouts of the
+///      operating system.
+///
+///  - dns_cache_ttl
+///
+///      If positive, addresses the host name resolves to are cached for this
+///      many milliseconds, in a cache shared by all sessions of the process
+///      (until \ref mg_finalize), so that reconnects don't wait for DNS.
+///      Default is 0, which means that the host name is resolved on every
+///      connect. Ignored for numeric addresses.
+///
+///  - query_timeout
+///
+///      Initial query timeout of the session, in milliseconds. See \ref
+///      mg_session_set_query_timeout. Default is 0, which means no timeout.
+///
 ///  - username
 ///
 ///      Username to connect as.
@@ -1196,6 +1359,12 @@ typedef struct mg_session mg_session;
 ///
 ///        Only try an SSL connection.
 ///
+///      SSL connections with the same client certificate share a single SSL
+///      context for the whole process (until \ref mg_finalize), and the last
+///      TLS session established with each server is resumed when connecting to
+///      it again, which makes reconnects considerably cheaper. Certificate
+///      files are loaded again when their modification time or size changes.
+///
 ///  - sslcert
 ///
 ///      This parameter specifies the file name of the client SSL certificate.
@@ -1225,12 +1394,137 @@ typedef struct mg_session mg_session;
 ///  - trust_data
 ///
 ///    Additional data that will be provided to trust_callback function.
+///
+///  - fetch_size
+///
+///    Number of records requested from the server at once when results are
+///    pulled without explicit pull information. Remaining records are then
+///    requested batch by batch while fetching, which bounds the amount of
+///    buffered data on huge results. Zero or negative value (default) means
+///    that all records are requested at once. Only supported by Bolt v4.
+///
+///  - decoder_max_block_size, decoder_spare_blocks
+///
+///    Limits of the memory pool used for decoding received messages. Blocks of
+///    the pool grow up to `decoder_max_block_size` bytes when a message doesn't
+///    fit in a single block, and up to `decoder_spare_blocks` blocks are kept
+///    for reuse, so that fetching rows of a steady size doesn't allocate memory
+///    at all. Zero `decoder_max_block_size` (default) means that the built-in
+///    limits (4 MiB and 4 blocks) are used.
+///
+///  - max_message_size, shrink_after
+///
+///    Limits of the buffers holding received messages. Receiving a message
+///    bigger than `max_message_size` bytes fails with \ref
+///    MG_ERROR_SIZE_EXCEEDED instead of growing the buffers to fit it. The
+///    session is unusable after that, as with any other network failure. Zero
+///    (default) means that messages of any size are accepted. Buffers which
+///    have grown for big messages shrink back to their initial size (64 KiB)
+///    after `shrink_after` messages in a row that fit in it, so that a single
+///    huge result doesn't keep a long-lived session big. Zero (default) means
+///    64 messages, a negative value means that the buffers never shrink.
+///
+///  - io_backend
+///
+///    This option determines how the session does its network I/O. There are 2
+///    possible values:
+///
+///    - \ref MG_IO_BACKEND_SOCKET
+///
+///      Every send and receive is a separate system call (default).
+///
+///    - \ref MG_IO_BACKEND_IO_URING
+///
+///      Requests are submitted through an io_uring together with the receive
+///      of their response, so that a request and the wait for its response
+///      take a single system call. Only applies to connections without SSL and
+///      only on Linux. If io_uring isn't available (the library was built
+///      without it, or the kernel doesn't allow it), the session silently
+///      falls back to \ref MG_IO_BACKEND_SOCKET.
+///
+///  - ktls
+///
+///    If set to a non-zero value, SSL connections ask OpenSSL to hand record
+///    encryption and decryption over to the kernel (kTLS) after the handshake.
+///    Application data is then sent and received with plain socket calls,
+///    which takes the cryptography off the reading thread and lets a single
+///    read return data of several records. This needs Linux, OpenSSL 3 built
+///    with kTLS support, the `tls` kernel module and a cipher the kernel
+///    supports (e.g. AES-GCM). Otherwise the connection silently stays with
+///    userspace TLS. Ignored for connections without SSL. Default is 0.
+///
+///  - decode_threads
+///
+///    If positive, the session starts this many threads that decode result
+///    rows for \ref mg_session_fetch. The thread calling \ref mg_session_fetch
+///    then only receives the rows, reading ahead those the server has already
+///    sent, while the other threads decode them. Rows are still returned in
+///    order, and each one stays valid until the next fetch. This lets a single
+///    session use more than one core for big results. Rows fetched by \ref
+///    mg_session_fetch_lazy aren't decoded ahead. Threads aren't available in
+///    WebAssembly builds, where the option is ignored. The decoding threads
+///    allocate the rows through the allocator set by \ref mg_set_allocator,
+///    which therefore has to be thread-safe, rather than through the
+///    allocator of the session, which may be a thread allocator (see \ref
+///    mg_set_thread_allocator). Default is 0, which means that rows are
+///    decoded by the thread fetching them.
+///
+///  - collect_stats
+///
+///    If non-zero, the session keeps the statistics returned by \ref
+///    mg_session_get_stats. Timing them costs a couple of clock reads per
+///    received message, so they are off by default.
+///
+///  - trace_callback
+///
+///    A pointer to a function of prototype:
+///       void trace_callback(enum mg_trace_event event, int64_t query_id,
+///                           uint64_t timestamp_ns, void *trace_data);
+///
+///    It is called by the session on each of \ref mg_trace_event, from the
+///    thread using the session, which makes it possible to turn queries into
+///    tracing spans. Default is NULL, in which case tracing costs a single
+///    check per event.
+///
+///  - trace_data
+///
+///    Additional data that will be provided to trace_callback function.
 typedef struct mg_session_params mg_session_params;
 
 /// Prototype of the callback function for verifying an SSL connection by user.
 typedef int (*mg_trust_callback_type)(const char *, const char *, const char *,
                                       const char *, void *);
 
+/// Events in the lifetime of a session, reported to the `trace_callback` of
+/// \ref mg_session_params.
+///
+/// Query events carry the number of the query within the session, starting
+/// from 1 for the first query run. Connection events carry 0.
+enum mg_trace_event {
+  /// The connection to the server is established (after the SSL handshake,
+  /// if any).
+  MG_TRACE_EVENT_CONNECT,
+  /// The Bolt protocol version is agreed on.
+  MG_TRACE_EVENT_HANDSHAKE,
+  /// A RUN message is written. Unless the session is buffering messages, it
+  /// is sent to the server at the same time.
+  MG_TRACE_EVENT_RUN_SENT,
+  /// The server accepted the query.
+  MG_TRACE_EVENT_RUN_SUCCESS,
+  /// The first result row of the query is fetched.
+  MG_TRACE_EVENT_FIRST_RECORD,
+  /// The summary of the query is fetched, after all of its rows.
+  MG_TRACE_EVENT_SUCCESS,
+  /// The query failed.
+  MG_TRACE_EVENT_FAILURE
+};
+
+/// Prototype of the callback function for tracing session events. The time
+/// is taken from a monotonic clock, in nanoseconds.
+typedef void (*mg_trace_callback_type)(enum mg_trace_event event,
+                                       int64_t query_id, uint64_t timestamp_ns,
+                                       void *trace_data);
+
 /// Creates a new `mg_session_params` object.
 MGCLIENT_EXPORT mg_session_params *mg_session_params_make(void);
 
@@ -1260,6 +1554,30 @@ MGCLIENT_EXPORT void mg_session_params_set_trust_callback(
     mg_session_params *, mg_trust_callback_type trust_callback);
 MGCLIENT_EXPORT void mg_session_params_set_trust_data(mg_session_params *,
                                                       void *trust_data);
+MGCLIENT_EXPORT void mg_session_params_set_fetch_size(mg_session_params *,
+                                                      int64_t fetch_size);
+MGCLIENT_EXPORT void mg_session_params_set_decoder_limits(
+    mg_session_params *, size_t max_block_size, size_t spare_blocks);
+MGCLIENT_EXPORT void mg_session_params_set_message_limits(
+    mg_session_params *, size_t max_message_size, int shrink_after);
+MGCLIENT_EXPORT void mg_session_params_set_io_backend(
+    mg_session_params *, enum mg_io_backend io_backend);
+MGCLIENT_EXPORT void mg_session_params_set_ktls(mg_session_params *,
+                                                int ktls);
+MGCLIENT_EXPORT void mg_session_params_set_decode_threads(
+    mg_session_params *, int decode_threads);
+MGCLIENT_EXPORT void mg_session_params_set_collect_stats(
+    mg_session_params *, int collect_stats);
+MGCLIENT_EXPORT void mg_session_params_set_trace_callback(
+    mg_session_params *, mg_trace_callback_type trace_callback);
+MGCLIENT_EXPORT void mg_session_params_set_trace_data(mg_session_params *,
+                                                      void *trace_data);
+MGCLIENT_EXPORT void mg_session_params_set_connect_timeout(
+    mg_session_params *, int connect_timeout_ms);
+MGCLIENT_EXPORT void mg_session_params_set_dns_cache_ttl(
+    mg_session_params *, int dns_cache_ttl_ms);
+MGCLIENT_EXPORT void mg_session_params_set_query_timeout(
+    mg_session_params *, int query_timeout_ms);
 
 MGCLIENT_EXPORT const char *mg_session_params_get_address(
     const mg_session_params *);
@@ -1282,6 +1600,33 @@ MGCLIENT_EXPORT mg_trust_callback_type
 mg_session_params_get_trust_callback(const mg_session_params *params);
 MGCLIENT_EXPORT void *mg_session_params_get_trust_data(
     const mg_session_params *);
+MGCLIENT_EXPORT int64_t mg_session_params_get_fetch_size(
+    const mg_session_params *);
+MGCLIENT_EXPORT size_t mg_session_params_get_decoder_max_block_size(
+    const mg_session_params *);
+MGCLIENT_EXPORT size_t mg_session_params_get_decoder_spare_blocks(
+    const mg_session_params *);
+MGCLIENT_EXPORT size_t mg_session_params_get_max_message_size(
+    const mg_session_params *);
+MGCLIENT_EXPORT int mg_session_params_get_shrink_after(
+    const mg_session_params *);
+MGCLIENT_EXPORT enum mg_io_backend mg_session_params_get_io_backend(
+    const mg_session_params *);
+MGCLIENT_EXPORT int mg_session_params_get_ktls(const mg_session_params *);
+MGCLIENT_EXPORT int mg_session_params_get_decode_threads(
+    const mg_session_params *);
+MGCLIENT_EXPORT int mg_session_params_get_collect_stats(
+    const mg_session_params *);
+MGCLIENT_EXPORT mg_trace_callback_type
+mg_session_params_get_trace_callback(const mg_session_params *params);
+MGCLIENT_EXPORT void *mg_session_params_get_trace_data(
+    const mg_session_params *);
+MGCLIENT_EXPORT int mg_session_params_get_connect_timeout(
+    const mg_session_params *);
+MGCLIENT_EXPORT int mg_session_params_get_dns_cache_ttl(
+    const mg_session_params *);
+MGCLIENT_EXPORT int mg_session_params_get_query_timeout(
+    const mg_session_params *);
 
 /// Makes a new connection to the database server.
 ///
@@ -1309,6 +1654,49 @@ MGCLIENT_EXPORT int mg_session_status(const mg_session *session);
 /// Obtains the error message stored in \ref mg_session (if any).
 MGCLIENT_EXPORT const char *mg_session_error(mg_session *session);
 
+/// Statistics of a \ref mg_session, counted from the start of the connection.
+///
+/// They tell apart the time spent waiting for the network, the time spent by
+/// the server (as reported by it) and the time spent decoding results.
+typedef struct mg_session_stats {
+  /// Bytes sent and received, including chunk headers.
+  uint64_t bytes_sent;
+  uint64_t bytes_received;
+  /// Chunks of Bolt messages sent and received, not counting the end of
+  /// message markers.
+  uint64_t chunks_sent;
+  uint64_t chunks_received;
+  /// Calls into the transport to send or receive data. For plain sockets,
+  /// each one is usually a single system call.
+  uint64_t send_calls;
+  uint64_t recv_calls;
+  /// Nanoseconds spent waiting for data from the server.
+  uint64_t read_wait_ns;
+  /// Nanoseconds spent decoding received messages, including the time spent
+  /// by decoding threads (see `decode_threads` in \ref mg_session_params).
+  uint64_t decode_ns;
+  /// Bytes allocated for decoded values.
+  uint64_t decoder_bytes_allocated;
+  /// Result rows returned by \ref mg_session_fetch and \ref
+  /// mg_session_fetch_lazy.
+  uint64_t rows_fetched;
+  /// Milliseconds the server took until the first row of the last query was
+  /// available (`t_first`) and until its last row was sent (`t_last`), as
+  /// reported in the response metadata. -1 if the server didn't report them.
+  int64_t t_first;
+  int64_t t_last;
+} mg_session_stats;
+
+/// Obtains the statistics of a \ref mg_session.
+///
+/// \param      session A \ref mg_session connected with `collect_stats` set.
+/// \param[out] stats   The statistics are written here.
+///
+/// \return Returns 0 on success, or \ref MG_ERROR_BAD_CALL if the session
+///         doesn't collect statistics.
+MGCLIENT_EXPORT int mg_session_get_stats(const mg_session *session,
+                                         mg_session_stats *stats);
+
 /// Destroys a \ref mg_session and releases all of its resources.
 MGCLIENT_EXPORT void mg_session_destroy(mg_session *session);
 
@@ -1318,6 +1706,14 @@ MGCLIENT_EXPORT void mg_session_destroy(mg_session *session);
 /// mg_result.
 typedef struct mg_result mg_result;
 
+/// A result row whose fields are decoded only when accessed.
+///
+/// Obtained by \ref mg_result_row_lazy on a result returned from \ref
+/// mg_session_fetch_lazy. It only records where each field starts in the
+/// received message, so fields that are never accessed aren't decoded at all.
+/// Its lifetime is the same as the lifetime of the parent \ref mg_result.
+typedef struct mg_lazy_row mg_lazy_row;
+
 /// Submits a query to the server for execution.
 ///
 /// All records from the previous query must be pulled before executing the
@@ -1363,6 +1759,229 @@ MGCLIENT_EXPORT int mg_session_run(mg_session *session, const char *query,
                                    const mg_map *extra_run_information,
                                    const mg_list **columns, int64_t *qid);
 
+/// Submits a query to the server for execution and pulls its results.
+///
+/// Equivalent to calling \ref mg_session_run followed by \ref mg_session_pull,
+/// except that both requests are sent together, before waiting for the server
+/// to respond to the first one. This saves a network round trip per query.
+/// On success, results can be fetched right away using \ref mg_session_fetch.
+///
+/// \param session               A \ref mg_session to be used for query
+///                              execution.
+/// \param query                 Query string.
+/// \param params                A \ref mg_map containing query parameters. NULL
+///                              can be supplied instead of an empty parameter
+///                              map.
+/// \param extra_run_information A \ref mg_map containing extra information for
+///                              running the statement, same as in
+///                              \ref mg_session_run.
+/// \param pull_information      A \ref mg_map containing extra information for
+///                              pulling the results, same as in
+///                              \ref mg_session_pull.
+/// \param columns               Names of the columns output by the query
+///                              execution will be stored in here. NULL can be
+///                              supplied if we're not interested in the
+///                              columns names.
+/// \param qid                   QID for the statement will be stored in here
+///                              if an Explicit transaction was started.
+/// \return Returns 0 if query was submitted for execution successfuly.
+///         Otherwise, a non-zero error code is returned.
+MGCLIENT_EXPORT int mg_session_run_and_pull(mg_session *session,
+                                            const char *query,
+                                            const mg_map *params,
+                                            const mg_map *extra_run_information,
+                                            const mg_map *pull_information,
+                                            const mg_list **columns,
+                                            int64_t *qid);
+
+/// Queues a query for pipelined execution.
+///
+/// The query and the request for all of its results are written to the
+/// session's output buffer, but nothing is sent to the server until results
+/// are requested using \ref mg_session_pipeline_next (or the buffer fills up).
+/// Any number of queries can be queued this way, so that they all get sent in
+/// a single write and executed without waiting for a round trip each.
+///
+/// Queries can be queued while results of another query are being fetched,
+/// unless those results are being pulled in batches. Results of queued
+/// queries are always pulled at once, regardless of `fetch_size`.
+/// No other query can be run, nor a transaction started or ended, until
+/// responses to all queued queries have been consumed.
+///
+/// \param session               A \ref mg_session to be used for query
+///                              execution.
+/// \param query                 Query string.
+/// \param params                A \ref mg_map containing query parameters. NULL
+///                              can be supplied instead of an empty parameter
+///                              map.
+/// \param extra_run_information A \ref mg_map containing extra information for
+///                              running the statement, same as in
+///                              \ref mg_session_run.
+/// \return Returns 0 if query was queued successfuly. Otherwise, a non-zero
+///         error code is returned.
+MGCLIENT_EXPORT int mg_session_pipeline_run(mg_session *session,
+                                            const char *query,
+                                            const mg_map *params,
+                                            const mg_map *extra_run_information);
+
+/// Obtains the response to the next query queued using
+/// \ref mg_session_pipeline_run.
+///
+/// Queries are answered in the order they were queued. On success, results of
+/// the query can be fetched using \ref mg_session_fetch, and they have to be
+/// fetched completely before moving on to the next query.
+///
+/// If the query fails, the server doesn't execute any of the queries queued
+/// after it and all of them are discarded.
+///
+/// \param session A \ref mg_session with queued queries.
+/// \param columns Names of the columns output by the query execution will be
+///                stored in here. NULL can be supplied if we're not interested
+///                in the columns names.
+/// \param qid     QID for the statement will be stored in here if an Explicit
+///                transaction was started.
+/// \return Returns 0 if the query was executed successfuly. Otherwise, a
+///         non-zero error code is returned.
+MGCLIENT_EXPORT int mg_session_pipeline_next(mg_session *session,
+                                             const mg_list **columns,
+                                             int64_t *qid);
+
+/// Returns the number of queued queries whose responses haven't been obtained
+/// using \ref mg_session_pipeline_next yet.
+MGCLIENT_EXPORT int mg_session_pipeline_pending(const mg_session *session);
+
+/// Sends queries queued using \ref mg_session_pipeline_run to the server
+/// without waiting for any of the responses, so that the server can start
+/// executing them.
+///
+/// A non-blocking session sends only what can be sent right away, and returns
+/// MG_WANT_WRITE if there is more to send. The rest is sent by the next call.
+///
+/// \return Returns 0 if everything was sent. Otherwise, a non-zero error code
+///         is returned.
+MGCLIENT_EXPORT int mg_session_pipeline_flush(mg_session *session);
+
+/// A query statement encoded once, to be run any number of times with
+/// different parameters.
+///
+/// Running a prepared query skips encoding the statement, so that only the
+/// parameters are serialized on each run. This matters for long statements
+/// which are run many times, such as batched writes.
+///
+/// A prepared query doesn't belong to any session and isn't modified by
+/// running it, so it can be shared between sessions and threads.
+typedef struct mg_prepared_query mg_prepared_query;
+
+/// Prepares the given query statement.
+///
+/// \return A pointer to the prepared query, or NULL if there wasn't enough
+///         memory or the statement is too long to be sent.
+MGCLIENT_EXPORT mg_prepared_query *mg_prepared_query_make(const char *query);
+
+/// Destroys the given prepared query.
+MGCLIENT_EXPORT void mg_prepared_query_destroy(mg_prepared_query *prepared);
+
+/// Same as \ref mg_session_run, with the statement given as a prepared query.
+MGCLIENT_EXPORT int mg_session_run_prepared(
+    mg_session *session, const mg_prepared_query *prepared,
+    const mg_map *params, const mg_map *extra_run_information,
+    const mg_list **columns, int64_t *qid);
+
+/// Same as \ref mg_session_run_and_pull, with the statement given as a
+/// prepared query.
+MGCLIENT_EXPORT int mg_session_run_and_pull_prepared(
+    mg_session *session, const mg_prepared_query *prepared,
+    const mg_map *params, const mg_map *extra_run_information,
+    const mg_map *pull_information, const mg_list **columns, int64_t *qid);
+
+/// Same as \ref mg_session_pipeline_run, with the statement given as a
+/// prepared query.
+MGCLIENT_EXPORT int mg_session_pipeline_run_prepared(
+    mg_session *session, const mg_prepared_query *prepared,
+    const mg_map *params, const mg_map *extra_run_information);
+
+/// Writes query parameters straight into the output buffer of a session.
+///
+/// Building an \ref mg_map of parameters allocates a value for each of its
+/// entries, only for all of them to be encoded and destroyed right away. For
+/// large parameters, such as the list of rows of a bulk insert, the
+/// parameters can instead be written one value at a time by a callback passed
+/// to \ref mg_session_run_and_pull_with_writer or
+/// \ref mg_session_pipeline_run_with_writer.
+///
+/// Lists and maps are written as a header, followed by their elements or by
+/// their keys and values in turn.
+typedef struct mg_param_writer mg_param_writer;
+
+/// Writes query parameters using `writer`, see \ref mg_param_writer.
+///
+/// The callback has to write exactly one map. It returns 0 on success and a
+/// non-zero error code otherwise, usually the error returned by one of the
+/// `mg_param_writer_*` functions.
+typedef int (*mg_param_writer_callback)(mg_param_writer *writer, void *data);
+
+MGCLIENT_EXPORT int mg_param_writer_write_null(mg_param_writer *writer);
+
+MGCLIENT_EXPORT int mg_param_writer_write_bool(mg_param_writer *writer,
+                                               int value);
+
+MGCLIENT_EXPORT int mg_param_writer_write_integer(mg_param_writer *writer,
+                                                  int64_t value);
+
+MGCLIENT_EXPORT int mg_param_writer_write_float(mg_param_writer *writer,
+                                                double value);
+
+/// Writes a string of `len` bytes, which doesn't have to be null-terminated.
+MGCLIENT_EXPORT int mg_param_writer_write_string(mg_param_writer *writer,
+                                                 size_t len, const char *data);
+
+/// Starts a list, which has to be followed by `size` values.
+MGCLIENT_EXPORT int mg_param_writer_begin_list(mg_param_writer *writer,
+                                               uint32_t size);
+
+/// Starts a map, which has to be followed by `size` pairs of a string key and
+/// a value.
+MGCLIENT_EXPORT int mg_param_writer_begin_map(mg_param_writer *writer,
+                                              uint32_t size);
+
+/// Writes a value of any of the types which can be sent to the server.
+MGCLIENT_EXPORT int mg_param_writer_write_value(mg_param_writer *writer,
+                                                const mg_value *value);
+
+/// Same as \ref mg_session_run_and_pull, with the parameters written by
+/// `write_params`, which gets called with `params_data` while the query is
+/// being sent.
+///
+/// If `write_params` fails, the error it returned is returned and the session
+/// can't be used anymore, since the query was only partially sent.
+MGCLIENT_EXPORT int mg_session_run_and_pull_with_writer(
+    mg_session *session, const char *query,
+    mg_param_writer_callback write_params, void *params_data,
+    const mg_map *extra_run_information, const mg_map *pull_information,
+    const mg_list **columns, int64_t *qid);
+
+/// Same as \ref mg_session_run_and_pull_with_writer, with the statement given
+/// as a prepared query.
+MGCLIENT_EXPORT int mg_session_run_and_pull_prepared_with_writer(
+    mg_session *session, const mg_prepared_query *prepared,
+    mg_param_writer_callback write_params, void *params_data,
+    const mg_map *extra_run_information, const mg_map *pull_information,
+    const mg_list **columns, int64_t *qid);
+
+/// Same as \ref mg_session_pipeline_run, with the parameters written by
+/// `write_params`, see \ref mg_session_run_and_pull_with_writer.
+MGCLIENT_EXPORT int mg_session_pipeline_run_with_writer(
+    mg_session *session, const char *query,
+    mg_param_writer_callback write_params, void *params_data,
+    const mg_map *extra_run_information);
+
+/// Same as \ref mg_session_pipeline_run_with_writer, with the statement given
+/// as a prepared query.
+MGCLIENT_EXPORT int mg_session_pipeline_run_prepared_with_writer(
+    mg_session *session, const mg_prepared_query *prepared,
+    mg_param_writer_callback write_params, void *params_data,
+    const mg_map *extra_run_information);
+
 /// Starts an Explicit transaction on the server.
 ///
 /// Every run will be part of that transaction until its explicitly ended.
@@ -1415,6 +2034,90 @@ MGCLIENT_EXPORT int mg_session_commit_transaction(mg_session *session,
 MGCLIENT_EXPORT int mg_session_rollback_transaction(mg_session *session,
                                                     mg_result **result);
 
+/// Resets the session to a clean state.
+///
+/// Sends RESET to the server, which rolls back the open transaction (if any)
+/// and clears the state of the connection on the server. Useful for checking
+/// that an idle session is still alive before reusing it.
+///
+/// \return Returns 0 if the session was reset successfully. Otherwise, a
+///         non-zero error code is returned and the session is no longer
+///         usable (unless the error is \ref MG_ERROR_BAD_CALL, returned when
+///         a query is still executing).
+MGCLIENT_EXPORT int mg_session_reset(mg_session *session);
+
+/// Returns the socket used by \ref mg_session, or -1 if it isn't known.
+///
+/// Meant for registering the session with an event loop (epoll, kqueue,
+/// poll, ...) when it's used in non-blocking mode. The socket is owned by the
+/// session and must not be read from, written to or closed.
+MGCLIENT_EXPORT int mg_session_socket(const mg_session *session);
+
+/// Switches \ref mg_session into non-blocking mode, or back to blocking mode
+/// when \p nonblocking is 0.
+///
+/// In non-blocking mode, \ref mg_session_pipeline_next, \ref mg_session_fetch
+/// and \ref mg_session_fetch_lazy never wait for the network. When a response
+/// hasn't been received completely yet, they return \ref MG_WANT_READ, or
+/// \ref MG_WANT_WRITE if part of the request still waits to be sent. The
+/// session stays usable, and the same call should be repeated once \ref
+/// mg_session_socket becomes readable (or writable). Responses are decoded only
+/// after they've been received completely, so no decoding work is repeated.
+/// Requests that can't be sent right away wait in the output buffer, which
+/// grows as needed.
+///
+/// A query is executed without blocking by queuing it with \ref
+/// mg_session_pipeline_run, calling \ref mg_session_pipeline_next until it
+/// returns the result columns, and calling \ref mg_session_fetch until it
+/// returns 0. This way, a single thread can drive many sessions.
+///
+/// Connecting, as well as all other functions that talk to the server (\ref
+/// mg_session_run, \ref mg_session_begin_transaction, \ref mg_session_reset,
+/// ...), still wait for their responses.
+///
+/// \return Returns 0 if the mode was changed successfully. Otherwise, a
+///         non-zero error code is returned.
+MGCLIENT_EXPORT int mg_session_set_nonblocking(mg_session *session,
+                                               int nonblocking);
+
+/// Bounds the time \ref mg_session waits for the server to respond to a
+/// query, in milliseconds, or removes the bound if \p timeout_ms is 0.
+///
+/// The time is measured from the moment the query (or a transaction
+/// statement, or RESET) is sent, and includes fetching all of its results, so
+/// a query has to complete within it. When it runs out while waiting for the
+/// next response, the call fails with \ref MG_ERROR_TIMEOUT. The server is
+/// then asked to stop the query, the rest of its responses are skipped, and
+/// the session is ready for the next query, as it would be after \ref
+/// mg_session_reset (an open transaction is rolled back). Skipping the
+/// responses gets another \p timeout_ms. If that isn't enough, or the time
+/// runs out in the middle of a response, the session becomes unusable.
+///
+/// While the timeout is set, the socket of the session is kept in
+/// non-blocking mode, which also lets \ref mg_session_cancel interrupt a wait
+/// for the server.
+///
+/// Responses received by decoding threads (see `decode_threads` in \ref
+/// mg_session_params) can't be skipped, so a timeout or cancellation leaves
+/// such a session unusable.
+///
+/// \return Returns 0 if the timeout was set successfully. Otherwise, a
+///         non-zero error code is returned.
+MGCLIENT_EXPORT int mg_session_set_query_timeout(mg_session *session,
+                                                 int timeout_ms);
+
+/// Cancels the query that \ref mg_session is executing, if any. Unlike other
+/// functions, it can be called from any thread while another thread uses the
+/// session.
+///
+/// The call waiting for the query response fails with \ref
+/// MG_ERROR_CANCELLED, and the session is left as after a timeout (see \ref
+/// mg_session_set_query_timeout). Without a query timeout, an ongoing wait for
+/// the server isn't interrupted, and the cancellation takes effect when the
+/// next response arrives. Cancellations made while no query is executing are
+/// ignored.
+MGCLIENT_EXPORT void mg_session_cancel(mg_session *session);
+
 /// Tries to fetch the next query result from \ref mg_session.
 ///
 /// The owner of the returned result is \ref mg_session \p session, and the
@@ -1428,6 +2131,15 @@ MGCLIENT_EXPORT int mg_session_rollback_transaction(mg_session *session,
 ///         mg_result_summary. On failure, a non-zero exit code is returned.
 MGCLIENT_EXPORT int mg_session_fetch(mg_session *session, mg_result **result);
 
+/// Same as \ref mg_session_fetch, except that a result row isn't decoded.
+///
+/// When 1 is returned, fields of the obtained row are accessed using \ref
+/// mg_result_row_lazy and \ref mg_lazy_row_at, while \ref mg_result_row
+/// returns NULL. Fields are decoded on first access. This is useful when only a
+/// few of many (or large) returned values are needed.
+MGCLIENT_EXPORT int mg_session_fetch_lazy(mg_session *session,
+                                          mg_result **result);
+
 /// Tries to pull results of a statement.
 ///
 /// \param session          A \ref mg_session from which the results should be
@@ -1441,11 +2153,69 @@ MGCLIENT_EXPORT int mg_session_fetch(mg_session *session, mg_result **result);
 ///                          from which statement the results should be pulled.
 ///                          `qid=-1` denotes the last executed statement. This
 ///                          is only for Explicit transactions.
+///                         If NULL is supplied, records are pulled in batches
+///                         of `fetch_size` (see \ref mg_session_params) and
+///                         \ref mg_session_fetch requests the next batch
+///                         automatically.
 /// \return Returns 0 if the result was pulled successfuly.
 ///         Otherwise, a non-zero error code is returned.
 MGCLIENT_EXPORT int mg_session_pull(mg_session *session,
                                     const mg_map *pull_information);
 
+/// Discards the rest of the results of a statement, returning its summary.
+///
+/// If the results weren't pulled yet (after \ref mg_session_run), DISCARD is
+/// sent instead of PULL, and the server drops them without sending them. If
+/// they are pulled in batches (see `fetch_size` in \ref mg_session_params),
+/// the rest of the current batch is skipped and DISCARD is sent instead of
+/// the next PULL. Rows already requested still have to be received, but they
+/// are skipped without being decoded.
+///
+/// \param session             A \ref mg_session executing a statement, or
+///                            fetching its results.
+/// \param discard_information A \ref mg_map with the same contents as the
+///                            `pull_information` of \ref mg_session_pull,
+///                            used only if the results weren't pulled yet. If
+///                            NULL is supplied, all of them are discarded.
+/// \param result              Set to the summary when 0 is returned, as by
+///                            \ref mg_session_fetch.
+/// \return Returns 0 if the results were discarded successfully. In
+///         non-blocking mode (see \ref mg_session_set_nonblocking), \ref
+///         MG_WANT_READ or \ref MG_WANT_WRITE may be returned, in which case
+///         the call should be repeated. Otherwise, a non-zero error code is
+///         returned.
+MGCLIENT_EXPORT int mg_session_discard(mg_session *session,
+                                       const mg_map *discard_information,
+                                       mg_result **result);
+
+/// Writes the rest of the results of a statement to a file, returning its
+/// summary. The file can be read back by \ref mg_replay_open.
+///
+/// Rows are written as they were received, without decoding them, each one
+/// prefixed by its size, after the names of the columns. This is much cheaper
+/// than converting the rows to some other format, and they are decoded from
+/// the file in the same way as from the network. If writing a row fails, the
+/// rest of them is discarded (see \ref mg_session_discard) and \ref
+/// MG_ERROR_FILE_FAILURE is returned once the summary is received. Rows
+/// already fetched by \ref mg_session_fetch aren't written.
+///
+/// \param session A \ref mg_session fetching the results of a statement (see
+///                \ref mg_session_pull).
+/// \param path    Path of the file, which is overwritten if it exists. The
+///                file is closed before the call returns, unless \ref
+///                MG_WANT_READ or \ref MG_WANT_WRITE is returned, in which
+///                case the repeated call continues writing to the same file
+///                and \p path is ignored.
+/// \param result  Set to the summary when 0 is returned, as by \ref
+///                mg_session_fetch.
+/// \return Returns 0 if the results were written successfully. In
+///         non-blocking mode (see \ref mg_session_set_nonblocking), \ref
+///         MG_WANT_READ or \ref MG_WANT_WRITE may be returned, in which case
+///         the call should be repeated. Otherwise, a non-zero error code is
+///         returned.
+MGCLIENT_EXPORT int mg_session_dump(mg_session *session, const char *path,
+                                    mg_result **result);
+
 /// Returns names of columns output by the current query execution.
 MGCLIENT_EXPORT const mg_list *mg_result_columns(const mg_result *result);
 
@@ -1455,6 +2225,166 @@ MGCLIENT_EXPORT const mg_list *mg_result_row(const mg_result *result);
 /// Returns query execution summary.
 MGCLIENT_EXPORT const mg_map *mg_result_summary(const mg_result *result);
 
+/// A copy of a result row that is independent of the \ref mg_session it came
+/// from.
+typedef struct mg_row mg_row;
+
+/// Copies column values of current result row, so that they outlive the next
+/// call to \ref mg_session_fetch.
+///
+/// Unlike \ref mg_list_copy, which allocates every copied value separately,
+/// the whole row is copied into a memory pool sized after the decoded row
+/// (usually a single block), which is released all at once by \ref
+/// mg_row_destroy.
+///
+/// \return A pointer to the copied row, or NULL if \p result doesn't contain a
+///         result row or an error occurred.
+MGCLIENT_EXPORT mg_row *mg_result_row_copy(const mg_result *result);
+
+/// Returns column values of a copied result row. The returned list is owned by
+/// the row.
+MGCLIENT_EXPORT const mg_list *mg_row_values(const mg_row *row);
+
+/// Destroys a copied result row and all of its values.
+MGCLIENT_EXPORT void mg_row_destroy(mg_row *row);
+
+/// A memory pool for result rows decoded by \ref mg_session_fetch, which are
+/// released all at once.
+///
+/// While an arena is set by \ref mg_session_set_arena, result rows are decoded
+/// into it instead of the session's own memory, so that they stay valid after
+/// subsequent fetches until the arena is reset or destroyed. This makes it
+/// possible to keep a whole result set (or a batch of rows) without copying
+/// any of its values, and without freeing them one by one.
+typedef struct mg_arena mg_arena;
+
+/// Constructs an arena that allocates memory in blocks of \p block_size bytes,
+/// or of a default size if \p block_size is 0. Block size grows as needed.
+///
+/// \return A pointer to the arena, or NULL if an error occurred.
+MGCLIENT_EXPORT mg_arena *mg_arena_make(size_t block_size);
+
+/// Releases all rows decoded into the arena. Part of its memory is kept for
+/// the rows decoded next.
+MGCLIENT_EXPORT void mg_arena_reset(mg_arena *arena);
+
+/// Destroys the arena and all rows decoded into it.
+MGCLIENT_EXPORT void mg_arena_destroy(mg_arena *arena);
+
+/// Sets the arena into which result rows returned by \ref mg_session_fetch are
+/// decoded, or decodes them into the session's own memory again if \p arena is
+/// NULL.
+///
+/// A row returned by \ref mg_result_row while an arena is set is valid until
+/// the arena is reset or destroyed. The arena may be reset at any time, but it
+/// mustn't be destroyed before it's unset or the session is destroyed. Query
+/// summaries, and rows fetched by \ref mg_session_fetch_lazy, aren't
+/// affected. Rows aren't decoded ahead by decoding threads while an arena is
+/// set (see \ref mg_session_params_set_decode_threads).
+///
+/// \return Returns 0 on success, or a non-zero error code if \p session is
+///         bad.
+MGCLIENT_EXPORT int mg_session_set_arena(mg_session *session, mg_arena *arena);
+
+/// Returns the current result row obtained by \ref mg_session_fetch_lazy, or
+/// NULL if \p result doesn't contain a lazily decoded row.
+MGCLIENT_EXPORT mg_lazy_row *mg_result_row_lazy(mg_result *result);
+
+/// Returns the number of fields in a lazily decoded result row.
+MGCLIENT_EXPORT uint32_t mg_lazy_row_size(const mg_lazy_row *row);
+
+/// Decodes the field at position \p pos of a result row, if it wasn't decoded
+/// already.
+///
+/// The returned value is owned by the row and its lifetime is the same as the
+/// lifetime of the row.
+///
+/// \return Returns 0 on success and stores the field in \p value. Returns
+///         \ref MG_ERROR_BAD_CALL if \p pos is out of range. Otherwise, the
+///         field couldn't be decoded, a non-zero error code is returned and the
+///         session is no longer usable.
+MGCLIENT_EXPORT int mg_lazy_row_at(mg_lazy_row *row, uint32_t pos,
+                                   const mg_value **value);
+
+/// Returns the type of the field at position \p pos of a result row, without
+/// decoding it, or \ref MG_VALUE_TYPE_UNKNOWN if \p pos is out of range.
+MGCLIENT_EXPORT enum mg_value_type mg_lazy_row_type_at(const mg_lazy_row *row,
+                                                       uint32_t pos);
+
+/// Reads the field at position \p pos of a result row as a boolean, straight
+/// from the received message, without creating a \ref mg_value.
+///
+/// This and the following functions are meant for rows whose layout is known
+/// ahead, see \ref mg_lazy_row_type_at.
+///
+/// \return Returns 0 on success and stores the field in \p value. Returns
+///         \ref MG_ERROR_BAD_CALL if \p pos is out of range and
+///         \ref MG_ERROR_TYPE_MISMATCH if the field isn't a boolean, in which
+///         case the row remains usable. Otherwise, the field couldn't be
+///         decoded, a non-zero error code is returned and the session is no
+///         longer usable.
+MGCLIENT_EXPORT int mg_lazy_row_bool_at(mg_lazy_row *row, uint32_t pos,
+                                        int *value);
+
+/// Reads the field at position \p pos of a result row as an integer. Returns
+/// the same as \ref mg_lazy_row_bool_at.
+MGCLIENT_EXPORT int mg_lazy_row_integer_at(mg_lazy_row *row, uint32_t pos,
+                                           int64_t *value);
+
+/// Reads the field at position \p pos of a result row as a float. Returns the
+/// same as \ref mg_lazy_row_bool_at.
+MGCLIENT_EXPORT int mg_lazy_row_float_at(mg_lazy_row *row, uint32_t pos,
+                                         double *value);
+
+/// Reads the field at position \p pos of a result row as a string. Returns
+/// the same as \ref mg_lazy_row_bool_at.
+///
+/// The string isn't null-terminated and \p data points into the received
+/// message, so it is only valid as long as the row.
+MGCLIENT_EXPORT int mg_lazy_row_string_at(mg_lazy_row *row, uint32_t pos,
+                                          const char **data, uint32_t *size);
+
+/// Result rows read from a file written by \ref mg_session_dump.
+///
+/// The file is mapped into memory, and each row is decoded directly from it
+/// when fetched, into memory that is reused for the next one. String values
+/// point into the mapped file instead of being copied. This makes replaying a
+/// result about as cheap as decoding it after it's received from the server,
+/// without the server.
+typedef struct mg_replay mg_replay;
+
+/// Opens a file written by \ref mg_session_dump for reading.
+///
+/// \return Returns 0 on success and stores the replay to \p replay. Returns
+///         \ref MG_ERROR_FILE_FAILURE if the file couldn't be opened or
+///         mapped, and \ref MG_ERROR_DECODING_FAILED if it isn't a result
+///         dump. Otherwise, a non-zero error code is returned.
+MGCLIENT_EXPORT int mg_replay_open(const char *path, mg_replay **replay);
+
+/// Returns names of the columns of the result. The returned list is owned by
+/// the replay.
+MGCLIENT_EXPORT const mg_list *mg_replay_columns(const mg_replay *replay);
+
+/// Decodes the next row of the result.
+///
+/// The row is owned by the replay and is valid until the next call to \ref
+/// mg_replay_fetch, or until the replay is destroyed.
+///
+/// \return Returns 1 and stores the row in \p row if there was a row left.
+///         Returns 0 when there are no more rows. Otherwise, the file is
+///         malformed and a non-zero error code is returned, and the error
+///         message can be obtained by calling \ref mg_replay_error.
+MGCLIENT_EXPORT int mg_replay_fetch(mg_replay *replay, const mg_list **row);
+
+/// Starts fetching rows from the first one again.
+MGCLIENT_EXPORT void mg_replay_rewind(mg_replay *replay);
+
+/// Obtains the error message of the last failed call to \ref mg_replay_fetch.
+MGCLIENT_EXPORT const char *mg_replay_error(const mg_replay *replay);
+
+/// Unmaps the file and destroys the replay, including the last fetched row.
+MGCLIENT_EXPORT void mg_replay_destroy(mg_replay *replay);
+
 #ifdef __cplusplus
 }
 #endif
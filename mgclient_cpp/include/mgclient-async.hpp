@@ -0,0 +1,364 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "mgclient-async.hpp requires C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "mgclient.hpp"
+
+namespace mg {
+
+/// A lazily started coroutine producing a `T`. The coroutine runs when the
+/// task is awaited, and the awaiting coroutine is resumed once it's done.
+template <typename T>
+class Task final {
+ public:
+  struct promise_type {
+    std::optional<T> value;
+    std::exception_ptr exception;
+    std::coroutine_handle<> continuation{std::noop_coroutine()};
+
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept {
+      struct ResumeContinuation {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<promise_type> handle) noexcept {
+          return handle.promise().continuation;
+        }
+        void await_resume() noexcept {}
+      };
+      return ResumeContinuation{};
+    }
+    void return_value(T result) { value.emplace(std::move(result)); }
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+
+  Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+  Task &operator=(Task &&) = delete;
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+    handle_.promise().continuation = awaiting;
+    return handle_;
+  }
+  T await_resume() {
+    if (handle_.promise().exception) {
+      std::rethrow_exception(handle_.promise().exception);
+    }
+    return std::move(*handle_.promise().value);
+  }
+
+ private:
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/// An asynchronous generator of `T` values. Each `co_await Next()` resumes the
+/// generator until it yields the next value, which is returned, or finishes,
+/// in which case `std::nullopt` is returned.
+template <typename T>
+class AsyncGenerator final {
+ public:
+  struct promise_type {
+    std::optional<T> value;
+    std::exception_ptr exception;
+    std::coroutine_handle<> consumer{std::noop_coroutine()};
+
+    struct ResumeConsumer {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<promise_type> handle) noexcept {
+        return handle.promise().consumer;
+      }
+      void await_resume() noexcept {}
+    };
+
+    AsyncGenerator get_return_object() {
+      return AsyncGenerator(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    ResumeConsumer final_suspend() noexcept { return {}; }
+    ResumeConsumer yield_value(T next) {
+      value.emplace(std::move(next));
+      return {};
+    }
+    void return_void() {}
+    void unhandled_exception() { exception = std::current_exception(); }
+  };
+
+  AsyncGenerator(AsyncGenerator &&other) noexcept
+      : handle_(std::exchange(other.handle_, {})) {}
+  AsyncGenerator(const AsyncGenerator &) = delete;
+  AsyncGenerator &operator=(const AsyncGenerator &) = delete;
+  AsyncGenerator &operator=(AsyncGenerator &&) = delete;
+  ~AsyncGenerator() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  /// \brief Awaits the next value.
+  /// \pre the previous `Next()` has completed
+  auto Next() {
+    struct NextAwaiter {
+      std::coroutine_handle<promise_type> handle;
+
+      bool await_ready() const noexcept { return handle.done(); }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) {
+        handle.promise().consumer = consumer;
+        handle.promise().value.reset();
+        return handle;
+      }
+      std::optional<T> await_resume() {
+        if (handle.promise().exception) {
+          std::rethrow_exception(
+              std::exchange(handle.promise().exception, nullptr));
+        }
+        if (handle.done()) {
+          return std::nullopt;
+        }
+        return std::move(handle.promise().value);
+      }
+    };
+    return NextAwaiter{handle_};
+  }
+
+ private:
+  explicit AsyncGenerator(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/// \brief Starts `task` right away, without awaiting it.
+/// Once the task completes, `on_done` is called with its result, or with the
+/// exception it threw (and an empty result).
+template <typename T, typename F>
+void Spawn(Task<T> task, F on_done) {
+  struct Detached {
+    struct promise_type {
+      Detached get_return_object() { return {}; }
+      std::suspend_never initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+    };
+  };
+  [](Task<T> task, F on_done) -> Detached {
+    std::optional<T> result;
+    std::exception_ptr exception;
+    try {
+      result.emplace(co_await std::move(task));
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    on_done(std::move(exception), std::move(result));
+  }(std::move(task), std::move(on_done));
+}
+
+/// Socket readiness an `AsyncClient` waits for.
+enum class IoEvent { Read, Write };
+
+/// A client whose methods are coroutines, suspended instead of blocking while
+/// waiting for the network.
+///
+/// The client doesn't run an event loop of its own. When it has to wait, it
+/// calls the user-supplied `WaitFunction` with the session socket, the event
+/// to wait for and the suspended coroutine, which should be resumed once the
+/// socket is ready. With Asio that is e.g. `socket.async_wait(...)` calling
+/// `resume()` from the handler, with io_uring a `POLL_ADD` whose completion
+/// resumes the coroutine. The coroutine may be resumed on any thread, but the
+/// client must not be used by two coroutines at once.
+///
+/// Query failures are reported the same way as by `Client`: `Execute` returns
+/// false, and fetching throws `ClientException`, `TransientException` or
+/// `DatabaseException`.
+class AsyncClient final {
+ public:
+  using WaitFunction = std::function<void(int socket, IoEvent event,
+                                          std::coroutine_handle<> resume)>;
+
+  AsyncClient(const AsyncClient &) = delete;
+  AsyncClient(AsyncClient &&) = delete;
+  AsyncClient &operator=(const AsyncClient &) = delete;
+  AsyncClient &operator=(AsyncClient &&) = delete;
+  ~AsyncClient() = default;
+
+  /// \brief Connects an asynchronous client.
+  /// Connecting itself blocks, see `Client::Connect`.
+  /// \return pointer to the created client, or `nullptr` if the connection
+  /// couldn't be established.
+  static std::unique_ptr<AsyncClient> Connect(const Client::Params &params,
+                                              WaitFunction wait);
+
+  /// \brief Executes the given Cypher `statement`.
+  /// \return true when the statement is successfully executed, false
+  /// otherwise. As with `Client::Execute`, all results have to be fetched
+  /// before executing another statement.
+  Task<bool> Execute(std::string statement);
+
+  /// \brief Executes the given Cypher `statement`, supplied with additional
+  /// `params`, which have to stay alive until the returned task completes.
+  Task<bool> Execute(std::string statement, ConstMap params);
+
+  /// \brief Fetches the next result.
+  /// \return next result, or `std::nullopt` if there is nothing to fetch.
+  Task<std::optional<std::vector<Value>>> FetchOne();
+
+  /// \brief Fetches all results.
+  Task<std::optional<std::vector<std::vector<Value>>>> FetchAll();
+
+  /// \brief Returns an asynchronous generator of the remaining results.
+  AsyncGenerator<std::vector<Value>> Rows();
+
+  /// \brief Returns names of the result columns of the last executed
+  /// statement.
+  const std::vector<std::string> &GetColumns() const;
+
+ private:
+  AsyncClient(std::unique_ptr<Client> client, WaitFunction wait)
+      : client_(std::move(client)), wait_(std::move(wait)) {}
+
+  /// Suspends the awaiting coroutine until the session socket is ready for
+  /// what the non-blocking call returning `status` asked for.
+  auto WaitFor(int status) {
+    struct IoAwaiter {
+      AsyncClient *client;
+      IoEvent event;
+
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> resume) {
+        client->wait_(mg_session_socket(client->client_->session_), event,
+                      resume);
+      }
+      void await_resume() const noexcept {}
+    };
+    return IoAwaiter{this,
+                     status == MG_WANT_WRITE ? IoEvent::Write : IoEvent::Read};
+  }
+
+  Task<bool> Run(std::string statement, const mg_map *params);
+
+  /// Fetches the next result, returns `nullptr` if there is nothing to fetch.
+  Task<mg_result *> FetchResult();
+
+  std::unique_ptr<Client> client_;
+  WaitFunction wait_;
+};
+
+inline std::unique_ptr<AsyncClient> AsyncClient::Connect(
+    const Client::Params &params, WaitFunction wait) {
+  std::unique_ptr<Client> client = Client::Connect(params);
+  if (!client || mg_session_set_nonblocking(client->session_, 1) != 0) {
+    return nullptr;
+  }
+  // Using `new` to access private constructor.
+  return std::unique_ptr<AsyncClient>(
+      new AsyncClient(std::move(client), std::move(wait)));
+}
+
+inline Task<bool> AsyncClient::Execute(std::string statement) {
+  return Run(std::move(statement), nullptr);
+}
+
+inline Task<bool> AsyncClient::Execute(std::string statement,
+                                       ConstMap params) {
+  return Run(std::move(statement), params.ptr());
+}
+
+inline Task<bool> AsyncClient::Run(std::string statement,
+                                   const mg_map *params) {
+  mg_session *session = client_->session_;
+  int status =
+      mg_session_pipeline_run(session, statement.c_str(), params, nullptr);
+  if (status != 0) {
+    co_return false;
+  }
+  const mg_list *columns;
+  while ((status = mg_session_pipeline_next(session, &columns, nullptr)) ==
+             MG_WANT_READ ||
+         status == MG_WANT_WRITE) {
+    co_await WaitFor(status);
+  }
+  if (status != 0) {
+    co_return false;
+  }
+  client_->SetColumns(columns);
+  co_return true;
+}
+
+inline Task<mg_result *> AsyncClient::FetchResult() {
+  mg_session *session = client_->session_;
+  mg_result *result;
+  int status;
+  while ((status = mg_session_fetch(session, &result)) == MG_WANT_READ ||
+         status == MG_WANT_WRITE) {
+    co_await WaitFor(status);
+  }
+  Client::ThrowIfFailed(session, status);
+  co_return status == 1 ? result : nullptr;
+}
+
+inline Task<std::optional<std::vector<Value>>> AsyncClient::FetchOne() {
+  mg_result *result = co_await FetchResult();
+  if (!result) {
+    co_return std::nullopt;
+  }
+  co_return Client::RowValues(mg_result_row(result));
+}
+
+inline Task<std::optional<std::vector<std::vector<Value>>>>
+AsyncClient::FetchAll() {
+  std::vector<std::vector<Value>> data;
+  while (mg_result *result = co_await FetchResult()) {
+    data.push_back(Client::RowValues(mg_result_row(result)));
+  }
+  co_return data;
+}
+
+inline AsyncGenerator<std::vector<Value>> AsyncClient::Rows() {
+  while (mg_result *result = co_await FetchResult()) {
+    co_yield Client::RowValues(mg_result_row(result));
+  }
+}
+
+inline const std::vector<std::string> &AsyncClient::GetColumns() const {
+  return client_->GetColumns();
+}
+
+}  // namespace mg
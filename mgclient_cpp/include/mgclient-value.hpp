@@ -16,6 +16,7 @@
 
 #include <cstring>
 #include <initializer_list>
+#include <optional>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -210,6 +211,14 @@ class ConstList final {
   Iterator begin() const { return Iterator(this, 0); }
   Iterator end() const { return Iterator(this, size()); }
 
+  /// \brief Returns the elements as an array of `size()` integers, or
+  /// `nullptr` unless they're all integers, see `mg_list_integers`.
+  const int64_t *integers() const { return mg_list_integers(const_ptr_); }
+
+  /// \brief Returns the elements as an array of `size()` floats, or `nullptr`
+  /// unless they're all floats, see `mg_list_floats`.
+  const double *floats() const { return mg_list_floats(const_ptr_); }
+
   /// \exception std::runtime_error list contains value with unknown type
   bool operator==(const ConstList &other) const;
   /// \exception std::runtime_error list contains value with unknown type
@@ -425,6 +434,9 @@ class Node final {
 
   Id id() const { return Id::FromInt(mg_node_id(ptr_)); }
 
+  /// \brief Return the element ID, which is empty before Bolt 5.
+  std::string_view element_id() const;
+
   Labels labels() const { return Labels(ptr_); }
 
   ConstMap properties() const { return ConstMap(mg_node_properties(ptr_)); }
@@ -456,6 +468,9 @@ class ConstNode final {
 
   Id id() const { return Id::FromInt(mg_node_id(const_ptr_)); }
 
+  /// \brief Return the element ID, which is empty before Bolt 5.
+  std::string_view element_id() const;
+
   Node::Labels labels() const { return Node::Labels(const_ptr_); }
 
   ConstMap properties() const {
@@ -512,6 +527,17 @@ class Relationship final {
   /// \brief Return the Id of the node that is at the end of the relationship.
   Id to() const { return Id::FromInt(mg_relationship_end_id(ptr_)); }
 
+  /// \brief Return the element ID, which is empty before Bolt 5.
+  std::string_view element_id() const;
+
+  /// \brief Return the element ID of the start node, which is empty before
+  /// Bolt 5.
+  std::string_view from_element_id() const;
+
+  /// \brief Return the element ID of the end node, which is empty before
+  /// Bolt 5.
+  std::string_view to_element_id() const;
+
   std::string_view type() const;
 
   ConstMap properties() const {
@@ -554,6 +580,17 @@ class ConstRelationship final {
   /// \brief Return the Id of the node that is at the end of the relationship.
   Id to() const { return Id::FromInt(mg_relationship_end_id(const_ptr_)); }
 
+  /// \brief Return the element ID, which is empty before Bolt 5.
+  std::string_view element_id() const;
+
+  /// \brief Return the element ID of the start node, which is empty before
+  /// Bolt 5.
+  std::string_view from_element_id() const;
+
+  /// \brief Return the element ID of the end node, which is empty before
+  /// Bolt 5.
+  std::string_view to_element_id() const;
+
   std::string_view type() const;
 
   ConstMap properties() const {
@@ -607,6 +644,9 @@ class UnboundRelationship final {
 
   Id id() const { return Id::FromInt(mg_unbound_relationship_id(ptr_)); }
 
+  /// \brief Return the element ID, which is empty before Bolt 5.
+  std::string_view element_id() const;
+
   std::string_view type() const;
 
   ConstMap properties() const {
@@ -645,6 +685,9 @@ class ConstUnboundRelationship final {
 
   Id id() const { return Id::FromInt(mg_unbound_relationship_id(const_ptr_)); }
 
+  /// \brief Return the element ID, which is empty before Bolt 5.
+  std::string_view element_id() const;
+
   std::string_view type() const;
 
   ConstMap properties() const {
@@ -1631,6 +1674,10 @@ inline std::string_view ConvertString(const mg_string *str) {
   return std::string_view(mg_string_data(str), mg_string_size(str));
 }
 
+inline std::string_view ConvertElementId(const mg_string *element_id) {
+  return element_id ? ConvertString(element_id) : std::string_view();
+}
+
 inline Value::Type ConvertType(mg_value_type type) {
   switch (type) {
     case MG_VALUE_TYPE_NULL:
@@ -2063,12 +2110,11 @@ inline ConstValue Map::operator[](const std::string_view key) const {
 }
 
 inline Map::Iterator Map::find(const std::string_view key) const {
-  for (size_t i = 0; i < size(); ++i) {
-    if (key == detail::ConvertString(mg_map_key_at(ptr_, i))) {
-      return Iterator(this, i);
-    }
+  const uint32_t pos = mg_map_find2(ptr_, key.size(), key.data());
+  if (pos == size()) {
+    return end();
   }
-  return end();
+  return Iterator(this, pos);
 }
 
 inline bool Map::Insert(const std::string_view key, const Value &value) {
@@ -2129,12 +2175,11 @@ inline ConstValue ConstMap::operator[](const std::string_view key) const {
 }
 
 inline ConstMap::Iterator ConstMap::find(const std::string_view key) const {
-  for (size_t i = 0; i < size(); ++i) {
-    if (key == detail::ConvertString(mg_map_key_at(const_ptr_, i))) {
-      return Iterator(this, i);
-    }
+  const uint32_t pos = mg_map_find2(const_ptr_, key.size(), key.data());
+  if (pos == size()) {
+    return end();
   }
-  return end();
+  return Iterator(this, pos);
 }
 
 inline bool ConstMap::operator==(const ConstMap &other) const {
@@ -2176,8 +2221,16 @@ inline bool Node::operator==(const ConstNode &other) const {
   return detail::AreNodesEqual(ptr_, other.ptr());
 }
 
+inline std::string_view Node::element_id() const {
+  return detail::ConvertElementId(mg_node_element_id(ptr_));
+}
+
 inline ConstNode Node::AsConstNode() const { return ConstNode(ptr_); }
 
+inline std::string_view ConstNode::element_id() const {
+  return detail::ConvertElementId(mg_node_element_id(const_ptr_));
+}
+
 inline bool ConstNode::operator==(const ConstNode &other) const {
   return detail::AreNodesEqual(const_ptr_, other.const_ptr_);
 }
@@ -2210,6 +2263,18 @@ inline std::string_view Relationship::type() const {
   return detail::ConvertString(mg_relationship_type(ptr_));
 }
 
+inline std::string_view Relationship::element_id() const {
+  return detail::ConvertElementId(mg_relationship_element_id(ptr_));
+}
+
+inline std::string_view Relationship::from_element_id() const {
+  return detail::ConvertElementId(mg_relationship_start_element_id(ptr_));
+}
+
+inline std::string_view Relationship::to_element_id() const {
+  return detail::ConvertElementId(mg_relationship_end_element_id(ptr_));
+}
+
 inline ConstRelationship Relationship::AsConstRelationship() const {
   return ConstRelationship(ptr_);
 }
@@ -2226,6 +2291,18 @@ inline std::string_view ConstRelationship::type() const {
   return detail::ConvertString(mg_relationship_type(const_ptr_));
 }
 
+inline std::string_view ConstRelationship::element_id() const {
+  return detail::ConvertElementId(mg_relationship_element_id(const_ptr_));
+}
+
+inline std::string_view ConstRelationship::from_element_id() const {
+  return detail::ConvertElementId(mg_relationship_start_element_id(const_ptr_));
+}
+
+inline std::string_view ConstRelationship::to_element_id() const {
+  return detail::ConvertElementId(mg_relationship_end_element_id(const_ptr_));
+}
+
 inline bool ConstRelationship::operator==(
     const ConstRelationship &other) const {
   return detail::AreRelationshipsEqual(const_ptr_, other.const_ptr_);
@@ -2261,6 +2338,10 @@ inline std::string_view UnboundRelationship::type() const {
   return detail::ConvertString(mg_unbound_relationship_type(ptr_));
 }
 
+inline std::string_view UnboundRelationship::element_id() const {
+  return detail::ConvertElementId(mg_unbound_relationship_element_id(ptr_));
+}
+
 inline ConstUnboundRelationship
 UnboundRelationship::AsConstUnboundRelationship() const {
   return ConstUnboundRelationship(ptr_);
@@ -2280,6 +2361,11 @@ inline std::string_view ConstUnboundRelationship::type() const {
   return detail::ConvertString(mg_unbound_relationship_type(const_ptr_));
 }
 
+inline std::string_view ConstUnboundRelationship::element_id() const {
+  return detail::ConvertElementId(
+      mg_unbound_relationship_element_id(const_ptr_));
+}
+
 inline bool ConstUnboundRelationship::operator==(
     const ConstUnboundRelationship &other) const {
   return detail::AreUnboundRelationshipsEqual(const_ptr_, other.const_ptr_);
@@ -3198,4 +3284,128 @@ inline bool ConstValue::operator==(const Value &other) const {
   return detail::AreValuesEqual(const_ptr_, other.ptr());
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Visit:
+
+/// \brief The C++ type of values of type `T`, as they are passed to visitors
+/// by `Visit` and returned by `GetIf`. Each value type maps to a different
+/// C++ type, so visitors can tell them apart with `if constexpr`.
+template <Value::Type T>
+struct ValueTraits;
+
+#define MG_VALUE_TRAITS(value_type, c_value_type, cpp_type, get)               \
+  template <>                                                                  \
+  struct ValueTraits<Value::Type::value_type> {                                \
+    using type = cpp_type;                                                     \
+    static constexpr mg_value_type c_type = c_value_type;                      \
+    static type Get(const mg_value *value) { return get; }                     \
+  };
+
+MG_VALUE_TRAITS(Null, MG_VALUE_TYPE_NULL, std::nullptr_t,
+                ((void)value, nullptr))
+MG_VALUE_TRAITS(Bool, MG_VALUE_TYPE_BOOL, bool,
+                static_cast<bool>(mg_value_bool(value)))
+MG_VALUE_TRAITS(Int, MG_VALUE_TYPE_INTEGER, int64_t, mg_value_integer(value))
+MG_VALUE_TRAITS(Double, MG_VALUE_TYPE_FLOAT, double, mg_value_float(value))
+MG_VALUE_TRAITS(String, MG_VALUE_TYPE_STRING, std::string_view,
+                detail::ConvertString(mg_value_string(value)))
+MG_VALUE_TRAITS(List, MG_VALUE_TYPE_LIST, ConstList,
+                ConstList(mg_value_list(value)))
+MG_VALUE_TRAITS(Map, MG_VALUE_TYPE_MAP, ConstMap, ConstMap(mg_value_map(value)))
+MG_VALUE_TRAITS(Node, MG_VALUE_TYPE_NODE, ConstNode,
+                ConstNode(mg_value_node(value)))
+MG_VALUE_TRAITS(Relationship, MG_VALUE_TYPE_RELATIONSHIP, ConstRelationship,
+                ConstRelationship(mg_value_relationship(value)))
+MG_VALUE_TRAITS(UnboundRelationship, MG_VALUE_TYPE_UNBOUND_RELATIONSHIP,
+                ConstUnboundRelationship,
+                ConstUnboundRelationship(mg_value_unbound_relationship(value)))
+MG_VALUE_TRAITS(Path, MG_VALUE_TYPE_PATH, ConstPath,
+                ConstPath(mg_value_path(value)))
+MG_VALUE_TRAITS(Date, MG_VALUE_TYPE_DATE, ConstDate,
+                ConstDate(mg_value_date(value)))
+MG_VALUE_TRAITS(Time, MG_VALUE_TYPE_TIME, ConstTime,
+                ConstTime(mg_value_time(value)))
+MG_VALUE_TRAITS(LocalTime, MG_VALUE_TYPE_LOCAL_TIME, ConstLocalTime,
+                ConstLocalTime(mg_value_local_time(value)))
+MG_VALUE_TRAITS(DateTime, MG_VALUE_TYPE_DATE_TIME, ConstDateTime,
+                ConstDateTime(mg_value_date_time(value)))
+MG_VALUE_TRAITS(DateTimeZoneId, MG_VALUE_TYPE_DATE_TIME_ZONE_ID,
+                ConstDateTimeZoneId,
+                ConstDateTimeZoneId(mg_value_date_time_zone_id(value)))
+MG_VALUE_TRAITS(LocalDateTime, MG_VALUE_TYPE_LOCAL_DATE_TIME,
+                ConstLocalDateTime,
+                ConstLocalDateTime(mg_value_local_date_time(value)))
+MG_VALUE_TRAITS(Duration, MG_VALUE_TYPE_DURATION, ConstDuration,
+                ConstDuration(mg_value_duration(value)))
+MG_VALUE_TRAITS(Point2d, MG_VALUE_TYPE_POINT_2D, ConstPoint2d,
+                ConstPoint2d(mg_value_point_2d(value)))
+MG_VALUE_TRAITS(Point3d, MG_VALUE_TYPE_POINT_3D, ConstPoint3d,
+                ConstPoint3d(mg_value_point_3d(value)))
+
+#undef MG_VALUE_TRAITS
+
+/// \brief Calls `visitor` with the value held by `value`, of the type given
+/// by `ValueTraits` for its value type.
+///
+/// Unlike checking `type()` and calling one of the `Value*` accessors, which
+/// checks the type again, the type is looked at only once.
+/// \exception std::runtime_error the value type is unknown
+template <typename Visitor>
+decltype(auto) Visit(Visitor &&visitor, const ConstValue &value) {
+#define MG_VISIT_CASE(value_type)                                              \
+  case ValueTraits<Value::Type::value_type>::c_type:                           \
+    return std::forward<Visitor>(visitor)(                                     \
+        ValueTraits<Value::Type::value_type>::Get(ptr));
+
+  const mg_value *ptr = value.ptr();
+  switch (mg_value_get_type(ptr)) {
+    MG_VISIT_CASE(Null)
+    MG_VISIT_CASE(Bool)
+    MG_VISIT_CASE(Int)
+    MG_VISIT_CASE(Double)
+    MG_VISIT_CASE(String)
+    MG_VISIT_CASE(List)
+    MG_VISIT_CASE(Map)
+    MG_VISIT_CASE(Node)
+    MG_VISIT_CASE(Relationship)
+    MG_VISIT_CASE(UnboundRelationship)
+    MG_VISIT_CASE(Path)
+    MG_VISIT_CASE(Date)
+    MG_VISIT_CASE(Time)
+    MG_VISIT_CASE(LocalTime)
+    MG_VISIT_CASE(DateTime)
+    MG_VISIT_CASE(DateTimeZoneId)
+    MG_VISIT_CASE(LocalDateTime)
+    MG_VISIT_CASE(Duration)
+    MG_VISIT_CASE(Point2d)
+    MG_VISIT_CASE(Point3d)
+    case MG_VALUE_TYPE_UNKNOWN:
+      break;
+  }
+  throw std::runtime_error("Unknown value type!");
+
+#undef MG_VISIT_CASE
+}
+
+/// \exception std::runtime_error the value type is unknown
+template <typename Visitor>
+decltype(auto) Visit(Visitor &&visitor, const Value &value) {
+  return Visit(std::forward<Visitor>(visitor), value.AsConstValue());
+}
+
+/// \brief Returns the value held by `value` if it is of type `T`, and
+/// `std::nullopt` otherwise.
+template <Value::Type T>
+std::optional<typename ValueTraits<T>::type> GetIf(const ConstValue &value) {
+  if (mg_value_get_type(value.ptr()) != ValueTraits<T>::c_type) {
+    return std::nullopt;
+  }
+  return ValueTraits<T>::Get(value.ptr());
+}
+
+template <Value::Type T>
+std::optional<typename ValueTraits<T>::type> GetIf(const Value &value) {
+  return GetIf<T>(value.AsConstValue());
+}
+
 }  // namespace mg
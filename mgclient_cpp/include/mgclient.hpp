@@ -14,9 +14,22 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <random>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 #include "mgclient-value.hpp"
 #include "mgclient.h"
@@ -50,6 +63,796 @@ class DatabaseException : public MgException {
       : MgException(message) {}
 };
 
+/// A result row that refers to values owned by the client, so getting one
+/// doesn't copy anything. It is only valid until the next fetch.
+using ConstRow = ConstList;
+
+/// A result row that owns its values. Values are copied out of the client into
+/// a single memory pool, which is released together with the row.
+class Row final {
+ public:
+  explicit Row(mg_row *ptr) : ptr_(ptr) {}
+
+  size_t size() const { return mg_list_size(mg_row_values(ptr_.get())); }
+  bool empty() const { return size() == 0; }
+
+  /// \brief Returns the value at the given `index`.
+  ConstValue operator[](size_t index) const {
+    return ConstValue(mg_list_at(mg_row_values(ptr_.get()), index));
+  }
+
+  /// \brief Returns all values of the row, valid as long as the row is.
+  ConstList values() const { return ConstList(mg_row_values(ptr_.get())); }
+
+ private:
+  struct Deleter {
+    void operator()(mg_row *ptr) const { mg_row_destroy(ptr); }
+  };
+  std::unique_ptr<mg_row, Deleter> ptr_;
+};
+
+/// Memory into which `Client::FetchAll` decodes result rows, released all at
+/// once, see `mg_arena`.
+class Arena final {
+ public:
+  /// \brief Constructs an arena with blocks of `block_size` bytes, or of a
+  /// default size if it's 0.
+  explicit Arena(size_t block_size = 0) : ptr_(mg_arena_make(block_size)) {
+    if (!ptr_) {
+      throw MgException("failed to create arena");
+    }
+  }
+
+  /// \brief Releases all rows decoded into the arena.
+  void Reset() { mg_arena_reset(ptr_.get()); }
+
+  mg_arena *ptr() const { return ptr_.get(); }
+
+ private:
+  struct Deleter {
+    void operator()(mg_arena *ptr) const { mg_arena_destroy(ptr); }
+  };
+  std::unique_ptr<mg_arena, Deleter> ptr_;
+};
+
+/// Result rows read from a file written by `Client::DumpAll`, see `mg_replay`.
+class Replay final {
+ public:
+  /// \brief Opens the file at `path`, throwing `MgException` if it can't be
+  /// opened or isn't a result dump.
+  explicit Replay(const std::string &path) {
+    mg_replay *ptr;
+    if (mg_replay_open(path.c_str(), &ptr) != 0) {
+      throw MgException("failed to open result dump " + path);
+    }
+    ptr_.reset(ptr);
+  }
+
+  ConstList columns() const { return ConstList(mg_replay_columns(ptr_.get())); }
+
+  /// \brief Decodes the next row from the file.
+  /// \return the row, valid until the next call, or `std::nullopt` if there
+  /// are no rows left. Throws `MgException` if the file is malformed.
+  std::optional<ConstRow> Next() {
+    const mg_list *row;
+    int status = mg_replay_fetch(ptr_.get(), &row);
+    if (status < 0) {
+      throw MgException(mg_replay_error(ptr_.get()));
+    }
+    if (status == 0) {
+      return std::nullopt;
+    }
+    return ConstRow(row);
+  }
+
+  /// \brief Starts from the first row again.
+  void Rewind() { mg_replay_rewind(ptr_.get()); }
+
+ private:
+  struct Deleter {
+    void operator()(mg_replay *ptr) const { mg_replay_destroy(ptr); }
+  };
+  std::unique_ptr<mg_replay, Deleter> ptr_;
+};
+
+/// A column of query results, stored in contiguous buffers.
+///
+/// Columns of booleans, integers, floats or strings are stored in typed
+/// buffers: `bools()`, `ints()`, `doubles()`, or `string_offsets()` with
+/// `string_data()` (string at row `i` spans bytes from `string_offsets()[i]` to
+/// `string_offsets()[i + 1]`). Columns holding values of any other type, or of
+/// more than one type, are stored as `values()` instead. For typed columns,
+/// `validity()` is a bitmap with the bit of each non-null row set, and null
+/// rows hold a default value in the typed buffer. A column of only nulls has
+/// type `Null` and no buffers.
+class Column final {
+ public:
+  enum class Type : uint8_t { Null, Bool, Int, Double, String, Value };
+
+  explicit Column(std::string name) : name_(std::move(name)) {}
+
+  const std::string &name() const { return name_; }
+  Type type() const { return type_; }
+  size_t size() const { return size_; }
+
+  bool IsNull(size_t row) const {
+    if (type_ == Type::Value) {
+      return values_[row].type() == Value::Type::Null;
+    }
+    return !(validity_[row / 8] & (1u << (row % 8)));
+  }
+
+  const std::vector<uint8_t> &validity() const { return validity_; }
+  /// \pre column type is Type::Bool
+  const std::vector<uint8_t> &bools() const { return bools_; }
+  /// \pre column type is Type::Int
+  const std::vector<int64_t> &ints() const { return ints_; }
+  /// \pre column type is Type::Double
+  const std::vector<double> &doubles() const { return doubles_; }
+  /// \pre column type is Type::String
+  const std::vector<size_t> &string_offsets() const { return string_offsets_; }
+  /// \pre column type is Type::String
+  const std::string &string_data() const { return string_data_; }
+  /// \pre column type is Type::String
+  std::string_view StringAt(size_t row) const {
+    return std::string_view(string_data_)
+        .substr(string_offsets_[row],
+                string_offsets_[row + 1] - string_offsets_[row]);
+  }
+  /// \pre column type is Type::Value
+  const std::vector<Value> &values() const { return values_; }
+
+  /// \brief Appends a copy of `value` to the column.
+  void Append(const ConstValue &value);
+
+ private:
+  static Type ColumnType(Value::Type type);
+  void AppendDefault();
+  void ConvertToValues();
+
+  std::string name_;
+  Type type_{Type::Null};
+  size_t size_{0};
+  std::vector<uint8_t> validity_;
+  std::vector<uint8_t> bools_;
+  std::vector<int64_t> ints_;
+  std::vector<double> doubles_;
+  std::vector<size_t> string_offsets_;
+  std::string string_data_;
+  std::vector<Value> values_;
+};
+
+inline Column::Type Column::ColumnType(Value::Type type) {
+  switch (type) {
+    case Value::Type::Null:
+      return Type::Null;
+    case Value::Type::Bool:
+      return Type::Bool;
+    case Value::Type::Int:
+      return Type::Int;
+    case Value::Type::Double:
+      return Type::Double;
+    case Value::Type::String:
+      return Type::String;
+    default:
+      return Type::Value;
+  }
+}
+
+inline void Column::AppendDefault() {
+  switch (type_) {
+    case Type::Null:
+      break;
+    case Type::Bool:
+      bools_.push_back(0);
+      break;
+    case Type::Int:
+      ints_.push_back(0);
+      break;
+    case Type::Double:
+      doubles_.push_back(0.0);
+      break;
+    case Type::String:
+      string_offsets_.push_back(string_data_.size());
+      break;
+    case Type::Value:
+      values_.emplace_back();
+      break;
+  }
+}
+
+inline void Column::ConvertToValues() {
+  values_.reserve(size_);
+  for (size_t row = 0; row < size_; ++row) {
+    if (type_ == Type::Null || IsNull(row)) {
+      values_.emplace_back();
+      continue;
+    }
+    switch (type_) {
+      case Type::Bool:
+        values_.emplace_back(static_cast<bool>(bools_[row]));
+        break;
+      case Type::Int:
+        values_.emplace_back(ints_[row]);
+        break;
+      case Type::Double:
+        values_.emplace_back(doubles_[row]);
+        break;
+      case Type::String:
+        values_.emplace_back(StringAt(row));
+        break;
+      default:
+        break;
+    }
+  }
+  type_ = Type::Value;
+  validity_ = {};
+  bools_ = {};
+  ints_ = {};
+  doubles_ = {};
+  string_offsets_ = {};
+  string_data_ = {};
+}
+
+inline void Column::Append(const ConstValue &value) {
+  const Type value_type = ColumnType(value.type());
+
+  if (value_type != Type::Null && value_type != type_ &&
+      type_ != Type::Value) {
+    if (type_ == Type::Null && value_type != Type::Value) {
+      // The first non-null value decides the type, rows so far are nulls.
+      type_ = value_type;
+      if (type_ == Type::String) {
+        string_offsets_.push_back(0);
+      }
+      for (size_t row = 0; row < size_; ++row) {
+        AppendDefault();
+      }
+    } else {
+      ConvertToValues();
+    }
+  }
+
+  if (type_ != Type::Value) {
+    if (size_ % 8 == 0) {
+      validity_.push_back(0);
+    }
+    if (value_type != Type::Null) {
+      validity_[size_ / 8] |= static_cast<uint8_t>(1u << (size_ % 8));
+    }
+  }
+
+  if (value_type == Type::Null) {
+    AppendDefault();
+  } else {
+    switch (type_) {
+      case Type::Bool:
+        bools_.push_back(value.ValueBool());
+        break;
+      case Type::Int:
+        ints_.push_back(value.ValueInt());
+        break;
+      case Type::Double:
+        doubles_.push_back(value.ValueDouble());
+        break;
+      case Type::String:
+        string_data_.append(value.ValueString());
+        string_offsets_.push_back(string_data_.size());
+        break;
+      case Type::Value:
+        values_.emplace_back(value);
+        break;
+      case Type::Null:
+        break;
+    }
+  }
+  ++size_;
+}
+
+/// A statement encoded once, to be executed any number of times with
+/// different parameters. It can be shared between clients and threads.
+class PreparedQuery final {
+ public:
+  /// \throws MgException if the statement couldn't be prepared.
+  explicit PreparedQuery(const std::string &statement)
+      : ptr_(mg_prepared_query_make(statement.c_str())) {
+    if (!ptr_) {
+      throw MgException("failed to prepare the query");
+    }
+  }
+
+  PreparedQuery(const PreparedQuery &) = delete;
+  PreparedQuery(PreparedQuery &&other) noexcept : ptr_(other.ptr_) {
+    other.ptr_ = nullptr;
+  }
+  PreparedQuery &operator=(const PreparedQuery &) = delete;
+  PreparedQuery &operator=(PreparedQuery &&other) noexcept {
+    std::swap(ptr_, other.ptr_);
+    return *this;
+  }
+  ~PreparedQuery() { mg_prepared_query_destroy(ptr_); }
+
+  const mg_prepared_query *ptr() const { return ptr_; }
+
+ private:
+  mg_prepared_query *ptr_;
+};
+
+namespace detail {
+template <typename T>
+struct IsOptional : std::false_type {};
+template <typename T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+struct IsTuple : std::false_type {};
+template <typename... Ts>
+struct IsTuple<std::tuple<Ts...>> : std::true_type {};
+template <typename T1, typename T2>
+struct IsTuple<std::pair<T1, T2>> : std::true_type {};
+
+// Maps with other keys are written as lists of key-value pairs.
+template <typename T, typename = void>
+struct IsMap : std::false_type {};
+template <typename T>
+struct IsMap<T, std::void_t<typename T::mapped_type>>
+    : std::is_convertible<const typename T::key_type &, std::string_view> {};
+
+template <typename T, typename = void>
+struct IsRange : std::false_type {};
+template <typename T>
+struct IsRange<T, std::void_t<decltype(std::size(std::declval<const T &>())),
+                              decltype(std::begin(std::declval<const T &>()))>>
+    : std::true_type {};
+}  // namespace detail
+
+/// Encodes query parameters straight into the output buffer of a client,
+/// without building `Value`s for them. See `Client::Execute`.
+///
+/// `Write` accepts booleans, integers, floating point numbers, strings,
+/// `nullptr`, `std::optional`, tuples and pairs (as lists), maps with string
+/// keys, other ranges such as `std::vector` (as lists), and values of the
+/// wrapper classes. Other types are written by a `WriteParam(ParamWriter &,
+/// const T &)` function found through argument-dependent lookup, which can
+/// write a struct as a map using `BeginMap` and `Write`.
+///
+/// Errors are kept until the end of writing, and all writes after the first
+/// failed one are ignored.
+///
+/// A default constructed writer doesn't write anything, it only adds up the
+/// encoded size of the values. Sizes of values of the wrapper classes are only
+/// estimated.
+class ParamWriter final {
+ public:
+  ParamWriter() : writer_(nullptr) {}
+  explicit ParamWriter(mg_param_writer *writer) : writer_(writer) {}
+
+  template <typename T>
+  void Write(const T &value);
+
+  /// Starts a list, which has to be followed by `size` values.
+  void BeginList(size_t size) {
+    if (!CheckSize(size)) {
+      return;
+    }
+    if (!writer_) {
+      size_ += HeaderSize(size);
+      return;
+    }
+    Check(mg_param_writer_begin_list(writer_, (uint32_t)size));
+  }
+
+  /// Starts a map, which has to be followed by `size` pairs of a string key
+  /// and a value.
+  void BeginMap(size_t size) {
+    if (!CheckSize(size)) {
+      return;
+    }
+    if (!writer_) {
+      size_ += HeaderSize(size);
+      return;
+    }
+    Check(mg_param_writer_begin_map(writer_, (uint32_t)size));
+  }
+
+  /// Returns 0 if everything was written successfully, and the error code of
+  /// the first failed write otherwise.
+  int status() const { return status_; }
+
+  /// Returns the number of bytes counted by a default constructed writer.
+  size_t size() const { return size_; }
+
+ private:
+  void Check(int status) {
+    if (status_ == 0) {
+      status_ = status;
+    }
+  }
+
+  bool CheckSize(size_t size) {
+    if (size > UINT32_MAX) {
+      Check(MG_ERROR_SIZE_EXCEEDED);
+    }
+    return status_ == 0;
+  }
+
+  static size_t HeaderSize(size_t size) {
+    return size < 16 ? 1 : size <= UINT8_MAX ? 2 : size <= UINT16_MAX ? 3 : 5;
+  }
+
+  void WriteNull() {
+    if (!writer_) {
+      size_ += 1;
+      return;
+    }
+    Check(mg_param_writer_write_null(writer_));
+  }
+
+  void WriteBool(bool value) {
+    if (!writer_) {
+      size_ += 1;
+      return;
+    }
+    Check(mg_param_writer_write_bool(writer_, value));
+  }
+
+  void WriteInteger(int64_t value) {
+    if (!writer_) {
+      if (value >= -16 && value <= INT8_MAX) {
+        size_ += 1;
+      } else if (value >= INT8_MIN && value <= INT8_MAX) {
+        size_ += 2;
+      } else if (value >= INT16_MIN && value <= INT16_MAX) {
+        size_ += 3;
+      } else if (value >= INT32_MIN && value <= INT32_MAX) {
+        size_ += 5;
+      } else {
+        size_ += 9;
+      }
+      return;
+    }
+    Check(mg_param_writer_write_integer(writer_, value));
+  }
+
+  void WriteFloat(double value) {
+    if (!writer_) {
+      size_ += 9;
+      return;
+    }
+    Check(mg_param_writer_write_float(writer_, value));
+  }
+
+  void WriteString(std::string_view value) {
+    if (!writer_) {
+      size_ += HeaderSize(value.size()) + value.size();
+      return;
+    }
+    Check(mg_param_writer_write_string(writer_, value.size(), value.data()));
+  }
+
+  void WriteValue(const ConstValue &value);
+
+  mg_param_writer *writer_;
+  int status_{0};
+  size_t size_{0};
+};
+
+inline void ParamWriter::WriteValue(const ConstValue &value) {
+  if (writer_) {
+    Check(mg_param_writer_write_value(writer_, value.ptr()));
+    return;
+  }
+  switch (value.type()) {
+    case Value::Type::Null:
+      WriteNull();
+      break;
+    case Value::Type::Bool:
+      WriteBool(value.ValueBool());
+      break;
+    case Value::Type::Int:
+      WriteInteger(value.ValueInt());
+      break;
+    case Value::Type::Double:
+      WriteFloat(value.ValueDouble());
+      break;
+    case Value::Type::String:
+      WriteString(value.ValueString());
+      break;
+    case Value::Type::List:
+      Write(value.ValueList());
+      break;
+    case Value::Type::Map:
+      Write(value.ValueMap());
+      break;
+    default:
+      // Temporal and spatial values, none of which takes up more than this.
+      size_ += 40;
+      break;
+  }
+}
+
+template <typename T>
+inline void ParamWriter::Write(const T &value) {
+  if (status_ != 0) {
+    return;
+  }
+  if constexpr (std::is_same_v<T, std::nullptr_t> ||
+                std::is_same_v<T, std::nullopt_t>) {
+    WriteNull();
+  } else if constexpr (std::is_same_v<T, bool>) {
+    WriteBool(value);
+  } else if constexpr (std::is_integral_v<T>) {
+    if constexpr (std::is_unsigned_v<T> && sizeof(T) >= sizeof(int64_t)) {
+      if (value > (T)INT64_MAX) {
+        Check(MG_ERROR_INVALID_VALUE);
+        return;
+      }
+    }
+    WriteInteger((int64_t)value);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    WriteFloat((double)value);
+  } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+    WriteString(value);
+  } else if constexpr (std::is_same_v<T, Value>) {
+    WriteValue(value.AsConstValue());
+  } else if constexpr (std::is_same_v<T, ConstValue>) {
+    WriteValue(value);
+  } else if constexpr (std::is_same_v<T, Map>) {
+    Write(value.AsConstMap());
+  } else if constexpr (std::is_same_v<T, List>) {
+    Write(value.AsConstList());
+  } else if constexpr (std::is_same_v<T, ConstMap> || detail::IsMap<T>::value) {
+    BeginMap(std::size(value));
+    for (const auto &[key, element] : value) {
+      Write(key);
+      Write(element);
+    }
+  } else if constexpr (detail::IsOptional<T>::value) {
+    if (value) {
+      Write(*value);
+    } else {
+      WriteNull();
+    }
+  } else if constexpr (detail::IsTuple<T>::value) {
+    BeginList(std::tuple_size_v<T>);
+    std::apply([this](const auto &...elements) { (Write(elements), ...); },
+               value);
+  } else if constexpr (detail::IsRange<T>::value) {
+    BeginList(std::size(value));
+    for (const auto &element : value) {
+      Write(element);
+    }
+  } else {
+    WriteParam(*this, value);
+  }
+}
+
+namespace detail {
+// Makes a `mg_param_writer_callback` out of a function taking `ParamWriter`.
+// An exception thrown by the function makes the callback fail, and is
+// rethrown by `RethrowIfFailed` once the C call using the callback returns.
+template <typename F>
+struct ParamWriterCallback {
+  static int Call(mg_param_writer *writer, void *data) {
+    auto *self = static_cast<ParamWriterCallback *>(data);
+    ParamWriter param_writer(writer);
+    try {
+      self->write(param_writer);
+    } catch (...) {
+      self->exception = std::current_exception();
+      return MG_ERROR_CLIENT_ERROR;
+    }
+    return param_writer.status();
+  }
+
+  void RethrowIfFailed() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  F &write;
+  std::exception_ptr exception{nullptr};
+};
+}  // namespace detail
+
+/// A named query parameter, see `Client::Execute`. It only refers to its
+/// value, which has to outlive it.
+template <typename T>
+struct Param {
+  Param(std::string_view name, const T &value) : name(name), value(value) {}
+
+  std::string_view name;
+  const T &value;
+};
+
+/// How managed transactions are retried, see
+/// `Client::ExecuteWriteTransaction`.
+///
+/// Delays between attempts grow exponentially, and each of them is randomized
+/// by up to `jitter` of its length, so that clients whose transactions
+/// conflicted with each other don't retry in lockstep and conflict again.
+struct RetryPolicy {
+  /// Maximum number of attempts, including the first one.
+  int max_attempts = 10;
+  /// No attempt starts later than this after the first one.
+  std::chrono::milliseconds max_retry_time{30000};
+  /// Delay before the first retry, multiplied by `multiplier` for each next
+  /// one, up to `max_delay`.
+  std::chrono::milliseconds initial_delay{100};
+  double multiplier = 2.0;
+  std::chrono::milliseconds max_delay{5000};
+  double jitter = 0.5;
+};
+
+namespace detail {
+/// Waits between the attempts of a managed transaction.
+class Backoff final {
+ public:
+  explicit Backoff(const RetryPolicy &policy)
+      : policy_(policy),
+        start_(std::chrono::steady_clock::now()),
+        delay_(policy.initial_delay) {}
+
+  /// Sleeps before the next attempt. Returns false without sleeping if the
+  /// policy doesn't allow another attempt.
+  bool Wait() {
+    if (attempts_ >= policy_.max_attempts) {
+      return false;
+    }
+    thread_local std::mt19937 generator{std::random_device{}()};
+    std::uniform_real_distribution<double> factor(1.0 - policy_.jitter,
+                                                  1.0 + policy_.jitter);
+    auto delay = delay_ * factor(generator);
+    if (std::chrono::steady_clock::now() + delay - start_ >
+        policy_.max_retry_time) {
+      return false;
+    }
+    std::this_thread::sleep_for(delay);
+    delay_ = std::min<Delay>(delay_ * policy_.multiplier, policy_.max_delay);
+    ++attempts_;
+    return true;
+  }
+
+ private:
+  using Delay = std::chrono::duration<double, std::milli>;
+
+  const RetryPolicy &policy_;
+  const std::chrono::steady_clock::time_point start_;
+  Delay delay_;
+  int attempts_{1};
+};
+}  // namespace detail
+
+/// Binds the result column `name` to a member of `T`, see `RowBinding`.
+template <typename T, typename M>
+struct Field {
+  constexpr Field(std::string_view name, M T::*member)
+      : name(name), member(member) {}
+
+  std::string_view name;
+  M T::*member;
+};
+
+/// Describes how result rows are read into a `T` by `Client::FetchAs`. It is
+/// specialized for each such type, listing its fields in a tuple:
+///
+///     struct Person {
+///       int64_t id;
+///       std::string name;
+///       std::optional<double> score;
+///     };
+///
+///     template <>
+///     struct mg::RowBinding<Person> {
+///       static constexpr auto fields =
+///           std::make_tuple(mg::Field("id", &Person::id),
+///                           mg::Field("name", &Person::name),
+///                           mg::Field("score", &Person::score));
+///     };
+///
+/// Members can be booleans, integers, floating point numbers, `std::string`
+/// and `std::string_view`, as well as `std::optional` of those for columns
+/// that might be null. A `std::string_view` points into the received message
+/// and is only valid until the next fetch. `T` has to be default
+/// constructible, members that aren't bound keep their initial values.
+template <typename T>
+struct RowBinding;
+
+namespace detail {
+template <typename T>
+inline constexpr bool kAlwaysFalse = false;
+
+// An address identifying the type `T`, without relying on RTTI. The tag isn't
+// const, so that it can't be merged with the tags of other types by identical
+// constant folding.
+template <typename T>
+const void *TypeTag() {
+  static char tag;
+  return &tag;
+}
+
+// Whether any of the `Field`s in the tuple `Fields` binds a
+// `std::string_view`, which is only valid until the next fetch.
+template <typename Fields>
+struct BindsStringView;
+
+template <typename... Ts, typename... Ms>
+struct BindsStringView<std::tuple<Field<Ts, Ms>...>>
+    : std::bool_constant<(
+          (std::is_same_v<Ms, std::string_view> ||
+           std::is_same_v<Ms, std::optional<std::string_view>>) ||
+          ...)> {};
+
+template <typename M>
+bool IntegerFits(int64_t value) {
+  if constexpr (std::is_signed_v<M>) {
+    return value >= std::numeric_limits<M>::min() &&
+           value <= std::numeric_limits<M>::max();
+  } else {
+    return value >= 0 &&
+           static_cast<uint64_t>(value) <= std::numeric_limits<M>::max();
+  }
+}
+
+// Reads the field `pos` of `row` into `member`, bound to the column `name`.
+// Returns the status of the failed read, except for type mismatches and
+// values out of range, which are thrown as `ClientException`.
+template <typename M>
+int ReadLazyField(mg_lazy_row *row, uint32_t pos, std::string_view name,
+                  M *member) {
+  int status;
+  if constexpr (IsOptional<M>::value) {
+    if (mg_lazy_row_type_at(row, pos) == MG_VALUE_TYPE_NULL) {
+      member->reset();
+      return 0;
+    }
+    typename M::value_type value{};
+    status = ReadLazyField(row, pos, name, &value);
+    if (status == 0) {
+      *member = std::move(value);
+    }
+  } else if constexpr (std::is_same_v<M, bool>) {
+    int value;
+    status = mg_lazy_row_bool_at(row, pos, &value);
+    if (status == 0) {
+      *member = value != 0;
+    }
+  } else if constexpr (std::is_integral_v<M>) {
+    int64_t value;
+    status = mg_lazy_row_integer_at(row, pos, &value);
+    if (status == 0) {
+      if (!IntegerFits<M>(value)) {
+        throw ClientException("value of column '" + std::string(name) +
+                              "' is out of range");
+      }
+      *member = static_cast<M>(value);
+    }
+  } else if constexpr (std::is_floating_point_v<M>) {
+    double value;
+    status = mg_lazy_row_float_at(row, pos, &value);
+    if (status == 0) {
+      *member = static_cast<M>(value);
+    }
+  } else if constexpr (std::is_same_v<M, std::string> ||
+                       std::is_same_v<M, std::string_view>) {
+    const char *data;
+    uint32_t size;
+    status = mg_lazy_row_string_at(row, pos, &data, &size);
+    if (status == 0) {
+      *member = M(data, size);
+    }
+  } else {
+    static_assert(kAlwaysFalse<M>, "unsupported type of a bound field");
+  }
+  if (status == MG_ERROR_TYPE_MISMATCH) {
+    throw ClientException("unexpected type of column '" + std::string(name) +
+                          "'");
+  }
+  return status;
+}
+}  // namespace detail
+
 /// An interface for a Memgraph client that can execute queries and fetch
 /// results.
 class Client {
@@ -61,6 +864,42 @@ class Client {
     std::string password = "";
     bool use_ssl = false;
     std::string user_agent = "mgclient++/" + std::string(mg_client_version());
+    /// Number of records requested from the server at once, 0 means all of
+    /// them. Remaining batches are requested automatically by `FetchOne`.
+    int64_t fetch_size = 0;
+    /// Limits of the memory pool used for decoding results, 0 means the
+    /// built-in defaults. See `mg_session_params` for details.
+    size_t decoder_max_block_size = 0;
+    size_t decoder_spare_blocks = 0;
+    /// Largest message accepted from the server, 0 means no limit. Grown
+    /// buffers shrink after `shrink_after` smaller messages in a row, 0 means
+    /// the built-in default. See `mg_session_params` for details.
+    size_t max_message_size = 0;
+    int shrink_after = 0;
+    /// Do the network I/O through an io_uring, see `mg_session_params` for
+    /// details.
+    bool use_io_uring = false;
+    /// Offload TLS record encryption to the kernel, see `mg_session_params`
+    /// for details.
+    bool use_ktls = false;
+    /// Number of threads decoding result rows ahead of `FetchOne`, 0 means
+    /// rows are decoded by the fetching thread. See `mg_session_params`.
+    int decode_threads = 0;
+    /// Keep the statistics returned by `Stats`.
+    bool collect_stats = false;
+    /// Called on query lifecycle events, see `mg_trace_event`.
+    mg_trace_callback_type trace_callback = nullptr;
+    void *trace_data = nullptr;
+    /// Time to wait for the connection to be established, trying the
+    /// addresses of the host in parallel, 0 means no limit. See
+    /// `mg_session_params` for details.
+    std::chrono::milliseconds connect_timeout{0};
+    /// How long the addresses of the host are cached for later connections,
+    /// 0 means they aren't cached.
+    std::chrono::milliseconds dns_cache_ttl{0};
+    /// Time a query has to complete in, including fetching its results, 0
+    /// means no limit. See `mg_session_set_query_timeout`.
+    std::chrono::milliseconds query_timeout{0};
   };
 
   Client(const Client &) = delete;
@@ -86,6 +925,9 @@ class Client {
   /// \brief Executes the given Cypher `statement`.
   /// \return true when the statement is successfully executed, false otherwise.
   /// \note
+  /// The statement and the request for its results are sent together, so
+  /// executing a statement takes a single network round trip.
+  /// \note
   /// After executing the statement, the method is blocked until all incoming
   /// data (execution results) are handled, i.e. until `FetchOne` method returns
   /// `std::nullopt`. Even if the result set is empty, the fetching has to be
@@ -102,19 +944,111 @@ class Client {
   /// `FetchOne` method returns `std::nullopt`.
   bool Execute(const std::string &statement, const ConstMap &params);
 
+  /// \brief Executes the given prepared `statement`, supplied with `params`.
+  /// Only the parameters are encoded, which makes running the same long
+  /// statement many times cheaper.
+  /// \return true when the statement is successfully executed, false
+  /// otherwise.
+  bool Execute(const PreparedQuery &statement, const ConstMap &params);
+
+  /// \brief Executes the given Cypher `statement`, supplied with `params`
+  /// which are written straight into the output buffer by `ParamWriter`,
+  /// without building a `Map` of them:
+  ///
+  ///     client->Execute("UNWIND $rows AS row CREATE (:Node {id: row[0]})",
+  ///                     mg::Param("rows", rows));
+  ///
+  /// \return true when the statement is successfully executed, false
+  /// otherwise.
+  /// \note
+  /// Exceptions thrown by `WriteParam` functions are rethrown, and the
+  /// client can't be used anymore after that.
+  template <typename... Ts>
+  bool Execute(const std::string &statement, const Param<Ts> &...params);
+
+  /// \brief Same as above, with a prepared `statement`.
+  template <typename... Ts>
+  bool Execute(const PreparedQuery &statement, const Param<Ts> &...params);
+
   /// \brief Fetches the next result from the input stream.
   /// \return next result from the input stream.
   /// If there is nothing to fetch, `std::nullopt` is returned.
   std::optional<std::vector<Value>> FetchOne();
 
-  /// \brief Fetches all results and discards them.
+  /// \brief Fetches the next result from the input stream without copying it.
+  /// \return next result from the input stream, valid until the next fetch.
+  /// If there is nothing to fetch, `std::nullopt` is returned.
+  std::optional<ConstRow> FetchOneView();
+
+  /// \brief Fetches the next result from the input stream and moves it out of
+  /// the client.
+  /// \return next result from the input stream. Unlike `FetchOne`, its values
+  /// aren't copied one by one, which makes it much cheaper for large rows.
+  /// If there is nothing to fetch, `std::nullopt` is returned.
+  std::optional<Row> FetchRow();
+
+  /// \brief Discards the rest of the results. Rows that weren't requested
+  /// from the server yet (see `Params::fetch_size`) aren't sent at all, and
+  /// those that were are skipped without decoding them. See
+  /// `mg_session_discard`.
   void DiscardAll();
 
+  /// \brief Writes the rest of the results to the file at `path` without
+  /// decoding them, to be read back by `Replay`. See `mg_session_dump`.
+  /// \return true if all of them were written, false otherwise.
+  bool DumpAll(const std::string &path);
+
   /// \brief Fetches all results.
   std::optional<std::vector<std::vector<Value>>> FetchAll();
 
+  /// \brief Fetches all results as `Row`s.
+  std::optional<std::vector<Row>> FetchAllRows();
+
+  /// \brief Fetches all results into `arena`.
+  /// \return rows valid until `arena` is reset or destroyed. Unlike
+  /// `FetchAllRows`, values are decoded straight into the arena, so they are
+  /// neither copied nor freed one by one.
+  std::optional<std::vector<ConstRow>> FetchAll(Arena &arena);
+
+  /// \brief Fetches all results, stored column by column.
+  /// \return one `Column` per column of the result, in the order of
+  /// `GetColumns()`. Values are copied straight into the column buffers,
+  /// without building a `Value` for each of them.
+  std::optional<std::vector<Column>> FetchAllColumns();
+
+  /// \brief Fetches the next result into a `T`, whose members are bound to
+  /// the result columns by `RowBinding<T>`. Columns are looked up once per
+  /// query, and fields are read straight from the received message, without
+  /// building a `Value` for each of them.
+  /// \return next result from the input stream. If there is nothing to
+  /// fetch, `std::nullopt` is returned.
+  /// \throws ClientException if a bound column is missing from the result or
+  /// a field doesn't match the type of its member.
+  template <typename T>
+  std::optional<T> FetchAs();
+
+  /// \brief Fetches all results into `T`s, see `FetchAs`. Since the rows
+  /// outlive the following fetches, `T` can't bind `std::string_view`
+  /// members.
+  template <typename T>
+  std::optional<std::vector<T>> FetchAllAs();
+
   const std::vector<std::string> &GetColumns() const;
 
+  /// \brief Statistics of the connection, see `mg_session_stats`.
+  /// \return `std::nullopt` unless the client was connected with
+  /// `Params::collect_stats` set.
+  std::optional<mg_session_stats> Stats() const;
+
+  /// \brief Changes the time queries have to complete in, 0 means no limit.
+  /// See `mg_session_set_query_timeout`.
+  /// \return true when the timeout was changed, false otherwise.
+  bool SetQueryTimeout(std::chrono::milliseconds timeout);
+
+  /// \brief Cancels the query currently executed by the client. Unlike other
+  /// methods, it can be called from any thread. See `mg_session_cancel`.
+  void Cancel();
+
   /// \brief Start a transaction.
   /// \return true when the transaction was successfully started, false
   /// otherwise.
@@ -130,6 +1064,25 @@ class Client {
   /// otherwise.
   bool RollbackTransaction();
 
+  /// \brief Runs `work(*this)` in a transaction and commits it, retrying the
+  /// whole transaction as set by `policy` when it fails with a transient
+  /// error (e.g. a serialization conflict with a concurrent write).
+  ///
+  /// A query of `work` that fails aborts the transaction, even if `work`
+  /// ignores the failure, so that `work` has to run again from the start.
+  /// Because of that, `work` shouldn't have side effects outside of the
+  /// transaction. The client can't reconnect by itself, so a broken
+  /// connection isn't retried, see `ClientPool::ExecuteWriteTransaction` for
+  /// that.
+  ///
+  /// \return the value returned by the successful run of `work`.
+  /// \throws MgException (or one of its subclasses) if the transaction failed
+  /// for good, or anything thrown by `work`. The transaction is rolled back in
+  /// that case.
+  template <typename F>
+  std::invoke_result_t<F &, Client &> ExecuteWriteTransaction(
+      F &&work, const RetryPolicy &policy = RetryPolicy());
+
   /// \brief Static method that creates a Memgraph client instance.
   /// \return pointer to the created client instance.
   /// If the connection couldn't be established given the `params`, it returns
@@ -139,8 +1092,61 @@ class Client {
  private:
   explicit Client(mg_session *session);
 
+  /// Fetches the next result, returns `nullptr` if there is nothing to fetch.
+  /// Fields of a `lazy` result are decoded only when accessed, see
+  /// `mg_session_fetch_lazy`.
+  mg_result *FetchResult(bool lazy = false);
+
+  /// Looks up the columns bound by `RowBinding<T>`, unless they were already
+  /// looked up for the current query.
+  template <typename T>
+  void BindColumns();
+
+  /// Stores names of the result columns.
+  void SetColumns(const mg_list *columns);
+
+  /// Executes either `statement` or `prepared`, with `params` written by
+  /// `ParamWriter`.
+  template <typename... Ts>
+  bool ExecuteWithParams(const char *statement,
+                         const mg_prepared_query *prepared,
+                         const Param<Ts> &...params);
+
+  /// Throws the exception matching a failed query `status`, if any.
+  static void ThrowIfFailed(mg_session *session, int status);
+
+  /// Records a failed query and throws the exception matching its `status`.
+  [[noreturn]] void ThrowFailure(int status);
+
+  /// Makes a single attempt of `ExecuteWriteTransaction`. The transaction is
+  /// rolled back if it fails.
+  template <typename F>
+  std::invoke_result_t<F &, Client &> RunTransaction(F &work);
+
+  /// Rolls back the transaction of a failed attempt, if the connection allows.
+  void AbortTransaction() noexcept;
+
+  /// Whether the last attempt of a transaction failed with a transient error
+  /// and the connection is still usable.
+  bool CanRetryTransaction() const;
+
+  /// Copies values of a result row.
+  static std::vector<Value> RowValues(const mg_list *row);
+
+  friend class AsyncClient;
+  friend class ClientPool;
+  friend class Router;
+  template <typename Row>
+  friend class BulkWriter;
+
   mg_session *session_;
   std::vector<std::string> columns_;
+  // Positions of the columns bound by `RowBinding` of the type identified by
+  // `bound_type_`, reset by `SetColumns`.
+  std::vector<uint32_t> binding_;
+  const void *bound_type_{nullptr};
+  // Status of the latest failed query or fetch, reset by `RunTransaction`.
+  int failure_{0};
 };
 
 inline std::unique_ptr<Client> Client::Connect(const Client::Params &params) {
@@ -150,6 +1156,12 @@ inline std::unique_ptr<Client> Client::Connect(const Client::Params &params) {
   }
   mg_session_params_set_host(mg_params, params.host.c_str());
   mg_session_params_set_port(mg_params, params.port);
+  mg_session_params_set_connect_timeout(mg_params,
+                                        (int)params.connect_timeout.count());
+  mg_session_params_set_dns_cache_ttl(mg_params,
+                                      (int)params.dns_cache_ttl.count());
+  mg_session_params_set_query_timeout(mg_params,
+                                      (int)params.query_timeout.count());
   if (!params.username.empty()) {
     mg_session_params_set_username(mg_params, params.username.c_str());
     mg_session_params_set_password(mg_params, params.password.c_str());
@@ -157,6 +1169,19 @@ inline std::unique_ptr<Client> Client::Connect(const Client::Params &params) {
   mg_session_params_set_user_agent(mg_params, params.user_agent.c_str());
   mg_session_params_set_sslmode(
       mg_params, params.use_ssl ? MG_SSLMODE_REQUIRE : MG_SSLMODE_DISABLE);
+  mg_session_params_set_fetch_size(mg_params, params.fetch_size);
+  mg_session_params_set_decoder_limits(mg_params, params.decoder_max_block_size,
+                                       params.decoder_spare_blocks);
+  mg_session_params_set_message_limits(mg_params, params.max_message_size,
+                                       params.shrink_after);
+  if (params.use_io_uring) {
+    mg_session_params_set_io_backend(mg_params, MG_IO_BACKEND_IO_URING);
+  }
+  mg_session_params_set_ktls(mg_params, params.use_ktls);
+  mg_session_params_set_decode_threads(mg_params, params.decode_threads);
+  mg_session_params_set_collect_stats(mg_params, params.collect_stats);
+  mg_session_params_set_trace_callback(mg_params, params.trace_callback);
+  mg_session_params_set_trace_data(mg_params, params.trace_data);
 
   mg_session *session = nullptr;
   int status = mg_connect(mg_params, &session);
@@ -181,83 +1206,176 @@ inline void Client::Finalize() { mg_finalize(); }
 
 inline bool Client::Execute(const std::string &statement) {
   const mg_list *columns;
-  int status = mg_session_run(session_, statement.c_str(), nullptr, nullptr,
-                              &columns, nullptr);
+  int status = mg_session_run_and_pull(session_, statement.c_str(), nullptr,
+                                       nullptr, nullptr, &columns, nullptr);
   if (status < 0) {
+    failure_ = status;
     return false;
   }
+  SetColumns(columns);
+  return true;
+}
 
-  status = mg_session_pull(session_, nullptr);
+inline bool Client::Execute(const std::string &statement,
+                            const ConstMap &params) {
+  const mg_list *columns;
+  int status = mg_session_run_and_pull(session_, statement.c_str(),
+                                       params.ptr(), nullptr, nullptr,
+                                       &columns, nullptr);
   if (status < 0) {
+    failure_ = status;
     return false;
   }
-
-  const size_t list_length = mg_list_size(columns);
-  columns_.clear();
-  for (size_t i = 0; i < list_length; i++) {
-    columns_.push_back(
-        std::string(Value(mg_list_at(columns, i)).ValueString()));
-  }
-
+  SetColumns(columns);
   return true;
 }
 
-inline bool Client::Execute(const std::string &statement,
+inline bool Client::Execute(const PreparedQuery &statement,
                             const ConstMap &params) {
   const mg_list *columns;
-  int status = mg_session_run(session_, statement.c_str(), params.ptr(),
-                              nullptr, &columns, nullptr);
+  int status = mg_session_run_and_pull_prepared(session_, statement.ptr(),
+                                                params.ptr(), nullptr, nullptr,
+                                                &columns, nullptr);
   if (status < 0) {
+    failure_ = status;
     return false;
   }
+  SetColumns(columns);
+  return true;
+}
+
+template <typename... Ts>
+inline bool Client::Execute(const std::string &statement,
+                            const Param<Ts> &...params) {
+  return ExecuteWithParams(statement.c_str(), nullptr, params...);
+}
+
+template <typename... Ts>
+inline bool Client::Execute(const PreparedQuery &statement,
+                            const Param<Ts> &...params) {
+  return ExecuteWithParams(nullptr, statement.ptr(), params...);
+}
 
-  status = mg_session_pull(session_, nullptr);
+template <typename... Ts>
+inline bool Client::ExecuteWithParams(const char *statement,
+                                      const mg_prepared_query *prepared,
+                                      const Param<Ts> &...params) {
+  auto write = [&params...](ParamWriter &writer) {
+    writer.BeginMap(sizeof...(Ts));
+    ((writer.Write(params.name), writer.Write(params.value)), ...);
+  };
+  detail::ParamWriterCallback<decltype(write)> callback{write};
+
+  const mg_list *columns;
+  int status =
+      prepared ? mg_session_run_and_pull_prepared_with_writer(
+                     session_, prepared, callback.Call, &callback, nullptr,
+                     nullptr, &columns, nullptr)
+               : mg_session_run_and_pull_with_writer(
+                     session_, statement, callback.Call, &callback, nullptr,
+                     nullptr, &columns, nullptr);
+  callback.RethrowIfFailed();
   if (status < 0) {
+    failure_ = status;
     return false;
   }
+  SetColumns(columns);
+  return true;
+}
 
+inline void Client::SetColumns(const mg_list *columns) {
   const size_t list_length = mg_list_size(columns);
   columns_.clear();
+  bound_type_ = nullptr;
   for (size_t i = 0; i < list_length; i++) {
     columns_.push_back(
         std::string(Value(mg_list_at(columns, i)).ValueString()));
   }
-
-  return true;
 }
 
-inline std::optional<std::vector<Value>> Client::FetchOne() {
-  mg_result *result;
-  int status = mg_session_fetch(session_, &result);
+inline void Client::ThrowIfFailed(mg_session *session, int status) {
   if (status == MG_ERROR_CLIENT_ERROR) {
-    throw ClientException(mg_session_error(session_));
+    throw ClientException(mg_session_error(session));
   }
 
   if (status == MG_ERROR_TRANSIENT_ERROR) {
-    throw TransientException(mg_session_error(session_));
+    throw TransientException(mg_session_error(session));
   }
 
   if (status == MG_ERROR_DATABASE_ERROR) {
-    throw DatabaseException(mg_session_error(session_));
-  }
-
-  if (status != 1) {
-    return std::nullopt;
+    throw DatabaseException(mg_session_error(session));
   }
+}
 
+inline std::vector<Value> Client::RowValues(const mg_list *row) {
   std::vector<Value> values;
-  const mg_list *list = mg_result_row(result);
-  const size_t list_length = mg_list_size(list);
+  const size_t list_length = mg_list_size(row);
   values.reserve(list_length);
   for (size_t i = 0; i < list_length; ++i) {
-    values.emplace_back(Value(mg_list_at(list, i)));
+    values.emplace_back(Value(mg_list_at(row, i)));
   }
   return values;
 }
 
+inline mg_result *Client::FetchResult(bool lazy) {
+  mg_result *result;
+  int status = lazy ? mg_session_fetch_lazy(session_, &result)
+                    : mg_session_fetch(session_, &result);
+  if (status < 0) {
+    failure_ = status;
+  }
+  ThrowIfFailed(session_, status);
+  if (status != 1) {
+    return nullptr;
+  }
+  return result;
+}
+
+inline std::optional<std::vector<Value>> Client::FetchOne() {
+  mg_result *result = FetchResult();
+  if (!result) {
+    return std::nullopt;
+  }
+  return RowValues(mg_result_row(result));
+}
+
+inline std::optional<ConstRow> Client::FetchOneView() {
+  mg_result *result = FetchResult();
+  if (!result) {
+    return std::nullopt;
+  }
+  return ConstRow(mg_result_row(result));
+}
+
+inline std::optional<Row> Client::FetchRow() {
+  mg_result *result = FetchResult();
+  if (!result) {
+    return std::nullopt;
+  }
+  mg_row *row = mg_result_row_copy(result);
+  if (!row) {
+    throw MgException("failed to copy result row");
+  }
+  return Row(row);
+}
+
 inline void Client::DiscardAll() {
-  while (FetchOne())
-    ;
+  mg_result *result;
+  int status = mg_session_discard(session_, nullptr, &result);
+  if (status < 0) {
+    failure_ = status;
+  }
+  ThrowIfFailed(session_, status);
+}
+
+inline bool Client::DumpAll(const std::string &path) {
+  mg_result *result;
+  int status = mg_session_dump(session_, path.c_str(), &result);
+  if (status < 0) {
+    failure_ = status;
+  }
+  ThrowIfFailed(session_, status);
+  return status == 0;
 }
 
 inline std::optional<std::vector<std::vector<Value>>> Client::FetchAll() {
@@ -268,10 +1386,124 @@ inline std::optional<std::vector<std::vector<Value>>> Client::FetchAll() {
   return data;
 }
 
+inline std::optional<std::vector<Row>> Client::FetchAllRows() {
+  std::vector<Row> data;
+  while (auto maybe_row = FetchRow()) {
+    data.emplace_back(std::move(*maybe_row));
+  }
+  return data;
+}
+
+inline std::optional<std::vector<ConstRow>> Client::FetchAll(Arena &arena) {
+  if (mg_session_set_arena(session_, arena.ptr()) != 0) {
+    return std::nullopt;
+  }
+  std::vector<ConstRow> data;
+  try {
+    while (mg_result *result = FetchResult()) {
+      data.emplace_back(mg_result_row(result));
+    }
+  } catch (...) {
+    mg_session_set_arena(session_, nullptr);
+    throw;
+  }
+  mg_session_set_arena(session_, nullptr);
+  return data;
+}
+
+inline std::optional<std::vector<Column>> Client::FetchAllColumns() {
+  std::vector<Column> columns;
+  columns.reserve(columns_.size());
+  for (const auto &name : columns_) {
+    columns.emplace_back(name);
+  }
+  while (mg_result *result = FetchResult()) {
+    const ConstList row(mg_result_row(result));
+    for (size_t i = 0; i < columns.size() && i < row.size(); ++i) {
+      columns[i].Append(row[i]);
+    }
+  }
+  return columns;
+}
+
+template <typename T>
+inline void Client::BindColumns() {
+  if (bound_type_ == detail::TypeTag<T>()) {
+    return;
+  }
+  binding_.clear();
+  std::apply(
+      [this](const auto &...fields) {
+        auto bind = [this](std::string_view name) {
+          auto it = std::find(columns_.begin(), columns_.end(), name);
+          if (it == columns_.end()) {
+            throw ClientException("column '" + std::string(name) +
+                                  "' is missing from the result");
+          }
+          binding_.push_back(static_cast<uint32_t>(it - columns_.begin()));
+        };
+        (bind(fields.name), ...);
+      },
+      RowBinding<T>::fields);
+  bound_type_ = detail::TypeTag<T>();
+}
+
+template <typename T>
+inline std::optional<T> Client::FetchAs() {
+  BindColumns<T>();
+  mg_result *result = FetchResult(true);
+  if (!result) {
+    return std::nullopt;
+  }
+  mg_lazy_row *row = mg_result_row_lazy(result);
+  T value{};
+  std::apply(
+      [&](const auto &...fields) {
+        size_t i = 0;
+        auto read = [&](const auto &field) {
+          int status = detail::ReadLazyField(row, binding_[i++], field.name,
+                                             &(value.*field.member));
+          if (status != 0) {
+            ThrowFailure(status);
+          }
+        };
+        (read(fields), ...);
+      },
+      RowBinding<T>::fields);
+  return value;
+}
+
+template <typename T>
+inline std::optional<std::vector<T>> Client::FetchAllAs() {
+  static_assert(!detail::BindsStringView<std::remove_cv_t<
+                    decltype(RowBinding<T>::fields)>>::value,
+                "fields bound as std::string_view would dangle after the next "
+                "fetch, use std::string or FetchAs");
+  std::vector<T> data;
+  while (auto maybe_value = FetchAs<T>()) {
+    data.emplace_back(std::move(*maybe_value));
+  }
+  return data;
+}
+
 inline const std::vector<std::string> &Client::GetColumns() const {
   return columns_;
 }
 
+inline std::optional<mg_session_stats> Client::Stats() const {
+  mg_session_stats stats;
+  if (mg_session_get_stats(session_, &stats) != 0) {
+    return std::nullopt;
+  }
+  return stats;
+}
+
+inline bool Client::SetQueryTimeout(std::chrono::milliseconds timeout) {
+  return mg_session_set_query_timeout(session_, (int)timeout.count()) == 0;
+}
+
+inline void Client::Cancel() { mg_session_cancel(session_); }
+
 inline bool Client::BeginTransaction() {
   return mg_session_begin_transaction(session_, nullptr) == 0;
 }
@@ -286,4 +1518,797 @@ inline bool Client::RollbackTransaction() {
   return mg_session_rollback_transaction(session_, &result) == 0;
 }
 
+inline void Client::ThrowFailure(int status) {
+  failure_ = status;
+  ThrowIfFailed(session_, status);
+  throw MgException(mg_session_error(session_));
+}
+
+template <typename F>
+inline std::invoke_result_t<F &, Client &> Client::ExecuteWriteTransaction(
+    F &&work, const RetryPolicy &policy) {
+  detail::Backoff backoff(policy);
+  while (true) {
+    try {
+      return RunTransaction(work);
+    } catch (...) {
+      if (!CanRetryTransaction() || !backoff.Wait()) {
+        throw;
+      }
+    }
+  }
+}
+
+template <typename F>
+inline std::invoke_result_t<F &, Client &> Client::RunTransaction(F &work) {
+  failure_ = 0;
+  int status = mg_session_begin_transaction(session_, nullptr);
+  if (status != 0) {
+    ThrowFailure(status);
+  }
+  try {
+    auto commit = [this] {
+      if (failure_ != 0) {
+        // The server has already aborted the transaction.
+        ThrowFailure(failure_);
+      }
+      mg_result *result;
+      int status = mg_session_commit_transaction(session_, &result);
+      if (status != 0) {
+        ThrowFailure(status);
+      }
+    };
+    if constexpr (std::is_void_v<std::invoke_result_t<F &, Client &>>) {
+      work(*this);
+      commit();
+    } else {
+      auto result = work(*this);
+      commit();
+      return result;
+    }
+  } catch (...) {
+    AbortTransaction();
+    throw;
+  }
+}
+
+inline void Client::AbortTransaction() noexcept {
+  // Failures while cleaning up don't change why the attempt failed.
+  const int failure = failure_;
+  int status = mg_session_status(session_);
+  if (status == MG_SESSION_EXECUTING || status == MG_SESSION_FETCHING) {
+    try {
+      DiscardAll();
+    } catch (const MgException &) {
+    }
+  }
+  if (mg_session_status(session_) == MG_SESSION_READY) {
+    mg_session_reset(session_);
+  }
+  failure_ = failure;
+}
+
+inline bool Client::CanRetryTransaction() const {
+  return failure_ == MG_ERROR_TRANSIENT_ERROR &&
+         mg_session_status(session_) == MG_SESSION_READY;
+}
+
+/// A thread-safe pool of connected clients.
+///
+/// All clients of a pool are connected with the same `Client::Params`, so a
+/// pool holds connections to a single host, and `max_connections` caps the
+/// number of connections to it. Use a pool per host to talk to several hosts.
+///
+/// Idle clients are reset (see `mg_session_reset`) before they are handed out
+/// again, which rolls back any transaction left open and drops clients whose
+/// connection died while they were idle. Clients whose session became bad
+/// while in use are closed instead of being returned to the pool.
+class ClientPool final {
+ public:
+  struct Params {
+    Client::Params client;
+    /// Maximum number of open connections, both idle and in use.
+    size_t max_connections = 8;
+    /// Reset idle clients before reusing them. This costs a network round trip
+    /// per `Acquire`, but guarantees that the returned client is usable.
+    bool reset_on_acquire = true;
+  };
+
+  /// A client borrowed from the pool. The client is returned to the pool when
+  /// the handle is destroyed or `Release` is called. Handles must not outlive
+  /// the pool.
+  class Handle final {
+   public:
+    Handle() = default;
+    Handle(Handle &&other) = default;
+    Handle &operator=(Handle &&other);
+    Handle(const Handle &) = delete;
+    Handle &operator=(const Handle &) = delete;
+    ~Handle() { Release(); }
+
+    explicit operator bool() const { return client_ != nullptr; }
+    Client *get() const { return client_.get(); }
+    Client *operator->() const { return client_.get(); }
+    Client &operator*() const { return *client_; }
+
+    /// Returns the client to the pool, leaving the handle empty.
+    void Release();
+
+   private:
+    friend class ClientPool;
+    Handle(ClientPool *pool, std::unique_ptr<Client> client)
+        : pool_(pool), client_(std::move(client)) {}
+
+    ClientPool *pool_{nullptr};
+    std::unique_ptr<Client> client_;
+  };
+
+  explicit ClientPool(Params params) : params_(std::move(params)) {}
+  ClientPool(const ClientPool &) = delete;
+  ClientPool(ClientPool &&) = delete;
+  ClientPool &operator=(const ClientPool &) = delete;
+  ClientPool &operator=(ClientPool &&) = delete;
+  ~ClientPool() = default;
+
+  /// \brief Borrows a client from the pool.
+  /// An idle client is reused if there is one, otherwise a new client is
+  /// connected. If `max_connections` clients are already in use, waits until
+  /// one of them is released.
+  /// \return an empty handle if a new client couldn't be connected.
+  Handle Acquire();
+
+  /// \brief Like `Acquire()`, but waits at most `timeout` for a client to be
+  /// released.
+  /// \return an empty handle on timeout or if a new client couldn't be
+  /// connected.
+  Handle Acquire(std::chrono::milliseconds timeout);
+
+  /// \brief Runs `work` with a client of the pool in a transaction and
+  /// commits it, like `Client::ExecuteWriteTransaction`. Besides transient
+  /// errors, the transaction is also retried when the connection breaks or the
+  /// pool can't connect, with a newly connected client.
+  ///
+  /// A connection that breaks while the transaction is being committed leaves
+  /// it unknown whether the transaction was committed, so `work` might take
+  /// effect more than once. Make it idempotent (e.g. with `MERGE`) if that
+  /// matters.
+  template <typename F>
+  std::invoke_result_t<F &, Client &> ExecuteWriteTransaction(
+      F &&work, const RetryPolicy &policy = RetryPolicy());
+
+  /// \brief Number of open connections, both idle and in use.
+  size_t size() const;
+
+  /// \brief Number of idle connections.
+  size_t idle() const;
+
+ private:
+  using Deadline = std::optional<std::chrono::steady_clock::time_point>;
+
+  Handle AcquireUntil(const Deadline &deadline);
+  void Release(std::unique_ptr<Client> client);
+
+  const Params params_;
+  mutable std::mutex mutex_;
+  std::condition_variable released_;
+  // Used as a stack, so that the most recently used clients are reused first.
+  std::vector<std::unique_ptr<Client>> idle_;
+  size_t open_{0};
+};
+
+inline ClientPool::Handle &ClientPool::Handle::operator=(Handle &&other) {
+  if (this != &other) {
+    Release();
+    pool_ = other.pool_;
+    client_ = std::move(other.client_);
+  }
+  return *this;
+}
+
+inline void ClientPool::Handle::Release() {
+  if (client_) {
+    pool_->Release(std::move(client_));
+  }
+}
+
+inline ClientPool::Handle ClientPool::Acquire() {
+  return AcquireUntil(std::nullopt);
+}
+
+inline ClientPool::Handle ClientPool::Acquire(
+    std::chrono::milliseconds timeout) {
+  return AcquireUntil(std::chrono::steady_clock::now() + timeout);
+}
+
+inline ClientPool::Handle ClientPool::AcquireUntil(const Deadline &deadline) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (!idle_.empty()) {
+      std::unique_ptr<Client> client = std::move(idle_.back());
+      idle_.pop_back();
+      lock.unlock();
+      if (!params_.reset_on_acquire ||
+          mg_session_reset(client->session_) == 0) {
+        return Handle(this, std::move(client));
+      }
+      // The connection is broken, close it and take its slot.
+      client.reset();
+      lock.lock();
+      --open_;
+      continue;
+    }
+
+    if (open_ < params_.max_connections) {
+      // Connect without holding the lock, the slot is reserved meanwhile.
+      ++open_;
+      lock.unlock();
+      std::unique_ptr<Client> client = Client::Connect(params_.client);
+      if (client) {
+        return Handle(this, std::move(client));
+      }
+      lock.lock();
+      --open_;
+      lock.unlock();
+      released_.notify_one();
+      return Handle();
+    }
+
+    if (!deadline) {
+      released_.wait(lock);
+    } else if (released_.wait_until(lock, *deadline) ==
+                   std::cv_status::timeout &&
+               idle_.empty() && open_ >= params_.max_connections) {
+      return Handle();
+    }
+  }
+}
+
+inline void ClientPool::Release(std::unique_ptr<Client> client) {
+  // A client in the middle of a query can't be reset, so it is closed as well.
+  if (mg_session_status(client->session_) != MG_SESSION_READY) {
+    client.reset();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (client) {
+      idle_.push_back(std::move(client));
+    } else {
+      --open_;
+    }
+  }
+  released_.notify_one();
+}
+
+template <typename F>
+inline std::invoke_result_t<F &, Client &> ClientPool::ExecuteWriteTransaction(
+    F &&work, const RetryPolicy &policy) {
+  detail::Backoff backoff(policy);
+  while (true) {
+    Handle handle = Acquire();
+    if (!handle) {
+      if (!backoff.Wait()) {
+        throw MgException("couldn't connect to the server");
+      }
+      continue;
+    }
+    try {
+      return handle->RunTransaction(work);
+    } catch (...) {
+      bool retry = handle->CanRetryTransaction() ||
+                   mg_session_status(handle->session_) == MG_SESSION_BAD;
+      // A broken client is closed here, so that the next attempt connects a
+      // new one.
+      handle.Release();
+      if (!retry || !backoff.Wait()) {
+        throw;
+      }
+    }
+  }
+}
+
+inline size_t ClientPool::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return open_;
+}
+
+inline size_t ClientPool::idle() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return idle_.size();
+}
+
+/// Routes queries across the instances of a replicated Memgraph deployment,
+/// keeping a `ClientPool` per instance.
+///
+/// Roles of the instances are discovered with `SHOW REPLICATION ROLE`. Write
+/// access goes to the MAIN instance, while read access goes to the REPLICA
+/// with the fewest clients in use at the moment, or to MAIN if no replica is
+/// available. An instance that can't report its role (a standalone instance)
+/// counts as MAIN.
+///
+/// When connecting to an instance fails, or a client's connection breaks
+/// while in use, the instance is avoided for `down_interval`, and the roles of
+/// the other instances are discovered again, so that a replica promoted to
+/// MAIN takes over the writes. Queries that were being executed on a broken
+/// connection aren't retried, as they might have been executed already.
+class Router final {
+ public:
+  enum class Access { Write, Read };
+  enum class Role { Unknown, Main, Replica };
+
+  struct Endpoint {
+    std::string host;
+    uint16_t port = 7687;
+  };
+
+  struct Params {
+    std::vector<Endpoint> endpoints;
+    /// Parameters of the pool of each endpoint, with the host and port
+    /// replaced by those of the endpoint.
+    ClientPool::Params pool;
+    /// How long an endpoint is avoided after a connection to it failed.
+    std::chrono::milliseconds down_interval{5000};
+  };
+
+  /// A client borrowed from the pool of an endpoint, see `ClientPool::Handle`.
+  /// Handles must not outlive the router.
+  class Handle final {
+   public:
+    Handle() = default;
+    Handle(Handle &&other) = default;
+    Handle &operator=(Handle &&other);
+    Handle(const Handle &) = delete;
+    Handle &operator=(const Handle &) = delete;
+    ~Handle() { Release(); }
+
+    explicit operator bool() const { return static_cast<bool>(handle_); }
+    Client *get() const { return handle_.get(); }
+    Client *operator->() const { return handle_.get(); }
+    Client &operator*() const { return *handle_; }
+
+    /// Index of the endpoint the client is connected to.
+    size_t endpoint() const { return endpoint_; }
+
+    /// Returns the client to its pool, leaving the handle empty.
+    void Release();
+
+   private:
+    friend class Router;
+    Handle(Router *router, size_t endpoint, ClientPool::Handle handle)
+        : router_(router), endpoint_(endpoint), handle_(std::move(handle)) {}
+
+    Router *router_{nullptr};
+    size_t endpoint_{0};
+    ClientPool::Handle handle_;
+  };
+
+  explicit Router(Params params);
+  Router(const Router &) = delete;
+  Router(Router &&) = delete;
+  Router &operator=(const Router &) = delete;
+  Router &operator=(Router &&) = delete;
+  ~Router() = default;
+
+  /// \brief Borrows a client of an instance suitable for `access`, failing
+  /// over to other instances if connecting fails.
+  /// \return an empty handle if no suitable instance is reachable.
+  Handle Acquire(Access access);
+
+  /// \brief Discovers the roles of all endpoints which aren't avoided.
+  void Refresh();
+
+  /// \brief Role of the endpoint at `index`, as last discovered.
+  Role role(size_t index) const;
+
+  /// \brief Number of clients of the endpoint at `index` in use.
+  size_t in_use(size_t index) const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Node {
+    std::unique_ptr<ClientPool> pool;
+    Role role{Role::Unknown};
+    size_t in_use{0};
+    // The endpoint is avoided until then.
+    Clock::time_point down_until{};
+  };
+
+  // Picks an endpoint for `access` and marks a client of it as in use.
+  // Requires `mutex_`.
+  std::optional<size_t> Pick(Access access, Clock::time_point now);
+  // Whether a reachable endpoint has an unknown role. Requires `mutex_`.
+  bool NeedsRefresh(Clock::time_point now) const;
+  // Avoids the endpoint and forgets the roles. Requires `mutex_`.
+  void MarkDown(size_t index, Clock::time_point now);
+  void Release(size_t index, ClientPool::Handle handle);
+
+  const std::chrono::milliseconds down_interval_;
+  std::vector<Node> nodes_;
+  mutable std::mutex mutex_;
+  // Held while discovering roles, so that only one thread does it.
+  std::mutex refresh_mutex_;
+};
+
+inline Router::Handle &Router::Handle::operator=(Handle &&other) {
+  if (this != &other) {
+    Release();
+    router_ = other.router_;
+    endpoint_ = other.endpoint_;
+    handle_ = std::move(other.handle_);
+  }
+  return *this;
+}
+
+inline void Router::Handle::Release() {
+  if (handle_) {
+    router_->Release(endpoint_, std::move(handle_));
+  }
+}
+
+inline Router::Router(Params params) : down_interval_(params.down_interval) {
+  for (const Endpoint &endpoint : params.endpoints) {
+    ClientPool::Params pool_params = params.pool;
+    pool_params.client.host = endpoint.host;
+    pool_params.client.port = endpoint.port;
+    nodes_.emplace_back();
+    nodes_.back().pool = std::make_unique<ClientPool>(std::move(pool_params));
+  }
+}
+
+inline Router::Handle Router::Acquire(Access access) {
+  // Every attempt either succeeds or puts an endpoint down.
+  for (size_t attempt = 0; attempt <= nodes_.size(); ++attempt) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (NeedsRefresh(Clock::now())) {
+      lock.unlock();
+      Refresh();
+      lock.lock();
+    }
+    std::optional<size_t> index = Pick(access, Clock::now());
+    if (!index) {
+      return Handle();
+    }
+    lock.unlock();
+
+    ClientPool::Handle handle = nodes_[*index].pool->Acquire();
+    if (handle) {
+      return Handle(this, *index, std::move(handle));
+    }
+    lock.lock();
+    --nodes_[*index].in_use;
+    MarkDown(*index, Clock::now());
+  }
+  return Handle();
+}
+
+inline void Router::Refresh() {
+  std::lock_guard<std::mutex> refresh_lock(refresh_mutex_);
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (nodes_[i].down_until > Clock::now()) {
+        continue;
+      }
+    }
+    ClientPool::Handle handle = nodes_[i].pool->Acquire();
+    Role role = Role::Unknown;
+    if (handle) {
+      // Instances without replication can't tell their role, and are
+      // standalone MAIN instances.
+      role = Role::Main;
+      try {
+        if (handle->Execute("SHOW REPLICATION ROLE")) {
+          auto rows = handle->FetchAll();
+          if (rows && !rows->empty() && !rows->front().empty() &&
+              rows->front()[0].type() == Value::Type::String &&
+              rows->front()[0].ValueString() == "replica") {
+            role = Role::Replica;
+          }
+        }
+      } catch (const MgException &) {
+      }
+      if (mg_session_status(handle->session_) == MG_SESSION_BAD) {
+        role = Role::Unknown;
+      }
+      handle.Release();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    nodes_[i].role = role;
+    if (role == Role::Unknown) {
+      nodes_[i].down_until = Clock::now() + down_interval_;
+    }
+  }
+}
+
+inline Router::Role Router::role(size_t index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nodes_[index].role;
+}
+
+inline size_t Router::in_use(size_t index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nodes_[index].in_use;
+}
+
+inline std::optional<size_t> Router::Pick(Access access,
+                                          Clock::time_point now) {
+  std::optional<size_t> main;
+  std::optional<size_t> replica;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const Node &node = nodes_[i];
+    if (node.down_until > now) {
+      continue;
+    }
+    if (node.role == Role::Main && !main) {
+      main = i;
+    } else if (node.role == Role::Replica &&
+               (!replica || node.in_use < nodes_[*replica].in_use)) {
+      replica = i;
+    }
+  }
+  std::optional<size_t> index =
+      access == Access::Read && replica ? replica : main;
+  if (index) {
+    ++nodes_[*index].in_use;
+  }
+  return index;
+}
+
+inline bool Router::NeedsRefresh(Clock::time_point now) const {
+  for (const Node &node : nodes_) {
+    if (node.role == Role::Unknown && node.down_until <= now) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void Router::MarkDown(size_t index, Clock::time_point now) {
+  nodes_[index].down_until = now + down_interval_;
+  // Another instance may have been promoted in the meantime.
+  for (Node &node : nodes_) {
+    node.role = Role::Unknown;
+  }
+}
+
+inline void Router::Release(size_t index, ClientPool::Handle handle) {
+  bool broken = mg_session_status(handle->session_) == MG_SESSION_BAD;
+  handle.Release();
+  std::lock_guard<std::mutex> lock(mutex_);
+  --nodes_[index].in_use;
+  if (broken) {
+    MarkDown(index, Clock::now());
+  }
+}
+
+/// Writes rows to the database in batches, each of them passed as the
+/// `$batch` parameter of a statement such as
+/// `UNWIND $batch AS row CREATE (:Node {id: row[0]})`.
+///
+/// Rows are collected until a batch is full. Full batches are queued for
+/// pipelined execution (see `mg_session_pipeline_run`) on the clients in
+/// turn, so that the server executes them while the next ones are being
+/// collected. Once `max_pending` batches are queued on a client, the writer
+/// waits for the oldest of them to be executed before queuing another one.
+///
+/// Rows can be of any type accepted by `ParamWriter`. They are encoded
+/// straight into the output buffer of a client when their batch is queued, so
+/// the writer only holds the rows of the current batch.
+///
+/// The clients can't be used for anything else until `Finish` returns. Failed
+/// batches are reported by throwing from `Add` or `Finish`, after which the
+/// writer can't be used anymore.
+template <typename Row>
+class BulkWriter final {
+ public:
+  struct Params {
+    /// Maximum number of rows in a batch.
+    size_t batch_rows = 10000;
+    /// Maximum encoded size of a batch in bytes, 0 means no limit. A row
+    /// bigger than this makes a batch of its own.
+    size_t batch_bytes = 0;
+    /// Maximum number of queued batches per client.
+    size_t max_pending = 4;
+    /// Write all batches of a client in a single explicit transaction, which
+    /// is committed by `Finish`. Otherwise, each batch is committed on its
+    /// own.
+    bool transaction = false;
+  };
+
+  /// \throws ClientException if `clients` is empty or contains a null
+  /// pointer, or MgException if the statement couldn't be prepared.
+  BulkWriter(std::vector<Client *> clients, const std::string &statement,
+             Params params)
+      : statement_(statement), params_(params) {
+    if (clients.empty()) {
+      throw ClientException("no clients to write to");
+    }
+    for (Client *client : clients) {
+      if (!client) {
+        throw ClientException("null client");
+      }
+      targets_.push_back(Target{client, {}, false, 0});
+    }
+    if (params_.max_pending == 0) {
+      params_.max_pending = 1;
+    }
+  }
+
+  BulkWriter(Client &client, const std::string &statement, Params params)
+      : BulkWriter(std::vector<Client *>{&client}, statement, params) {}
+
+  BulkWriter(const BulkWriter &) = delete;
+  BulkWriter &operator=(const BulkWriter &) = delete;
+
+  /// Waits for the queued batches, but drops the rows that weren't queued yet
+  /// and rolls back transactions that weren't committed by `Finish`.
+  ~BulkWriter();
+
+  /// \brief Adds a row, queuing the current batch if it is full.
+  /// \throws MgException if a batch failed.
+  void Add(Row row);
+
+  /// \brief Queues the remaining rows and waits for all batches to be
+  /// executed, committing the transactions if `Params::transaction` is set.
+  /// \throws MgException if a batch failed.
+  void Finish();
+
+  /// \brief Number of rows written by the batches executed (and committed)
+  /// so far.
+  size_t rows_written() const { return rows_written_; }
+
+ private:
+  struct Target {
+    Client *client;
+    // Numbers of rows in the queued batches, oldest first.
+    std::deque<size_t> pending;
+    bool in_transaction;
+    // Rows written in the current transaction.
+    size_t uncommitted;
+  };
+
+  void Queue();
+
+  // Waits for the oldest batch queued on `target`.
+  void Wait(Target &target);
+
+  void Check(Target &target, int status);
+
+  std::vector<Target> targets_;
+  PreparedQuery statement_;
+  Params params_;
+  std::vector<Row> batch_;
+  size_t batch_size_{0};
+  size_t next_{0};
+  size_t rows_written_{0};
+  bool failed_{false};
+};
+
+template <typename Row>
+inline BulkWriter<Row>::~BulkWriter() {
+  for (Target &target : targets_) {
+    mg_session *session = target.client->session_;
+    for (; !target.pending.empty(); target.pending.pop_front()) {
+      if (mg_session_pipeline_next(session, nullptr, nullptr) != 0) {
+        continue;
+      }
+      mg_result *result;
+      while (mg_session_fetch(session, &result) == 1) {
+      }
+    }
+    if (target.in_transaction) {
+      mg_result *result;
+      mg_session_rollback_transaction(session, &result);
+    }
+  }
+}
+
+template <typename Row>
+inline void BulkWriter<Row>::Add(Row row) {
+  if (failed_) {
+    throw MgException("an earlier batch failed");
+  }
+  size_t row_size = 0;
+  if (params_.batch_bytes) {
+    ParamWriter sizer;
+    sizer.Write(row);
+    row_size = sizer.size();
+    if (!batch_.empty() && batch_size_ + row_size > params_.batch_bytes) {
+      Queue();
+    }
+  }
+  batch_.push_back(std::move(row));
+  batch_size_ += row_size;
+  if (batch_.size() >= params_.batch_rows ||
+      (params_.batch_bytes && batch_size_ >= params_.batch_bytes)) {
+    Queue();
+  }
+}
+
+template <typename Row>
+inline void BulkWriter<Row>::Finish() {
+  if (failed_) {
+    throw MgException("an earlier batch failed");
+  }
+  if (!batch_.empty()) {
+    Queue();
+  }
+  for (Target &target : targets_) {
+    while (!target.pending.empty()) {
+      Wait(target);
+    }
+    if (target.in_transaction) {
+      mg_result *result;
+      Check(target,
+            mg_session_commit_transaction(target.client->session_, &result));
+      target.in_transaction = false;
+      rows_written_ += target.uncommitted;
+      target.uncommitted = 0;
+    }
+  }
+}
+
+template <typename Row>
+inline void BulkWriter<Row>::Queue() {
+  Target &target = targets_[next_];
+  next_ = (next_ + 1) % targets_.size();
+  mg_session *session = target.client->session_;
+  while (target.pending.size() >= params_.max_pending) {
+    Wait(target);
+  }
+  if (params_.transaction && !target.in_transaction) {
+    Check(target, mg_session_begin_transaction(session, nullptr));
+    target.in_transaction = true;
+  }
+
+  auto write = [this](ParamWriter &writer) {
+    writer.BeginMap(1);
+    writer.Write("batch");
+    writer.Write(batch_);
+  };
+  detail::ParamWriterCallback<decltype(write)> callback{write};
+  int status = mg_session_pipeline_run_prepared_with_writer(
+      session, statement_.ptr(), callback.Call, &callback, nullptr);
+  if (status != 0) {
+    failed_ = true;
+  }
+  callback.RethrowIfFailed();
+  Check(target, status);
+  target.pending.push_back(batch_.size());
+  batch_.clear();
+  batch_size_ = 0;
+
+  // Get the server going on the batch right away.
+  Check(target, mg_session_pipeline_flush(session));
+}
+
+template <typename Row>
+inline void BulkWriter<Row>::Wait(Target &target) {
+  mg_session *session = target.client->session_;
+  Check(target, mg_session_pipeline_next(session, nullptr, nullptr));
+  mg_result *result;
+  int status;
+  while ((status = mg_session_fetch(session, &result)) == 1) {
+  }
+  Check(target, status);
+  if (target.in_transaction) {
+    target.uncommitted += target.pending.front();
+  } else {
+    rows_written_ += target.pending.front();
+  }
+  target.pending.pop_front();
+}
+
+template <typename Row>
+inline void BulkWriter<Row>::Check(Target &target, int status) {
+  if (status >= 0) {
+    return;
+  }
+  failed_ = true;
+  // Batches queued after a failed one are discarded by the server.
+  target.pending.clear();
+  Client::ThrowIfFailed(target.client->session_, status);
+  throw MgException(mg_session_error(target.client->session_));
+}
+
 }  // namespace mg
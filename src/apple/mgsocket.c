@@ -15,6 +15,7 @@
 #include "mgsocket.h"
 
 #include <string.h>
+#include <time.h>
 
 #define MG_RETRY_ON_EINTR(expression)          \
   __extension__({                              \
@@ -53,6 +54,21 @@ int mg_socket_connect(int sock, const struct sockaddr *addr,
   return MG_SUCCESS;
 }
 
+int mg_socket_connect_in_progress(void) { return errno == EINPROGRESS; }
+
+int mg_socket_connect_result(int sock) {
+  int error = 0;
+  socklen_t error_len = sizeof(error);
+  if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0) {
+    return MG_ERROR_SOCKET;
+  }
+  if (error != 0) {
+    errno = error;
+    return MG_ERROR_SOCKET;
+  }
+  return MG_SUCCESS;
+}
+
 int mg_socket_connect_handle_error(int *sock, int status, mg_session *session) {
   if (status != MG_SUCCESS) {
     mg_session_set_error(session, "couldn't connect to host: %s",
@@ -76,10 +92,40 @@ ssize_t mg_socket_send(int sock, const void *buf, int len) {
   return MG_RETRY_ON_EINTR(send(sock, buf, len, 0));
 }
 
+ssize_t mg_socket_send_vector(int sock, const mg_transport_buffer *buffers,
+                              size_t count) {
+  struct iovec iov[MG_TRANSPORT_MAX_BUFFERS];
+  for (size_t i = 0; i < count; ++i) {
+    iov[i].iov_base = (void *)buffers[i].data;
+    iov[i].iov_len = buffers[i].len;
+  }
+  struct msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = iov;
+  message.msg_iovlen = count;
+  return MG_RETRY_ON_EINTR(sendmsg(sock, &message, 0));
+}
+
 ssize_t mg_socket_receive(int sock, void *buf, int len) {
   return MG_RETRY_ON_EINTR(recv(sock, buf, len, 0));
 }
 
+int mg_socket_set_nonblocking(int sock, int nonblocking) {
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags == -1) {
+    return MG_ERROR_SOCKET;
+  }
+  flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  if (fcntl(sock, F_SETFL, flags) == -1) {
+    return MG_ERROR_SOCKET;
+  }
+  return MG_SUCCESS;
+}
+
+int mg_socket_would_block(void) {
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
 int mg_socket_poll(struct pollfd *fds, unsigned int nfds, int timeout) {
   return MG_RETRY_ON_EINTR(poll(fds, nfds, timeout));
 }
@@ -93,3 +139,9 @@ int mg_socket_close(int sock) { return MG_RETRY_ON_EINTR(close(sock)); }
 char *mg_socket_error(void) { return strerror(errno); }
 
 void mg_socket_finalize(void) {}
+
+uint64_t mg_clock_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
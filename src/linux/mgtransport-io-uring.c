@@ -0,0 +1,469 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "mgclient.h"
+#include "mgsocket.h"
+#include "mgtransport.h"
+
+// At most a write and a read are in flight at any time.
+#define MG_IO_URING_ENTRIES 4
+
+#define MG_IO_URING_BUFFER_SIZE 65536
+
+// `user_data` of the submitted requests.
+#define MG_IO_URING_WRITE 0
+#define MG_IO_URING_READ 1
+
+// Result of a request which wasn't submitted.
+#define MG_IO_URING_NONE 1
+
+static int mg_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int mg_io_uring_enter(int ring_fd, unsigned to_submit,
+                             unsigned min_complete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                      flags, NULL, 0);
+}
+
+static void mg_io_uring_transport_unmap(mg_io_uring_transport *self) {
+  if (self->sqes && self->sqes != MAP_FAILED) {
+    munmap(self->sqes, self->sqes_size);
+  }
+  if (self->cq_ring && self->cq_ring != MAP_FAILED) {
+    munmap(self->cq_ring, self->cq_ring_size);
+  }
+  if (self->sq_ring && self->sq_ring != MAP_FAILED) {
+    munmap(self->sq_ring, self->sq_ring_size);
+  }
+}
+
+int mg_io_uring_transport_init(int sockfd, mg_io_uring_transport **transport,
+                               mg_allocator *allocator) {
+  mg_io_uring_transport *ttransport =
+      mg_allocator_malloc(allocator, sizeof(mg_io_uring_transport));
+  if (!ttransport) {
+    return MG_ERROR_OOM;
+  }
+  memset(ttransport, 0, sizeof(mg_io_uring_transport));
+  ttransport->ring_fd = -1;
+  ttransport->allocator = allocator;
+
+  int status = 0;
+
+  ttransport->send_capacity = MG_IO_URING_BUFFER_SIZE;
+  ttransport->send_buffer =
+      mg_allocator_malloc(allocator, ttransport->send_capacity);
+  ttransport->recv_capacity = MG_IO_URING_BUFFER_SIZE;
+  ttransport->recv_buffer =
+      mg_allocator_malloc(allocator, ttransport->recv_capacity);
+  if (!ttransport->send_buffer || !ttransport->recv_buffer) {
+    status = MG_ERROR_OOM;
+    goto failure;
+  }
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ttransport->ring_fd = mg_io_uring_setup(MG_IO_URING_ENTRIES, &params);
+  if (ttransport->ring_fd < 0) {
+    status = MG_ERROR_SOCKET;
+    goto failure;
+  }
+
+  ttransport->sq_ring_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ttransport->sq_ring =
+      mmap(NULL, ttransport->sq_ring_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ttransport->ring_fd, IORING_OFF_SQ_RING);
+  ttransport->cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ttransport->cq_ring =
+      mmap(NULL, ttransport->cq_ring_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ttransport->ring_fd, IORING_OFF_CQ_RING);
+  ttransport->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ttransport->sqes =
+      mmap(NULL, ttransport->sqes_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ttransport->ring_fd, IORING_OFF_SQES);
+  if (ttransport->sq_ring == MAP_FAILED || ttransport->cq_ring == MAP_FAILED ||
+      ttransport->sqes == MAP_FAILED) {
+    status = MG_ERROR_SOCKET;
+    goto failure;
+  }
+
+  char *sq_ring = ttransport->sq_ring;
+  ttransport->sq_head = (unsigned *)(sq_ring + params.sq_off.head);
+  ttransport->sq_tail = (unsigned *)(sq_ring + params.sq_off.tail);
+  ttransport->sq_mask = (unsigned *)(sq_ring + params.sq_off.ring_mask);
+  ttransport->sq_array = (unsigned *)(sq_ring + params.sq_off.array);
+  char *cq_ring = ttransport->cq_ring;
+  ttransport->cq_head = (unsigned *)(cq_ring + params.cq_off.head);
+  ttransport->cq_tail = (unsigned *)(cq_ring + params.cq_off.tail);
+  ttransport->cq_mask = (unsigned *)(cq_ring + params.cq_off.ring_mask);
+  ttransport->cqes = (struct io_uring_cqe *)(cq_ring + params.cq_off.cqes);
+
+  ttransport->sockfd = sockfd;
+  ttransport->send = mg_io_uring_transport_send;
+  ttransport->recv = mg_io_uring_transport_recv;
+  ttransport->recv_some = mg_io_uring_transport_recv_some;
+  ttransport->try_send = mg_io_uring_transport_try_send;
+  ttransport->try_recv = mg_io_uring_transport_try_recv;
+  // Sends are staged in the send buffer anyway.
+  ttransport->send_vector = NULL;
+  ttransport->destroy = mg_io_uring_transport_destroy;
+  ttransport->suspend_until_ready_to_read = NULL;
+  ttransport->suspend_until_ready_to_write = NULL;
+  *transport = ttransport;
+  return 0;
+
+failure:
+  mg_io_uring_transport_unmap(ttransport);
+  if (ttransport->ring_fd >= 0) {
+    close(ttransport->ring_fd);
+  }
+  mg_allocator_free(allocator, ttransport->send_buffer);
+  mg_allocator_free(allocator, ttransport->recv_buffer);
+  mg_allocator_free(allocator, ttransport);
+  return status;
+}
+
+static struct io_uring_sqe *mg_io_uring_transport_get_sqe(
+    mg_io_uring_transport *self, uint64_t user_data) {
+  unsigned tail = *self->sq_tail;
+  unsigned index = tail & *self->sq_mask;
+  struct io_uring_sqe *sqe = &self->sqes[index];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->fd = self->sockfd;
+  sqe->user_data = user_data;
+  self->sq_array[index] = index;
+  __atomic_store_n(self->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  return sqe;
+}
+
+// Submits the staged data (if any) and a read into `buf` (if given), linked so
+// that the read is issued only after the whole write succeeds, and waits for
+// both of them with a single system call. If `dontwait` is set, requests which
+// can't complete right away fail with -EAGAIN instead of waiting for the
+// socket (io_uring doesn't honor O_NONBLOCK on sockets). The results are
+// stored in `write_result` and `read_result`, MG_IO_URING_NONE for a request
+// which wasn't made. Returns -1 if the requests couldn't be submitted.
+static int mg_io_uring_transport_submit(mg_io_uring_transport *self, char *buf,
+                                        size_t len, int dontwait,
+                                        int *write_result, int *read_result) {
+  *write_result = MG_IO_URING_NONE;
+  *read_result = MG_IO_URING_NONE;
+  unsigned requests = 0;
+  if (self->send_pending) {
+    struct io_uring_sqe *sqe =
+        mg_io_uring_transport_get_sqe(self, MG_IO_URING_WRITE);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->addr = (uint64_t)(uintptr_t)self->send_buffer;
+    sqe->len = (uint32_t)self->send_pending;
+    sqe->msg_flags = MSG_NOSIGNAL | (dontwait ? MSG_DONTWAIT : 0);
+    if (buf) {
+      sqe->flags = IOSQE_IO_LINK;
+    }
+    ++requests;
+  }
+  if (buf) {
+    struct io_uring_sqe *sqe =
+        mg_io_uring_transport_get_sqe(self, MG_IO_URING_READ);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->msg_flags = dontwait ? MSG_DONTWAIT : 0;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len > INT_MAX ? INT_MAX : (uint32_t)len;
+    ++requests;
+  }
+
+  unsigned completed = 0;
+  while (completed < requests) {
+    unsigned unsubmitted =
+        *self->sq_tail - __atomic_load_n(self->sq_head, __ATOMIC_ACQUIRE);
+    if (mg_io_uring_enter(self->ring_fd, unsubmitted, requests - completed,
+                          IORING_ENTER_GETEVENTS) < 0 &&
+        errno != EINTR) {
+      perror("mg_io_uring_transport_submit");
+      return -1;
+    }
+    unsigned head = *self->cq_head;
+    unsigned tail = __atomic_load_n(self->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head, ++completed) {
+      struct io_uring_cqe *cqe = &self->cqes[head & *self->cq_mask];
+      if (cqe->user_data == MG_IO_URING_WRITE) {
+        *write_result = cqe->res;
+      } else {
+        *read_result = cqe->res;
+      }
+    }
+    __atomic_store_n(self->cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  if (self->send_pending && *write_result > 0) {
+    size_t written = (size_t)*write_result;
+    memmove(self->send_buffer, self->send_buffer + written,
+            self->send_pending - written);
+    self->send_pending -= written;
+  }
+  return 0;
+}
+
+// Blocking operations on a socket in non-blocking mode wait here until the
+// socket becomes ready.
+static int mg_io_uring_transport_wait(mg_io_uring_transport *self,
+                                      short events) {
+  struct pollfd p;
+  p.fd = self->sockfd;
+  p.events = events;
+  p.revents = 0;
+  return mg_socket_poll(&p, 1, -1) < 0 ? -1 : 0;
+}
+
+// Checks the result of the write part of a submission. Returns 1 if the
+// caller should retry, 0 if it can go on and -1 on failure.
+static int mg_io_uring_transport_check_write(mg_io_uring_transport *self,
+                                             int write_result) {
+  if (write_result == -EAGAIN) {
+    return mg_io_uring_transport_wait(self, POLLOUT) == 0 ? 1 : -1;
+  }
+  if (write_result == -EINTR) {
+    return 1;
+  }
+  if (write_result < 0) {
+    errno = -write_result;
+    perror("mg_io_uring_transport_send");
+    return -1;
+  }
+  return 0;
+}
+
+static int mg_io_uring_transport_flush(mg_io_uring_transport *self) {
+  while (self->send_pending) {
+    int write_result, read_result;
+    if (mg_io_uring_transport_submit(self, NULL, 0, 0, &write_result,
+                                     &read_result) != 0 ||
+        mg_io_uring_transport_check_write(self, write_result) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int mg_io_uring_transport_send(struct mg_transport *transport, const char *buf,
+                               size_t len) {
+  mg_io_uring_transport *self = (mg_io_uring_transport *)transport;
+  while (len > 0) {
+    if (self->send_pending == self->send_capacity &&
+        mg_io_uring_transport_flush(self) != 0) {
+      return -1;
+    }
+    size_t now = self->send_capacity - self->send_pending;
+    if (now > len) {
+      now = len;
+    }
+    memcpy(self->send_buffer + self->send_pending, buf, now);
+    self->send_pending += now;
+    buf += now;
+    len -= now;
+  }
+  return 0;
+}
+
+int mg_io_uring_transport_recv(struct mg_transport *transport, char *buf,
+                               size_t len) {
+  size_t total_received = 0;
+  while (total_received < len) {
+    ssize_t received_now = mg_io_uring_transport_recv_some(
+        transport, buf + total_received, len - total_received);
+    if (received_now < 0) {
+      return -1;
+    }
+    total_received += (size_t)received_now;
+  }
+  return 0;
+}
+
+static size_t mg_io_uring_transport_take_received(mg_io_uring_transport *self,
+                                                  char *buf, size_t len) {
+  size_t buffered = self->recv_end - self->recv_begin;
+  if (len > buffered) {
+    len = buffered;
+  }
+  memcpy(buf, self->recv_buffer + self->recv_begin, len);
+  self->recv_begin += len;
+  return len;
+}
+
+ssize_t mg_io_uring_transport_recv_some(struct mg_transport *transport,
+                                        char *buf, size_t len) {
+  mg_io_uring_transport *self = (mg_io_uring_transport *)transport;
+  if (self->recv_begin < self->recv_end) {
+    return (ssize_t)mg_io_uring_transport_take_received(self, buf, len);
+  }
+  // Big reads go directly to the destination, small ones are buffered.
+  int direct = len >= self->recv_capacity;
+  while (1) {
+    int write_result, read_result;
+    if (mg_io_uring_transport_submit(
+            self, direct ? buf : self->recv_buffer,
+            direct ? len : self->recv_capacity, 0, &write_result,
+            &read_result) != 0) {
+      return -1;
+    }
+    int write_status = mg_io_uring_transport_check_write(self, write_result);
+    if (write_status < 0) {
+      return -1;
+    }
+    if (write_status > 0 || read_result == -ECANCELED ||
+        read_result == -EINTR) {
+      // The read was cancelled because not all of the staged data was
+      // written.
+      continue;
+    }
+    if (read_result == -EAGAIN) {
+      if (mg_io_uring_transport_wait(self, POLLIN) != 0) {
+        return -1;
+      }
+      continue;
+    }
+    if (read_result == 0) {
+      // Server closed the connection.
+      fprintf(stderr,
+              "mg_io_uring_transport_recv_some: connection closed by server\n");
+      return -1;
+    }
+    if (read_result < 0) {
+      errno = -read_result;
+      perror("mg_io_uring_transport_recv_some");
+      return -1;
+    }
+    if (direct) {
+      return read_result;
+    }
+    self->recv_begin = 0;
+    self->recv_end = (size_t)read_result;
+    return (ssize_t)mg_io_uring_transport_take_received(self, buf, len);
+  }
+}
+
+// Writes whatever is staged without blocking. Returns 0 once nothing is
+// staged, MG_TRANSPORT_WANT_WRITE if the socket isn't writable or -1 on
+// failure.
+static int mg_io_uring_transport_try_flush(mg_io_uring_transport *self) {
+  while (self->send_pending) {
+    int write_result, read_result;
+    if (mg_io_uring_transport_submit(self, NULL, 0, 1, &write_result,
+                                     &read_result) != 0) {
+      return -1;
+    }
+    if (write_result == -EAGAIN) {
+      return MG_TRANSPORT_WANT_WRITE;
+    }
+    if (write_result < 0 && write_result != -EINTR) {
+      errno = -write_result;
+      perror("mg_io_uring_transport_try_send");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+ssize_t mg_io_uring_transport_try_send(struct mg_transport *transport,
+                                       const char *buf, size_t len) {
+  mg_io_uring_transport *self = (mg_io_uring_transport *)transport;
+  int status = mg_io_uring_transport_try_flush(self);
+  if (status != 0) {
+    return status;
+  }
+  // Data has to reach the socket before returning, since the session may wait
+  // for the server's response without calling into the transport again.
+  if (len > self->send_capacity) {
+    len = self->send_capacity;
+  }
+  memcpy(self->send_buffer, buf, len);
+  self->send_pending = len;
+  int write_result, read_result;
+  if (mg_io_uring_transport_submit(self, NULL, 0, 1, &write_result,
+                                   &read_result) != 0) {
+    return -1;
+  }
+  // Whatever wasn't written is taken back.
+  self->send_pending = 0;
+  if (write_result == -EAGAIN || write_result == -EINTR) {
+    return MG_TRANSPORT_WANT_WRITE;
+  }
+  if (write_result < 0) {
+    errno = -write_result;
+    perror("mg_io_uring_transport_try_send");
+    return -1;
+  }
+  return write_result;
+}
+
+ssize_t mg_io_uring_transport_try_recv(struct mg_transport *transport,
+                                       char *buf, size_t len) {
+  mg_io_uring_transport *self = (mg_io_uring_transport *)transport;
+  if (self->recv_begin < self->recv_end) {
+    return (ssize_t)mg_io_uring_transport_take_received(self, buf, len);
+  }
+  int status = mg_io_uring_transport_try_flush(self);
+  if (status != 0) {
+    return status;
+  }
+  int write_result, read_result;
+  if (mg_io_uring_transport_submit(self, self->recv_buffer,
+                                   self->recv_capacity, 1, &write_result,
+                                   &read_result) != 0) {
+    return -1;
+  }
+  if (read_result == -EAGAIN || read_result == -EINTR) {
+    return MG_TRANSPORT_WANT_READ;
+  }
+  if (read_result == 0) {
+    // Server closed the connection.
+    fprintf(stderr,
+            "mg_io_uring_transport_try_recv: connection closed by server\n");
+    return -1;
+  }
+  if (read_result < 0) {
+    errno = -read_result;
+    perror("mg_io_uring_transport_try_recv");
+    return -1;
+  }
+  self->recv_begin = 0;
+  self->recv_end = (size_t)read_result;
+  return (ssize_t)mg_io_uring_transport_take_received(self, buf, len);
+}
+
+void mg_io_uring_transport_destroy(struct mg_transport *transport) {
+  mg_io_uring_transport *self = (mg_io_uring_transport *)transport;
+  // Messages like GOODBYE may still be staged.
+  mg_io_uring_transport_flush(self);
+  mg_io_uring_transport_unmap(self);
+  close(self->ring_fd);
+  if (mg_socket_close(self->sockfd) != 0) {
+    abort();
+  }
+  mg_allocator_free(self->allocator, self->send_buffer);
+  mg_allocator_free(self->allocator, self->recv_buffer);
+  mg_allocator_free(self->allocator, transport);
+}
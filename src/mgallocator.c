@@ -30,21 +30,78 @@ typedef double max_align_t;
 #include <stdlib.h>
 #include <string.h>
 
-void *mg_system_realloc(struct mg_allocator *self, void *buf, size_t size) {
+#include "mgcommon.h"
+
+static void *mg_libc_realloc(struct mg_allocator *self, void *buf,
+                             size_t size) {
   (void)self;
   return realloc(buf, size);
 }
 
-void *mg_system_malloc(struct mg_allocator *self, size_t size) {
+static void *mg_libc_malloc(struct mg_allocator *self, size_t size) {
   (void)self;
   return malloc(size);
 }
 
-void mg_system_free(struct mg_allocator *self, void *buf) {
+static void mg_libc_free(struct mg_allocator *self, void *buf) {
   (void)self;
   free(buf);
 }
 
+static struct mg_allocator mg_libc_allocator = {mg_libc_malloc, mg_libc_realloc,
+                                                mg_libc_free};
+
+static mg_allocator *mg_allocator_of_process = &mg_libc_allocator;
+static MG_THREAD_LOCAL mg_allocator *mg_allocator_of_thread = NULL;
+
+void mg_set_allocator(mg_allocator *allocator) {
+  mg_allocator_of_process = allocator ? allocator : &mg_libc_allocator;
+}
+
+void mg_set_thread_allocator(mg_allocator *allocator) {
+  mg_allocator_of_thread = allocator;
+}
+
+mg_allocator *mg_current_allocator(void) {
+  return mg_allocator_of_thread ? mg_allocator_of_thread
+                                : mg_allocator_of_process;
+}
+
+static void *mg_system_malloc(struct mg_allocator *self, size_t size) {
+  (void)self;
+  mg_allocator *allocator = mg_current_allocator();
+  return allocator->malloc(allocator, size);
+}
+
+static void *mg_system_realloc(struct mg_allocator *self, void *buf,
+                               size_t size) {
+  (void)self;
+  mg_allocator *allocator = mg_current_allocator();
+  return allocator->realloc(allocator, buf, size);
+}
+
+static void mg_system_free(struct mg_allocator *self, void *buf) {
+  (void)self;
+  mg_allocator *allocator = mg_current_allocator();
+  allocator->free(allocator, buf);
+}
+
+static void *mg_process_malloc(struct mg_allocator *self, size_t size) {
+  (void)self;
+  return mg_allocator_of_process->malloc(mg_allocator_of_process, size);
+}
+
+static void *mg_process_realloc(struct mg_allocator *self, void *buf,
+                                size_t size) {
+  (void)self;
+  return mg_allocator_of_process->realloc(mg_allocator_of_process, buf, size);
+}
+
+static void mg_process_free(struct mg_allocator *self, void *buf) {
+  (void)self;
+  mg_allocator_of_process->free(mg_allocator_of_process, buf);
+}
+
 void *mg_allocator_malloc(struct mg_allocator *allocator, size_t size) {
   return allocator->malloc(allocator, size);
 }
@@ -61,23 +118,29 @@ void mg_allocator_free(struct mg_allocator *allocator, void *buf) {
 struct mg_allocator mg_system_allocator = {mg_system_malloc, mg_system_realloc,
                                            mg_system_free};
 
+struct mg_allocator mg_process_allocator = {
+    mg_process_malloc, mg_process_realloc, mg_process_free};
+
 typedef struct mg_memory_block {
   char *buffer;
+  size_t size;
   struct mg_memory_block *next;
 } mg_memory_block;
 
+// Block header is padded so that the buffer is aligned as max_align_t.
+#define MG_MEMORY_BLOCK_HEADER_SIZE                                    \
+  ((sizeof(mg_memory_block) + alignof(max_align_t) - 1) /              \
+   alignof(max_align_t) * alignof(max_align_t))
+
 mg_memory_block *mg_memory_block_alloc(mg_allocator *allocator, size_t size) {
-  /// Ensure that the memory is properly aligned.
-  _Static_assert(
-      sizeof(mg_memory_block) % alignof(max_align_t) == 0,
-      "Size of mg_memory_block doesn't satisfy alignment requirements");
   mg_memory_block *block =
-      mg_allocator_malloc(allocator, sizeof(mg_memory_block) + size);
+      mg_allocator_malloc(allocator, MG_MEMORY_BLOCK_HEADER_SIZE + size);
   if (!block) {
     return NULL;
   }
   block->next = NULL;
-  block->buffer = (char *)block + sizeof(mg_memory_block);
+  block->size = size;
+  block->buffer = (char *)block + MG_MEMORY_BLOCK_HEADER_SIZE;
   return block;
 }
 
@@ -89,42 +152,92 @@ typedef struct mg_linear_allocator {
   mg_memory_block *current_block;
   size_t current_offset;
 
-  const size_t block_size;
+  size_t block_size;
   const size_t sep_alloc_threshold;
 
+  // Number of bytes allocated since the last reset, used to grow `block_size`
+  // up to `max_block_size`.
+  size_t allocated;
+  size_t max_block_size;
+
+  // Blocks kept around on reset for reuse, at most `max_spare_blocks` of them.
+  mg_memory_block *spare_blocks;
+  size_t spare_block_count;
+  size_t max_spare_blocks;
+
   mg_allocator *underlying_allocator;
 } mg_linear_allocator;
 
+// Takes a spare block of at least `size` bytes, or allocates a new one.
+static mg_memory_block *mg_linear_allocator_get_block(
+    mg_linear_allocator *self, size_t size) {
+  mg_memory_block **prev = &self->spare_blocks;
+  while (*prev) {
+    mg_memory_block *block = *prev;
+    if (block->size >= size) {
+      *prev = block->next;
+      block->next = NULL;
+      self->spare_block_count--;
+      return block;
+    }
+    prev = &block->next;
+  }
+  return mg_memory_block_alloc(self->underlying_allocator, size);
+}
+
+static void mg_linear_allocator_put_block(mg_linear_allocator *self,
+                                          mg_memory_block *block) {
+  if (self->spare_block_count >= self->max_spare_blocks) {
+    mg_allocator_free(self->underlying_allocator, block);
+    return;
+  }
+  block->next = self->spare_blocks;
+  self->spare_blocks = block;
+  self->spare_block_count++;
+}
+
 void *mg_linear_allocator_malloc(struct mg_allocator *allocator, size_t size) {
   mg_linear_allocator *self = (mg_linear_allocator *)allocator;
 
-  if (size >= self->sep_alloc_threshold) {
+  self->allocated += size;
+
+  int fits = self->current_block &&
+             self->current_offset + size <= self->current_block->size;
+
+  if (!fits && size >= self->sep_alloc_threshold && self->current_block) {
     // Make a new block, but put it below the first block so we don't waste
     // bytes in it.
-    mg_memory_block *new_block =
-        mg_memory_block_alloc(self->underlying_allocator, size);
+    mg_memory_block *new_block = mg_linear_allocator_get_block(self, size);
+    if (!new_block) {
+      return NULL;
+    }
     new_block->next = self->current_block->next;
     self->current_block->next = new_block;
     return new_block->buffer;
   }
 
-  if (self->current_offset + size > self->block_size) {
+  if (!fits) {
     // Create a new block and put it at the beginning of the list.
-    mg_memory_block *new_block =
-        mg_memory_block_alloc(self->underlying_allocator, self->block_size);
+    size_t block_size = size > self->block_size ? size : self->block_size;
+    mg_memory_block *new_block = mg_linear_allocator_get_block(self, block_size);
+    if (!new_block) {
+      return NULL;
+    }
     new_block->next = self->current_block;
     self->current_block = new_block;
     self->current_offset = 0;
   }
 
-  assert(self->current_offset + size <= self->block_size);
+  assert(self->current_offset + size <= self->current_block->size);
   assert(self->current_offset % alignof(max_align_t) == 0);
 
   void *ret = self->current_block->buffer + self->current_offset;
   self->current_offset += size;
   if (self->current_offset % alignof(max_align_t) != 0) {
-    self->current_offset +=
+    size_t padding =
         alignof(max_align_t) - (self->current_offset % alignof(max_align_t));
+    self->current_offset += padding;
+    self->allocated += padding;
   }
   return ret;
 }
@@ -159,6 +272,11 @@ mg_linear_allocator *mg_linear_allocator_init(mg_allocator *allocator,
                                    0,
                                    block_size,
                                    sep_alloc_threshold,
+                                   0,
+                                   block_size,
+                                   NULL,
+                                   0,
+                                   0,
                                    allocator};
   mg_linear_allocator *alloc =
       mg_allocator_malloc(allocator, sizeof(mg_linear_allocator));
@@ -171,27 +289,79 @@ mg_linear_allocator *mg_linear_allocator_init(mg_allocator *allocator,
   return alloc;
 }
 
+void mg_linear_allocator_set_limits(mg_linear_allocator *allocator,
+                                    size_t max_block_size,
+                                    size_t max_spare_blocks) {
+  allocator->max_block_size = max_block_size;
+  if (allocator->block_size > max_block_size) {
+    allocator->block_size = max_block_size;
+  }
+  allocator->max_spare_blocks = max_spare_blocks;
+  while (allocator->spare_block_count > max_spare_blocks) {
+    mg_memory_block *block = allocator->spare_blocks;
+    allocator->spare_blocks = block->next;
+    allocator->spare_block_count--;
+    mg_allocator_free(allocator->underlying_allocator, block);
+  }
+}
+
+size_t mg_linear_allocator_block_size(const mg_linear_allocator *allocator) {
+  return allocator->block_size;
+}
+
+size_t mg_linear_allocator_allocated(const mg_linear_allocator *allocator) {
+  return allocator->allocated;
+}
+
+static void mg_memory_block_list_free(mg_allocator *allocator,
+                                      mg_memory_block *block) {
+  while (block) {
+    mg_memory_block *next_block = block->next;
+    mg_allocator_free(allocator, block);
+    block = next_block;
+  }
+}
+
 void mg_linear_allocator_destroy(mg_linear_allocator *allocator) {
   if (allocator == NULL) {
     return;
   }
-  while (allocator->current_block) {
-    mg_memory_block *next_block = allocator->current_block->next;
-    mg_allocator_free(allocator->underlying_allocator,
-                      allocator->current_block);
-    allocator->current_block = next_block;
-  }
+  mg_memory_block_list_free(allocator->underlying_allocator,
+                            allocator->current_block);
+  mg_memory_block_list_free(allocator->underlying_allocator,
+                            allocator->spare_blocks);
   mg_allocator_free(allocator->underlying_allocator, allocator);
 }
 
 void mg_linear_allocator_reset(mg_linear_allocator *allocator) {
-  // The first block is always of size allocator->block_size. We will keep that
-  // one and free the others.
-  mg_memory_block *first_block = allocator->current_block;
-  while (first_block->next) {
-    mg_memory_block *new_next = first_block->next->next;
-    mg_allocator_free(allocator->underlying_allocator, first_block->next);
-    first_block->next = new_next;
+  // If everything allocated since the last reset didn't fit in one block, make
+  // the blocks bigger so that it does next time.
+  while (allocator->allocated > allocator->block_size &&
+         allocator->block_size < allocator->max_block_size) {
+    allocator->block_size = allocator->block_size * 2 < allocator->max_block_size
+                                ? allocator->block_size * 2
+                                : allocator->max_block_size;
+  }
+  allocator->allocated = 0;
+
+  // Keep the first block of at least `block_size` bytes for the next message,
+  // others are either kept as spares or freed.
+  mg_memory_block *block = allocator->current_block;
+  mg_memory_block *first_block = NULL;
+  while (block) {
+    mg_memory_block *next_block = block->next;
+    block->next = NULL;
+    if (!first_block && block->size >= allocator->block_size) {
+      first_block = block;
+    } else {
+      mg_linear_allocator_put_block(allocator, block);
+    }
+    block = next_block;
+  }
+  if (!first_block) {
+    // If this fails, the next allocation will try again.
+    first_block = mg_linear_allocator_get_block(allocator, allocator->block_size);
   }
+  allocator->current_block = first_block;
   allocator->current_offset = 0;
 }
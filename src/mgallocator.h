@@ -21,11 +21,7 @@ extern "C" {
 
 #include <stddef.h>
 
-typedef struct mg_allocator {
-  void *(*malloc)(struct mg_allocator *self, size_t size);
-  void *(*realloc)(struct mg_allocator *self, void *buf, size_t size);
-  void (*free)(struct mg_allocator *self, void *buf);
-} mg_allocator;
+#include "mgclient.h"
 
 void *mg_allocator_malloc(struct mg_allocator *allocator, size_t size);
 
@@ -56,30 +52,60 @@ void mg_allocator_free(struct mg_allocator *allocator, void *buf);
 ///
 /// Allocator is tuned with the following constructor parameters:
 /// - block_size: size of the standard allocation block,
-/// - sep_alloc_threshold: objects bigger that this size are given their
-///                        separate blocks, as this will prevent wasting too
-///                        much memory (the maximum amount of wasted memory per
-///                        block is sep_alloc_threshold, not including padding).
+/// - sep_alloc_threshold: objects bigger that this size which don't fit in the
+///                        current block are given their separate blocks, as
+///                        this will prevent wasting too much memory (the
+///                        maximum amount of wasted memory per block is
+///                        sep_alloc_threshold, not including padding).
 ///
 /// When an objects gets its separate block, it will be placed as the second
 /// element of the linked list, so we don't waste leftover space in the first
 /// element.
 ///
 /// Memory from the allocator is freed using `mg_linear_allocator_reset`. It
-/// only keeps one empty block of size `block_size` to avoid allocating for each
-/// row in the common case when the entire result row fits in a single block.
+/// keeps one empty block of size `block_size` to avoid allocating for each row
+/// in the common case when the entire result row fits in a single block.
+///
+/// The allocator can also adapt to the observed message size, which is
+/// controlled by `mg_linear_allocator_set_limits`:
+/// - max_block_size: when more than `block_size` bytes were allocated between
+///                   two resets, `block_size` is doubled (up to this limit),
+///                   so that the next message fits in a single block,
+/// - max_spare_blocks: up to this many of the other blocks are kept on reset
+///                     and reused instead of allocating new ones.
+///
+/// By default, `block_size` is fixed and no spare blocks are kept.
 typedef struct mg_linear_allocator mg_linear_allocator;
 
 mg_linear_allocator *mg_linear_allocator_init(mg_allocator *allocator,
                                               size_t block_size,
                                               size_t sep_alloc_threshold);
 
+void mg_linear_allocator_set_limits(mg_linear_allocator *allocator,
+                                    size_t max_block_size,
+                                    size_t max_spare_blocks);
+
+size_t mg_linear_allocator_block_size(const mg_linear_allocator *allocator);
+
+// Number of bytes allocated since the last reset.
+size_t mg_linear_allocator_allocated(const mg_linear_allocator *allocator);
+
 void mg_linear_allocator_reset(mg_linear_allocator *allocator);
 
 void mg_linear_allocator_destroy(mg_linear_allocator *allocator);
 
+// Allocates through the allocator of the calling thread, if it has one, and
+// through the allocator of the process otherwise (see `mg_set_allocator` and
+// `mg_set_thread_allocator`).
 extern struct mg_allocator mg_system_allocator;
 
+// Always allocates through the allocator of the process. Used for state shared
+// by all threads.
+extern struct mg_allocator mg_process_allocator;
+
+// The allocator `mg_system_allocator` allocates through at the moment.
+mg_allocator *mg_current_allocator(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,36 +23,46 @@
 
 #include "mgcommon.h"
 #include "mgconstants.h"
+#include "mgdecodepool.h"
+#include "mgdump.h"
 #include "mgmessage.h"
+#include "mgresolver.h"
 #include "mgsession.h"
 #include "mgsocket.h"
 #include "mgtransport.h"
 #include "mgvalue.h"
 
+// Arenas allocate blocks of this size by default. Blocks grow up to the maximum
+// size with the rows decoded between resets, and some of them are kept on
+// reset for the rows decoded next.
+#define MG_ARENA_BLOCK_SIZE 65536
+#define MG_ARENA_SEP_ALLOC_THRESHOLD 4096
+#define MG_ARENA_MAX_BLOCK_SIZE 4194304
+#define MG_ARENA_SPARE_BLOCKS 16
+
+// Delay before the connection attempt to the next address of a host starts,
+// recommended by RFC 8305.
+#define MG_CONNECT_ATTEMPT_DELAY_MS 250
+
 const char *mg_client_version(void) { return MGCLIENT_VERSION; }
 
 int mg_init_session_static_vars(void) {
-  mg_value *n_val = mg_value_make_integer(-1);
-  if (!n_val) {
-    goto fatal_failure;
-  }
-  mg_default_pull_extra_map = mg_map_make_empty(1);
+  // The map is shared by all threads, so it is copied with the allocator of
+  // the process.
+  char n_key_data[] = "n";
+  mg_string n_key = {1, n_key_data};
+  mg_value n_value;
+  n_value.type = MG_VALUE_TYPE_INTEGER;
+  n_value.integer_v = -1;
+  mg_string *keys[] = {&n_key};
+  mg_value *values[] = {&n_value};
+  mg_map pull_extra = {1, 1, keys, values, 0, NULL};
+  mg_default_pull_extra_map =
+      mg_map_copy_ca(&pull_extra, &mg_process_allocator);
   if (!mg_default_pull_extra_map) {
-    goto fatal_failure;
-  }
-  if (mg_map_insert_unsafe(mg_default_pull_extra_map, "n", n_val) != 0) {
-    goto fatal_failure;
+    return MG_ERROR_CLIENT_ERROR;
   }
   return MG_SUCCESS;
-
-fatal_failure:
-  if (n_val) {
-    mg_value_destroy(n_val);
-  }
-  if (mg_default_pull_extra_map) {
-    mg_map_destroy(mg_default_pull_extra_map);
-  }
-  return MG_ERROR_CLIENT_ERROR;
 }
 
 int mg_init(void) {
@@ -61,12 +71,21 @@ int mg_init(void) {
   return mg_socket_init();
 }
 
-void mg_finalize(void) { mg_socket_finalize(); }
+void mg_finalize(void) {
+#ifndef __EMSCRIPTEN__
+  mg_secure_transport_finalize();
+#endif
+  mg_resolver_finalize();
+  mg_socket_finalize();
+}
 
 typedef struct mg_session_params {
   const char *address;
   const char *host;
   uint16_t port;
+  int connect_timeout;
+  int dns_cache_ttl;
+  int query_timeout;
   const char *username;
   const char *password;
   const char *user_agent;
@@ -76,6 +95,17 @@ typedef struct mg_session_params {
   int (*trust_callback)(const char *, const char *, const char *, const char *,
                         void *);
   void *trust_data;
+  int64_t fetch_size;
+  size_t decoder_max_block_size;
+  size_t decoder_spare_blocks;
+  size_t max_message_size;
+  int shrink_after;
+  enum mg_io_backend io_backend;
+  int ktls;
+  int decode_threads;
+  int collect_stats;
+  mg_trace_callback_type trace_callback;
+  void *trace_data;
 } mg_session_params;
 
 mg_session_params *mg_session_params_make(void) {
@@ -87,6 +117,9 @@ mg_session_params *mg_session_params_make(void) {
   params->address = NULL;
   params->host = NULL;
   params->port = 0;
+  params->connect_timeout = 0;
+  params->dns_cache_ttl = 0;
+  params->query_timeout = 0;
   params->username = NULL;
   params->password = NULL;
   params->user_agent = MG_USER_AGENT;
@@ -95,6 +128,17 @@ mg_session_params *mg_session_params_make(void) {
   params->sslkey = NULL;
   params->trust_callback = NULL;
   params->trust_data = NULL;
+  params->fetch_size = 0;
+  params->decoder_max_block_size = 0;
+  params->decoder_spare_blocks = 0;
+  params->max_message_size = 0;
+  params->shrink_after = 0;
+  params->io_backend = MG_IO_BACKEND_SOCKET;
+  params->ktls = 0;
+  params->decode_threads = 0;
+  params->collect_stats = 0;
+  params->trace_callback = NULL;
+  params->trace_data = NULL;
   return params;
 }
 
@@ -160,6 +204,69 @@ void mg_session_params_set_trust_data(mg_session_params *params,
   params->trust_data = trust_data;
 }
 
+void mg_session_params_set_fetch_size(mg_session_params *params,
+                                      int64_t fetch_size) {
+  params->fetch_size = fetch_size;
+}
+
+void mg_session_params_set_decoder_limits(mg_session_params *params,
+                                          size_t max_block_size,
+                                          size_t spare_blocks) {
+  params->decoder_max_block_size = max_block_size;
+  params->decoder_spare_blocks = spare_blocks;
+}
+
+void mg_session_params_set_message_limits(mg_session_params *params,
+                                          size_t max_message_size,
+                                          int shrink_after) {
+  params->max_message_size = max_message_size;
+  params->shrink_after = shrink_after;
+}
+
+void mg_session_params_set_io_backend(mg_session_params *params,
+                                      enum mg_io_backend io_backend) {
+  params->io_backend = io_backend;
+}
+
+void mg_session_params_set_ktls(mg_session_params *params, int ktls) {
+  params->ktls = ktls;
+}
+
+void mg_session_params_set_decode_threads(mg_session_params *params,
+                                          int decode_threads) {
+  params->decode_threads = decode_threads;
+}
+
+void mg_session_params_set_collect_stats(mg_session_params *params,
+                                         int collect_stats) {
+  params->collect_stats = collect_stats;
+}
+
+void mg_session_params_set_trace_callback(
+    mg_session_params *params, mg_trace_callback_type trace_callback) {
+  params->trace_callback = trace_callback;
+}
+
+void mg_session_params_set_trace_data(mg_session_params *params,
+                                      void *trace_data) {
+  params->trace_data = trace_data;
+}
+
+void mg_session_params_set_connect_timeout(mg_session_params *params,
+                                           int connect_timeout_ms) {
+  params->connect_timeout = connect_timeout_ms;
+}
+
+void mg_session_params_set_dns_cache_ttl(mg_session_params *params,
+                                         int dns_cache_ttl_ms) {
+  params->dns_cache_ttl = dns_cache_ttl_ms;
+}
+
+void mg_session_params_set_query_timeout(mg_session_params *params,
+                                         int query_timeout_ms) {
+  params->query_timeout = query_timeout_ms;
+}
+
 const char *mg_session_params_get_address(const mg_session_params *params) {
   return params->address;
 }
@@ -205,6 +312,67 @@ void *mg_session_params_get_trust_data(const mg_session_params *params) {
   return params->trust_data;
 }
 
+int64_t mg_session_params_get_fetch_size(const mg_session_params *params) {
+  return params->fetch_size;
+}
+
+size_t mg_session_params_get_decoder_max_block_size(
+    const mg_session_params *params) {
+  return params->decoder_max_block_size;
+}
+
+size_t mg_session_params_get_decoder_spare_blocks(
+    const mg_session_params *params) {
+  return params->decoder_spare_blocks;
+}
+
+size_t mg_session_params_get_max_message_size(
+    const mg_session_params *params) {
+  return params->max_message_size;
+}
+
+int mg_session_params_get_shrink_after(const mg_session_params *params) {
+  return params->shrink_after;
+}
+
+enum mg_io_backend mg_session_params_get_io_backend(
+    const mg_session_params *params) {
+  return params->io_backend;
+}
+
+int mg_session_params_get_ktls(const mg_session_params *params) {
+  return params->ktls;
+}
+
+int mg_session_params_get_decode_threads(const mg_session_params *params) {
+  return params->decode_threads;
+}
+
+int mg_session_params_get_collect_stats(const mg_session_params *params) {
+  return params->collect_stats;
+}
+
+mg_trace_callback_type mg_session_params_get_trace_callback(
+    const mg_session_params *params) {
+  return params->trace_callback;
+}
+
+void *mg_session_params_get_trace_data(const mg_session_params *params) {
+  return params->trace_data;
+}
+
+int mg_session_params_get_connect_timeout(const mg_session_params *params) {
+  return params->connect_timeout;
+}
+
+int mg_session_params_get_dns_cache_ttl(const mg_session_params *params) {
+  return params->dns_cache_ttl;
+}
+
+int mg_session_params_get_query_timeout(const mg_session_params *params) {
+  return params->query_timeout;
+}
+
 int validate_session_params(const mg_session_params *params,
                             mg_session *session) {
   if ((!params->address && !params->host) ||
@@ -233,30 +401,37 @@ static int mg_bolt_handshake(mg_session *session) {
   const uint32_t VERSION_NONE = htobe32(0);
   const uint32_t VERSION_1 = htobe32(1);
   const uint32_t VERSION_4_1 = htobe32(0x0104);
+  // Versions 5.2 down to 5.0, proposed as a range of minor versions below 5.2.
+  const uint32_t VERSION_5_RANGE = htobe32(0x00020205);
+  // Magic and all proposed versions are sent in a single packet.
+  char handshake[20];
+  memcpy(handshake, MG_HANDSHAKE_MAGIC, 4);
+  memcpy(handshake + 4, &VERSION_5_RANGE, 4);
+  memcpy(handshake + 8, &VERSION_4_1, 4);
+  memcpy(handshake + 12, &VERSION_1, 4);
+  memcpy(handshake + 16, &VERSION_NONE, 4);
   mg_transport_suspend_until_ready_to_write(session->transport);
-  if (mg_transport_send(session->transport, MG_HANDSHAKE_MAGIC,
-                        strlen(MG_HANDSHAKE_MAGIC)) != 0 ||
-      mg_transport_send(session->transport, (char *)&VERSION_4_1, 4) != 0 ||
-      mg_transport_send(session->transport, (char *)&VERSION_1, 4) != 0 ||
-      mg_transport_send(session->transport, (char *)&VERSION_NONE, 4) != 0 ||
-      mg_transport_send(session->transport, (char *)&VERSION_NONE, 4) != 0) {
+  if (mg_session_send_raw(session, handshake, sizeof(handshake)) != 0) {
     mg_session_set_error(session, "failed to send handshake data");
     return MG_ERROR_SEND_FAILED;
   }
 
   uint32_t server_version;
-  mg_transport_suspend_until_ready_to_read(session->transport);
-  if (mg_transport_recv(session->transport, (char *)&server_version, 4) != 0) {
+  if (mg_session_read_raw(session, (char *)&server_version, 4) != 0) {
     mg_session_set_error(session, "failed to receive handshake response");
     return MG_ERROR_RECV_FAILED;
   }
+  uint32_t version = be32toh(server_version);
   if (server_version == VERSION_1) {
-    session->version = 1;
+    mg_session_set_version(session, 1);
   } else if (server_version == VERSION_4_1) {
-    session->version = 4;
+    mg_session_set_version(session, 4);
+  } else if ((version & 0xFFFF00FF) == 5 && (version >> 8) <= 2) {
+    mg_session_set_version(session, 5);
+    session->minor_version = (int)(version >> 8);
   } else {
     mg_session_set_error(session, "unsupported protocol version: %" PRIu32,
-                         be32toh(server_version));
+                         version);
     return MG_ERROR_PROTOCOL_VIOLATION;
   }
   return 0;
@@ -320,12 +495,16 @@ int handle_failure_message(mg_session *session, mg_message_failure *message) {
     goto done;
   }
 
-  char *type_begin = strchr(code->data, '.');
+  // String data isn't null-terminated, so searches must be bounded by its
+  // size.
+  const char *code_end = code->data + code->size;
+  const char *type_begin = memchr(code->data, '.', code->size);
   if (!type_begin) {
     goto done;
   }
   type_begin++;
-  char *type_end = strchr(type_begin, '.');
+  const char *type_end =
+      memchr(type_begin, '.', (size_t)(code_end - type_begin));
   if (!type_end) {
     goto done;
   }
@@ -364,8 +543,8 @@ int mg_bolt_init_v1(mg_session *session, const mg_session_params *params) {
   return status;
 }
 
-static mg_map *build_hello_extra(const char *user_agent, const char *username,
-                                 const char *password) {
+static mg_map *build_hello_extra(const char *user_agent, int with_auth,
+                                 const char *username, const char *password) {
   mg_map *extra = mg_map_make_empty(4);
   if (!extra) {
     return NULL;
@@ -379,6 +558,10 @@ static mg_map *build_hello_extra(const char *user_agent, const char *username,
     }
   }
 
+  if (!with_auth) {
+    return extra;
+  }
+
   assert((username && password) || (!username && !password));
   if (username) {
     mg_value *scheme = mg_value_make_string("basic");
@@ -411,8 +594,8 @@ cleanup:
 }
 
 int mg_bolt_init_v4(mg_session *session, const mg_session_params *params) {
-  mg_map *extra =
-      build_hello_extra(params->user_agent, params->username, params->password);
+  mg_map *extra = build_hello_extra(params->user_agent, 1, params->username,
+                                    params->password);
   if (!extra) {
     return MG_ERROR_OOM;
   }
@@ -423,18 +606,40 @@ int mg_bolt_init_v4(mg_session *session, const mg_session_params *params) {
   return status;
 }
 
-static int mg_bolt_init(mg_session *session, const mg_session_params *params) {
-  int status = session->version == 1 ? mg_bolt_init_v1(session, params)
-                                     : mg_bolt_init_v4(session, params);
-  if (status != 0) {
-    return status;
+// Since Bolt 5.1 authentication is moved from HELLO to LOGON. Both messages
+// are sent in a single write.
+static int mg_bolt_init_v5_1(mg_session *session,
+                             const mg_session_params *params) {
+  mg_map *extra = build_hello_extra(params->user_agent, 0, NULL, NULL);
+  if (!extra) {
+    return MG_ERROR_OOM;
+  }
+  mg_map *auth_token = build_auth_token(params->username, params->password);
+  if (!auth_token) {
+    mg_map_destroy(extra);
+    return MG_ERROR_OOM;
+  }
+
+  int buffer_messages = session->buffer_messages;
+  session->buffer_messages = 1;
+  int status = mg_session_send_hello_message(session, extra);
+  session->buffer_messages = buffer_messages;
+  if (status == 0) {
+    status = mg_session_send_logon_message(session, auth_token);
   }
+  mg_map_destroy(auth_token);
+  mg_map_destroy(extra);
+
+  return status;
+}
 
+static int mg_bolt_read_init_response(mg_session *session) {
   MG_RETURN_IF_FAILED(mg_session_receive_message(session));
 
   mg_message *response;
   MG_RETURN_IF_FAILED(mg_session_read_bolt_message(session, &response));
 
+  int status;
   if (response->type == MG_MESSAGE_TYPE_SUCCESS) {
     status = 0;
   } else if (response->type == MG_MESSAGE_TYPE_FAILURE) {
@@ -448,63 +653,208 @@ static int mg_bolt_init(mg_session *session, const mg_session_params *params) {
   return status;
 }
 
-static int init_tcp_connection(const mg_session_params *params, int *sockfd,
-                               struct sockaddr *peer_addr,
-                               mg_session *session) {
-  struct addrinfo *addr_list = NULL;
-  struct addrinfo hints;
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_UNSPEC;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = IPPROTO_TCP;
-
-  char portstr[6];
-  sprintf(portstr, "%" PRIu16, params->port);
-  int getaddrinfo_status;
-  if (params->host) {
-    getaddrinfo_status = getaddrinfo(params->host, portstr, &hints, &addr_list);
-  } else if (params->address) {
-    hints.ai_flags = AI_NUMERICHOST;
-    getaddrinfo_status =
-        getaddrinfo(params->address, portstr, &hints, &addr_list);
+static int mg_bolt_init(mg_session *session, const mg_session_params *params) {
+  int logon = session->version == 5 && session->minor_version >= 1;
+  int status;
+  if (session->version == 1) {
+    status = mg_bolt_init_v1(session, params);
+  } else if (logon) {
+    status = mg_bolt_init_v5_1(session, params);
   } else {
-    abort();
+    status = mg_bolt_init_v4(session, params);
   }
-  if (getaddrinfo_status != 0) {
-#ifdef __EMSCRIPTEN__
-    mg_session_set_error(session, "getaddrinfo failed: %d", getaddrinfo_status);
-    // Not supported by emscripten:
-    // gai_strerror(getaddrinfo_status));
-#else
-    mg_session_set_error(session, "getaddrinfo failed: %s",
-                         gai_strerror(getaddrinfo_status));
-#endif
-    return MG_ERROR_NETWORK_FAILURE;
+  if (status != 0) {
+    return status;
   }
 
-  int tsockfd = MG_ERROR_SOCKET;
-  int status = MG_SUCCESS;
-  for (struct addrinfo *curr_addr = addr_list; curr_addr;
-       curr_addr = curr_addr->ai_next) {
-    tsockfd = mg_socket_create(curr_addr->ai_family, curr_addr->ai_socktype,
-                               curr_addr->ai_protocol);
+  MG_RETURN_IF_FAILED(mg_bolt_read_init_response(session));
+  if (logon) {
+    MG_RETURN_IF_FAILED(mg_bolt_read_init_response(session));
+  }
+  return 0;
+}
+
+#ifdef __EMSCRIPTEN__
+// Sockets are emulated with WebSockets, so the addresses are tried one by
+// one with a blocking connect.
+static int connect_to_any(const mg_resolved_address *addresses, int count,
+                          int timeout_ms, int *sockfd, int *index,
+                          mg_session *session) {
+  (void)timeout_ms;
+  int status = MG_ERROR_NETWORK_FAILURE;
+  for (int i = 0; i < count; ++i) {
+    int tsockfd = mg_socket_create(addresses[i].family, addresses[i].socktype,
+                                   addresses[i].protocol);
     status = mg_socket_create_handle_error(tsockfd, session);
     if (status != MG_SUCCESS) {
       continue;
     }
-    status =
-        mg_socket_connect(tsockfd, curr_addr->ai_addr, curr_addr->ai_addrlen);
+    status = mg_socket_connect(tsockfd,
+                               (const struct sockaddr *)&addresses[i].addr,
+                               addresses[i].addrlen);
     status = mg_socket_connect_handle_error(&tsockfd, status, session);
     if (status == MG_SUCCESS) {
-      memcpy(peer_addr, curr_addr->ai_addr, sizeof(struct sockaddr));
+      *sockfd = tsockfd;
+      *index = i;
+      return MG_SUCCESS;
+    }
+  }
+  return status;
+}
+#else
+// Connects to the first of the addresses that accepts the connection
+// (RFC 8305). Attempts start in order, the next one as soon as the previous
+// one fails or after MG_CONNECT_ATTEMPT_DELAY_MS, and then run in parallel,
+// so that an address which doesn't respond (e.g. IPv6 without a route)
+// delays the connection only by that much instead of a whole TCP timeout.
+static int connect_to_any(const mg_resolved_address *addresses, int count,
+                          int timeout_ms, int *sockfd, int *index,
+                          mg_session *session) {
+  struct pollfd fds[MG_RESOLVER_MAX_ADDRESSES];
+  int fd_index[MG_RESOLVER_MAX_ADDRESSES];
+  int pending = 0;
+  int next = 0;
+  int winner = MG_ERROR_SOCKET;
+  int status = MG_ERROR_NETWORK_FAILURE;
+  uint64_t now = mg_clock_ns();
+  uint64_t deadline = now + (uint64_t)timeout_ms * 1000000;
+  uint64_t next_attempt = now;
+
+  while (winner == MG_ERROR_SOCKET) {
+    now = mg_clock_ns();
+    if (timeout_ms > 0 && now >= deadline) {
+      mg_session_set_error(session,
+                           "couldn't connect to host: timed out after %d ms",
+                           timeout_ms);
+      status = MG_ERROR_NETWORK_FAILURE;
+      break;
+    }
+    if (next < count && now >= next_attempt) {
+      const mg_resolved_address *address = &addresses[next];
+      int tsockfd = mg_socket_create(address->family, address->socktype,
+                                     address->protocol);
+      status = mg_socket_create_handle_error(tsockfd, session);
+      if (status != MG_SUCCESS) {
+        ++next;
+        continue;
+      }
+      if (mg_socket_set_nonblocking(tsockfd, 1) != MG_SUCCESS) {
+        status = mg_socket_connect_handle_error(&tsockfd, MG_ERROR_SOCKET,
+                                                session);
+        ++next;
+        continue;
+      }
+      int connect_status = mg_socket_connect(
+          tsockfd, (const struct sockaddr *)&address->addr, address->addrlen);
+      if (connect_status == MG_SUCCESS) {
+        winner = tsockfd;
+        *index = next;
+        break;
+      }
+      if (!mg_socket_connect_in_progress()) {
+        status = mg_socket_connect_handle_error(&tsockfd, connect_status,
+                                                session);
+        ++next;
+        continue;
+      }
+      fds[pending].fd = tsockfd;
+      fds[pending].events = POLLOUT;
+      fds[pending].revents = 0;
+      fd_index[pending] = next;
+      ++pending;
+      ++next;
+      next_attempt = now + (uint64_t)MG_CONNECT_ATTEMPT_DELAY_MS * 1000000;
+    }
+    if (pending == 0) {
+      if (next < count) {
+        // All the attempts so far failed, start the next one right away.
+        next_attempt = now;
+        continue;
+      }
+      break;
+    }
+
+    uint64_t wake_up = timeout_ms > 0 ? deadline : UINT64_MAX;
+    if (next < count && next_attempt < wake_up) {
+      wake_up = next_attempt;
+    }
+    int wait_ms = -1;
+    if (wake_up != UINT64_MAX) {
+      wait_ms = wake_up > now ? (int)((wake_up - now + 999999) / 1000000) : 0;
+    }
+    int ready = mg_socket_poll(fds, (unsigned int)pending, wait_ms);
+    if (ready < 0) {
+      mg_session_set_error(session, "couldn't connect to host: %s",
+                           mg_socket_error());
+      status = MG_ERROR_NETWORK_FAILURE;
       break;
     }
+    for (int i = 0; i < pending && ready > 0;) {
+      if (fds[i].revents == 0) {
+        ++i;
+        continue;
+      }
+      --ready;
+      int tsockfd = fds[i].fd;
+      int connect_status = mg_socket_connect_result(tsockfd);
+      if (connect_status == MG_SUCCESS) {
+        winner = tsockfd;
+        *index = fd_index[i];
+        fds[i] = fds[--pending];
+        fd_index[i] = fd_index[pending];
+        break;
+      }
+      status =
+          mg_socket_connect_handle_error(&tsockfd, connect_status, session);
+      fds[i] = fds[--pending];
+      fd_index[i] = fd_index[pending];
+      next_attempt = now;
+    }
+  }
+
+  // Attempts still in progress lost the race.
+  for (int i = 0; i < pending; ++i) {
+    if (mg_socket_close(fds[i].fd) != 0) {
+      abort();
+    }
   }
-  freeaddrinfo(addr_list);
-  if (tsockfd == MG_ERROR_SOCKET) {
+  if (winner == MG_ERROR_SOCKET) {
     assert(status != MG_SUCCESS);
     return status;
   }
+  if (mg_socket_set_nonblocking(winner, 0) != MG_SUCCESS) {
+    return mg_socket_connect_handle_error(&winner, MG_ERROR_SOCKET, session);
+  }
+  *sockfd = winner;
+  return MG_SUCCESS;
+}
+#endif
+
+static int init_tcp_connection(const mg_session_params *params, int *sockfd,
+                               struct sockaddr_storage *peer_addr,
+                               mg_session *session) {
+  mg_resolved_address addresses[MG_RESOLVER_MAX_ADDRESSES];
+  int count;
+  if (params->host) {
+    count = mg_resolve(params->host, 0, params->port, params->dns_cache_ttl,
+                       addresses, session);
+  } else if (params->address) {
+    count = mg_resolve(params->address, 1, params->port, 0, addresses, session);
+  } else {
+    abort();
+  }
+  if (count < 0) {
+    return count;
+  }
+
+  int tsockfd = MG_ERROR_SOCKET;
+  int index = 0;
+  int status = connect_to_any(addresses, count, params->connect_timeout,
+                              &tsockfd, &index, session);
+  if (status != MG_SUCCESS) {
+    return status;
+  }
+  memcpy(peer_addr, &addresses[index].addr, sizeof(*peer_addr));
 
   int set_options_status = mg_socket_options(tsockfd, session);
   if (set_options_status != MG_SUCCESS) {
@@ -519,8 +869,10 @@ static int init_tcp_connection(const mg_session_params *params, int *sockfd,
 static int get_hostname_and_ip(const struct sockaddr *peer_addr, char *hostname,
                                char *ip, mg_session *session) {
   // Populate the ip.
+  socklen_t peer_addr_len;
   switch (peer_addr->sa_family) {
     case AF_INET:
+      peer_addr_len = sizeof(struct sockaddr_in);
       if (!inet_ntop(AF_INET, &((struct sockaddr_in *)peer_addr)->sin_addr, ip,
                      INET6_ADDRSTRLEN)) {
         mg_session_set_error(session, "failed to get server IP: %s",
@@ -529,6 +881,7 @@ static int get_hostname_and_ip(const struct sockaddr *peer_addr, char *hostname,
       }
       break;
     case AF_INET6:
+      peer_addr_len = sizeof(struct sockaddr_in6);
       if (!inet_ntop(AF_INET6, &((struct sockaddr_in6 *)peer_addr)->sin6_addr,
                      ip, INET6_ADDRSTRLEN)) {
         mg_session_set_error(session, "failed to get server IP: %s",
@@ -542,7 +895,7 @@ static int get_hostname_and_ip(const struct sockaddr *peer_addr, char *hostname,
   }
   // Populate the hostname.
   // Useful read https://stackoverflow.com/questions/12274028.
-  int nameinfo_status = getnameinfo(peer_addr, sizeof(struct sockaddr),
+  int nameinfo_status = getnameinfo(peer_addr, peer_addr_len,
                                     hostname, NI_MAXHOST, NULL, 0, 0);
   if (nameinfo_status != 0) {
     // ON_WINDOWS getnameinfo fails if peer_addr was constructed from
@@ -573,14 +926,39 @@ int mg_connect_ca(const mg_session_params *params, mg_session **session,
   if (status != 0) {
     goto cleanup;
   }
+  tsession->fetch_size = params->fetch_size;
+  tsession->collect_stats = params->collect_stats;
+  tsession->trace_callback = params->trace_callback;
+  tsession->trace_data = params->trace_data;
+  if (params->decoder_max_block_size) {
+    mg_linear_allocator_set_limits(
+        (mg_linear_allocator *)tsession->decoder_allocator,
+        params->decoder_max_block_size, params->decoder_spare_blocks);
+  }
+  tsession->max_message_size = params->max_message_size;
+  if (params->shrink_after) {
+    tsession->shrink_after = params->shrink_after;
+  }
 
-  struct sockaddr peer_addr;
+  struct sockaddr_storage peer_addr;
   status = init_tcp_connection(params, &sockfd, &peer_addr, tsession);
   if (status != 0) {
     goto cleanup;
   }
   switch (params->sslmode) {
     case MG_SSLMODE_DISABLE:
+      if (params->io_backend == MG_IO_BACKEND_IO_URING) {
+        status = mg_io_uring_transport_init(
+            sockfd, (mg_io_uring_transport **)&tsession->transport, allocator);
+        if (status == MG_ERROR_OOM) {
+          mg_session_set_error(tsession, "failed to initialize connection");
+          goto cleanup;
+        }
+        if (status == 0) {
+          break;
+        }
+        // io_uring isn't available, fall back to plain sockets.
+      }
       status = mg_raw_transport_init(
           sockfd, (mg_raw_transport **)&tsession->transport, allocator);
       if (status != 0) {
@@ -592,7 +970,7 @@ int mg_connect_ca(const mg_session_params *params, mg_session **session,
     case MG_SSLMODE_REQUIRE: {
       mg_secure_transport *ttransport;
       status = mg_secure_transport_init(sockfd, params->sslcert, params->sslkey,
-                                        &ttransport, allocator);
+                                        &ttransport, allocator, params->ktls);
       if (status != 0) {
         mg_session_set_error(tsession,
                              "failed to initialize secure connection");
@@ -602,7 +980,8 @@ int mg_connect_ca(const mg_session_params *params, mg_session **session,
       if (params->trust_callback) {
         char ip[INET6_ADDRSTRLEN];
         char hostname[NI_MAXHOST];
-        status = get_hostname_and_ip(&peer_addr, hostname, ip, tsession);
+        status = get_hostname_and_ip((struct sockaddr *)&peer_addr, hostname,
+                                     ip, tsession);
         if (status != 0) {
           goto cleanup;
         }
@@ -625,17 +1004,36 @@ int mg_connect_ca(const mg_session_params *params, mg_session **session,
   }
 
   // mg_transport object took ownership of the socket.
+  tsession->sockfd = sockfd;
   sockfd = -1;
+  MG_SESSION_TRACE(tsession, MG_TRACE_EVENT_CONNECT, 0);
   status = mg_bolt_handshake(tsession);
   if (status != 0) {
     goto cleanup;
   }
+  MG_SESSION_TRACE(tsession, MG_TRACE_EVENT_HANDSHAKE, 0);
   status = mg_bolt_init(tsession, params);
   if (status != 0) {
     goto cleanup;
   }
+  if (params->decode_threads > 0) {
+    status = mg_decode_pool_init(tsession, params->decode_threads,
+                                 &tsession->decode_pool);
+    if (status == MG_ERROR_OOM) {
+      mg_session_set_error(tsession, "failed to start decoding threads");
+      goto cleanup;
+    }
+    // Without threads, rows are decoded by the session itself.
+    status = 0;
+  }
 
   tsession->status = MG_SESSION_READY;
+  if (params->query_timeout > 0) {
+    status = mg_session_set_query_timeout(tsession, params->query_timeout);
+    if (status != 0) {
+      goto cleanup;
+    }
+  }
   *session = tsession;
   return 0;
 
@@ -649,7 +1047,9 @@ cleanup:
 }
 
 int mg_connect(const mg_session_params *params, mg_session **session) {
-  return mg_connect_ca(params, session, &mg_system_allocator);
+  // The session keeps the allocator of the thread making it, even when it is
+  // used by other threads.
+  return mg_connect_ca(params, session, mg_current_allocator());
 }
 
 int handle_failure(mg_session *session) {
@@ -660,29 +1060,78 @@ int handle_failure(mg_session *session) {
     return status;
   }
 
-  status = mg_session_receive_message(session);
-  if (status != 0) {
-    return status;
+  // Server ignores all requests sent after the failed one (e.g. pipelined
+  // PULL or queued queries) until it receives ACK_FAILURE or RESET.
+  session->pipeline_pending = 0;
+  session->trace_query_id = session->trace_queries_sent;
+  if (session->nonblocking) {
+    // Responses are skipped when they arrive, see `mg_session_receive_message`.
+    session->reset_pending = 1;
+    return 0;
   }
+  while (1) {
+    status = mg_session_receive_message(session);
+    if (status != 0) {
+      return status;
+    }
 
-  mg_message *response;
-  status = mg_session_read_bolt_message(session, &response);
-  if (status != 0) {
-    return status;
-  }
+    mg_message *response;
+    status = mg_session_read_bolt_message(session, &response);
+    if (status != 0) {
+      return status;
+    }
 
-  if (response->type != MG_MESSAGE_TYPE_SUCCESS) {
-    status = MG_ERROR_PROTOCOL_VIOLATION;
-    mg_session_set_error(session, "unexpected message type");
+    enum mg_message_type type = response->type;
+    mg_message_destroy_ca(response, session->decoder_allocator);
+    if (type == MG_MESSAGE_TYPE_IGNORED) {
+      continue;
+    }
+    if (type != MG_MESSAGE_TYPE_SUCCESS) {
+      mg_session_set_error(session, "unexpected message type");
+      return MG_ERROR_PROTOCOL_VIOLATION;
+    }
+    return 0;
   }
+}
 
-  mg_message_destroy_ca(response, session->decoder_allocator);
-  return status;
+// Sends PULL with the given extra information. If none is given, either all of
+// the records or a batch of `fetch_size` records is requested, and in the
+// latter case remaining batches are requested automatically while fetching.
+static int mg_session_send_default_pull(mg_session *session,
+                                        const mg_map *pull_information) {
+  session->pull_batched = 0;
+  if (session->version < 4 || pull_information) {
+    return mg_session_send_pull_message(session, pull_information);
+  }
+  if (session->fetch_size <= 0) {
+    return mg_session_send_pull_message(session, mg_default_pull_extra_map);
+  }
+
+  session->pull_batched = 1;
+  char n_key_data[] = "n";
+  mg_string n_key = {1, n_key_data};
+  mg_value n_value;
+  n_value.type = MG_VALUE_TYPE_INTEGER;
+  n_value.integer_v = session->fetch_size;
+  mg_string *keys[] = {&n_key};
+  mg_value *values[] = {&n_value};
+  mg_map batch_pull_information = {1, 1, keys, values, 0, NULL};
+  return mg_session_send_pull_message(session, &batch_pull_information);
 }
 
-int mg_session_run(mg_session *session, const char *query, const mg_map *params,
-                   const mg_map *extra_run_information, const mg_list **columns,
-                   int64_t *qid) {
+// Starts the time the server has to respond to a request in, and drops
+// cancellations made before it (see `mg_session_cancel`).
+static void mg_session_start_request(mg_session *session) {
+  session->deadline_ns =
+      session->query_timeout > 0
+          ? mg_clock_ns() + (uint64_t)session->query_timeout * 1000000
+          : 0;
+  session->cancels_handled = MG_ATOMIC_LOAD(&session->cancel_requests);
+  session->interrupted = 0;
+  session->discarding = 0;
+}
+
+static int mg_session_check_can_run(mg_session *session) {
   if (session->status == MG_SESSION_BAD) {
     mg_session_set_error(session, "bad session");
     return MG_ERROR_BAD_CALL;
@@ -696,40 +1145,112 @@ int mg_session_run(mg_session *session, const char *query, const mg_map *params,
     mg_session_set_error(session, "fetching results of a query");
     return MG_ERROR_BAD_CALL;
   }
+  if (session->pipeline_pending) {
+    mg_session_set_error(session, "pipelined queries are pending");
+    return MG_ERROR_BAD_CALL;
+  }
 
   assert(session->status == MG_SESSION_READY ||
-         (session->version == 4 && session->explicit_transaction &&
+         (session->version >= 4 && session->explicit_transaction &&
           session->status == MG_SESSION_EXECUTING));
+  return 0;
+}
 
-  mg_message_destroy_ca(session->result.message, session->decoder_allocator);
-  session->result.message = NULL;
-  mg_list_destroy_ca(session->result.columns, session->allocator);
-  session->result.columns = NULL;
-
-  if (!params) {
-    params = &mg_empty_map;
-  }
+// Statement and parameters of a RUN message. The statement is `prepared` if
+// it isn't NULL, and `query` otherwise. The parameters are written by
+// `write_params` if it isn't NULL, and taken from `params` otherwise.
+typedef struct mg_run_request {
+  const char *query;
+  const mg_prepared_query *prepared;
+  const mg_map *params;
+  mg_param_writer_callback write_params;
+  void *params_data;
+} mg_run_request;
+
+// Writes RUN and, if `pull` is set, PULL right after it. Messages are sent
+// right away unless `session->buffer_messages` is set.
+static int mg_session_write_run(mg_session *session, const mg_run_request *run,
+                                const mg_map *extra_run_information, int pull,
+                                const mg_map *pull_information) {
+  const mg_map *params = run->params ? run->params : &mg_empty_map;
+  mg_session_start_request(session);
 
   // extra field allowed only allowed for Auto-commit Transaction
   // TODO(aandelic): Check if sending extra run information while in Explicit
   // Transaction should result with an error
-  if (session->version == 4 &&
+  if (session->version >= 4 &&
       (!extra_run_information || session->explicit_transaction)) {
     extra_run_information = &mg_empty_map;
   }
 
-  int status = 0;
-  status = mg_session_send_run_message(session, query, params,
-                                       extra_run_information);
+  // If PULL follows, RUN is kept in the output buffer so that both messages
+  // are sent in a single write.
+  int buffer_messages = session->buffer_messages;
+  session->buffer_messages = buffer_messages || pull;
+  int status;
+  if (run->write_params) {
+    status = mg_session_send_streamed_run_message(
+        session, run->query, run->prepared, run->write_params,
+        run->params_data, extra_run_information);
+  } else if (run->prepared) {
+    status = mg_session_send_prepared_run_message(
+        session, run->prepared, params, extra_run_information);
+  } else {
+    status = mg_session_send_run_message(session, run->query, params,
+                                         extra_run_information);
+  }
+  session->buffer_messages = buffer_messages;
   if (status != 0) {
-    goto fatal_failure;
+    return status;
+  }
+  ++session->trace_queries_sent;
+  MG_SESSION_TRACE(session, MG_TRACE_EVENT_RUN_SENT,
+                   session->trace_queries_sent);
+
+  if (pull) {
+    return mg_session_send_default_pull(session, pull_information);
+  }
+  return 0;
+}
+
+// Returns the time in milliseconds reported by the server under `key` in the
+// response metadata, or -1 if it isn't there.
+static int64_t mg_server_time(const mg_map *metadata, const char *key) {
+  const mg_value *value = mg_map_at(metadata, key);
+  if (!value || mg_value_get_type(value) != MG_VALUE_TYPE_INTEGER) {
+    return -1;
   }
+  return mg_value_integer(value);
+}
+
+// Reads the server response to RUN. If `pull` is set, PULL was sent after
+// RUN and the session goes straight to fetching the results. If `try_receive`
+// is set and the session is non-blocking, MG_WANT_READ or MG_WANT_WRITE is
+// returned if the response hasn't arrived yet.
+static int mg_session_read_run_response(mg_session *session, int pull,
+                                        int try_receive,
+                                        const mg_list **columns,
+                                        int64_t *qid) {
+  mg_message_destroy_ca(session->result.message, session->decoder_allocator);
+  session->result.message = NULL;
+  session->result.arena_row = NULL;
+  mg_lazy_row_destroy_ca(session->result.lazy_row, session->decoder_allocator);
+  session->result.lazy_row = NULL;
+  mg_list_destroy_ca(session->result.columns, session->allocator);
+  session->result.columns = NULL;
+
+  int status = 0;
 
   mg_transport_suspend_until_ready_to_read(session->transport);
-  status = mg_session_receive_message(session);
+  status = try_receive ? mg_session_try_receive_message(session)
+                       : mg_session_receive_message(session);
+  if (status == MG_WANT_READ || status == MG_WANT_WRITE) {
+    return status;
+  }
   if (status != 0) {
     goto fatal_failure;
   }
+  ++session->trace_query_id;
 
   mg_message *response;
 
@@ -749,13 +1270,13 @@ int mg_session_run(mg_session *session, const char *query, const mg_map *params,
     }
     session->result.columns =
         mg_list_copy_ca(mg_value_list(columns_tmp), session->allocator);
-    mg_message_destroy_ca(response, session->decoder_allocator);
     if (!session->result.columns) {
+      mg_message_destroy_ca(response, session->decoder_allocator);
       mg_session_set_error(session, "out of memory");
       return MG_ERROR_OOM;
     }
 
-    if (session->version == 4 && session->explicit_transaction) {
+    if (session->version >= 4 && session->explicit_transaction) {
       if (qid) {
         const mg_value *qid_tmp =
             mg_map_at(response->success_v->metadata, "qid");
@@ -772,24 +1293,34 @@ int mg_session_run(mg_session *session, const char *query, const mg_map *params,
 
       ++session->query_number;
     }
+    if (session->collect_stats) {
+      session->stats.t_first =
+          mg_server_time(response->success_v->metadata, "t_first");
+      session->stats.t_last = -1;
+    }
+    mg_message_destroy_ca(response, session->decoder_allocator);
 
     if (columns) {
       *columns = session->result.columns;
     }
 
-    session->status = MG_SESSION_EXECUTING;
+    MG_SESSION_TRACE(session, MG_TRACE_EVENT_RUN_SUCCESS,
+                     session->trace_query_id);
+    session->trace_first_record = session->trace_callback != NULL;
+    session->status = pull ? MG_SESSION_FETCHING : MG_SESSION_EXECUTING;
     return 0;
   }
 
   if (response->type == MG_MESSAGE_TYPE_FAILURE) {
+    MG_SESSION_TRACE(session, MG_TRACE_EVENT_FAILURE, session->trace_query_id);
     int failure_status = handle_failure_message(session, response->failure_v);
+    mg_message_destroy_ca(response, session->decoder_allocator);
 
     status = handle_failure(session);
     if (status != 0) {
       goto fatal_failure;
     }
 
-    mg_message_destroy_ca(response, session->decoder_allocator);
     return failure_status;
   }
 
@@ -798,36 +1329,227 @@ int mg_session_run(mg_session *session, const char *query, const mg_map *params,
   mg_session_set_error(session, "unexpected message type");
 
 fatal_failure:
-  mg_session_invalidate(session);
+  mg_session_fail(session, status);
   assert(status != 0);
   return status;
 }
 
-int mg_session_pull(mg_session *session, const mg_map *pull_information) {
-  if (session->status == MG_SESSION_BAD) {
-    mg_session_set_error(session, "called pull while bad session");
-    return MG_ERROR_BAD_CALL;
-  }
-  if (session->status == MG_SESSION_READY) {
-    mg_session_set_error(session, "called pull while not executing a query");
-    return MG_ERROR_BAD_CALL;
-  }
-  if (session->status == MG_SESSION_FETCHING) {
-    mg_session_set_error(session, "called pull while still fetching data");
-    return MG_ERROR_BAD_CALL;
+static int mg_session_start_query(mg_session *session,
+                                  const mg_run_request *run,
+                                  const mg_map *extra_run_information, int pull,
+                                  const mg_map *pull_information,
+                                  const mg_list **columns, int64_t *qid) {
+  MG_RETURN_IF_FAILED(mg_session_check_can_run(session));
+
+  int status = mg_session_write_run(session, run, extra_run_information, pull,
+                                    pull_information);
+  if (status != 0) {
+    mg_session_invalidate(session);
+    return status;
   }
+  return mg_session_read_run_response(session, pull, 0, columns, qid);
+}
 
-  assert(session->status == MG_SESSION_EXECUTING);
+int mg_session_run(mg_session *session, const char *query, const mg_map *params,
+                   const mg_map *extra_run_information, const mg_list **columns,
+                   int64_t *qid) {
+  mg_run_request run = {query, NULL, params, NULL, NULL};
+  return mg_session_start_query(session, &run, extra_run_information, 0, NULL,
+                                columns, qid);
+}
 
-  mg_message_destroy_ca(session->result.message, session->decoder_allocator);
-  session->result.message = NULL;
+int mg_session_run_prepared(mg_session *session,
+                            const mg_prepared_query *prepared,
+                            const mg_map *params,
+                            const mg_map *extra_run_information,
+                            const mg_list **columns, int64_t *qid) {
+  mg_run_request run = {NULL, prepared, params, NULL, NULL};
+  return mg_session_start_query(session, &run, extra_run_information, 0, NULL,
+                                columns, qid);
+}
 
-  int status = 0;
-  if (session->version == 4 && !pull_information) {
-    pull_information = mg_default_pull_extra_map;
-  }
+int mg_session_run_and_pull(mg_session *session, const char *query,
+                            const mg_map *params,
+                            const mg_map *extra_run_information,
+                            const mg_map *pull_information,
+                            const mg_list **columns, int64_t *qid) {
+  mg_run_request run = {query, NULL, params, NULL, NULL};
+  return mg_session_start_query(session, &run, extra_run_information, 1,
+                                pull_information, columns, qid);
+}
 
-  status = mg_session_send_pull_message(session, pull_information);
+int mg_session_run_and_pull_prepared(mg_session *session,
+                                     const mg_prepared_query *prepared,
+                                     const mg_map *params,
+                                     const mg_map *extra_run_information,
+                                     const mg_map *pull_information,
+                                     const mg_list **columns, int64_t *qid) {
+  mg_run_request run = {NULL, prepared, params, NULL, NULL};
+  return mg_session_start_query(session, &run, extra_run_information, 1,
+                                pull_information, columns, qid);
+}
+
+int mg_session_run_and_pull_with_writer(
+    mg_session *session, const char *query,
+    mg_param_writer_callback write_params, void *params_data,
+    const mg_map *extra_run_information, const mg_map *pull_information,
+    const mg_list **columns, int64_t *qid) {
+  mg_run_request run = {query, NULL, NULL, write_params, params_data};
+  return mg_session_start_query(session, &run, extra_run_information, 1,
+                                pull_information, columns, qid);
+}
+
+int mg_session_run_and_pull_prepared_with_writer(
+    mg_session *session, const mg_prepared_query *prepared,
+    mg_param_writer_callback write_params, void *params_data,
+    const mg_map *extra_run_information, const mg_map *pull_information,
+    const mg_list **columns, int64_t *qid) {
+  mg_run_request run = {NULL, prepared, NULL, write_params, params_data};
+  return mg_session_start_query(session, &run, extra_run_information, 1,
+                                pull_information, columns, qid);
+}
+
+static int mg_session_queue_query(mg_session *session,
+                                  const mg_run_request *run,
+                                  const mg_map *extra_run_information) {
+  if (session->status == MG_SESSION_BAD) {
+    mg_session_set_error(session, "bad session");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (!session->explicit_transaction &&
+      session->status == MG_SESSION_EXECUTING) {
+    mg_session_set_error(session, "already executing a query");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (session->status == MG_SESSION_FETCHING && session->pull_batched) {
+    // Remaining batches would be requested after the queued queries.
+    mg_session_set_error(session, "fetching results of a query in batches");
+    return MG_ERROR_BAD_CALL;
+  }
+
+  // Results of pipelined queries are always pulled at once.
+  const mg_map *pull_information =
+      session->version >= 4 ? mg_default_pull_extra_map : NULL;
+  int buffer_messages = session->buffer_messages;
+  session->buffer_messages = 1;
+  int status = mg_session_write_run(session, run, extra_run_information, 1,
+                                    pull_information);
+  session->buffer_messages = buffer_messages;
+  if (status != 0) {
+    mg_session_invalidate(session);
+    return status;
+  }
+  ++session->pipeline_pending;
+  return 0;
+}
+
+int mg_session_pipeline_run(mg_session *session, const char *query,
+                            const mg_map *params,
+                            const mg_map *extra_run_information) {
+  mg_run_request run = {query, NULL, params, NULL, NULL};
+  return mg_session_queue_query(session, &run, extra_run_information);
+}
+
+int mg_session_pipeline_run_prepared(mg_session *session,
+                                     const mg_prepared_query *prepared,
+                                     const mg_map *params,
+                                     const mg_map *extra_run_information) {
+  mg_run_request run = {NULL, prepared, params, NULL, NULL};
+  return mg_session_queue_query(session, &run, extra_run_information);
+}
+
+int mg_session_pipeline_run_with_writer(mg_session *session, const char *query,
+                                        mg_param_writer_callback write_params,
+                                        void *params_data,
+                                        const mg_map *extra_run_information) {
+  mg_run_request run = {query, NULL, NULL, write_params, params_data};
+  return mg_session_queue_query(session, &run, extra_run_information);
+}
+
+int mg_session_pipeline_run_prepared_with_writer(
+    mg_session *session, const mg_prepared_query *prepared,
+    mg_param_writer_callback write_params, void *params_data,
+    const mg_map *extra_run_information) {
+  mg_run_request run = {NULL, prepared, NULL, write_params, params_data};
+  return mg_session_queue_query(session, &run, extra_run_information);
+}
+
+int mg_session_pipeline_next(mg_session *session, const mg_list **columns,
+                             int64_t *qid) {
+  if (session->status == MG_SESSION_BAD) {
+    mg_session_set_error(session, "bad session");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (session->status == MG_SESSION_FETCHING) {
+    mg_session_set_error(session, "fetching results of a query");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (!session->pipeline_pending) {
+    mg_session_set_error(session, "no pipelined queries are pending");
+    return MG_ERROR_BAD_CALL;
+  }
+
+  int status = mg_session_flush(session);
+  if (status != 0) {
+    mg_session_invalidate(session);
+    return status;
+  }
+  --session->pipeline_pending;
+  session->pull_batched = 0;
+  status = mg_session_read_run_response(session, 1, 1, columns, qid);
+  if (status == MG_WANT_READ || status == MG_WANT_WRITE) {
+    ++session->pipeline_pending;
+  }
+  return status;
+}
+
+int mg_session_pipeline_pending(const mg_session *session) {
+  return session->pipeline_pending;
+}
+
+int mg_session_pipeline_flush(mg_session *session) {
+  if (session->status == MG_SESSION_BAD) {
+    mg_session_set_error(session, "bad session");
+    return MG_ERROR_BAD_CALL;
+  }
+  int status = mg_session_flush(session);
+  if (status != 0) {
+    mg_session_invalidate(session);
+    return status;
+  }
+  // Non-blocking sessions keep whatever couldn't be sent right away.
+  if (session->out_begin > MG_BOLT_CHUNK_HEADER_SIZE) {
+    return MG_WANT_WRITE;
+  }
+  return 0;
+}
+
+int mg_session_pull(mg_session *session, const mg_map *pull_information) {
+  if (session->status == MG_SESSION_BAD) {
+    mg_session_set_error(session, "called pull while bad session");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (session->status == MG_SESSION_READY) {
+    mg_session_set_error(session, "called pull while not executing a query");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (session->status == MG_SESSION_FETCHING) {
+    mg_session_set_error(session, "called pull while still fetching data");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (session->pipeline_pending) {
+    mg_session_set_error(session, "pipelined queries are pending");
+    return MG_ERROR_BAD_CALL;
+  }
+
+  assert(session->status == MG_SESSION_EXECUTING);
+
+  mg_message_destroy_ca(session->result.message, session->decoder_allocator);
+  session->result.message = NULL;
+  session->result.arena_row = NULL;
+
+  int status = 0;
+  status = mg_session_send_default_pull(session, pull_information);
   if (status != 0) {
     goto fatal_failure;
   }
@@ -841,7 +1563,46 @@ fatal_failure:
   return status;
 }
 
-int mg_session_fetch(mg_session *session, mg_result **result) {
+// Accounts for a result row returned by `mg_session_fetch`.
+static void mg_session_count_row(mg_session *session) {
+  MG_SESSION_STATS_ADD(session, rows_fetched, 1);
+  if (session->trace_first_record) {
+    session->trace_first_record = 0;
+    mg_session_trace(session, MG_TRACE_EVENT_FIRST_RECORD,
+                     session->trace_query_id);
+  }
+}
+
+// Decodes the result row in the input buffer into the arena of the session.
+// Decoded strings point into the message they were decoded from, so the message
+// is copied into the arena first.
+static int mg_session_read_arena_row(mg_session *session, mg_list **row) {
+  char *data = mg_allocator_malloc(session->arena, session->in_end);
+  if (!data) {
+    mg_session_set_error(session, "out of memory");
+    return MG_ERROR_OOM;
+  }
+  memcpy(data, session->in_buffer, session->in_end);
+
+  char *in_buffer = session->in_buffer;
+  mg_allocator *decoder_allocator = session->decoder_allocator;
+  session->in_buffer = data;
+  session->decoder_allocator = session->arena;
+  mg_message *message;
+  int status = mg_session_read_bolt_message(session, &message);
+  session->in_buffer = in_buffer;
+  session->decoder_allocator = decoder_allocator;
+  if (status != 0) {
+    return status;
+  }
+  *row = message->record_v->fields;
+  return 0;
+}
+
+// Fetches the next message of the result stream. If `lazy` is set, fields of
+// a result row are decoded only when accessed through `mg_lazy_row_at`.
+static int mg_session_fetch_next(mg_session *session, mg_result **result,
+                                 int lazy) {
   if (session->status == MG_SESSION_BAD) {
     mg_session_set_error(session, "called fetch while bad session");
     return MG_ERROR_BAD_CALL;
@@ -858,15 +1619,87 @@ int mg_session_fetch(mg_session *session, mg_result **result) {
 
   mg_message_destroy_ca(session->result.message, session->decoder_allocator);
   session->result.message = NULL;
+  session->result.arena_row = NULL;
+  mg_lazy_row_destroy_ca(session->result.lazy_row, session->decoder_allocator);
+  session->result.lazy_row = NULL;
 
   int status = 0;
 
   mg_message *message = NULL;
-  status = mg_session_receive_message(session);
+next_batch:
+  // Queries pipelined while fetching are sent before blocking on the
+  // response, so that the server can start on them right away.
+  status = mg_session_flush(session);
+  if (status != 0) {
+    goto fatal_failure;
+  }
+  // Rows decoded into the arena aren't decoded by the pool.
+  if (mg_decode_pool_in_use(session, lazy || session->arena)) {
+    status = mg_decode_pool_receive(session, lazy || session->arena, &message);
+  } else {
+    status = mg_session_try_receive_message(session);
+  }
+  if (status == MG_WANT_READ || status == MG_WANT_WRITE) {
+    return status;
+  }
   if (status != 0) {
     goto fatal_failure;
   }
 
+  if ((session->discarding || session->dump_file) &&
+      (message || (session->in_end >= 2 && (uint8_t)session->in_buffer[1] ==
+                                               MG_SIGNATURE_MESSAGE_RECORD))) {
+    // Discarded rows are skipped without decoding them. One decoded by the
+    // pool is released on the next receive. Dumped rows are fetched lazily,
+    // so they are always in the input buffer, and their fields are written
+    // as they were received.
+    if (session->dump_file &&
+        mg_dump_write_row(session->dump_file, session->in_buffer + 2,
+                          session->in_end - 2) != 0) {
+      fclose(session->dump_file);
+      session->dump_file = NULL;
+      session->dump_failed = 1;
+      session->discarding = 1;
+    }
+    message = NULL;
+    goto next_batch;
+  }
+
+  if (message) {
+    // Decoded by the pool, and released by it on the next fetch.
+    session->result.message = message;
+    *result = &session->result;
+    mg_session_count_row(session);
+    return 1;
+  }
+
+  if (lazy) {
+    mg_lazy_row *row;
+    status = mg_session_read_lazy_row(session, &row);
+    if (status != 0) {
+      goto fatal_failure;
+    }
+    if (row) {
+      session->result.lazy_row = row;
+      *result = &session->result;
+      mg_session_count_row(session);
+      return 1;
+    }
+  }
+
+  if (session->arena && session->in_end >= 2 &&
+      (uint8_t)session->in_buffer[1] == MG_SIGNATURE_MESSAGE_RECORD) {
+    mg_list *row;
+    status = mg_session_read_arena_row(session, &row);
+    if (status != 0) {
+      goto fatal_failure;
+    }
+    session->result.arena_row = row;
+    *result = &session->result;
+    mg_session_count_row(session);
+    return 1;
+  }
+
   status = mg_session_read_bolt_message(session, &message);
   if (status != 0) {
     goto fatal_failure;
@@ -875,11 +1708,12 @@ int mg_session_fetch(mg_session *session, mg_result **result) {
   if (message->type == MG_MESSAGE_TYPE_RECORD) {
     session->result.message = message;
     *result = &session->result;
+    mg_session_count_row(session);
     return 1;
   }
 
   if (message->type == MG_MESSAGE_TYPE_SUCCESS) {
-    if (session->version == 4) {
+    if (session->version >= 4) {
       const mg_value *has_more =
           mg_map_at(message->success_v->metadata, "has_more");
 
@@ -891,22 +1725,49 @@ int mg_session_fetch(mg_session *session, mg_result **result) {
       }
 
       if (!has_more || !mg_value_bool(has_more)) {
+        MG_SESSION_TRACE(session, MG_TRACE_EVENT_SUCCESS,
+                         session->trace_query_id);
         session->query_number -= session->explicit_transaction;
         session->status = session->explicit_transaction && session->query_number
                               ? MG_SESSION_EXECUTING
                               : MG_SESSION_READY;
+        session->pull_batched = 0;
+      } else if (session->pull_batched) {
+        // Summary of a batch isn't interesting to the caller, just request the
+        // next one and carry on. When discarding, the server is asked to drop
+        // the rest of the result instead.
+        mg_message_destroy_ca(message, session->decoder_allocator);
+        message = NULL;
+        if (session->discarding) {
+          session->pull_batched = 0;
+          status = mg_session_send_discard_message(session,
+                                                   mg_default_pull_extra_map);
+        } else {
+          status = mg_session_send_default_pull(session, NULL);
+        }
+        if (status != 0) {
+          goto fatal_failure;
+        }
+        goto next_batch;
       } else {
         session->status = MG_SESSION_EXECUTING;
       }
     } else {
+      MG_SESSION_TRACE(session, MG_TRACE_EVENT_SUCCESS,
+                       session->trace_query_id);
       session->status = MG_SESSION_READY;
     }
+    if (session->collect_stats) {
+      session->stats.t_last =
+          mg_server_time(message->success_v->metadata, "t_last");
+    }
     session->result.message = message;
     *result = &session->result;
     return 0;
   }
 
   if (message->type == MG_MESSAGE_TYPE_FAILURE) {
+    MG_SESSION_TRACE(session, MG_TRACE_EVENT_FAILURE, session->trace_query_id);
     int failure_status = handle_failure_message(session, message->failure_v);
     mg_message_destroy_ca(message, session->decoder_allocator);
 
@@ -925,7 +1786,98 @@ int mg_session_fetch(mg_session *session, mg_result **result) {
   mg_message_destroy_ca(message, session->decoder_allocator);
 
 fatal_failure:
-  mg_session_invalidate(session);
+  mg_session_fail(session, status);
+  return status;
+}
+
+int mg_session_fetch(mg_session *session, mg_result **result) {
+  return mg_session_fetch_next(session, result, 0);
+}
+
+int mg_session_fetch_lazy(mg_session *session, mg_result **result) {
+  return mg_session_fetch_next(session, result, 1);
+}
+
+int mg_session_discard(mg_session *session, const mg_map *discard_information,
+                       mg_result **result) {
+  if (session->status == MG_SESSION_BAD) {
+    mg_session_set_error(session, "called discard while bad session");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (session->status == MG_SESSION_READY) {
+    mg_session_set_error(session,
+                         "called discard while not executing a query");
+    return MG_ERROR_BAD_CALL;
+  }
+
+  if (session->status == MG_SESSION_EXECUTING) {
+    if (session->pipeline_pending) {
+      mg_session_set_error(session, "pipelined queries are pending");
+      return MG_ERROR_BAD_CALL;
+    }
+    mg_message_destroy_ca(session->result.message, session->decoder_allocator);
+    session->result.message = NULL;
+    session->result.arena_row = NULL;
+    if (!discard_information && session->version >= 4) {
+      discard_information = mg_default_pull_extra_map;
+    }
+    int status = mg_session_send_discard_message(session, discard_information);
+    if (status != 0) {
+      mg_session_invalidate(session);
+      return status;
+    }
+    session->pull_batched = 0;
+    session->status = MG_SESSION_FETCHING;
+  }
+
+  // Lazy fetching keeps the decoding threads from decoding rows ahead.
+  session->discarding = 1;
+  int status = mg_session_fetch_next(session, result, 1);
+  if (status != MG_WANT_READ && status != MG_WANT_WRITE) {
+    session->discarding = 0;
+  }
+  return status;
+}
+
+int mg_session_dump(mg_session *session, const char *path,
+                    mg_result **result) {
+  // A dump interrupted by MG_WANT_READ or MG_WANT_WRITE is continued.
+  if (!session->dump_file) {
+    if (session->status != MG_SESSION_FETCHING) {
+      mg_session_set_error(session, "called dump without pulling results");
+      return MG_ERROR_BAD_CALL;
+    }
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+      mg_session_set_error(session, "failed to open %s", path);
+      return MG_ERROR_FILE_FAILURE;
+    }
+    int status =
+        mg_dump_write_header(file, session->version, session->result.columns);
+    if (status != 0) {
+      fclose(file);
+      mg_session_set_error(session, "failed to write result dump");
+      return status;
+    }
+    session->dump_file = file;
+    session->dump_failed = 0;
+  }
+
+  int status = mg_session_fetch_next(session, result, 1);
+  if (status == MG_WANT_READ || status == MG_WANT_WRITE) {
+    return status;
+  }
+  int failed = session->dump_failed;
+  if (session->dump_file) {
+    failed |= fclose(session->dump_file) != 0;
+    session->dump_file = NULL;
+  }
+  session->dump_failed = 0;
+  session->discarding = 0;
+  if (status == 0 && failed) {
+    mg_session_set_error(session, "failed to write result dump");
+    return MG_ERROR_FILE_FAILURE;
+  }
   return status;
 }
 
@@ -952,16 +1904,22 @@ int mg_session_begin_transaction(mg_session *session,
     mg_session_set_error(session, "Transaction already started");
     return MG_ERROR_BAD_CALL;
   }
+  if (session->pipeline_pending) {
+    mg_session_set_error(session, "pipelined queries are pending");
+    return MG_ERROR_BAD_CALL;
+  }
   assert(session->status == MG_SESSION_READY && !session->explicit_transaction);
 
   mg_message_destroy_ca(session->result.message, session->decoder_allocator);
   session->result.message = NULL;
+  session->result.arena_row = NULL;
   // TODO(aandelic): Check if the columns should be destroyed
 
   if (!extra_run_information) {
     extra_run_information = &mg_empty_map;
   }
 
+  mg_session_start_request(session);
   int status = 0;
   status = mg_session_send_begin_message(session, extra_run_information);
   if (status != 0) {
@@ -1003,7 +1961,7 @@ int mg_session_begin_transaction(mg_session *session,
   mg_session_set_error(session, "unexpected message type");
 
 fatal_failure:
-  mg_session_invalidate(session);
+  mg_session_fail(session, status);
   assert(status != 0);
   return status;
 }
@@ -1030,13 +1988,19 @@ int mg_session_end_transaction(mg_session *session, int commit_transaction,
                          "Cannot end a transaction while a query is executing");
     return MG_ERROR_BAD_CALL;
   }
+  if (session->pipeline_pending) {
+    mg_session_set_error(session, "pipelined queries are pending");
+    return MG_ERROR_BAD_CALL;
+  }
 
   assert(session->status == MG_SESSION_READY && session->explicit_transaction);
 
   mg_message_destroy_ca(session->result.message, session->decoder_allocator);
   session->result.message = NULL;
+  session->result.arena_row = NULL;
   // TODO(aandelic): Check if the columns should be destroyed
 
+  mg_session_start_request(session);
   int status = 0;
   status = commit_transaction ? mg_session_send_commit_messsage(session)
                               : mg_session_send_rollback_messsage(session);
@@ -1081,7 +2045,7 @@ int mg_session_end_transaction(mg_session *session, int commit_transaction,
   mg_session_set_error(session, "unexpected message type");
 
 fatal_failure:
-  mg_session_invalidate(session);
+  mg_session_fail(session, status);
   assert(status != 0);
   return status;
 }
@@ -1094,11 +2058,132 @@ int mg_session_rollback_transaction(mg_session *session, mg_result **result) {
   return mg_session_end_transaction(session, 0, result);
 }
 
+int mg_session_reset(mg_session *session) {
+  if (session->status == MG_SESSION_BAD) {
+    mg_session_set_error(session, "bad session");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (session->status == MG_SESSION_EXECUTING ||
+      session->status == MG_SESSION_FETCHING) {
+    mg_session_set_error(session,
+                         "Cannot reset the session while a query is executing");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (session->pipeline_pending) {
+    mg_session_set_error(session, "pipelined queries are pending");
+    return MG_ERROR_BAD_CALL;
+  }
+
+  mg_lazy_row_destroy_ca(session->result.lazy_row, session->decoder_allocator);
+  session->result.lazy_row = NULL;
+  mg_message_destroy_ca(session->result.message, session->decoder_allocator);
+  session->result.message = NULL;
+  session->result.arena_row = NULL;
+
+  mg_session_start_request(session);
+  int status = mg_session_send_reset_message(session);
+  if (status != 0) {
+    goto fatal_failure;
+  }
+
+  status = mg_session_receive_message(session);
+  if (status != 0) {
+    goto fatal_failure;
+  }
+
+  mg_message *response;
+  status = mg_session_read_bolt_message(session, &response);
+  if (status != 0) {
+    goto fatal_failure;
+  }
+
+  enum mg_message_type type = response->type;
+  mg_message_destroy_ca(response, session->decoder_allocator);
+  if (type != MG_MESSAGE_TYPE_SUCCESS) {
+    status = MG_ERROR_PROTOCOL_VIOLATION;
+    mg_session_set_error(session, "unexpected message type");
+    goto fatal_failure;
+  }
+
+  // RESET rolls back the open transaction, if any.
+  session->explicit_transaction = 0;
+  session->query_number = 0;
+  return 0;
+
+fatal_failure:
+  mg_session_fail(session, status);
+  assert(status != 0);
+  return status;
+}
+
+int mg_session_socket(const mg_session *session) { return session->sockfd; }
+
+int mg_session_set_nonblocking(mg_session *session, int nonblocking) {
+  if (session->status == MG_SESSION_BAD) {
+    mg_session_set_error(session, "bad session");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (session->sockfd < 0) {
+    mg_session_set_error(session, "session socket is unknown");
+    return MG_ERROR_BAD_CALL;
+  }
+  nonblocking = nonblocking != 0;
+  if (session->nonblocking == nonblocking) {
+    return 0;
+  }
+  // The socket stays non-blocking while there's a query timeout.
+  if (mg_socket_set_nonblocking(session->sockfd,
+                                nonblocking || session->query_timeout > 0) !=
+      0) {
+    mg_session_set_error(session, "couldn't change socket mode: %s",
+                         mg_socket_error());
+    return MG_ERROR_NETWORK_FAILURE;
+  }
+  // Output left in the buffer by non-blocking sends goes out with the next
+  // request, as blocking functions always send everything before waiting.
+  session->nonblocking = nonblocking;
+  return 0;
+}
+
+int mg_session_set_query_timeout(mg_session *session, int timeout_ms) {
+  if (session->status == MG_SESSION_BAD) {
+    mg_session_set_error(session, "bad session");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (timeout_ms < 0) {
+    mg_session_set_error(session, "query timeout can't be negative");
+    return MG_ERROR_BAD_PARAMETER;
+  }
+  if (session->sockfd < 0) {
+    mg_session_set_error(session, "session socket is unknown");
+    return MG_ERROR_BAD_CALL;
+  }
+  // Waits are interrupted by polling the socket, which has to be non-blocking
+  // for that (see `mg_session_read_raw`).
+  int socket_nonblocking = session->nonblocking || timeout_ms > 0;
+  if (socket_nonblocking !=
+          (session->nonblocking || session->query_timeout > 0) &&
+      mg_socket_set_nonblocking(session->sockfd, socket_nonblocking) != 0) {
+    mg_session_set_error(session, "couldn't change socket mode: %s",
+                         mg_socket_error());
+    return MG_ERROR_NETWORK_FAILURE;
+  }
+  session->query_timeout = timeout_ms;
+  return 0;
+}
+
+void mg_session_cancel(mg_session *session) {
+  MG_ATOMIC_INCREMENT(&session->cancel_requests);
+}
+
 const mg_list *mg_result_columns(const mg_result *result) {
   return result->columns;
 }
 
 const mg_list *mg_result_row(const mg_result *result) {
+  if (result->arena_row) {
+    return result->arena_row;
+  }
   if (!result->message) {
     return NULL;
   }
@@ -1108,6 +2193,178 @@ const mg_list *mg_result_row(const mg_result *result) {
   return result->message->record_v->fields;
 }
 
+typedef struct mg_row {
+  mg_linear_allocator *allocator;
+  mg_list *values;
+} mg_row;
+
+mg_row *mg_result_row_copy(const mg_result *result) {
+  const mg_list *fields = mg_result_row(result);
+  if (!fields) {
+    return NULL;
+  }
+  mg_session *session = result->session;
+
+  // A copy takes about as much memory as the decoded row, plus the string data
+  // that decoded values point to in the input buffer, so that's usually enough
+  // for it to fit in a single block.
+  size_t block_size = mg_linear_allocator_allocated(
+                          (mg_linear_allocator *)session->decoder_allocator) +
+                      session->in_end + sizeof(mg_row);
+  mg_linear_allocator *allocator =
+      mg_linear_allocator_init(session->allocator, block_size, block_size);
+  if (!allocator) {
+    return NULL;
+  }
+  mg_row *row = mg_allocator_malloc((mg_allocator *)allocator, sizeof(mg_row));
+  if (!row) {
+    mg_linear_allocator_destroy(allocator);
+    return NULL;
+  }
+  row->allocator = allocator;
+  row->values = mg_list_copy_ca(fields, (mg_allocator *)allocator);
+  if (!row->values) {
+    mg_linear_allocator_destroy(allocator);
+    return NULL;
+  }
+  return row;
+}
+
+const mg_list *mg_row_values(const mg_row *row) { return row->values; }
+
+void mg_row_destroy(mg_row *row) {
+  if (!row) {
+    return;
+  }
+  mg_linear_allocator_destroy(row->allocator);
+}
+
+typedef struct mg_arena {
+  mg_allocator *allocator;
+  mg_linear_allocator *memory;
+} mg_arena;
+
+mg_arena *mg_arena_make(size_t block_size) {
+  if (block_size == 0) {
+    block_size = MG_ARENA_BLOCK_SIZE;
+  }
+  mg_allocator *allocator = mg_current_allocator();
+  mg_arena *arena = mg_allocator_malloc(allocator, sizeof(mg_arena));
+  if (!arena) {
+    return NULL;
+  }
+  arena->allocator = allocator;
+  arena->memory = mg_linear_allocator_init(allocator, block_size,
+                                           MG_ARENA_SEP_ALLOC_THRESHOLD);
+  if (!arena->memory) {
+    mg_allocator_free(allocator, arena);
+    return NULL;
+  }
+  mg_linear_allocator_set_limits(arena->memory,
+                                 block_size > MG_ARENA_MAX_BLOCK_SIZE
+                                     ? block_size
+                                     : MG_ARENA_MAX_BLOCK_SIZE,
+                                 MG_ARENA_SPARE_BLOCKS);
+  return arena;
+}
+
+void mg_arena_reset(mg_arena *arena) {
+  mg_linear_allocator_reset(arena->memory);
+}
+
+void mg_arena_destroy(mg_arena *arena) {
+  if (!arena) {
+    return;
+  }
+  mg_linear_allocator_destroy(arena->memory);
+  mg_allocator_free(arena->allocator, arena);
+}
+
+int mg_session_set_arena(mg_session *session, mg_arena *arena) {
+  if (arena && session->status == MG_SESSION_BAD) {
+    mg_session_set_error(session, "called set_arena while bad session");
+    return MG_ERROR_BAD_CALL;
+  }
+  session->arena = arena ? (mg_allocator *)arena->memory : NULL;
+  return 0;
+}
+
+mg_lazy_row *mg_result_row_lazy(mg_result *result) {
+  return result->lazy_row;
+}
+
+uint32_t mg_lazy_row_size(const mg_lazy_row *row) { return row->size; }
+
+int mg_lazy_row_at(mg_lazy_row *row, uint32_t pos, const mg_value **value) {
+  if (pos >= row->size) {
+    mg_session_set_error(row->session, "field index out of range");
+    return MG_ERROR_BAD_CALL;
+  }
+  if (!row->values[pos]) {
+    int status = mg_session_read_lazy_row_value(row, pos);
+    if (status != 0) {
+      mg_session_invalidate(row->session);
+      return status;
+    }
+  }
+  *value = row->values[pos];
+  return 0;
+}
+
+enum mg_value_type mg_lazy_row_type_at(const mg_lazy_row *row,
+                                       uint32_t pos) {
+  if (pos >= row->size) {
+    return MG_VALUE_TYPE_UNKNOWN;
+  }
+  return mg_session_lazy_row_field_type(row, pos);
+}
+
+// Typed fields are read again from the input buffer even if they were already
+// decoded by `mg_lazy_row_at`, which is as cheap as looking at the value.
+static int mg_lazy_row_check_pos(mg_lazy_row *row, uint32_t pos) {
+  if (pos >= row->size) {
+    mg_session_set_error(row->session, "field index out of range");
+    return MG_ERROR_BAD_CALL;
+  }
+  return 0;
+}
+
+static int mg_lazy_row_check_read(mg_lazy_row *row, int status) {
+  if (status != 0 && status != MG_ERROR_TYPE_MISMATCH) {
+    mg_session_invalidate(row->session);
+  }
+  return status;
+}
+
+int mg_lazy_row_bool_at(mg_lazy_row *row, uint32_t pos, int *value) {
+  MG_RETURN_IF_FAILED(mg_lazy_row_check_pos(row, pos));
+  return mg_lazy_row_check_read(
+      row, mg_session_read_lazy_row_bool(row, pos, value));
+}
+
+int mg_lazy_row_integer_at(mg_lazy_row *row, uint32_t pos, int64_t *value) {
+  MG_RETURN_IF_FAILED(mg_lazy_row_check_pos(row, pos));
+  return mg_lazy_row_check_read(
+      row, mg_session_read_lazy_row_integer(row, pos, value));
+}
+
+int mg_lazy_row_float_at(mg_lazy_row *row, uint32_t pos, double *value) {
+  MG_RETURN_IF_FAILED(mg_lazy_row_check_pos(row, pos));
+  return mg_lazy_row_check_read(
+      row, mg_session_read_lazy_row_float(row, pos, value));
+}
+
+int mg_lazy_row_string_at(mg_lazy_row *row, uint32_t pos, const char **data,
+                          uint32_t *size) {
+  MG_RETURN_IF_FAILED(mg_lazy_row_check_pos(row, pos));
+  mg_string str;
+  MG_RETURN_IF_FAILED(mg_lazy_row_check_read(
+      row, mg_session_read_lazy_row_string(row, pos, &str)));
+  *data = str.data;
+  *size = str.size;
+  return 0;
+}
+
 const mg_map *mg_result_summary(const mg_result *result) {
   if (!result->message) {
     return NULL;
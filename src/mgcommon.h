@@ -55,6 +55,22 @@ extern "C" {
 #define MG_ATTRIBUTE_WEAK
 #endif
 
+#ifdef _MSC_VER
+#define MG_THREAD_LOCAL __declspec(thread)
+#else
+#define MG_THREAD_LOCAL _Thread_local
+#endif
+
+// Atomic operations on a `volatile long`, for counters shared between threads.
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MG_ATOMIC_INCREMENT(ptr) _InterlockedIncrement(ptr)
+#define MG_ATOMIC_LOAD(ptr) _InterlockedOr((ptr), 0)
+#else
+#define MG_ATOMIC_INCREMENT(ptr) __atomic_add_fetch((ptr), 1, __ATOMIC_SEQ_CST)
+#define MG_ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -97,11 +97,14 @@ static const uint8_t MG_MARKERS_MAP[] = {MG_MARKER_TINY_MAP, MG_MARKER_MAP_8,
 #define MG_SIGNATURE_POINT_2D 0x58
 #define MG_SIGNATURE_POINT_3D 0x59
 #define MG_SIGNATURE_MESSAGE_HELLO 0x01
+#define MG_SIGNATURE_MESSAGE_LOGON 0x6A
 #define MG_SIGNATURE_MESSAGE_RUN 0x10
 #define MG_SIGNATURE_MESSAGE_PULL 0x3F
+#define MG_SIGNATURE_MESSAGE_DISCARD 0x2F
 #define MG_SIGNATURE_MESSAGE_RECORD 0x71
 #define MG_SIGNATURE_MESSAGE_SUCCESS 0x70
 #define MG_SIGNATURE_MESSAGE_FAILURE 0x7F
+#define MG_SIGNATURE_MESSAGE_IGNORED 0x7E
 #define MG_SIGNATURE_MESSAGE_ACK_FAILURE 0x0E
 #define MG_SIGNATURE_MESSAGE_RESET 0x0F
 #define MG_SIGNATURE_MESSAGE_BEGIN 0x11
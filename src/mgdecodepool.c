@@ -0,0 +1,475 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mgdecodepool.h"
+
+#include <stdint.h>
+#include <string.h>
+#if defined(MGCLIENT_ON_WINDOWS)
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#endif
+
+#include "mgallocator.h"
+#include "mgclient.h"
+#include "mgconstants.h"
+#include "mgsocket.h"
+
+#ifdef __EMSCRIPTEN__
+
+// The browser main thread can't block waiting for workers, so rows are always
+// decoded by the session itself.
+
+int mg_decode_pool_init(mg_session *session, int threads,
+                        mg_decode_pool **pool) {
+  (void)session;
+  (void)threads;
+  (void)pool;
+  return MG_ERROR_UNIMPLEMENTED;
+}
+
+int mg_decode_pool_in_use(const mg_session *session, int lazy) {
+  (void)session;
+  (void)lazy;
+  return 0;
+}
+
+int mg_decode_pool_receive(mg_session *session, int lazy,
+                           mg_message **record) {
+  (void)session;
+  (void)lazy;
+  (void)record;
+  return MG_ERROR_UNIMPLEMENTED;
+}
+
+void mg_decode_pool_destroy(mg_decode_pool *pool) { (void)pool; }
+
+#else
+
+#ifdef MGCLIENT_ON_WINDOWS
+typedef SRWLOCK mg_mutex;
+typedef CONDITION_VARIABLE mg_condition;
+typedef HANDLE mg_thread;
+#else
+typedef pthread_mutex_t mg_mutex;
+typedef pthread_cond_t mg_condition;
+typedef pthread_t mg_thread;
+#endif
+
+// Each decoding thread gets this many slots, so that rows can be decoded
+// while the caller is busy with the previous ones.
+#define MG_DECODE_POOL_SLOTS_PER_THREAD 4
+
+// Slot allocators start small and grow up to the same limit as the session
+// decoder allocator when rows don't fit in a single block.
+#define MG_DECODE_POOL_BLOCK_SIZE 8192
+#define MG_DECODE_POOL_SEP_ALLOC_THRESHOLD 4096
+#define MG_DECODE_POOL_MAX_BLOCK_SIZE 4194304
+
+enum mg_decode_slot_state {
+  MG_DECODE_SLOT_FRAMED,
+  MG_DECODE_SLOT_DECODING,
+  MG_DECODE_SLOT_DONE
+};
+
+typedef struct mg_decode_slot {
+  enum mg_decode_slot_state state;
+  // Set if the message is a RECORD, other messages aren't decoded.
+  int record;
+
+  char *buffer;
+  size_t size;
+  size_t capacity;
+
+  mg_linear_allocator *decoder_allocator;
+  mg_message *message;
+  int status;
+  char error[MG_MAX_ERROR_SIZE];
+  // Time spent decoding the message, if the session collects statistics.
+  uint64_t decode_ns;
+} mg_decode_slot;
+
+struct mg_decode_pool {
+  // Allocator of the session, only used by the thread using the session. The
+  // decoding threads allocate through `mg_process_allocator`, since the
+  // allocator of the session might not be thread-safe (e.g. one set by
+  // `mg_set_thread_allocator`).
+  mg_allocator *allocator;
+  int version;
+  int collect_stats;
+
+  mg_mutex mutex;
+  // Signalled when a message is framed, or the pool is stopped.
+  mg_condition framed;
+  // Signalled when a slot is decoded.
+  mg_condition decoded;
+  int stop;
+
+  // `head`, `next` and `tail` count the slots used so far, the slot index is
+  // the count modulo `slot_count`. Slots in [head, tail) hold received
+  // messages, the ones in [next, tail) aren't taken for decoding yet. Only the
+  // session moves `head` and `tail`, and `next` is protected by the mutex.
+  mg_decode_slot *slots;
+  size_t slot_count;
+  size_t head;
+  size_t next;
+  size_t tail;
+  // Set while the record decoded in the head slot is the session result.
+  int holding;
+
+  mg_thread *threads;
+  int thread_count;
+};
+
+static void mg_decode_pool_lock(mg_decode_pool *pool) {
+#ifdef MGCLIENT_ON_WINDOWS
+  AcquireSRWLockExclusive(&pool->mutex);
+#else
+  pthread_mutex_lock(&pool->mutex);
+#endif
+}
+
+static void mg_decode_pool_unlock(mg_decode_pool *pool) {
+#ifdef MGCLIENT_ON_WINDOWS
+  ReleaseSRWLockExclusive(&pool->mutex);
+#else
+  pthread_mutex_unlock(&pool->mutex);
+#endif
+}
+
+static void mg_decode_pool_wait(mg_decode_pool *pool,
+                                mg_condition *condition) {
+#ifdef MGCLIENT_ON_WINDOWS
+  SleepConditionVariableSRW(condition, &pool->mutex, INFINITE, 0);
+#else
+  pthread_cond_wait(condition, &pool->mutex);
+#endif
+}
+
+static void mg_decode_pool_notify(mg_condition *condition, int all) {
+#ifdef MGCLIENT_ON_WINDOWS
+  if (all) {
+    WakeAllConditionVariable(condition);
+  } else {
+    WakeConditionVariable(condition);
+  }
+#else
+  if (all) {
+    pthread_cond_broadcast(condition);
+  } else {
+    pthread_cond_signal(condition);
+  }
+#endif
+}
+
+static void mg_decode_pool_decode(mg_decode_pool *pool, mg_decode_slot *slot) {
+  slot->message = NULL;
+  slot->status = 0;
+  if (!slot->record) {
+    return;
+  }
+  uint64_t start = pool->collect_stats ? mg_clock_ns() : 0;
+  mg_linear_allocator_reset(slot->decoder_allocator);
+  // The decoder only needs the input buffer and the allocator of a session,
+  // so each slot is decoded as a session of its own.
+  mg_session decoder;
+  memset(&decoder, 0, sizeof(decoder));
+  mg_session_set_version(&decoder, pool->version);
+  decoder.allocator = &mg_process_allocator;
+  decoder.decoder_allocator = (mg_allocator *)slot->decoder_allocator;
+  decoder.in_buffer = slot->buffer;
+  decoder.in_end = slot->size;
+  decoder.in_capacity = slot->capacity;
+  slot->status = mg_session_read_bolt_message(&decoder, &slot->message);
+  if (slot->status != 0) {
+    slot->message = NULL;
+    memcpy(slot->error, decoder.error_buffer, MG_MAX_ERROR_SIZE);
+  }
+  if (pool->collect_stats) {
+    slot->decode_ns = mg_clock_ns() - start;
+  }
+}
+
+static void mg_decode_pool_work(mg_decode_pool *pool) {
+  mg_decode_pool_lock(pool);
+  while (1) {
+    while (!pool->stop && pool->next == pool->tail) {
+      mg_decode_pool_wait(pool, &pool->framed);
+    }
+    if (pool->stop) {
+      break;
+    }
+    mg_decode_slot *slot = &pool->slots[pool->next++ % pool->slot_count];
+    slot->state = MG_DECODE_SLOT_DECODING;
+    mg_decode_pool_unlock(pool);
+    mg_decode_pool_decode(pool, slot);
+    mg_decode_pool_lock(pool);
+    slot->state = MG_DECODE_SLOT_DONE;
+    mg_decode_pool_notify(&pool->decoded, 0);
+  }
+  mg_decode_pool_unlock(pool);
+}
+
+#ifdef MGCLIENT_ON_WINDOWS
+static DWORD WINAPI mg_decode_pool_thread(LPVOID pool) {
+  mg_decode_pool_work(pool);
+  return 0;
+}
+#else
+static void *mg_decode_pool_thread(void *pool) {
+  mg_decode_pool_work(pool);
+  return NULL;
+}
+#endif
+
+static int mg_decode_pool_start_thread(mg_decode_pool *pool,
+                                       mg_thread *thread) {
+#ifdef MGCLIENT_ON_WINDOWS
+  *thread = CreateThread(NULL, 0, mg_decode_pool_thread, pool, 0, NULL);
+  return *thread ? 0 : -1;
+#else
+  return pthread_create(thread, NULL, mg_decode_pool_thread, pool);
+#endif
+}
+
+static void mg_decode_pool_join_thread(mg_thread thread) {
+#ifdef MGCLIENT_ON_WINDOWS
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+int mg_decode_pool_init(mg_session *session, int threads,
+                        mg_decode_pool **pool) {
+  mg_allocator *allocator = session->allocator;
+  mg_decode_pool *tpool = mg_allocator_malloc(allocator, sizeof(*tpool));
+  if (!tpool) {
+    return MG_ERROR_OOM;
+  }
+  memset(tpool, 0, sizeof(*tpool));
+  tpool->allocator = allocator;
+  tpool->version = session->version;
+  tpool->collect_stats = session->collect_stats;
+#ifdef MGCLIENT_ON_WINDOWS
+  InitializeSRWLock(&tpool->mutex);
+  InitializeConditionVariable(&tpool->framed);
+  InitializeConditionVariable(&tpool->decoded);
+#else
+  pthread_mutex_init(&tpool->mutex, NULL);
+  pthread_cond_init(&tpool->framed, NULL);
+  pthread_cond_init(&tpool->decoded, NULL);
+#endif
+
+  int status = MG_ERROR_OOM;
+  tpool->slot_count = (size_t)threads * MG_DECODE_POOL_SLOTS_PER_THREAD;
+  tpool->slots = mg_allocator_malloc(
+      allocator, tpool->slot_count * sizeof(mg_decode_slot));
+  if (!tpool->slots) {
+    tpool->slot_count = 0;
+    goto cleanup;
+  }
+  memset(tpool->slots, 0, tpool->slot_count * sizeof(mg_decode_slot));
+  for (size_t i = 0; i < tpool->slot_count; ++i) {
+    mg_decode_slot *slot = &tpool->slots[i];
+    slot->capacity = MG_BOLT_MAX_CHUNK_SIZE;
+    slot->buffer = mg_allocator_malloc(allocator, slot->capacity);
+    slot->decoder_allocator =
+        mg_linear_allocator_init(&mg_process_allocator,
+                                 MG_DECODE_POOL_BLOCK_SIZE,
+                                 MG_DECODE_POOL_SEP_ALLOC_THRESHOLD);
+    if (!slot->buffer || !slot->decoder_allocator) {
+      goto cleanup;
+    }
+    mg_linear_allocator_set_limits(slot->decoder_allocator,
+                                   MG_DECODE_POOL_MAX_BLOCK_SIZE, 0);
+  }
+
+  tpool->threads =
+      mg_allocator_malloc(allocator, (size_t)threads * sizeof(mg_thread));
+  if (!tpool->threads) {
+    goto cleanup;
+  }
+  while (tpool->thread_count < threads &&
+         mg_decode_pool_start_thread(
+             tpool, &tpool->threads[tpool->thread_count]) == 0) {
+    tpool->thread_count++;
+  }
+  if (tpool->thread_count == 0) {
+    status = MG_ERROR_CLIENT_ERROR;
+    goto cleanup;
+  }
+
+  *pool = tpool;
+  return 0;
+
+cleanup:
+  mg_decode_pool_destroy(tpool);
+  return status;
+}
+
+int mg_decode_pool_in_use(const mg_session *session, int lazy) {
+  const mg_decode_pool *pool = session->decode_pool;
+  if (!pool) {
+    return 0;
+  }
+  if (pool->tail - pool->head > (size_t)pool->holding) {
+    return 1;
+  }
+  return !lazy && !session->nonblocking && !session->reset_pending;
+}
+
+// Receives the next message into the tail slot.
+static int mg_decode_pool_frame(mg_session *session) {
+  mg_decode_pool *pool = session->decode_pool;
+  mg_decode_slot *slot = &pool->slots[pool->tail % pool->slot_count];
+
+  // The message is received straight into the slot buffer.
+  char *in_buffer = session->in_buffer;
+  size_t in_capacity = session->in_capacity;
+  session->in_buffer = slot->buffer;
+  session->in_capacity = slot->capacity;
+  int status = mg_session_read_message_chunks(session);
+  slot->buffer = session->in_buffer;
+  slot->capacity = session->in_capacity;
+  slot->size = session->in_end;
+  session->in_buffer = in_buffer;
+  session->in_capacity = in_capacity;
+  session->in_end = 0;
+  session->in_cursor = 0;
+  if (status != 0) {
+    return status;
+  }
+
+  slot->record = slot->size >= 2 && (uint8_t)slot->buffer[1] ==
+                                        MG_SIGNATURE_MESSAGE_RECORD;
+  slot->state = MG_DECODE_SLOT_FRAMED;
+  mg_decode_pool_lock(pool);
+  pool->tail++;
+  mg_decode_pool_notify(&pool->framed, 0);
+  mg_decode_pool_unlock(pool);
+  return 0;
+}
+
+int mg_decode_pool_receive(mg_session *session, int lazy,
+                           mg_message **record) {
+  mg_decode_pool *pool = session->decode_pool;
+  *record = NULL;
+  if (pool->holding) {
+    pool->head++;
+    pool->holding = 0;
+  }
+
+  int status;
+  if (pool->head == pool->tail) {
+    status = mg_decode_pool_frame(session);
+    if (status != 0) {
+      return status;
+    }
+  }
+  // Read ahead the rows the server has already sent, but nothing after the
+  // end of the result.
+  while (pool->tail - pool->head < pool->slot_count &&
+         pool->slots[(pool->tail - 1) % pool->slot_count].record) {
+    status = mg_session_message_available(session);
+    if (status < 0) {
+      return status;
+    }
+    if (status == 0) {
+      break;
+    }
+    status = mg_decode_pool_frame(session);
+    if (status != 0) {
+      return status;
+    }
+  }
+
+  mg_decode_slot *slot = &pool->slots[pool->head % pool->slot_count];
+  int decode_here = 0;
+  mg_decode_pool_lock(pool);
+  if (pool->next == pool->head) {
+    // No thread got to it yet.
+    pool->next++;
+    decode_here = 1;
+  } else {
+    while (slot->state != MG_DECODE_SLOT_DONE) {
+      mg_decode_pool_wait(pool, &pool->decoded);
+    }
+  }
+  mg_decode_pool_unlock(pool);
+
+  if (slot->record && !lazy) {
+    if (decode_here) {
+      mg_decode_pool_decode(pool, slot);
+    }
+    if (slot->status != 0) {
+      memcpy(session->error_buffer, slot->error, MG_MAX_ERROR_SIZE);
+      pool->head++;
+      return slot->status;
+    }
+    MG_SESSION_STATS_ADD(session, decode_ns, slot->decode_ns);
+    MG_SESSION_STATS_ADD(
+        session, decoder_bytes_allocated,
+        mg_linear_allocator_allocated(slot->decoder_allocator));
+    *record = slot->message;
+    pool->holding = 1;
+    return 0;
+  }
+
+  // Hand the message over to the session by swapping the buffers.
+  char *in_buffer = session->in_buffer;
+  size_t in_capacity = session->in_capacity;
+  session->in_buffer = slot->buffer;
+  session->in_capacity = slot->capacity;
+  session->in_end = slot->size;
+  session->in_cursor = 0;
+  slot->buffer = in_buffer;
+  slot->capacity = in_capacity;
+  pool->head++;
+  mg_session_reset_decoder_allocator(session);
+  return 0;
+}
+
+void mg_decode_pool_destroy(mg_decode_pool *pool) {
+  if (!pool) {
+    return;
+  }
+  mg_decode_pool_lock(pool);
+  pool->stop = 1;
+  mg_decode_pool_notify(&pool->framed, 1);
+  mg_decode_pool_unlock(pool);
+  for (int i = 0; i < pool->thread_count; ++i) {
+    mg_decode_pool_join_thread(pool->threads[i]);
+  }
+  mg_allocator_free(pool->allocator, pool->threads);
+
+  for (size_t i = 0; i < pool->slot_count; ++i) {
+    mg_allocator_free(pool->allocator, pool->slots[i].buffer);
+    if (pool->slots[i].decoder_allocator) {
+      mg_linear_allocator_destroy(pool->slots[i].decoder_allocator);
+    }
+  }
+  mg_allocator_free(pool->allocator, pool->slots);
+
+#ifndef MGCLIENT_ON_WINDOWS
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->framed);
+  pthread_cond_destroy(&pool->decoded);
+#endif
+  mg_allocator_free(pool->allocator, pool);
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MGCLIENT_MGDECODEPOOL_H
+#define MGCLIENT_MGDECODEPOOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mgmessage.h"
+#include "mgsession.h"
+
+/// Threads decoding the result rows of a session ahead of the caller.
+///
+/// The thread fetching the results only frames messages: it receives whole
+/// messages into the slots of a ring buffer, reading ahead as long as the
+/// server has already sent them. Worker threads decode RECORD messages from
+/// the slots in the order they were received, each slot into its own linear
+/// allocator, so a decoded row stays valid until the slot is reused. Rows are
+/// returned in the order they were received, and other messages (summaries
+/// and failures) are handed back to the session undecoded, to be handled as
+/// usual. Read-ahead stops at the first message that isn't a RECORD, so the
+/// pool never holds responses to later requests.
+///
+/// Worker threads allocate slot memory and decoded rows from the process
+/// allocator (see `mg_set_allocator`), which has to be thread-safe. Only the
+/// slot buffers, which the fetching thread swaps with the session input
+/// buffer, come from the session allocator.
+typedef struct mg_decode_pool mg_decode_pool;
+
+/// Starts `threads` decoding threads for `session`, which has to be connected
+/// already. Returns MG_ERROR_UNIMPLEMENTED where threads aren't available.
+int mg_decode_pool_init(mg_session *session, int threads,
+                        mg_decode_pool **pool);
+
+/// Returns whether the next message of the session should be received through
+/// the pool. Messages read ahead are always taken from the pool, otherwise
+/// only blocking fetches of decoded rows use it.
+int mg_decode_pool_in_use(const mg_session *session, int lazy);
+
+/// Receives the next message of `session`. If it's a RECORD and `lazy` isn't
+/// set, the decoded record is stored to `*record`, and stays valid until the
+/// next call. Otherwise `*record` is set to NULL and the message is placed
+/// into the session input buffer, as if it was received by
+/// `mg_session_receive_message`.
+int mg_decode_pool_receive(mg_session *session, int lazy,
+                           mg_message **record);
+
+void mg_decode_pool_destroy(mg_decode_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MGCLIENT_MGDECODEPOOL_H */
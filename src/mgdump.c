@@ -0,0 +1,329 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mgdump.h"
+
+#include <stdint.h>
+#include <string.h>
+#ifdef MGCLIENT_ON_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mgallocator.h"
+#include "mgclient.h"
+#include "mgcommon.h"
+#include "mgconstants.h"
+#include "mgsession.h"
+
+#define MG_DUMP_MAGIC "MGDUMP"
+#define MG_DUMP_MAGIC_SIZE 6
+#define MG_DUMP_FORMAT_VERSION 1
+#define MG_DUMP_HEADER_SIZE (MG_DUMP_MAGIC_SIZE + 2)
+
+// Rows are decoded into blocks of this size, see `mg_decode_pool`.
+#define MG_REPLAY_BLOCK_SIZE 8192
+#define MG_REPLAY_SEP_ALLOC_THRESHOLD 4096
+#define MG_REPLAY_MAX_BLOCK_SIZE 4194304
+
+// Writes the header of a PackStream container (or string) of `size` elements
+// (or bytes) to `out` and returns its length.
+static size_t mg_dump_put_container_size(char *out, const uint8_t *markers,
+                                         uint32_t size) {
+  if (size <= MG_TINY_SIZE_MAX) {
+    out[0] = (char)(markers[0] + size);
+    return 1;
+  }
+  if (size <= UINT8_MAX) {
+    out[0] = (char)markers[1];
+    out[1] = (char)size;
+    return 2;
+  }
+  if (size <= UINT16_MAX) {
+    uint16_t be_size = htobe16((uint16_t)size);
+    out[0] = (char)markers[2];
+    memcpy(out + 1, &be_size, sizeof(be_size));
+    return 3;
+  }
+  uint32_t be_size = htobe32(size);
+  out[0] = (char)markers[3];
+  memcpy(out + 1, &be_size, sizeof(be_size));
+  return 5;
+}
+
+static int mg_dump_write_entry(FILE *file, const char *data, size_t size) {
+  if (size > UINT32_MAX) {
+    return MG_ERROR_SIZE_EXCEEDED;
+  }
+  uint32_t be_size = htobe32((uint32_t)size);
+  if (fwrite(&be_size, sizeof(be_size), 1, file) != 1 ||
+      (size > 0 && fwrite(data, size, 1, file) != 1)) {
+    return MG_ERROR_FILE_FAILURE;
+  }
+  return 0;
+}
+
+int mg_dump_write_header(FILE *file, int version, const mg_list *columns) {
+  char header[MG_DUMP_HEADER_SIZE];
+  memcpy(header, MG_DUMP_MAGIC, MG_DUMP_MAGIC_SIZE);
+  header[MG_DUMP_MAGIC_SIZE] = MG_DUMP_FORMAT_VERSION;
+  header[MG_DUMP_MAGIC_SIZE + 1] = (char)version;
+  if (fwrite(header, sizeof(header), 1, file) != 1) {
+    return MG_ERROR_FILE_FAILURE;
+  }
+
+  // Column names are encoded the same way as the server encodes them.
+  uint32_t count = columns ? mg_list_size(columns) : 0;
+  size_t size = 5;
+  for (uint32_t i = 0; i < count; ++i) {
+    const mg_value *column = mg_list_at(columns, i);
+    if (mg_value_get_type(column) != MG_VALUE_TYPE_STRING) {
+      return MG_ERROR_INVALID_VALUE;
+    }
+    size += 5 + mg_string_size(mg_value_string(column));
+  }
+  char *data = mg_allocator_malloc(&mg_system_allocator, size);
+  if (!data) {
+    return MG_ERROR_OOM;
+  }
+  size_t end = mg_dump_put_container_size(data, MG_MARKERS_LIST, count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const mg_string *column = mg_value_string(mg_list_at(columns, i));
+    end += mg_dump_put_container_size(data + end, MG_MARKERS_STRING,
+                                      mg_string_size(column));
+    memcpy(data + end, mg_string_data(column), mg_string_size(column));
+    end += mg_string_size(column);
+  }
+  int status = mg_dump_write_entry(file, data, end);
+  mg_allocator_free(&mg_system_allocator, data);
+  return status;
+}
+
+int mg_dump_write_row(FILE *file, const char *data, size_t size) {
+  return mg_dump_write_entry(file, data, size);
+}
+
+struct mg_replay {
+  // The whole file, mapped into memory.
+  const char *data;
+  size_t size;
+  size_t offset;
+  // Offset of the first row, see `mg_replay_rewind`.
+  size_t rows_offset;
+
+  mg_list *columns;
+  mg_linear_allocator *decoder_allocator;
+  // The decoder only needs the input buffer and the allocator of a session,
+  // so each row is decoded as the input buffer of this one.
+  mg_session decoder;
+};
+
+#ifdef MGCLIENT_ON_WINDOWS
+static int mg_replay_map(const char *path, const char **data, size_t *size) {
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return MG_ERROR_FILE_FAILURE;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size) ||
+      (uint64_t)file_size.QuadPart > SIZE_MAX) {
+    CloseHandle(file);
+    return MG_ERROR_FILE_FAILURE;
+  }
+  *size = (size_t)file_size.QuadPart;
+  *data = NULL;
+  if (*size == 0) {
+    CloseHandle(file);
+    return 0;
+  }
+  // The view keeps the file mapped after the handles are closed.
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (!mapping) {
+    return MG_ERROR_FILE_FAILURE;
+  }
+  *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  return *data ? 0 : MG_ERROR_FILE_FAILURE;
+}
+
+static void mg_replay_unmap(const char *data, size_t size) {
+  (void)size;
+  if (data) {
+    UnmapViewOfFile(data);
+  }
+}
+#else
+static int mg_replay_map(const char *path, const char **data, size_t *size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return MG_ERROR_FILE_FAILURE;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || (uint64_t)file_stat.st_size > SIZE_MAX) {
+    close(fd);
+    return MG_ERROR_FILE_FAILURE;
+  }
+  *size = (size_t)file_stat.st_size;
+  *data = NULL;
+  if (*size == 0) {
+    close(fd);
+    return 0;
+  }
+  // The mapping stays valid after the file is closed.
+  void *mapped = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return MG_ERROR_FILE_FAILURE;
+  }
+  *data = mapped;
+  return 0;
+}
+
+static void mg_replay_unmap(const char *data, size_t size) {
+  if (data) {
+    munmap((void *)data, size);
+  }
+}
+#endif
+
+// Points the decoder to the next entry of the file and skips it.
+static int mg_replay_next_entry(mg_replay *replay) {
+  mg_session *decoder = &replay->decoder;
+  uint32_t be_size;
+  if (replay->size - replay->offset < sizeof(be_size)) {
+    mg_session_set_error(decoder, "unexpected end of dump");
+    return MG_ERROR_DECODING_FAILED;
+  }
+  memcpy(&be_size, replay->data + replay->offset, sizeof(be_size));
+  size_t size = be32toh(be_size);
+  replay->offset += sizeof(be_size);
+  if (replay->size - replay->offset < size) {
+    mg_session_set_error(decoder, "unexpected end of dump");
+    return MG_ERROR_DECODING_FAILED;
+  }
+  decoder->in_buffer = (char *)replay->data + replay->offset;
+  decoder->in_end = size;
+  decoder->in_capacity = size;
+  decoder->in_cursor = 0;
+  replay->offset += size;
+  return 0;
+}
+
+static int mg_replay_read_list(mg_replay *replay, mg_list **list) {
+  mg_linear_allocator_reset(replay->decoder_allocator);
+  mg_session *decoder = &replay->decoder;
+  MG_RETURN_IF_FAILED(mg_replay_next_entry(replay));
+  MG_RETURN_IF_FAILED(mg_session_read_list(decoder, list));
+  if (decoder->in_cursor != decoder->in_end) {
+    mg_session_set_error(decoder, "unexpected data after row");
+    return MG_ERROR_DECODING_FAILED;
+  }
+  return 0;
+}
+
+int mg_replay_open(const char *path, mg_replay **replay) {
+  mg_replay *treplay =
+      mg_allocator_malloc(&mg_system_allocator, sizeof(mg_replay));
+  if (!treplay) {
+    return MG_ERROR_OOM;
+  }
+  memset(treplay, 0, sizeof(mg_replay));
+  int status = mg_replay_map(path, &treplay->data, &treplay->size);
+  if (status != 0) {
+    mg_allocator_free(&mg_system_allocator, treplay);
+    return status;
+  }
+
+  treplay->decoder_allocator =
+      mg_linear_allocator_init(&mg_system_allocator, MG_REPLAY_BLOCK_SIZE,
+                               MG_REPLAY_SEP_ALLOC_THRESHOLD);
+  if (!treplay->decoder_allocator) {
+    status = MG_ERROR_OOM;
+    goto cleanup;
+  }
+  mg_linear_allocator_set_limits(treplay->decoder_allocator,
+                                 MG_REPLAY_MAX_BLOCK_SIZE, 0);
+
+  if (treplay->size < MG_DUMP_HEADER_SIZE ||
+      memcmp(treplay->data, MG_DUMP_MAGIC, MG_DUMP_MAGIC_SIZE) != 0 ||
+      treplay->data[MG_DUMP_MAGIC_SIZE] != MG_DUMP_FORMAT_VERSION) {
+    status = MG_ERROR_DECODING_FAILED;
+    goto cleanup;
+  }
+  mg_session *decoder = &treplay->decoder;
+  mg_session_set_version(decoder,
+                         (uint8_t)treplay->data[MG_DUMP_MAGIC_SIZE + 1]);
+  decoder->allocator = &mg_system_allocator;
+  decoder->decoder_allocator = (mg_allocator *)treplay->decoder_allocator;
+  treplay->offset = MG_DUMP_HEADER_SIZE;
+
+  mg_list *columns;
+  status = mg_replay_read_list(treplay, &columns);
+  if (status != 0) {
+    goto cleanup;
+  }
+  treplay->columns = mg_list_copy_ca(columns, &mg_system_allocator);
+  if (!treplay->columns) {
+    status = MG_ERROR_OOM;
+    goto cleanup;
+  }
+  treplay->rows_offset = treplay->offset;
+  *replay = treplay;
+  return 0;
+
+cleanup:
+  mg_replay_destroy(treplay);
+  return status;
+}
+
+const mg_list *mg_replay_columns(const mg_replay *replay) {
+  return replay->columns;
+}
+
+int mg_replay_fetch(mg_replay *replay, const mg_list **row) {
+  if (replay->offset == replay->size) {
+    mg_linear_allocator_reset(replay->decoder_allocator);
+    return 0;
+  }
+  mg_list *trow;
+  MG_RETURN_IF_FAILED(mg_replay_read_list(replay, &trow));
+  *row = trow;
+  return 1;
+}
+
+void mg_replay_rewind(mg_replay *replay) {
+  replay->offset = replay->rows_offset;
+}
+
+const char *mg_replay_error(const mg_replay *replay) {
+  return replay->decoder.error_buffer;
+}
+
+void mg_replay_destroy(mg_replay *replay) {
+  if (!replay) {
+    return;
+  }
+  mg_list_destroy_ca(replay->columns, &mg_system_allocator);
+  if (replay->decoder_allocator) {
+    mg_linear_allocator_destroy(replay->decoder_allocator);
+  }
+  mg_replay_unmap(replay->data, replay->size);
+  mg_allocator_free(&mg_system_allocator, replay);
+}
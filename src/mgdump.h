@@ -0,0 +1,51 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MGCLIENT_MGDUMP_H
+#define MGCLIENT_MGDUMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "mgvalue.h"
+
+/// Result dumps, written by `mg_session_dump` and read by `mg_replay`.
+///
+/// A dump starts with the magic "MGDUMP", followed by the format version and
+/// the Bolt version of the session, one byte each. After that come entries,
+/// each one a 32-bit big-endian size followed by that many bytes. The first
+/// entry is the list of column names and each of the others is the list of
+/// fields of a result row, all of them encoded as PackStream lists, exactly as
+/// they are received in the RECORD messages. Rows are thus written without
+/// decoding them, and decoded from the file in the same way as from the input
+/// buffer of a session.
+
+/// Writes the header of a dump, including the column names, which may be
+/// NULL if there are none. Returns 0 on success and MG_ERROR_FILE_FAILURE or
+/// MG_ERROR_OOM otherwise.
+int mg_dump_write_header(FILE *file, int version, const mg_list *columns);
+
+/// Writes the fields of a result row, already encoded as a PackStream list.
+/// Returns 0 on success and MG_ERROR_FILE_FAILURE otherwise.
+int mg_dump_write_row(FILE *file, const char *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MGCLIENT_MGDUMP_H */
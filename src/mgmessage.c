@@ -50,6 +50,13 @@ void mg_message_hello_destroy_ca(mg_message_hello *message,
   mg_allocator_free(allocator, message);
 }
 
+void mg_message_logon_destroy_ca(mg_message_logon *message,
+                                 mg_allocator *allocator) {
+  if (!message) return;
+  mg_map_destroy_ca(message->auth, allocator);
+  mg_allocator_free(allocator, message);
+}
+
 void mg_message_run_destroy_ca(mg_message_run *message,
                                mg_allocator *allocator) {
   if (!message) return;
@@ -77,6 +84,15 @@ void mg_message_pull_destroy_ca(mg_message_pull *message,
   mg_allocator_free(allocator, message);
 }
 
+void mg_message_discard_destroy_ca(mg_message_discard *message,
+                                   mg_allocator *allocator) {
+  if (!message) {
+    return;
+  }
+  mg_map_destroy_ca(message->extra, allocator);
+  mg_allocator_free(allocator, message);
+}
+
 void mg_message_destroy_ca(mg_message *message, mg_allocator *allocator) {
   if (!message) return;
   switch (message->type) {
@@ -95,6 +111,9 @@ void mg_message_destroy_ca(mg_message *message, mg_allocator *allocator) {
     case MG_MESSAGE_TYPE_HELLO:
       mg_message_hello_destroy_ca(message->hello_v, allocator);
       break;
+    case MG_MESSAGE_TYPE_LOGON:
+      mg_message_logon_destroy_ca(message->logon_v, allocator);
+      break;
     case MG_MESSAGE_TYPE_RUN:
       mg_message_run_destroy_ca(message->run_v, allocator);
       break;
@@ -104,10 +123,14 @@ void mg_message_destroy_ca(mg_message *message, mg_allocator *allocator) {
     case MG_MESSAGE_TYPE_PULL:
       mg_message_pull_destroy_ca(message->pull_v, allocator);
       break;
+    case MG_MESSAGE_TYPE_DISCARD:
+      mg_message_discard_destroy_ca(message->discard_v, allocator);
+      break;
     case MG_MESSAGE_TYPE_ACK_FAILURE:
     case MG_MESSAGE_TYPE_RESET:
     case MG_MESSAGE_TYPE_COMMIT:
     case MG_MESSAGE_TYPE_ROLLBACK:
+    case MG_MESSAGE_TYPE_IGNORED:
       break;
   }
   mg_allocator_free(allocator, message);
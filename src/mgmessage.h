@@ -29,13 +29,16 @@ enum mg_message_type {
   MG_MESSAGE_TYPE_FAILURE,
   MG_MESSAGE_TYPE_INIT,
   MG_MESSAGE_TYPE_HELLO,
+  MG_MESSAGE_TYPE_LOGON,
   MG_MESSAGE_TYPE_RUN,
   MG_MESSAGE_TYPE_ACK_FAILURE,
   MG_MESSAGE_TYPE_RESET,
   MG_MESSAGE_TYPE_PULL,
+  MG_MESSAGE_TYPE_DISCARD,
   MG_MESSAGE_TYPE_BEGIN,
   MG_MESSAGE_TYPE_COMMIT,
-  MG_MESSAGE_TYPE_ROLLBACK
+  MG_MESSAGE_TYPE_ROLLBACK,
+  MG_MESSAGE_TYPE_IGNORED
 };
 
 typedef struct mg_message_success {
@@ -59,6 +62,10 @@ typedef struct mg_message_hello {
   mg_map *extra;
 } mg_message_hello;
 
+typedef struct mg_message_logon {
+  mg_map *auth;
+} mg_message_logon;
+
 typedef struct mg_message_run {
   mg_string *statement;
   mg_map *parameters;
@@ -73,6 +80,10 @@ typedef struct mg_message_pull {
   mg_map *extra;
 } mg_message_pull;
 
+typedef struct mg_message_discard {
+  mg_map *extra;
+} mg_message_discard;
+
 typedef struct mg_message {
   enum mg_message_type type;
   union {
@@ -81,9 +92,11 @@ typedef struct mg_message {
     mg_message_record *record_v;
     mg_message_init *init_v;
     mg_message_hello *hello_v;
+    mg_message_logon *logon_v;
     mg_message_run *run_v;
     mg_message_begin *begin_v;
     mg_message_pull *pull_v;
+    mg_message_discard *discard_v;
   };
 } mg_message;
 
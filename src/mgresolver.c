@@ -0,0 +1,241 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mgresolver.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef MGCLIENT_ON_WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "mgallocator.h"
+#include "mgclient.h"
+
+// Resolved host names are cached until they expire, in a list ordered from
+// the most recently resolved one. The list is short, so it is searched
+// linearly. It lives until `mg_finalize`.
+
+#define MG_RESOLVER_MAX_CACHED_HOSTS 64
+
+typedef struct mg_resolver_entry {
+  char *host;
+  uint16_t port;
+  uint64_t expires_ns;
+  int count;
+  mg_resolved_address addresses[MG_RESOLVER_MAX_ADDRESSES];
+  struct mg_resolver_entry *next;
+} mg_resolver_entry;
+
+static mg_resolver_entry *mg_resolver_entries = NULL;
+
+#ifdef MGCLIENT_ON_WINDOWS
+static SRWLOCK mg_resolver_lock = SRWLOCK_INIT;
+
+static void mg_resolver_acquire(void) {
+  AcquireSRWLockExclusive(&mg_resolver_lock);
+}
+
+static void mg_resolver_release(void) {
+  ReleaseSRWLockExclusive(&mg_resolver_lock);
+}
+#else
+static pthread_mutex_t mg_resolver_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void mg_resolver_acquire(void) { pthread_mutex_lock(&mg_resolver_lock); }
+
+static void mg_resolver_release(void) {
+  pthread_mutex_unlock(&mg_resolver_lock);
+}
+#endif
+
+static void mg_resolver_entry_destroy(mg_resolver_entry *entry) {
+  mg_allocator_free(&mg_process_allocator, entry->host);
+  mg_allocator_free(&mg_process_allocator, entry);
+}
+
+// Has to be called with the lock held. Drops expired entries on the way.
+static int mg_resolver_lookup(const char *host, uint16_t port,
+                              mg_resolved_address *addresses) {
+  uint64_t now = mg_clock_ns();
+  mg_resolver_entry **it = &mg_resolver_entries;
+  while (*it) {
+    mg_resolver_entry *entry = *it;
+    if (entry->expires_ns <= now) {
+      *it = entry->next;
+      mg_resolver_entry_destroy(entry);
+      continue;
+    }
+    if (entry->port == port && strcmp(entry->host, host) == 0) {
+      memcpy(addresses, entry->addresses,
+             (size_t)entry->count * sizeof(mg_resolved_address));
+      return entry->count;
+    }
+    it = &entry->next;
+  }
+  return 0;
+}
+
+static void mg_resolver_store(const char *host, uint16_t port, int ttl_ms,
+                              const mg_resolved_address *addresses,
+                              int count) {
+  mg_resolver_entry *entry =
+      mg_allocator_malloc(&mg_process_allocator, sizeof(mg_resolver_entry));
+  if (!entry) {
+    return;
+  }
+  size_t host_len = strlen(host) + 1;
+  entry->host = mg_allocator_malloc(&mg_process_allocator, host_len);
+  if (!entry->host) {
+    mg_allocator_free(&mg_process_allocator, entry);
+    return;
+  }
+  memcpy(entry->host, host, host_len);
+  entry->port = port;
+  entry->expires_ns = mg_clock_ns() + (uint64_t)ttl_ms * 1000000;
+  entry->count = count;
+  memcpy(entry->addresses, addresses,
+         (size_t)count * sizeof(mg_resolved_address));
+
+  mg_resolver_acquire();
+  // Another connection might have resolved the same host in the meantime.
+  int cached = 0;
+  mg_resolver_entry **it = &mg_resolver_entries;
+  while (*it) {
+    mg_resolver_entry *curr = *it;
+    if (curr->port == port && strcmp(curr->host, host) == 0) {
+      *it = curr->next;
+      mg_resolver_entry_destroy(curr);
+      continue;
+    }
+    if (++cached == MG_RESOLVER_MAX_CACHED_HOSTS - 1) {
+      // Drop the least recently resolved hosts to make room.
+      while (curr->next) {
+        mg_resolver_entry *last = curr->next;
+        curr->next = last->next;
+        mg_resolver_entry_destroy(last);
+      }
+      break;
+    }
+    it = &curr->next;
+  }
+  entry->next = mg_resolver_entries;
+  mg_resolver_entries = entry;
+  mg_resolver_release();
+}
+
+static int mg_resolver_getaddrinfo(const char *host, int numeric,
+                                   uint16_t port,
+                                   mg_resolved_address *addresses,
+                                   mg_session *session) {
+  struct addrinfo *addr_list = NULL;
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  if (numeric) {
+    hints.ai_flags = AI_NUMERICHOST;
+  }
+
+  char portstr[6];
+  sprintf(portstr, "%" PRIu16, port);
+  int getaddrinfo_status = getaddrinfo(host, portstr, &hints, &addr_list);
+  if (getaddrinfo_status != 0) {
+#ifdef __EMSCRIPTEN__
+    mg_session_set_error(session, "getaddrinfo failed: %d", getaddrinfo_status);
+    // Not supported by emscripten:
+    // gai_strerror(getaddrinfo_status));
+#else
+    mg_session_set_error(session, "getaddrinfo failed: %s",
+                         gai_strerror(getaddrinfo_status));
+#endif
+    return MG_ERROR_NETWORK_FAILURE;
+  }
+
+  // Addresses of the first family go to the even positions and the others to
+  // the odd ones, as long as both are available.
+  const struct addrinfo *by_family[2][MG_RESOLVER_MAX_ADDRESSES];
+  int family_count[2] = {0, 0};
+  int first_family = addr_list ? addr_list->ai_family : AF_UNSPEC;
+  for (const struct addrinfo *curr_addr = addr_list; curr_addr;
+       curr_addr = curr_addr->ai_next) {
+    if (curr_addr->ai_addrlen > sizeof(struct sockaddr_storage)) {
+      continue;
+    }
+    int family = curr_addr->ai_family == first_family ? 0 : 1;
+    if (family_count[family] < MG_RESOLVER_MAX_ADDRESSES) {
+      by_family[family][family_count[family]++] = curr_addr;
+    }
+  }
+  int count = 0;
+  for (int i = 0; count < MG_RESOLVER_MAX_ADDRESSES &&
+                  (i < family_count[0] || i < family_count[1]);
+       ++i) {
+    for (int family = 0; family < 2; ++family) {
+      if (i >= family_count[family] || count == MG_RESOLVER_MAX_ADDRESSES) {
+        continue;
+      }
+      const struct addrinfo *curr_addr = by_family[family][i];
+      mg_resolved_address *address = &addresses[count++];
+      address->family = curr_addr->ai_family;
+      address->socktype = curr_addr->ai_socktype;
+      address->protocol = curr_addr->ai_protocol;
+      address->addrlen = (socklen_t)curr_addr->ai_addrlen;
+      memset(&address->addr, 0, sizeof(address->addr));
+      memcpy(&address->addr, curr_addr->ai_addr, curr_addr->ai_addrlen);
+    }
+  }
+  freeaddrinfo(addr_list);
+
+  if (count == 0) {
+    mg_session_set_error(session, "getaddrinfo returned no addresses");
+    return MG_ERROR_NETWORK_FAILURE;
+  }
+  return count;
+}
+
+int mg_resolve(const char *host, int numeric, uint16_t port, int ttl_ms,
+               mg_resolved_address *addresses, mg_session *session) {
+  // Numeric addresses are converted without any lookup, so there is nothing
+  // to save by caching them.
+  int cache = ttl_ms > 0 && !numeric;
+  if (cache) {
+    mg_resolver_acquire();
+    int count = mg_resolver_lookup(host, port, addresses);
+    mg_resolver_release();
+    if (count > 0) {
+      return count;
+    }
+  }
+  // The lock isn't held while resolving, which can take a while.
+  int count = mg_resolver_getaddrinfo(host, numeric, port, addresses, session);
+  if (count > 0 && cache) {
+    mg_resolver_store(host, port, ttl_ms, addresses, count);
+  }
+  return count;
+}
+
+void mg_resolver_finalize(void) {
+  mg_resolver_acquire();
+  while (mg_resolver_entries) {
+    mg_resolver_entry *entry = mg_resolver_entries;
+    mg_resolver_entries = entry->next;
+    mg_resolver_entry_destroy(entry);
+  }
+  mg_resolver_release();
+}
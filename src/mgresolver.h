@@ -0,0 +1,62 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MGCLIENT_MGRESOLVER_H
+#define MGCLIENT_MGRESOLVER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mgsession.h"
+#include "mgsocket.h"
+
+/// At most this many addresses of a host are tried when connecting to it.
+#define MG_RESOLVER_MAX_ADDRESSES 16
+
+typedef struct mg_resolved_address {
+  int family;
+  int socktype;
+  int protocol;
+  socklen_t addrlen;
+  struct sockaddr_storage addr;
+} mg_resolved_address;
+
+/// Resolves `host` and `port` to at most MG_RESOLVER_MAX_ADDRESSES addresses,
+/// stored to `addresses`, and returns their number. If `numeric` is set,
+/// `host` has to be a numeric address. Addresses are reordered so that IPv6
+/// and IPv4 ones alternate, starting with the family of the first address
+/// returned by the system (as recommended by RFC 8305), which lets a failing
+/// family be skipped quickly when they are tried in turn.
+///
+/// If `ttl_ms` is positive, the addresses of host names are kept in a cache
+/// shared by the whole process and returned from it for `ttl_ms`
+/// milliseconds. Failed resolutions aren't cached.
+///
+/// Returns a negative error code on failure, in which case the session error
+/// message is set.
+int mg_resolve(const char *host, int numeric, uint16_t port, int ttl_ms,
+               mg_resolved_address *addresses, mg_session *session);
+
+/// Drops all cached addresses. Called from `mg_finalize`.
+void mg_resolver_finalize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MGCLIENT_MGRESOLVER_H */
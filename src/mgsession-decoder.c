@@ -19,8 +19,21 @@
 #include "mgconstants.h"
 #include "mgmessage.h"
 #include "mgsession.h"
+#include "mgsocket.h"
 #include "mgvalue.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MG_SKIP_WITH_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define MG_SKIP_WITH_NEON
+#include <arm_neon.h>
+#endif
+
 int mg_session_read_uint8(mg_session *session, uint8_t *val) {
   if (session->in_cursor + 1 > session->in_end) {
     mg_session_set_error(session, "unexpected end of message");
@@ -177,7 +190,8 @@ int mg_session_read_container_size(mg_session *session, uint32_t *size,
   return 0;
 }
 
-int mg_session_read_string(mg_session *session, mg_string **str) {
+static int mg_session_read_string_inline(mg_session *session,
+                                         mg_string *str) {
   uint32_t size;
   MG_RETURN_IF_FAILED(
       mg_session_read_container_size(session, &size, MG_MARKERS_STRING));
@@ -187,25 +201,186 @@ int mg_session_read_string(mg_session *session, mg_string **str) {
     return MG_ERROR_DECODING_FAILED;
   }
 
-  mg_string *tstr = mg_string_alloc(size, session->decoder_allocator);
+  // Decoded objects live only until the next message is received, and so does
+  // the message in the input buffer. Therefore, string data doesn't have to be
+  // copied, it's enough to point into the input buffer.
+  str->size = size;
+  str->data = session->in_buffer + session->in_cursor;
+  session->in_cursor += size;
+  return 0;
+}
+
+int mg_session_read_string(mg_session *session, mg_string **str) {
+  mg_string *tstr =
+      mg_allocator_malloc(session->decoder_allocator, sizeof(mg_string));
   if (!tstr) {
     mg_session_set_error(session, "out of memory");
     return MG_ERROR_OOM;
   }
 
-  tstr->size = size;
-  memcpy(tstr->data, session->in_buffer + session->in_cursor, size);
-  session->in_cursor += size;
+  int status = mg_session_read_string_inline(session, tstr);
+  if (status != 0) {
+    mg_allocator_free(session->decoder_allocator, tstr);
+    return status;
+  }
   *str = tstr;
   return 0;
 }
 
+static int mg_session_read_value_inline(mg_session *session, mg_value *value);
+
+// Lists and maps are decoded in a flat layout: elements (and keys) are stored
+// inline, in the same block as the container, instead of being allocated one
+// by one. The element pointer arrays point into that block, so the containers
+// are still accessed through the regular API. This works only because the
+// decoder allocator ignores frees and releases everything at once when the
+// next message is received.
+//
+// Lists whose first element is an integer or a float get room for a packed
+// array of their elements, which is used if all of them turn out to be of the
+// same type.
+static mg_list *mg_session_alloc_list(mg_session *session, uint32_t size,
+                                      int packed) {
+  size_t elements_size = size * sizeof(mg_value *);
+  size_t storage_size = size * sizeof(mg_value);
+  char *block = mg_allocator_malloc(
+      session->decoder_allocator,
+      sizeof(mg_list) + elements_size + storage_size +
+          (packed ? size * sizeof(int64_t) : 0));
+  if (!block) {
+    return NULL;
+  }
+  mg_list *list = (mg_list *)block;
+  list->elements = (mg_value **)(block + sizeof(mg_list));
+  mg_value *storage = (mg_value *)(block + sizeof(mg_list) + elements_size);
+  for (uint32_t i = 0; i < size; ++i) {
+    list->elements[i] = &storage[i];
+  }
+  list->capacity = size;
+  list->integers = NULL;
+  list->floats = NULL;
+  return list;
+}
+
+static mg_map *mg_session_alloc_map(mg_session *session, uint32_t size) {
+  size_t keys_size = size * sizeof(mg_string *);
+  size_t values_size = size * sizeof(mg_value *);
+  size_t storage_size = size * (sizeof(mg_value) + sizeof(mg_string));
+  uint32_t index_capacity = mg_map_index_capacity(size);
+  size_t index_size = index_capacity * sizeof(uint32_t);
+  char *block = mg_allocator_malloc(
+      session->decoder_allocator,
+      sizeof(mg_map) + keys_size + values_size + storage_size + index_size);
+  if (!block) {
+    return NULL;
+  }
+  mg_map *map = (mg_map *)block;
+  map->keys = (mg_string **)(block + sizeof(mg_map));
+  map->values = (mg_value **)(block + sizeof(mg_map) + keys_size);
+  mg_value *value_storage =
+      (mg_value *)(block + sizeof(mg_map) + keys_size + values_size);
+  mg_string *key_storage = (mg_string *)(value_storage + size);
+  for (uint32_t i = 0; i < size; ++i) {
+    map->keys[i] = &key_storage[i];
+    map->values[i] = &value_storage[i];
+  }
+  map->capacity = size;
+  map->index_capacity = index_capacity;
+  map->index = index_capacity ? (uint32_t *)(key_storage + size) : NULL;
+  if (index_capacity) {
+    memset(map->index, 0, index_size);
+  }
+  return map;
+}
+
+// Decodes elements of `list` from the beginning while they're integers, into
+// both the element values and the `packed` array. Returns the number of
+// decoded elements, the rest is left to `mg_session_read_value_inline`.
+static uint32_t mg_session_read_integer_run(mg_session *session,
+                                            mg_list *list, int64_t *packed,
+                                            uint32_t size) {
+  const uint8_t *data = (const uint8_t *)session->in_buffer;
+  const size_t end = session->in_end;
+  size_t cursor = session->in_cursor;
+  uint32_t i = 0;
+  for (; i < size && cursor < end; ++i) {
+    uint8_t marker = data[cursor];
+    int64_t value;
+    if ((int8_t)marker >= -16) {
+      // Tiny integer, from -16 to 127.
+      value = (int8_t)marker;
+      cursor += 1;
+    } else if (marker == MG_MARKER_INT_8 && end - cursor >= 2) {
+      value = (int8_t)data[cursor + 1];
+      cursor += 2;
+    } else if (marker == MG_MARKER_INT_16 && end - cursor >= 3) {
+      uint16_t tmp;
+      memcpy(&tmp, data + cursor + 1, sizeof(tmp));
+      value = (int16_t)be16toh(tmp);
+      cursor += 3;
+    } else if (marker == MG_MARKER_INT_32 && end - cursor >= 5) {
+      uint32_t tmp;
+      memcpy(&tmp, data + cursor + 1, sizeof(tmp));
+      value = (int32_t)be32toh(tmp);
+      cursor += 5;
+    } else if (marker == MG_MARKER_INT_64 && end - cursor >= 9) {
+      uint64_t tmp;
+      memcpy(&tmp, data + cursor + 1, sizeof(tmp));
+      value = (int64_t)be64toh(tmp);
+      cursor += 9;
+    } else {
+      break;
+    }
+    packed[i] = value;
+    list->elements[i]->type = MG_VALUE_TYPE_INTEGER;
+    list->elements[i]->integer_v = value;
+  }
+  session->in_cursor = cursor;
+  return i;
+}
+
+// Same as `mg_session_read_integer_run`, for floats.
+static uint32_t mg_session_read_float_run(mg_session *session, mg_list *list,
+                                          double *packed, uint32_t size) {
+  const uint8_t *data = (const uint8_t *)session->in_buffer;
+  size_t cursor = session->in_cursor;
+  // Floats are all of the same size, so a single bounds check covers them.
+  size_t available = (session->in_end - cursor) / 9;
+  uint32_t count = size < available ? size : (uint32_t)available;
+  uint32_t i = 0;
+  for (; i < count && data[cursor] == MG_MARKER_FLOAT; ++i) {
+    uint64_t tmp;
+    memcpy(&tmp, data + cursor + 1, sizeof(tmp));
+    tmp = be64toh(tmp);
+    double value;
+    memcpy(&value, &tmp, sizeof(value));
+    packed[i] = value;
+    list->elements[i]->type = MG_VALUE_TYPE_FLOAT;
+    list->elements[i]->float_v = value;
+    cursor += 9;
+  }
+  session->in_cursor = cursor;
+  return i;
+}
+
 int mg_session_read_list(mg_session *session, mg_list **list) {
   uint32_t size;
   MG_RETURN_IF_FAILED(
       mg_session_read_container_size(session, &size, MG_MARKERS_LIST));
 
-  mg_list *tlist = mg_list_alloc(size, session->decoder_allocator);
+  // Each element is at least one byte long, so a container can't have more
+  // elements than there are bytes left in the message.
+  if (size > session->in_end - session->in_cursor) {
+    mg_session_set_error(session, "unexpected end of message");
+    return MG_ERROR_DECODING_FAILED;
+  }
+
+  uint8_t first = size > 0 ? (uint8_t)session->in_buffer[session->in_cursor]
+                           : MG_MARKER_NULL;
+  int integers = (int8_t)first >= -16 ||
+                 (first >= MG_MARKER_INT_8 && first <= MG_MARKER_INT_64);
+  int floats = first == MG_MARKER_FLOAT;
+  mg_list *tlist = mg_session_alloc_list(session, size, integers || floats);
   if (!tlist) {
     mg_session_set_error(session, "out of memory");
     return MG_ERROR_OOM;
@@ -213,9 +388,23 @@ int mg_session_read_list(mg_session *session, mg_list **list) {
 
   int status = 0;
 
+  // The packed array follows the element values.
+  void *packed = (char *)tlist->elements +
+                 size * (sizeof(mg_value *) + sizeof(mg_value));
   tlist->size = 0;
-  for (uint32_t i = 0; i < size; ++i) {
-    status = mg_session_read_value(session, &tlist->elements[i]);
+  if (integers) {
+    tlist->size = mg_session_read_integer_run(session, tlist, packed, size);
+    if (tlist->size == size) {
+      tlist->integers = packed;
+    }
+  } else if (floats) {
+    tlist->size = mg_session_read_float_run(session, tlist, packed, size);
+    if (tlist->size == size) {
+      tlist->floats = packed;
+    }
+  }
+  for (uint32_t i = tlist->size; i < size; ++i) {
+    status = mg_session_read_value_inline(session, tlist->elements[i]);
     if (status != 0) {
       goto cleanup;
     }
@@ -238,7 +427,14 @@ int mg_session_read_map(mg_session *session, mg_map **map) {
   MG_RETURN_IF_FAILED(
       mg_session_read_container_size(session, &size, MG_MARKERS_MAP));
 
-  mg_map *tmap = mg_map_alloc(size, session->decoder_allocator);
+  // Each element is at least one byte long, so a container can't have more
+  // elements than there are bytes left in the message.
+  if (size > session->in_end - session->in_cursor) {
+    mg_session_set_error(session, "unexpected end of message");
+    return MG_ERROR_DECODING_FAILED;
+  }
+
+  mg_map *tmap = mg_session_alloc_map(session, size);
   if (!tmap) {
     mg_session_set_error(session, "out of memory");
     return MG_ERROR_OOM;
@@ -251,12 +447,13 @@ int mg_session_read_map(mg_session *session, mg_map **map) {
   uint32_t keys_read = 0;
   uint32_t values_read = 0;
   for (uint32_t i = 0; i < size; ++i) {
-    status = mg_session_read_string(session, &tmap->keys[i]);
+    status = mg_session_read_string_inline(session, tmap->keys[i]);
     if (status != 0) {
       goto cleanup;
     }
+    mg_map_index_insert(tmap, i);
     keys_read++;
-    status = mg_session_read_value(session, &tmap->values[i]);
+    status = mg_session_read_value_inline(session, tmap->values[i]);
     if (status != 0) {
       goto cleanup;
     }
@@ -296,9 +493,15 @@ int mg_session_check_struct_header(mg_session *session, uint8_t marker,
   return 0;
 }
 
-int mg_session_read_node(mg_session *session, mg_node **node) {
+// Graph structures of Bolt 5 also have element IDs, following the other
+// fields. Each of the decoders below is specialized for either layout, and
+// the ones for the version of the session are picked by
+// `mg_session_set_version`, so that they don't check it for every structure.
+static inline int mg_session_decode_node(mg_session *session, mg_node **node,
+                                         int element_ids) {
   MG_RETURN_IF_FAILED(mg_session_check_struct_header(
-      session, (uint8_t)(MG_MARKER_TINY_STRUCT + 3), MG_SIGNATURE_NODE));
+      session, (uint8_t)(MG_MARKER_TINY_STRUCT + 3 + element_ids),
+      MG_SIGNATURE_NODE));
 
   int64_t id;
   MG_RETURN_IF_FAILED(mg_session_read_integer(session, &id));
@@ -330,10 +533,20 @@ int mg_session_read_node(mg_session *session, mg_node **node) {
     goto cleanup;
   }
 
+  if (element_ids) {
+    status = mg_session_read_string(session, &tnode->element_id);
+    if (status != 0) {
+      goto cleanup_properties;
+    }
+  }
+
   *node = tnode;
 
   return 0;
 
+cleanup_properties:
+  mg_map_destroy_ca(tnode->properties, session->decoder_allocator);
+
 cleanup:
   for (uint32_t i = 0; i < tnode->label_count; ++i) {
     mg_string_destroy_ca(tnode->labels[i], session->decoder_allocator);
@@ -342,9 +555,11 @@ cleanup:
   return status;
 }
 
-int mg_session_read_relationship(mg_session *session, mg_relationship **rel) {
+static inline int mg_session_decode_relationship(mg_session *session,
+                                                 mg_relationship **rel,
+                                                 int element_ids) {
   MG_RETURN_IF_FAILED(mg_session_check_struct_header(
-      session, (uint8_t)(MG_MARKER_TINY_STRUCT + 5),
+      session, (uint8_t)(MG_MARKER_TINY_STRUCT + (element_ids ? 8 : 5)),
       MG_SIGNATURE_RELATIONSHIP));
 
   mg_relationship *trel =
@@ -356,6 +571,10 @@ int mg_session_read_relationship(mg_session *session, mg_relationship **rel) {
 
   int status = 0;
 
+  trel->element_id = NULL;
+  trel->start_element_id = NULL;
+  trel->end_element_id = NULL;
+
   status = mg_session_read_integer(session, &trel->id);
   if (status != 0) {
     goto cleanup;
@@ -381,9 +600,27 @@ int mg_session_read_relationship(mg_session *session, mg_relationship **rel) {
     goto cleanup_type;
   }
 
+  if (element_ids) {
+    status = mg_session_read_string(session, &trel->element_id);
+    if (status == 0) {
+      status = mg_session_read_string(session, &trel->start_element_id);
+    }
+    if (status == 0) {
+      status = mg_session_read_string(session, &trel->end_element_id);
+    }
+    if (status != 0) {
+      goto cleanup_element_ids;
+    }
+  }
+
   *rel = trel;
   return 0;
 
+cleanup_element_ids:
+  mg_string_destroy_ca(trel->element_id, session->decoder_allocator);
+  mg_string_destroy_ca(trel->start_element_id, session->decoder_allocator);
+  mg_map_destroy_ca(trel->properties, session->decoder_allocator);
+
 cleanup_type:
   mg_string_destroy_ca(trel->type, session->decoder_allocator);
 
@@ -392,10 +629,10 @@ cleanup:
   return status;
 }
 
-int mg_session_read_unbound_relationship(mg_session *session,
-                                         mg_unbound_relationship **rel) {
+static inline int mg_session_decode_unbound_relationship(
+    mg_session *session, mg_unbound_relationship **rel, int element_ids) {
   MG_RETURN_IF_FAILED(mg_session_check_struct_header(
-      session, (uint8_t)(MG_MARKER_TINY_STRUCT + 3),
+      session, (uint8_t)(MG_MARKER_TINY_STRUCT + 3 + element_ids),
       MG_SIGNATURE_UNBOUND_RELATIONSHIP));
 
   mg_unbound_relationship *trel = mg_allocator_malloc(
@@ -407,6 +644,8 @@ int mg_session_read_unbound_relationship(mg_session *session,
 
   int status = 0;
 
+  trel->element_id = NULL;
+
   status = mg_session_read_integer(session, &trel->id);
   if (status != 0) {
     goto cleanup;
@@ -422,9 +661,19 @@ int mg_session_read_unbound_relationship(mg_session *session,
     goto cleanup_type;
   }
 
+  if (element_ids) {
+    status = mg_session_read_string(session, &trel->element_id);
+    if (status != 0) {
+      goto cleanup_properties;
+    }
+  }
+
   *rel = trel;
   return 0;
 
+cleanup_properties:
+  mg_map_destroy_ca(trel->properties, session->decoder_allocator);
+
 cleanup_type:
   mg_string_destroy_ca(trel->type, session->decoder_allocator);
 
@@ -433,6 +682,62 @@ cleanup:
   return status;
 }
 
+static int mg_session_read_node_v1(mg_session *session, mg_node **node) {
+  return mg_session_decode_node(session, node, 0);
+}
+
+static int mg_session_read_node_v5(mg_session *session, mg_node **node) {
+  return mg_session_decode_node(session, node, 1);
+}
+
+static int mg_session_read_relationship_v1(mg_session *session,
+                                           mg_relationship **rel) {
+  return mg_session_decode_relationship(session, rel, 0);
+}
+
+static int mg_session_read_relationship_v5(mg_session *session,
+                                           mg_relationship **rel) {
+  return mg_session_decode_relationship(session, rel, 1);
+}
+
+static int mg_session_read_unbound_relationship_v1(
+    mg_session *session, mg_unbound_relationship **rel) {
+  return mg_session_decode_unbound_relationship(session, rel, 0);
+}
+
+static int mg_session_read_unbound_relationship_v5(
+    mg_session *session, mg_unbound_relationship **rel) {
+  return mg_session_decode_unbound_relationship(session, rel, 1);
+}
+
+// Bolt 4 structures are the same as those of Bolt 1.
+static const mg_structure_decoders mg_structure_decoders_v1 = {
+    mg_session_read_node_v1, mg_session_read_relationship_v1,
+    mg_session_read_unbound_relationship_v1};
+
+static const mg_structure_decoders mg_structure_decoders_v5 = {
+    mg_session_read_node_v5, mg_session_read_relationship_v5,
+    mg_session_read_unbound_relationship_v5};
+
+void mg_session_set_version(mg_session *session, int version) {
+  session->version = version;
+  session->structure_decoders =
+      version >= 5 ? &mg_structure_decoders_v5 : &mg_structure_decoders_v1;
+}
+
+int mg_session_read_node(mg_session *session, mg_node **node) {
+  return session->structure_decoders->read_node(session, node);
+}
+
+int mg_session_read_relationship(mg_session *session, mg_relationship **rel) {
+  return session->structure_decoders->read_relationship(session, rel);
+}
+
+int mg_session_read_unbound_relationship(mg_session *session,
+                                         mg_unbound_relationship **rel) {
+  return session->structure_decoders->read_unbound_relationship(session, rel);
+}
+
 int mg_session_read_path(mg_session *session, mg_path **path) {
   MG_RETURN_IF_FAILED(mg_session_check_struct_header(
       session, (uint8_t)(MG_MARKER_TINY_STRUCT + 3), MG_SIGNATURE_PATH));
@@ -925,20 +1230,14 @@ int mg_session_read_struct_value(mg_session *session, mg_value *value) {
   return MG_ERROR_DECODING_FAILED;
 }
 
-int mg_session_read_value(mg_session *session, mg_value **value) {
+static int mg_session_read_value_inline(mg_session *session,
+                                        mg_value *tvalue) {
   if (session->in_cursor >= session->in_end) {
     mg_session_set_error(session, "unexpected end of message");
     return MG_ERROR_DECODING_FAILED;
   }
   uint8_t marker = *(uint8_t *)(session->in_buffer + session->in_cursor);
 
-  mg_value *tvalue =
-      mg_allocator_malloc(session->decoder_allocator, sizeof(mg_value));
-  if (!tvalue) {
-    mg_session_set_error(session, "out of memory");
-    return MG_ERROR_OOM;
-  }
-
   int status = 0;
 
   switch (marker) {
@@ -946,7 +1245,7 @@ int mg_session_read_value(mg_session *session, mg_value **value) {
       tvalue->type = MG_VALUE_TYPE_NULL;
       status = mg_session_read_null(session);
       if (status != 0) {
-        goto cleanup;
+        return status;
       }
       break;
     }
@@ -955,7 +1254,7 @@ int mg_session_read_value(mg_session *session, mg_value **value) {
       tvalue->type = MG_VALUE_TYPE_BOOL;
       status = mg_session_read_bool(session, &tvalue->bool_v);
       if (status != 0) {
-        goto cleanup;
+        return status;
       }
       break;
     case MG_MARKER_INT_8:
@@ -965,14 +1264,14 @@ int mg_session_read_value(mg_session *session, mg_value **value) {
       tvalue->type = MG_VALUE_TYPE_INTEGER;
       status = mg_session_read_integer(session, &tvalue->integer_v);
       if (status != 0) {
-        goto cleanup;
+        return status;
       }
       break;
     case MG_MARKER_FLOAT:
       tvalue->type = MG_VALUE_TYPE_FLOAT;
       status = mg_session_read_float(session, &tvalue->float_v);
       if (status != 0) {
-        goto cleanup;
+        return status;
       }
       break;
     case MG_MARKER_STRING_8:
@@ -981,7 +1280,7 @@ int mg_session_read_value(mg_session *session, mg_value **value) {
       tvalue->type = MG_VALUE_TYPE_STRING;
       status = mg_session_read_string(session, &tvalue->string_v);
       if (status != 0) {
-        goto cleanup;
+        return status;
       }
       break;
     case MG_MARKER_LIST_8:
@@ -990,7 +1289,7 @@ int mg_session_read_value(mg_session *session, mg_value **value) {
       tvalue->type = MG_VALUE_TYPE_LIST;
       status = mg_session_read_list(session, &tvalue->list_v);
       if (status != 0) {
-        goto cleanup;
+        return status;
       }
       break;
     case MG_MARKER_MAP_8:
@@ -999,59 +1298,485 @@ int mg_session_read_value(mg_session *session, mg_value **value) {
       tvalue->type = MG_VALUE_TYPE_MAP;
       status = mg_session_read_map(session, &tvalue->map_v);
       if (status != 0) {
-        goto cleanup;
+        return status;
       }
       break;
     case MG_MARKER_STRUCT_8:
     case MG_MARKER_STRUCT_16:
       mg_session_set_error(session, "unsupported value");
       status = MG_ERROR_DECODING_FAILED;
-      goto cleanup;
+      return status;
     default:
       if ((marker & 0x80) == 0 || (marker & 0xF0) == 0xF0) {
         tvalue->type = MG_VALUE_TYPE_INTEGER;
         status = mg_session_read_integer(session, &tvalue->integer_v);
         if (status != 0) {
-          goto cleanup;
+          return status;
         }
       } else if ((marker & 0xF0) == MG_MARKER_TINY_STRING) {
         tvalue->type = MG_VALUE_TYPE_STRING;
         status = mg_session_read_string(session, &tvalue->string_v);
         if (status != 0) {
-          goto cleanup;
+          return status;
         }
       } else if ((marker & 0xF0) == MG_MARKER_TINY_LIST) {
         tvalue->type = MG_VALUE_TYPE_LIST;
         status = mg_session_read_list(session, &tvalue->list_v);
         if (status != 0) {
-          goto cleanup;
+          return status;
         }
       } else if ((marker & 0xF0) == MG_MARKER_TINY_MAP) {
         tvalue->type = MG_VALUE_TYPE_MAP;
         status = mg_session_read_map(session, &tvalue->map_v);
         if (status != 0) {
-          goto cleanup;
+          return status;
         }
       } else if ((marker & 0xF0) == MG_MARKER_TINY_STRUCT) {
         status = mg_session_read_struct_value(session, tvalue);
         if (status != 0) {
-          goto cleanup;
+          return status;
         }
       } else {
         mg_session_set_error(session, "unsupported value");
         status = MG_ERROR_DECODING_FAILED;
-        goto cleanup;
+        return status;
       }
   }
 
+  return 0;
+}
+
+int mg_session_read_value(mg_session *session, mg_value **value) {
+  mg_value *tvalue =
+      mg_allocator_malloc(session->decoder_allocator, sizeof(mg_value));
+  if (!tvalue) {
+    mg_session_set_error(session, "out of memory");
+    return MG_ERROR_OOM;
+  }
+
+  int status = mg_session_read_value_inline(session, tvalue);
+  if (status != 0) {
+    mg_allocator_free(session->decoder_allocator, tvalue);
+    return status;
+  }
   *value = tvalue;
   return 0;
+}
 
-cleanup:
-  mg_allocator_free(session->decoder_allocator, tvalue);
+static int mg_session_skip_bytes(mg_session *session, size_t len) {
+  if (session->in_cursor + len > session->in_end) {
+    mg_session_set_error(session, "unexpected end of message");
+    return MG_ERROR_DECODING_FAILED;
+  }
+  session->in_cursor += len;
+  return 0;
+}
+
+static int mg_session_skip_string(mg_session *session) {
+  uint32_t size;
+  MG_RETURN_IF_FAILED(
+      mg_session_read_container_size(session, &size, MG_MARKERS_STRING));
+  return mg_session_skip_bytes(session, size);
+}
+
+static int mg_session_skip_map(mg_session *session) {
+  uint32_t size;
+  MG_RETURN_IF_FAILED(
+      mg_session_read_container_size(session, &size, MG_MARKERS_MAP));
+  for (uint32_t i = 0; i < size; ++i) {
+    MG_RETURN_IF_FAILED(mg_session_skip_string(session));
+    MG_RETURN_IF_FAILED(mg_session_skip_value(session));
+  }
+  return 0;
+}
+
+// Returns the number of leading bytes out of the 16 at `data` which are
+// values of their own: tiny integers, nulls and booleans. Lists of such values
+// (small numbers, flags, missing properties) are common, and skipping them a
+// byte at a time would be the bottleneck.
+static size_t mg_count_single_byte_values(const uint8_t *data) {
+#if defined(MG_SKIP_WITH_SSE2)
+  __m128i bytes = _mm_loadu_si128((const __m128i *)data);
+  // Tiny integers are the bytes from -16 to 127 when taken as signed.
+  __m128i single = _mm_cmpgt_epi8(bytes, _mm_set1_epi8(-17));
+  single = _mm_or_si128(
+      single, _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)MG_MARKER_NULL)));
+  // Booleans differ only in the lowest bit.
+  single = _mm_or_si128(
+      single, _mm_cmpeq_epi8(_mm_or_si128(bytes, _mm_set1_epi8(1)),
+                             _mm_set1_epi8((char)MG_MARKER_BOOL_TRUE)));
+  unsigned others = ~(unsigned)_mm_movemask_epi8(single) & 0xFFFF;
+  if (!others) {
+    return 16;
+  }
+#ifdef _MSC_VER
+  unsigned long first;
+  _BitScanForward(&first, others);
+  return first;
+#else
+  return (size_t)__builtin_ctz(others);
+#endif
+#elif defined(MG_SKIP_WITH_NEON)
+  int8x16_t bytes = vld1q_s8((const int8_t *)data);
+  uint8x16_t single = vcgtq_s8(bytes, vdupq_n_s8(-17));
+  single = vorrq_u8(single,
+                    vceqq_s8(bytes, vdupq_n_s8((int8_t)MG_MARKER_NULL)));
+  single = vorrq_u8(single,
+                    vceqq_s8(vorrq_s8(bytes, vdupq_n_s8(1)),
+                             vdupq_n_s8((int8_t)MG_MARKER_BOOL_TRUE)));
+  // Narrows each lane to 4 bits of a 64-bit mask.
+  uint64_t mask = vget_lane_u64(
+      vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(single), 4)), 0);
+  uint64_t others = ~mask;
+  if (!others) {
+    return 16;
+  }
+  return (size_t)__builtin_ctzll(others) / 4;
+#else
+  size_t count = 0;
+  while (count < 16 &&
+         ((int8_t)data[count] >= -16 || data[count] == MG_MARKER_NULL ||
+          (data[count] | 1) == MG_MARKER_BOOL_TRUE)) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
+// Reads the size of a string, list or map that follows `marker` at `data`, in
+// `width` bytes. Returns the number of bytes read, or 0 if they aren't there.
+static size_t mg_read_skipped_size(const uint8_t *data, size_t available,
+                                   size_t width, uint64_t *size) {
+  if (available < width) {
+    return 0;
+  }
+  uint64_t value = 0;
+  for (size_t i = 0; i < width; ++i) {
+    value = (value << 8) | data[i];
+  }
+  *size = value;
+  return width;
+}
+
+// Values are skipped without recursion into lists and structures: only the
+// number of values left to skip is tracked, and a container adds its elements
+// to it. Map keys have to be strings, so maps are handled separately.
+int mg_session_skip_value(mg_session *session) {
+  const uint8_t *data = (const uint8_t *)session->in_buffer;
+  const size_t end = session->in_end;
+  size_t cursor = session->in_cursor;
+  uint64_t pending = 1;
+
+  while (pending > 0) {
+    if (cursor >= end) {
+      goto unexpected_end;
+    }
+    uint8_t marker = data[cursor];
+    if (pending > 1 && end - cursor >= 16 && (int8_t)marker >= -16) {
+      // A tiny integer, which is likely followed by more of them.
+      size_t count = mg_count_single_byte_values(data + cursor);
+      if (count > pending) {
+        count = (size_t)pending;
+      }
+      cursor += count;
+      pending -= count;
+      continue;
+    }
+    ++cursor;
+    --pending;
+    if ((marker & 0x80) == 0 || (marker & 0xF0) == 0xF0) {
+      continue;
+    }
+
+    // Bytes of the value following the marker and its size, and the number
+    // of values it contains.
+    uint64_t payload = 0;
+    uint64_t elements = 0;
+    size_t width = 0;
+    switch (marker) {
+      case MG_MARKER_NULL:
+      case MG_MARKER_BOOL_FALSE:
+      case MG_MARKER_BOOL_TRUE:
+        break;
+      case MG_MARKER_INT_8:
+        payload = 1;
+        break;
+      case MG_MARKER_INT_16:
+        payload = 2;
+        break;
+      case MG_MARKER_INT_32:
+        payload = 4;
+        break;
+      case MG_MARKER_INT_64:
+      case MG_MARKER_FLOAT:
+        payload = 8;
+        break;
+      case MG_MARKER_STRING_8:
+      case MG_MARKER_STRING_16:
+      case MG_MARKER_STRING_32:
+        width = (size_t)1 << (marker - MG_MARKER_STRING_8);
+        if (!mg_read_skipped_size(data + cursor, end - cursor, width,
+                                  &payload)) {
+          goto unexpected_end;
+        }
+        break;
+      case MG_MARKER_LIST_8:
+      case MG_MARKER_LIST_16:
+      case MG_MARKER_LIST_32:
+        width = (size_t)1 << (marker - MG_MARKER_LIST_8);
+        if (!mg_read_skipped_size(data + cursor, end - cursor, width,
+                                  &elements)) {
+          goto unexpected_end;
+        }
+        break;
+      case MG_MARKER_MAP_8:
+      case MG_MARKER_MAP_16:
+      case MG_MARKER_MAP_32:
+        session->in_cursor = cursor - 1;
+        MG_RETURN_IF_FAILED(mg_session_skip_map(session));
+        cursor = session->in_cursor;
+        continue;
+      default:
+        switch (marker & 0xF0) {
+          case MG_MARKER_TINY_STRING:
+            payload = marker & 0x0F;
+            break;
+          case MG_MARKER_TINY_LIST:
+            elements = marker & 0x0F;
+            break;
+          case MG_MARKER_TINY_MAP:
+            session->in_cursor = cursor - 1;
+            MG_RETURN_IF_FAILED(mg_session_skip_map(session));
+            cursor = session->in_cursor;
+            continue;
+          case MG_MARKER_TINY_STRUCT:
+            // Skip the signature, fields are skipped as any other value
+            // regardless of the structure type.
+            payload = 1;
+            elements = marker & 0x0F;
+            break;
+          default:
+            session->in_cursor = cursor - 1;
+            mg_session_set_error(session, "unsupported value");
+            return MG_ERROR_DECODING_FAILED;
+        }
+    }
+    cursor += width;
+    if (payload > end - cursor) {
+      goto unexpected_end;
+    }
+    cursor += (size_t)payload;
+    pending += elements;
+  }
+
+  session->in_cursor = cursor;
+  return 0;
+
+unexpected_end:
+  session->in_cursor = end;
+  mg_session_set_error(session, "unexpected end of message");
+  return MG_ERROR_DECODING_FAILED;
+}
+
+static int mg_session_index_lazy_row(mg_session *session, mg_lazy_row **row) {
+  *row = NULL;
+  if (session->in_end - session->in_cursor < 2 ||
+      *(uint8_t *)(session->in_buffer + session->in_cursor) !=
+          MG_MARKER_TINY_STRUCT1 ||
+      *(uint8_t *)(session->in_buffer + session->in_cursor + 1) !=
+          MG_SIGNATURE_MESSAGE_RECORD) {
+    // Not a RECORD message, leave it to `mg_session_read_bolt_message`.
+    return 0;
+  }
+  session->in_cursor += 2;
+
+  uint32_t size;
+  MG_RETURN_IF_FAILED(
+      mg_session_read_container_size(session, &size, MG_MARKERS_LIST));
+
+  // Each field is at least one byte long, so this also keeps the allocation
+  // size bounded by the message size.
+  if (size > session->in_end - session->in_cursor) {
+    mg_session_set_error(session, "unexpected end of message");
+    return MG_ERROR_DECODING_FAILED;
+  }
+
+  mg_lazy_row *trow = mg_allocator_malloc(
+      session->decoder_allocator,
+      sizeof(mg_lazy_row) + size * (sizeof(mg_value *) + sizeof(size_t)));
+  if (!trow) {
+    mg_session_set_error(session, "out of memory");
+    return MG_ERROR_OOM;
+  }
+  trow->session = session;
+  trow->size = size;
+  trow->values = (mg_value **)((char *)trow + sizeof(mg_lazy_row));
+  trow->offsets = (size_t *)(trow->values + size);
+
+  for (uint32_t i = 0; i < size; ++i) {
+    trow->values[i] = NULL;
+    trow->offsets[i] = session->in_cursor;
+    int status = mg_session_skip_value(session);
+    if (status != 0) {
+      mg_allocator_free(session->decoder_allocator, trow);
+      return status;
+    }
+  }
+
+  *row = trow;
+  return 0;
+}
+
+int mg_session_read_lazy_row(mg_session *session, mg_lazy_row **row) {
+  if (!session->collect_stats) {
+    return mg_session_index_lazy_row(session, row);
+  }
+  uint64_t start = mg_clock_ns();
+  int status = mg_session_index_lazy_row(session, row);
+  session->stats.decode_ns += mg_clock_ns() - start;
   return status;
 }
 
+int mg_session_read_lazy_row_value(mg_lazy_row *row, uint32_t pos) {
+  mg_session *session = row->session;
+  session->in_cursor = row->offsets[pos];
+  if (!session->collect_stats) {
+    return mg_session_read_value(session, &row->values[pos]);
+  }
+  uint64_t start = mg_clock_ns();
+  int status = mg_session_read_value(session, &row->values[pos]);
+  session->stats.decode_ns += mg_clock_ns() - start;
+  return status;
+}
+
+static enum mg_value_type mg_struct_signature_type(uint8_t signature) {
+  switch (signature) {
+    case MG_SIGNATURE_NODE:
+      return MG_VALUE_TYPE_NODE;
+    case MG_SIGNATURE_RELATIONSHIP:
+      return MG_VALUE_TYPE_RELATIONSHIP;
+    case MG_SIGNATURE_UNBOUND_RELATIONSHIP:
+      return MG_VALUE_TYPE_UNBOUND_RELATIONSHIP;
+    case MG_SIGNATURE_PATH:
+      return MG_VALUE_TYPE_PATH;
+    case MG_SIGNATURE_DATE:
+      return MG_VALUE_TYPE_DATE;
+    case MG_SIGNATURE_TIME:
+      return MG_VALUE_TYPE_TIME;
+    case MG_SIGNATURE_LOCAL_TIME:
+      return MG_VALUE_TYPE_LOCAL_TIME;
+    case MG_SIGNATURE_DATE_TIME:
+      return MG_VALUE_TYPE_DATE_TIME;
+    case MG_SIGNATURE_DATE_TIME_ZONE_ID:
+      return MG_VALUE_TYPE_DATE_TIME_ZONE_ID;
+    case MG_SIGNATURE_LOCAL_DATE_TIME:
+      return MG_VALUE_TYPE_LOCAL_DATE_TIME;
+    case MG_SIGNATURE_DURATION:
+      return MG_VALUE_TYPE_DURATION;
+    case MG_SIGNATURE_POINT_2D:
+      return MG_VALUE_TYPE_POINT_2D;
+    case MG_SIGNATURE_POINT_3D:
+      return MG_VALUE_TYPE_POINT_3D;
+  }
+  return MG_VALUE_TYPE_UNKNOWN;
+}
+
+enum mg_value_type mg_session_lazy_row_field_type(const mg_lazy_row *row,
+                                                  uint32_t pos) {
+  // Fields were already skipped over when indexing the row, so they are known
+  // to be within the message.
+  const uint8_t *data =
+      (const uint8_t *)(row->session->in_buffer + row->offsets[pos]);
+  uint8_t marker = data[0];
+  switch (marker) {
+    case MG_MARKER_NULL:
+      return MG_VALUE_TYPE_NULL;
+    case MG_MARKER_BOOL_FALSE:
+    case MG_MARKER_BOOL_TRUE:
+      return MG_VALUE_TYPE_BOOL;
+    case MG_MARKER_INT_8:
+    case MG_MARKER_INT_16:
+    case MG_MARKER_INT_32:
+    case MG_MARKER_INT_64:
+      return MG_VALUE_TYPE_INTEGER;
+    case MG_MARKER_FLOAT:
+      return MG_VALUE_TYPE_FLOAT;
+    case MG_MARKER_STRING_8:
+    case MG_MARKER_STRING_16:
+    case MG_MARKER_STRING_32:
+      return MG_VALUE_TYPE_STRING;
+    case MG_MARKER_LIST_8:
+    case MG_MARKER_LIST_16:
+    case MG_MARKER_LIST_32:
+      return MG_VALUE_TYPE_LIST;
+    case MG_MARKER_MAP_8:
+    case MG_MARKER_MAP_16:
+    case MG_MARKER_MAP_32:
+      return MG_VALUE_TYPE_MAP;
+  }
+  if ((marker & 0x80) == 0 || (marker & 0xF0) == 0xF0) {
+    return MG_VALUE_TYPE_INTEGER;
+  }
+  switch (marker & 0xF0) {
+    case MG_MARKER_TINY_STRING:
+      return MG_VALUE_TYPE_STRING;
+    case MG_MARKER_TINY_LIST:
+      return MG_VALUE_TYPE_LIST;
+    case MG_MARKER_TINY_MAP:
+      return MG_VALUE_TYPE_MAP;
+    case MG_MARKER_TINY_STRUCT:
+      return mg_struct_signature_type(data[1]);
+  }
+  return MG_VALUE_TYPE_UNKNOWN;
+}
+
+static int mg_session_seek_lazy_row_field(mg_lazy_row *row, uint32_t pos,
+                                          enum mg_value_type type) {
+  if (mg_session_lazy_row_field_type(row, pos) != type) {
+    mg_session_set_error(row->session, "unexpected type of field");
+    return MG_ERROR_TYPE_MISMATCH;
+  }
+  row->session->in_cursor = row->offsets[pos];
+  return 0;
+}
+
+int mg_session_read_lazy_row_bool(mg_lazy_row *row, uint32_t pos, int *value) {
+  MG_RETURN_IF_FAILED(
+      mg_session_seek_lazy_row_field(row, pos, MG_VALUE_TYPE_BOOL));
+  return mg_session_read_bool(row->session, value);
+}
+
+int mg_session_read_lazy_row_integer(mg_lazy_row *row, uint32_t pos,
+                                     int64_t *value) {
+  MG_RETURN_IF_FAILED(
+      mg_session_seek_lazy_row_field(row, pos, MG_VALUE_TYPE_INTEGER));
+  return mg_session_read_integer(row->session, value);
+}
+
+int mg_session_read_lazy_row_float(mg_lazy_row *row, uint32_t pos,
+                                   double *value) {
+  MG_RETURN_IF_FAILED(
+      mg_session_seek_lazy_row_field(row, pos, MG_VALUE_TYPE_FLOAT));
+  return mg_session_read_float(row->session, value);
+}
+
+int mg_session_read_lazy_row_string(mg_lazy_row *row, uint32_t pos,
+                                    mg_string *str) {
+  MG_RETURN_IF_FAILED(
+      mg_session_seek_lazy_row_field(row, pos, MG_VALUE_TYPE_STRING));
+  return mg_session_read_string_inline(row->session, str);
+}
+
+void mg_lazy_row_destroy_ca(mg_lazy_row *row, mg_allocator *allocator) {
+  if (!row) {
+    return;
+  }
+  for (uint32_t i = 0; i < row->size; ++i) {
+    mg_value_destroy_ca(row->values[i], allocator);
+  }
+  mg_allocator_free(allocator, row);
+}
+
 // Some of these message types are never received by client, but we still have
 // decoding function because they are useful for testing.
 int mg_session_read_success_message(mg_session *session,
@@ -1165,6 +1890,23 @@ cleanup:
   return status;
 }
 
+int mg_session_read_logon_message(mg_session *session,
+                                  mg_message_logon **message) {
+  mg_map *auth;
+  MG_RETURN_IF_FAILED(mg_session_read_map(session, &auth));
+
+  mg_message_logon *tmessage =
+      mg_allocator_malloc(session->decoder_allocator, sizeof(mg_message_logon));
+  if (!tmessage) {
+    mg_map_destroy_ca(auth, session->decoder_allocator);
+    return MG_ERROR_OOM;
+  }
+
+  tmessage->auth = auth;
+  *message = tmessage;
+  return 0;
+}
+
 int mg_session_read_run_message(mg_session *session, mg_message_run **message) {
   mg_string *statement;
   MG_RETURN_IF_FAILED(mg_session_read_string(session, &statement));
@@ -1179,7 +1921,7 @@ int mg_session_read_run_message(mg_session *session, mg_message_run **message) {
   }
 
   mg_map *extra = NULL;
-  if (session->version == 4) {
+  if (session->version >= 4) {
     status = mg_session_read_map(session, &extra);
     if (status != 0) {
       goto cleanup_parameters;
@@ -1241,7 +1983,7 @@ int mg_session_read_pull_message(mg_session *session,
   int status = 0;
 
   mg_map *extra = NULL;
-  if (session->version == 4) {
+  if (session->version >= 4) {
     status = mg_session_read_map(session, &extra);
     if (status != 0) {
       return status;
@@ -1263,7 +2005,26 @@ cleanup:
   return status;
 }
 
-int mg_session_read_bolt_message(mg_session *session, mg_message **message) {
+int mg_session_read_discard_message(mg_session *session,
+                                    mg_message_discard **message) {
+  mg_map *extra = NULL;
+  if (session->version >= 4) {
+    MG_RETURN_IF_FAILED(mg_session_read_map(session, &extra));
+  }
+
+  mg_message_discard *tmessage = mg_allocator_malloc(
+      session->decoder_allocator, sizeof(mg_message_discard));
+  if (!tmessage) {
+    mg_map_destroy_ca(extra, session->decoder_allocator);
+    return MG_ERROR_OOM;
+  }
+  tmessage->extra = extra;
+  *message = tmessage;
+  return 0;
+}
+
+static int mg_session_decode_bolt_message(mg_session *session,
+                                          mg_message **message) {
   uint8_t marker;
   MG_RETURN_IF_FAILED(mg_session_read_uint8(session, &marker));
 
@@ -1300,6 +2061,12 @@ int mg_session_read_bolt_message(mg_session *session, mg_message **message) {
         goto cleanup;
       }
       break;
+    case MG_SIGNATURE_MESSAGE_IGNORED:
+      if (marker != MG_MARKER_TINY_STRUCT) {
+        goto wrong_marker;
+      }
+      tmessage->type = MG_MESSAGE_TYPE_IGNORED;
+      break;
     case MG_SIGNATURE_MESSAGE_RECORD:
       if (marker != (uint8_t)(MG_MARKER_TINY_STRUCT + 1)) {
         goto wrong_marker;
@@ -1328,8 +2095,18 @@ int mg_session_read_bolt_message(mg_session *session, mg_message **message) {
         goto cleanup;
       }
       break;
+    case MG_SIGNATURE_MESSAGE_LOGON:
+      if (marker != (uint8_t)(MG_MARKER_TINY_STRUCT + 1)) {
+        goto wrong_marker;
+      }
+      tmessage->type = MG_MESSAGE_TYPE_LOGON;
+      status = mg_session_read_logon_message(session, &tmessage->logon_v);
+      if (status != 0) {
+        goto cleanup;
+      }
+      break;
     case MG_SIGNATURE_MESSAGE_RUN: {
-      int field_number = 2 + (session->version == 4);
+      int field_number = 2 + (session->version >= 4);
       if (marker != (uint8_t)(MG_MARKER_TINY_STRUCT + field_number)) {
         goto wrong_marker;
       }
@@ -1375,7 +2152,7 @@ int mg_session_read_bolt_message(mg_session *session, mg_message **message) {
       tmessage->type = MG_MESSAGE_TYPE_RESET;
       break;
     case MG_SIGNATURE_MESSAGE_PULL: {
-      uint8_t expected_marker = MG_MARKER_TINY_STRUCT + (session->version == 4);
+      uint8_t expected_marker = MG_MARKER_TINY_STRUCT + (session->version >= 4);
       if (marker != expected_marker) {
         goto wrong_marker;
       }
@@ -1386,6 +2163,18 @@ int mg_session_read_bolt_message(mg_session *session, mg_message **message) {
       }
       break;
     }
+    case MG_SIGNATURE_MESSAGE_DISCARD: {
+      uint8_t expected_marker = MG_MARKER_TINY_STRUCT + (session->version >= 4);
+      if (marker != expected_marker) {
+        goto wrong_marker;
+      }
+      tmessage->type = MG_MESSAGE_TYPE_DISCARD;
+      status = mg_session_read_discard_message(session, &tmessage->discard_v);
+      if (status != 0) {
+        goto cleanup;
+      }
+      break;
+    }
     default:
       mg_session_set_error(session, "unknown message type");
       status = MG_ERROR_PROTOCOL_VIOLATION;
@@ -1402,3 +2191,13 @@ cleanup:
   mg_allocator_free(session->decoder_allocator, tmessage);
   return status;
 }
+
+int mg_session_read_bolt_message(mg_session *session, mg_message **message) {
+  if (!session->collect_stats) {
+    return mg_session_decode_bolt_message(session, message);
+  }
+  uint64_t start = mg_clock_ns();
+  int status = mg_session_decode_bolt_message(session, message);
+  session->stats.decode_ns += mg_clock_ns() - start;
+  return status;
+}
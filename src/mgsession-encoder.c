@@ -278,29 +278,90 @@ int mg_session_send_hello_message(mg_session *session, const mg_map *extra) {
   return mg_session_flush_message(session);
 }
 
-int mg_session_send_run_message(mg_session *session, const char *statement,
-                                const mg_map *parameters, const mg_map *extra) {
-  int field_number = 2 + (session->version == 4);
+int mg_session_send_logon_message(mg_session *session, const mg_map *auth) {
+  MG_RETURN_IF_FAILED(
+      mg_session_write_uint8(session, (uint8_t)(MG_MARKER_TINY_STRUCT + 1)));
+  MG_RETURN_IF_FAILED(
+      mg_session_write_uint8(session, MG_SIGNATURE_MESSAGE_LOGON));
+  MG_RETURN_IF_FAILED(mg_session_write_map(session, auth));
+  return mg_session_flush_message(session);
+}
+
+static int mg_session_write_run_header(mg_session *session) {
+  int field_number = 2 + (session->version >= 4);
   MG_RETURN_IF_FAILED(mg_session_write_uint8(
       session, (uint8_t)(MG_MARKER_TINY_STRUCT + field_number)));
-  MG_RETURN_IF_FAILED(
-      mg_session_write_uint8(session, MG_SIGNATURE_MESSAGE_RUN));
+  return mg_session_write_uint8(session, MG_SIGNATURE_MESSAGE_RUN);
+}
+
+int mg_session_send_run_message(mg_session *session, const char *statement,
+                                const mg_map *parameters, const mg_map *extra) {
+  MG_RETURN_IF_FAILED(mg_session_write_run_header(session));
   MG_RETURN_IF_FAILED(mg_session_write_string(session, statement));
   MG_RETURN_IF_FAILED(mg_session_write_map(session, parameters));
 
-  if (session->version == 4) {
+  if (session->version >= 4) {
+    MG_RETURN_IF_FAILED(mg_session_write_map(session, extra));
+  }
+  return mg_session_flush_message(session);
+}
+
+int mg_session_send_prepared_run_message(mg_session *session,
+                                         const mg_prepared_query *statement,
+                                         const mg_map *parameters,
+                                         const mg_map *extra) {
+  MG_RETURN_IF_FAILED(mg_session_write_run_header(session));
+  MG_RETURN_IF_FAILED(
+      mg_session_write_raw(session, statement->data, statement->size));
+  MG_RETURN_IF_FAILED(mg_session_write_map(session, parameters));
+
+  if (session->version >= 4) {
+    MG_RETURN_IF_FAILED(mg_session_write_map(session, extra));
+  }
+  return mg_session_flush_message(session);
+}
+
+int mg_session_send_streamed_run_message(mg_session *session,
+                                         const char *statement,
+                                         const mg_prepared_query *prepared,
+                                         mg_param_writer_callback write_params,
+                                         void *params_data,
+                                         const mg_map *extra) {
+  MG_RETURN_IF_FAILED(mg_session_write_run_header(session));
+  if (prepared) {
+    MG_RETURN_IF_FAILED(
+        mg_session_write_raw(session, prepared->data, prepared->size));
+  } else {
+    MG_RETURN_IF_FAILED(mg_session_write_string(session, statement));
+  }
+  MG_RETURN_IF_FAILED(write_params((mg_param_writer *)session, params_data));
+
+  if (session->version >= 4) {
     MG_RETURN_IF_FAILED(mg_session_write_map(session, extra));
   }
   return mg_session_flush_message(session);
 }
 
 int mg_session_send_pull_message(mg_session *session, const mg_map *extra) {
-  uint8_t marker = MG_MARKER_TINY_STRUCT + (session->version == 4);
+  uint8_t marker = MG_MARKER_TINY_STRUCT + (session->version >= 4);
   MG_RETURN_IF_FAILED(mg_session_write_uint8(session, marker));
   MG_RETURN_IF_FAILED(
       mg_session_write_uint8(session, MG_SIGNATURE_MESSAGE_PULL));
 
-  if (session->version == 4) {
+  if (session->version >= 4) {
+    MG_RETURN_IF_FAILED(mg_session_write_map(session, extra));
+  }
+
+  return mg_session_flush_message(session);
+}
+
+int mg_session_send_discard_message(mg_session *session, const mg_map *extra) {
+  uint8_t marker = MG_MARKER_TINY_STRUCT + (session->version >= 4);
+  MG_RETURN_IF_FAILED(mg_session_write_uint8(session, marker));
+  MG_RETURN_IF_FAILED(
+      mg_session_write_uint8(session, MG_SIGNATURE_MESSAGE_DISCARD));
+
+  if (session->version >= 4) {
     MG_RETURN_IF_FAILED(mg_session_write_map(session, extra));
   }
 
@@ -331,6 +392,13 @@ int mg_session_send_failure_message(mg_session *session,
   return mg_session_flush_message(session);
 }
 
+int mg_session_send_ignored_message(mg_session *session) {
+  MG_RETURN_IF_FAILED(mg_session_write_uint8(session, MG_MARKER_TINY_STRUCT));
+  MG_RETURN_IF_FAILED(
+      mg_session_write_uint8(session, MG_SIGNATURE_MESSAGE_IGNORED));
+  return mg_session_flush_message(session);
+}
+
 int mg_session_send_success_message(mg_session *session,
                                     const mg_map *metadata) {
   MG_RETURN_IF_FAILED(
@@ -373,3 +441,86 @@ int mg_session_send_rollback_messsage(mg_session *session) {
       mg_session_write_uint8(session, MG_SIGNATURE_MESSAGE_ROLLBACK));
   return mg_session_flush_message(session);
 }
+
+mg_prepared_query *mg_prepared_query_make(const char *query) {
+  size_t len = strlen(query);
+  if (len > UINT32_MAX) {
+    return NULL;
+  }
+  // The longest string header is a marker followed by a 32-bit size.
+  mg_prepared_query *prepared = mg_allocator_malloc(
+      &mg_system_allocator, sizeof(mg_prepared_query) + 5 + len);
+  if (!prepared) {
+    return NULL;
+  }
+  prepared->data = (char *)prepared + sizeof(mg_prepared_query);
+
+  uint32_t size = (uint32_t)len;
+  char *header = prepared->data;
+  if (size <= MG_TINY_SIZE_MAX) {
+    header[0] = (char)(MG_MARKERS_STRING[0] + size);
+    prepared->size = 1;
+  } else if (size <= UINT8_MAX) {
+    header[0] = (char)MG_MARKERS_STRING[1];
+    header[1] = (char)size;
+    prepared->size = 2;
+  } else if (size <= UINT16_MAX) {
+    uint16_t be_size = htobe16((uint16_t)size);
+    header[0] = (char)MG_MARKERS_STRING[2];
+    memcpy(header + 1, &be_size, sizeof(be_size));
+    prepared->size = 3;
+  } else {
+    uint32_t be_size = htobe32(size);
+    header[0] = (char)MG_MARKERS_STRING[3];
+    memcpy(header + 1, &be_size, sizeof(be_size));
+    prepared->size = 5;
+  }
+  memcpy(prepared->data + prepared->size, query, len);
+  prepared->size += len;
+  return prepared;
+}
+
+void mg_prepared_query_destroy(mg_prepared_query *prepared) {
+  mg_allocator_free(&mg_system_allocator, prepared);
+}
+
+int mg_param_writer_write_null(mg_param_writer *writer) {
+  return mg_session_write_null((mg_session *)writer);
+}
+
+int mg_param_writer_write_bool(mg_param_writer *writer, int value) {
+  return mg_session_write_bool((mg_session *)writer, value);
+}
+
+int mg_param_writer_write_integer(mg_param_writer *writer, int64_t value) {
+  return mg_session_write_integer((mg_session *)writer, value);
+}
+
+int mg_param_writer_write_float(mg_param_writer *writer, double value) {
+  return mg_session_write_float((mg_session *)writer, value);
+}
+
+int mg_param_writer_write_string(mg_param_writer *writer, size_t len,
+                                 const char *data) {
+  mg_session *session = (mg_session *)writer;
+  if (len > UINT32_MAX) {
+    mg_session_set_error(session, "string too long");
+    return MG_ERROR_SIZE_EXCEEDED;
+  }
+  return mg_session_write_string2(session, (uint32_t)len, data);
+}
+
+int mg_param_writer_begin_list(mg_param_writer *writer, uint32_t size) {
+  return mg_session_write_container_size((mg_session *)writer, size,
+                                         MG_MARKERS_LIST);
+}
+
+int mg_param_writer_begin_map(mg_param_writer *writer, uint32_t size) {
+  return mg_session_write_container_size((mg_session *)writer, size,
+                                         MG_MARKERS_MAP);
+}
+
+int mg_param_writer_write_value(mg_param_writer *writer,
+                                const mg_value *value) {
+  return mg_session_write_value((mg_session *)writer, value);
+}
@@ -16,6 +16,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -31,6 +32,8 @@
 
 #include "mgcommon.h"
 #include "mgconstants.h"
+#include "mgdecodepool.h"
+#include "mgsocket.h"
 #include "mgtransport.h"
 
 int mg_session_status(const mg_session *session) {
@@ -48,6 +51,22 @@ int mg_session_status(const mg_session *session) {
 // characters, ...).
 #define MG_DECODER_SEP_ALLOC_THRESHOLD 4096
 
+// Decoder blocks grow up to this size when messages don't fit in a single
+// block, and this many extra blocks are kept around for reuse, so that
+// fetching rows of a steady size doesn't allocate at all.
+#define MG_DECODER_ALLOCATOR_MAX_BLOCK_SIZE 4194304
+#define MG_DECODER_ALLOCATOR_SPARE_BLOCKS 4
+
+// Incoming data is read from the transport in batches of up to this many
+// bytes, so that small chunks and messages don't cost a system call each.
+#define MG_SESSION_READ_BUFFER_SIZE 65536
+
+// Input buffers start out big enough for a single chunk. Once they've grown
+// to fit a bigger message, they shrink back after this many messages in a row
+// that would have fit in their initial size.
+#define MG_SESSION_IN_BUFFER_SIZE MG_BOLT_MAX_CHUNK_SIZE
+#define MG_SESSION_SHRINK_AFTER_MESSAGES 64
+
 mg_session *mg_session_init(mg_allocator *allocator) {
   mg_linear_allocator *decoder_allocator =
       mg_linear_allocator_init(allocator, MG_DECODER_ALLOCATOR_BLOCK_SIZE,
@@ -55,6 +74,9 @@ mg_session *mg_session_init(mg_allocator *allocator) {
   if (!decoder_allocator) {
     return NULL;
   }
+  mg_linear_allocator_set_limits(decoder_allocator,
+                                 MG_DECODER_ALLOCATOR_MAX_BLOCK_SIZE,
+                                 MG_DECODER_ALLOCATOR_SPARE_BLOCKS);
 
   mg_session *session = mg_allocator_malloc(allocator, sizeof(mg_session));
   if (!session) {
@@ -63,32 +85,87 @@ mg_session *mg_session_init(mg_allocator *allocator) {
   }
 
   session->transport = NULL;
+  session->sockfd = -1;
+  session->nonblocking = 0;
+  session->reset_pending = 0;
   session->allocator = allocator;
   session->decoder_allocator = (mg_allocator *)decoder_allocator;
+  session->arena = NULL;
   session->out_buffer = NULL;
   session->in_buffer = NULL;
-  session->out_capacity = MG_BOLT_CHUNK_HEADER_SIZE + MG_BOLT_MAX_CHUNK_SIZE;
+  session->read_buffer = NULL;
+  // Two extra bytes at the end leave room for the end of message marker.
+  session->out_capacity =
+      MG_BOLT_CHUNK_HEADER_SIZE + MG_BOLT_MAX_CHUNK_SIZE + 2;
   session->out_buffer = mg_allocator_malloc(allocator, session->out_capacity);
   if (!session->out_buffer) {
     goto cleanup;
   }
   session->out_begin = MG_BOLT_CHUNK_HEADER_SIZE;
   session->out_end = session->out_begin;
+  session->buffer_messages = 0;
 
-  session->in_capacity = MG_BOLT_MAX_CHUNK_SIZE;
+  session->in_capacity = MG_SESSION_IN_BUFFER_SIZE;
   session->in_buffer = mg_allocator_malloc(allocator, session->in_capacity);
   if (!session->in_buffer) {
     goto cleanup;
   }
   session->in_end = 0;
   session->in_cursor = 0;
+  session->max_message_size = 0;
+  session->shrink_after = MG_SESSION_SHRINK_AFTER_MESSAGES;
+  session->small_messages = 0;
+
+  session->read_capacity = MG_SESSION_READ_BUFFER_SIZE;
+  session->read_buffer = mg_allocator_malloc(allocator, session->read_capacity);
+  if (!session->read_buffer) {
+    goto cleanup;
+  }
+  session->read_begin = 0;
+  session->read_end = 0;
+  session->read_scanned = 0;
+  session->read_scanned_size = 0;
 
   session->result.session = session;
   session->result.message = NULL;
+  session->result.lazy_row = NULL;
+  session->result.arena_row = NULL;
   session->result.columns = NULL;
 
   session->explicit_transaction = 0;
   session->query_number = 0;
+  session->pipeline_pending = 0;
+  session->fetch_size = 0;
+  session->pull_batched = 0;
+  session->discarding = 0;
+  session->dump_file = NULL;
+  session->dump_failed = 0;
+
+  mg_session_set_version(session, 4);
+  session->minor_version = 0;
+
+  session->decode_pool = NULL;
+
+  session->collect_stats = 0;
+  memset(&session->stats, 0, sizeof(session->stats));
+  session->stats.t_first = -1;
+  session->stats.t_last = -1;
+
+  session->trace_callback = NULL;
+  session->trace_data = NULL;
+  session->trace_queries_sent = 0;
+  session->trace_query_id = 0;
+  session->trace_first_record = 0;
+
+  session->query_timeout = 0;
+  session->deadline_ns = 0;
+  session->cancel_requests = 0;
+  session->cancels_handled = 0;
+  session->responses_pending = 0;
+  session->message_started = 0;
+  session->interrupt_pending = 0;
+  session->draining = 0;
+  session->interrupted = 0;
 
   session->error_buffer[0] = 0;
 
@@ -96,6 +173,7 @@ mg_session *mg_session_init(mg_allocator *allocator) {
 
 cleanup:
   mg_linear_allocator_destroy(decoder_allocator);
+  mg_allocator_free(allocator, session->read_buffer);
   mg_allocator_free(allocator, session->in_buffer);
   mg_allocator_free(allocator, session->out_buffer);
   mg_allocator_free(allocator, session);
@@ -119,6 +197,22 @@ const char *mg_session_error(mg_session *session) {
   return session->error_buffer;
 }
 
+int mg_session_get_stats(const mg_session *session, mg_session_stats *stats) {
+  if (!session || !session->collect_stats) {
+    return MG_ERROR_BAD_CALL;
+  }
+  *stats = session->stats;
+  // Objects of the current message are counted once they're released.
+  stats->decoder_bytes_allocated += mg_linear_allocator_allocated(
+      (const mg_linear_allocator *)session->decoder_allocator);
+  return 0;
+}
+
+void mg_session_trace(mg_session *session, enum mg_trace_event event,
+                      int64_t query_id) {
+  session->trace_callback(event, query_id, mg_clock_ns(), session->trace_data);
+}
+
 void mg_session_invalidate(mg_session *session) {
   if (session->transport) {
     mg_transport_destroy(session->transport);
@@ -134,83 +228,226 @@ void mg_session_destroy(mg_session *session) {
   if (session->transport) {
     mg_transport_destroy(session->transport);
   }
+  if (session->dump_file) {
+    fclose(session->dump_file);
+  }
+  mg_allocator_free(session->allocator, session->read_buffer);
   mg_allocator_free(session->allocator, session->in_buffer);
   mg_allocator_free(session->allocator, session->out_buffer);
 
   mg_message_destroy_ca(session->result.message, session->decoder_allocator);
   session->result.message = NULL;
+  mg_lazy_row_destroy_ca(session->result.lazy_row, session->decoder_allocator);
+  session->result.lazy_row = NULL;
   mg_list_destroy_ca(session->result.columns, session->allocator);
   session->result.columns = NULL;
 
+  // The current result row may have been decoded by the pool.
+  mg_decode_pool_destroy(session->decode_pool);
   mg_linear_allocator_destroy(
       (mg_linear_allocator *)session->decoder_allocator);
   mg_allocator_free(session->allocator, session);
 }
 
-int mg_session_flush_chunk(mg_session *session) {
+// The output buffer holds complete chunks (and end of message markers) which
+// are ready to be sent, followed by the chunk currently being written. Two
+// bytes in front of the current chunk (at `out_begin`) are reserved for its
+// header, which is filled in once the chunk is complete.
+
+// Completes the current chunk by writing its header, and starts a new one
+// right after it.
+static void mg_session_close_chunk(mg_session *session) {
   size_t chunk_size = session->out_end - session->out_begin;
   if (!chunk_size) {
-    return 0;
+    return;
   }
   if (chunk_size > MG_BOLT_MAX_CHUNK_SIZE) {
     abort();
   }
-
-  // Actual chunk data is written with offset of two bytes, leaving 2 bytes for
-  // chunk size which we write here before sending.
-  assert(session->out_begin == MG_BOLT_CHUNK_HEADER_SIZE);
   assert(MG_BOLT_CHUNK_HEADER_SIZE == sizeof(uint16_t));
+  uint16_t header = htobe16((uint16_t)chunk_size);
+  memcpy(session->out_buffer + session->out_begin - MG_BOLT_CHUNK_HEADER_SIZE,
+         &header, sizeof(header));
+  MG_SESSION_STATS_ADD(session, chunks_sent, 1);
+  session->out_begin = session->out_end + MG_BOLT_CHUNK_HEADER_SIZE;
+  session->out_end = session->out_begin;
+}
 
-  *(uint16_t *)session->out_buffer = htobe16((uint16_t)chunk_size);
+// Sends as much of the `pending` bytes at the front of the output buffer as
+// the transport takes without blocking, and keeps the rest at the front. The
+// buffer grows as needed to leave room for a full chunk after them.
+static int mg_session_try_send_pending(mg_session *session, size_t pending) {
+  size_t sent = 0;
+  while (sent < pending) {
+    ssize_t now = mg_transport_try_send(
+        session->transport, session->out_buffer + sent, pending - sent);
+    MG_SESSION_STATS_ADD(session, send_calls, 1);
+    if (now == MG_TRANSPORT_WANT_READ || now == MG_TRANSPORT_WANT_WRITE) {
+      break;
+    }
+    if (now < 0) {
+      mg_session_set_error(session, "failed to send chunk data");
+      return MG_ERROR_SEND_FAILED;
+    }
+    MG_SESSION_STATS_ADD(session, bytes_sent, (uint64_t)now);
+    sent += (size_t)now;
+  }
 
-  if (mg_transport_send(session->transport, session->out_buffer,
-                        session->out_end) != 0) {
-    mg_session_set_error(session, "failed to send chunk data");
+  size_t unsent = pending - sent;
+  size_t capacity =
+      unsent + MG_BOLT_CHUNK_HEADER_SIZE + MG_BOLT_MAX_CHUNK_SIZE + 2;
+  if (capacity > session->out_capacity) {
+    if (capacity < 2 * session->out_capacity) {
+      capacity = 2 * session->out_capacity;
+    }
+    char *new_out_buffer =
+        mg_allocator_realloc(session->allocator, session->out_buffer, capacity);
+    if (!new_out_buffer) {
+      mg_session_set_error(session,
+                           "failed to enlarge outgoing message buffer");
+      return MG_ERROR_OOM;
+    }
+    session->out_buffer = new_out_buffer;
+    session->out_capacity = capacity;
+  }
+  memmove(session->out_buffer, session->out_buffer + sent, unsent);
+  session->out_begin = unsent + MG_BOLT_CHUNK_HEADER_SIZE;
+  session->out_end = session->out_begin;
+  return 0;
+}
+
+int mg_session_send_raw(mg_session *session, const char *data, size_t len) {
+  MG_SESSION_STATS_ADD(session, send_calls, 1);
+  if (mg_transport_send(session->transport, data, len) != 0) {
     return MG_ERROR_SEND_FAILED;
   }
+  MG_SESSION_STATS_ADD(session, bytes_sent, len);
+  return 0;
+}
 
+// Sends all complete chunks from the output buffer. Must be called after the
+// current chunk is closed. Non-blocking sessions send only what can be sent
+// right away.
+static int mg_session_send_pending(mg_session *session) {
+  assert(session->out_end == session->out_begin);
+  size_t pending = session->out_begin - MG_BOLT_CHUNK_HEADER_SIZE;
+  if (session->nonblocking) {
+    return mg_session_try_send_pending(session, pending);
+  }
+  session->out_begin = MG_BOLT_CHUNK_HEADER_SIZE;
   session->out_end = session->out_begin;
+  if (!pending) {
+    return 0;
+  }
+  if (mg_session_send_raw(session, session->out_buffer, pending) != 0) {
+    mg_session_set_error(session, "failed to send chunk data");
+    return MG_ERROR_SEND_FAILED;
+  }
   return 0;
 }
 
+int mg_session_flush(mg_session *session) {
+  mg_session_close_chunk(session);
+  return mg_session_send_pending(session);
+}
+
 int mg_session_flush_message(mg_session *session) {
-  {
-    int status = mg_session_flush_chunk(session);
-    if (status != 0) {
-      return status;
-    }
+  mg_session_close_chunk(session);
+  // End of message marker goes where the header of the next chunk would be.
+  // Whenever there is room for it in the output buffer, it is sent together
+  // with the last chunk.
+  if (session->out_begin > session->out_capacity) {
+    MG_RETURN_IF_FAILED(mg_session_send_pending(session));
   }
-  const char MESSAGE_END[] = {0x00, 0x00};
-  {
-    int status =
-        mg_transport_send(session->transport, MESSAGE_END, sizeof(MESSAGE_END));
-    if (status != 0) {
-      mg_session_set_error(session, "failed to send message end marker");
-      return MG_ERROR_SEND_FAILED;
-    }
+  memset(session->out_buffer + session->out_begin - MG_BOLT_CHUNK_HEADER_SIZE,
+         0, MG_BOLT_CHUNK_HEADER_SIZE);
+  session->out_begin += MG_BOLT_CHUNK_HEADER_SIZE;
+  session->out_end = session->out_begin;
+  ++session->responses_pending;
+  if (session->buffer_messages) {
+    return 0;
+  }
+  return mg_session_send_pending(session);
+}
+
+static int mg_session_send_raw_vector(mg_session *session,
+                                      const mg_transport_buffer *buffers,
+                                      size_t count) {
+  MG_SESSION_STATS_ADD(session, send_calls, 1);
+  if (mg_transport_send_vector(session->transport, buffers, count) != 0) {
+    return MG_ERROR_SEND_FAILED;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    MG_SESSION_STATS_ADD(session, bytes_sent, buffers[i].len);
   }
   return 0;
 }
 
+// Sends the data in full chunks straight from the caller's memory, together
+// with everything waiting in the output buffer, and copies only the last
+// chunk into the buffer. That one may be completed by whatever is written
+// next, and is sent together with the end of message marker.
+static int mg_session_write_raw_direct(mg_session *session, const char *data,
+                                       size_t len) {
+  static const char full_chunk_header[MG_BOLT_CHUNK_HEADER_SIZE] = {'\xFF',
+                                                                    '\xFF'};
+  assert(MG_BOLT_MAX_CHUNK_SIZE == 0xFFFF);
+
+  mg_session_close_chunk(session);
+  mg_transport_buffer buffers[MG_TRANSPORT_MAX_BUFFERS];
+  size_t count = 0;
+  size_t pending = session->out_begin - MG_BOLT_CHUNK_HEADER_SIZE;
+  if (pending) {
+    buffers[count].data = session->out_buffer;
+    buffers[count].len = pending;
+    ++count;
+  }
+  while (len > MG_BOLT_MAX_CHUNK_SIZE) {
+    buffers[count].data = full_chunk_header;
+    buffers[count].len = MG_BOLT_CHUNK_HEADER_SIZE;
+    buffers[count + 1].data = data;
+    buffers[count + 1].len = MG_BOLT_MAX_CHUNK_SIZE;
+    count += 2;
+    MG_SESSION_STATS_ADD(session, chunks_sent, 1);
+    data += MG_BOLT_MAX_CHUNK_SIZE;
+    len -= MG_BOLT_MAX_CHUNK_SIZE;
+    if (count + 2 > MG_TRANSPORT_MAX_BUFFERS || len <= MG_BOLT_MAX_CHUNK_SIZE) {
+      if (mg_session_send_raw_vector(session, buffers, count) != 0) {
+        mg_session_set_error(session, "failed to send chunk data");
+        return MG_ERROR_SEND_FAILED;
+      }
+      count = 0;
+    }
+  }
+  session->out_begin = MG_BOLT_CHUNK_HEADER_SIZE;
+  session->out_end = session->out_begin;
+  return mg_session_write_raw(session, data, len);
+}
+
 int mg_session_write_raw(mg_session *session, const char *data, size_t len) {
+  // Non-blocking sessions may have to keep unsent data around after the call
+  // returns, so they always copy it.
+  if (len > MG_BOLT_MAX_CHUNK_SIZE && !session->nonblocking &&
+      session->transport->send_vector) {
+    return mg_session_write_raw_direct(session, data, len);
+  }
   size_t sent = 0;
   while (sent < len) {
-    size_t buffer_free = session->out_capacity - session->out_end;
-    if (len - sent >= buffer_free) {
-      memcpy(session->out_buffer + session->out_end, data + sent, buffer_free);
-      session->out_end = session->out_capacity;
-      sent += buffer_free;
-      {
-        int status = mg_session_flush_chunk(session);
-        if (status != 0) {
-          return status;
-        }
-      }
-    } else {
-      memcpy(session->out_buffer + session->out_end, data + sent, len - sent);
-      session->out_end += len - sent;
-      sent = len;
+    size_t chunk_end = session->out_begin + MG_BOLT_MAX_CHUNK_SIZE;
+    if (chunk_end > session->out_capacity) {
+      chunk_end = session->out_capacity;
+    }
+    if (session->out_end >= chunk_end) {
+      MG_RETURN_IF_FAILED(mg_session_flush(session));
+      continue;
     }
+    size_t now = chunk_end - session->out_end;
+    if (now > len - sent) {
+      now = len - sent;
+    }
+    memcpy(session->out_buffer + session->out_end, data + sent, now);
+    session->out_end += now;
+    sent += now;
   }
   return 0;
 }
@@ -230,43 +467,498 @@ int mg_session_ensure_space_for_chunk(mg_session *session, size_t chunk_size) {
   return 0;
 }
 
+// Longest wait for the socket between checks whether the query was cancelled.
+#define MG_SESSION_CANCEL_CHECK_MS 50
+
+// Returns MG_ERROR_CANCELLED if `mg_session_cancel` was called since the
+// current query started, MG_ERROR_TIMEOUT if its deadline passed, and 0
+// otherwise, in which case `*wait_ms` is set to how long the socket can be
+// waited for before checking again.
+static int mg_session_check_interrupted(mg_session *session, int *wait_ms) {
+  long cancel_requests = MG_ATOMIC_LOAD(&session->cancel_requests);
+  if (cancel_requests != session->cancels_handled) {
+    session->cancels_handled = cancel_requests;
+    mg_session_set_error(session, "query cancelled");
+    return MG_ERROR_CANCELLED;
+  }
+  *wait_ms = MG_SESSION_CANCEL_CHECK_MS;
+  if (session->deadline_ns) {
+    uint64_t now = mg_clock_ns();
+    if (now >= session->deadline_ns) {
+      mg_session_set_error(session, "query timed out");
+      return MG_ERROR_TIMEOUT;
+    }
+    uint64_t left_ms = (session->deadline_ns - now + 999999) / 1000000;
+    if (left_ms < (uint64_t)*wait_ms) {
+      *wait_ms = (int)left_ms;
+    }
+  }
+  return 0;
+}
+
+// Receives at most `len` bytes like `mg_transport_recv_some`, but gives up
+// waiting for them once the query is cancelled or times out. The socket of a
+// session with a query timeout is non-blocking, so the wait happens here.
+static int mg_session_recv_interruptible(mg_session *session, char *buf,
+                                         size_t len, size_t *received) {
+  while (1) {
+    ssize_t now = mg_transport_try_recv(session->transport, buf, len);
+    if (now >= 0) {
+      *received = (size_t)now;
+      return 0;
+    }
+    if (now != MG_TRANSPORT_WANT_READ && now != MG_TRANSPORT_WANT_WRITE) {
+      return MG_ERROR_RECV_FAILED;
+    }
+    int wait_ms;
+    MG_RETURN_IF_FAILED(mg_session_check_interrupted(session, &wait_ms));
+    struct pollfd p;
+    p.fd = session->sockfd;
+    p.events = now == MG_TRANSPORT_WANT_READ ? POLLIN : POLLOUT;
+    p.revents = 0;
+    if (mg_socket_poll(&p, 1, wait_ms) < 0 && errno != EINTR) {
+      return MG_ERROR_RECV_FAILED;
+    }
+  }
+}
+
+int mg_session_read_raw(mg_session *session, char *buf, size_t len) {
+  size_t received = 0;
+  while (received < len) {
+    size_t buffered = session->read_end - session->read_begin;
+    if (buffered > 0) {
+      size_t now = len - received < buffered ? len - received : buffered;
+      memcpy(buf + received, session->read_buffer + session->read_begin, now);
+      session->read_begin += now;
+      received += now;
+      continue;
+    }
+    uint64_t wait_start = session->collect_stats ? mg_clock_ns() : 0;
+    mg_transport_suspend_until_ready_to_read(session->transport);
+    size_t remaining = len - received;
+    // There's no point in buffering data which is going to be copied out right
+    // away, so big reads go directly to the destination.
+    int direct = remaining >= session->read_capacity;
+    char *dest = direct ? buf + received : session->read_buffer;
+    size_t dest_len = direct ? remaining : session->read_capacity;
+    ssize_t now;
+    if (session->query_timeout > 0 && session->sockfd >= 0) {
+      size_t now_received;
+      int status = mg_session_recv_interruptible(session, dest, dest_len,
+                                                 &now_received);
+      if (status != 0) {
+        session->message_started |= received > 0;
+        return status;
+      }
+      now = (ssize_t)now_received;
+    } else {
+      now = mg_transport_recv_some(session->transport, dest, dest_len);
+    }
+    MG_SESSION_STATS_ADD(session, read_wait_ns, mg_clock_ns() - wait_start);
+    MG_SESSION_STATS_ADD(session, recv_calls, 1);
+    if (now < 0) {
+      return MG_ERROR_RECV_FAILED;
+    }
+    MG_SESSION_STATS_ADD(session, bytes_received, (uint64_t)now);
+    if (direct) {
+      received += (size_t)now;
+    } else {
+      session->read_begin = 0;
+      session->read_end = (size_t)now;
+    }
+  }
+  return 0;
+}
+
+// Checks whether reading failed because the query was interrupted, in which
+// case the error is already set.
+static int mg_session_read_interrupted(int status) {
+  return status == MG_ERROR_TIMEOUT || status == MG_ERROR_CANCELLED;
+}
+
+void mg_session_fail(mg_session *session, int status) {
+  int skipped = session->interrupted && mg_session_read_interrupted(status);
+  session->interrupted = 0;
+  if (!skipped) {
+    mg_session_invalidate(session);
+  }
+}
+
 int mg_session_read_chunk(mg_session *session) {
   uint16_t chunk_size;
-  mg_transport_suspend_until_ready_to_read(session->transport);
-  if (mg_transport_recv(session->transport, (char *)&chunk_size, 2) != 0) {
+  int status = mg_session_read_raw(session, (char *)&chunk_size, 2);
+  if (status != 0) {
+    if (mg_session_read_interrupted(status)) {
+      return status;
+    }
     mg_session_set_error(session, "failed to receive chunk size");
     return MG_ERROR_RECV_FAILED;
   }
+  session->message_started = 1;
   chunk_size = be16toh(chunk_size);
   if (chunk_size == 0) {
     return 0;
   }
-  {
-    int status = mg_session_ensure_space_for_chunk(session, chunk_size);
-    if (status != 0) {
+  if (session->max_message_size &&
+      session->in_end + chunk_size > session->max_message_size) {
+    mg_session_set_error(session,
+                         "message exceeds the maximum size of %zu bytes",
+                         session->max_message_size);
+    return MG_ERROR_SIZE_EXCEEDED;
+  }
+  status = mg_session_ensure_space_for_chunk(session, chunk_size);
+  if (status != 0) {
+    return status;
+  }
+  status = mg_session_read_raw(session, session->in_buffer + session->in_end,
+                               chunk_size);
+  if (status != 0) {
+    if (mg_session_read_interrupted(status)) {
       return status;
     }
-  }
-  mg_transport_suspend_until_ready_to_read(session->transport);
-  if (mg_transport_recv(session->transport,
-                        session->in_buffer + session->in_end,
-                        chunk_size) != 0) {
     mg_session_set_error(session, "failed to receive chunk data");
     return MG_ERROR_RECV_FAILED;
   }
   session->in_end += chunk_size;
+  MG_SESSION_STATS_ADD(session, chunks_received, 1);
   return 1;
 }
 
-int mg_session_receive_message(mg_session *session) {
-  // At this point, we reset the session decoder allocator and all objects from
-  // the previous message are lost.
-  mg_linear_allocator_reset((mg_linear_allocator *)session->decoder_allocator);
+// Gives the memory of grown input and read buffers back once enough small
+// messages were received in a row. With decoding threads, the session reads
+// into the buffers of the pool in turn, and each of them shrinks the next time
+// a message is read into it.
+static void mg_session_shrink_buffers(mg_session *session) {
+  if (session->shrink_after <= 0 ||
+      session->small_messages < session->shrink_after) {
+    return;
+  }
+  if (session->in_capacity > MG_SESSION_IN_BUFFER_SIZE) {
+    char *new_in_buffer = mg_allocator_realloc(
+        session->allocator, session->in_buffer, MG_SESSION_IN_BUFFER_SIZE);
+    // If it can't be shrunk, the big buffer is still good.
+    if (new_in_buffer) {
+      session->in_buffer = new_in_buffer;
+      session->in_capacity = MG_SESSION_IN_BUFFER_SIZE;
+    }
+  }
+  size_t buffered = session->read_end - session->read_begin;
+  if (session->read_capacity > MG_SESSION_READ_BUFFER_SIZE &&
+      buffered <= MG_SESSION_READ_BUFFER_SIZE) {
+    memmove(session->read_buffer, session->read_buffer + session->read_begin,
+            buffered);
+    session->read_begin = 0;
+    session->read_end = buffered;
+    char *new_read_buffer = mg_allocator_realloc(
+        session->allocator, session->read_buffer, MG_SESSION_READ_BUFFER_SIZE);
+    if (new_read_buffer) {
+      session->read_buffer = new_read_buffer;
+      session->read_capacity = MG_SESSION_READ_BUFFER_SIZE;
+    }
+  }
+}
+
+// Counts the received response summaries, see `mg_session_skip_interrupted`.
+static void mg_session_count_response(mg_session *session) {
+  if (session->in_end < 2 || session->responses_pending == 0) {
+    return;
+  }
+  uint8_t signature = (uint8_t)session->in_buffer[1];
+  if (signature == MG_SIGNATURE_MESSAGE_SUCCESS ||
+      signature == MG_SIGNATURE_MESSAGE_FAILURE ||
+      signature == MG_SIGNATURE_MESSAGE_IGNORED) {
+    --session->responses_pending;
+  }
+}
+
+int mg_session_read_message_chunks(mg_session *session) {
+  mg_session_shrink_buffers(session);
+  session->interrupted = 0;
+  session->read_scanned = 0;
+  session->read_scanned_size = 0;
   session->in_end = 0;
   session->in_cursor = 0;
-  int status;
-  do {
-    status = mg_session_read_chunk(session);
-  } while (status == 1);
+  session->message_started = 0;
+  int status = 0;
+  // Messages that are already buffered don't wait for the socket, so running
+  // queries are also checked between them.
+  int wait_ms;
+  if (session->deadline_ns || MG_ATOMIC_LOAD(&session->cancel_requests) !=
+                                  session->cancels_handled) {
+    status = mg_session_check_interrupted(session, &wait_ms);
+  }
+  if (status == 0) {
+    do {
+      status = mg_session_read_chunk(session);
+    } while (status == 1);
+  }
+  if (status == 0) {
+    mg_session_count_response(session);
+    if (session->in_end > MG_SESSION_IN_BUFFER_SIZE) {
+      session->small_messages = 0;
+    } else if (session->small_messages < INT_MAX) {
+      ++session->small_messages;
+    }
+  } else if (mg_session_read_interrupted(status)) {
+    session->interrupt_pending = !session->message_started;
+  }
   return status;
 }
+
+void mg_session_reset_decoder_allocator(mg_session *session) {
+  mg_linear_allocator *allocator =
+      (mg_linear_allocator *)session->decoder_allocator;
+  MG_SESSION_STATS_ADD(session, decoder_bytes_allocated,
+                       mg_linear_allocator_allocated(allocator));
+  mg_linear_allocator_reset(allocator);
+}
+
+static int mg_session_receive_message_now(mg_session *session) {
+  // At this point, we reset the session decoder allocator and all objects from
+  // the previous message are lost.
+  mg_session_reset_decoder_allocator(session);
+  return mg_session_read_message_chunks(session);
+}
+
+// Checks whether the received message is a response to a RESET sent after a
+// failure (IGNORED for the requests sent before it, then SUCCESS), which nobody
+// is waiting for. Returns 1 if it is, 0 if it's a regular message.
+static int mg_session_skip_reset_response(mg_session *session) {
+  if (!session->reset_pending) {
+    return 0;
+  }
+  if (session->in_end < 2) {
+    mg_session_set_error(session, "unexpected message type");
+    return MG_ERROR_PROTOCOL_VIOLATION;
+  }
+  uint8_t signature = (uint8_t)session->in_buffer[1];
+  if (signature == MG_SIGNATURE_MESSAGE_IGNORED) {
+    return 1;
+  }
+  if (signature == MG_SIGNATURE_MESSAGE_SUCCESS) {
+    session->reset_pending = 0;
+    return 1;
+  }
+  mg_session_set_error(session, "unexpected message type");
+  return MG_ERROR_PROTOCOL_VIOLATION;
+}
+
+// Skips the rest of the responses after waiting for them was interrupted
+// because of `reason`. RESET makes the server stop, after which it responds
+// to each request sent before it, and finally to RESET. If the responses are
+// skipped in time, the session is ready for the next query and 0 is returned.
+// Otherwise, the session has to be invalidated.
+static int mg_session_skip_interrupted(mg_session *session, int reason) {
+  session->interrupt_pending = 0;
+  int nonblocking = session->nonblocking;
+  session->nonblocking = 0;
+  int status = mg_session_send_reset_message(session);
+  if (status == 0) {
+    status = mg_session_flush(session);
+  }
+  session->nonblocking = nonblocking;
+  if (status != 0) {
+    return status;
+  }
+
+  // Skipping the responses gets the same amount of time as the query had.
+  session->deadline_ns =
+      session->query_timeout > 0
+          ? mg_clock_ns() + (uint64_t)session->query_timeout * 1000000
+          : 0;
+  session->draining = 1;
+  while (status == 0 && session->responses_pending > 0) {
+    status = mg_session_receive_message_now(session);
+  }
+  session->draining = 0;
+  session->deadline_ns = 0;
+  if (status != 0) {
+    if (mg_session_read_interrupted(status)) {
+      mg_session_set_error(session,
+                           "failed to skip responses to interrupted query");
+    }
+    return status;
+  }
+
+  // RESET rolls back the open transaction, if any.
+  session->explicit_transaction = 0;
+  session->query_number = 0;
+  session->pipeline_pending = 0;
+  session->pull_batched = 0;
+  session->reset_pending = 0;
+  session->status = MG_SESSION_READY;
+  mg_session_set_error(session, reason == MG_ERROR_TIMEOUT ? "query timed out"
+                                                           : "query cancelled");
+  return 0;
+}
+
+int mg_session_receive_message(mg_session *session) {
+  if (session->nonblocking) {
+    // Requests that couldn't be sent without blocking have to reach the server
+    // before waiting for its response.
+    session->nonblocking = 0;
+    int status = mg_session_flush(session);
+    session->nonblocking = 1;
+    if (status != 0) {
+      return status;
+    }
+  }
+  while (1) {
+    int status = mg_session_receive_message_now(session);
+    if (status != 0) {
+      if (mg_session_read_interrupted(status) && session->interrupt_pending &&
+          !session->draining) {
+        int reason = status;
+        status = mg_session_skip_interrupted(session, reason);
+        // If the responses were skipped, the session stays usable even though
+        // the call fails with `reason`, see `mg_session_fail`.
+        session->interrupted = status == 0;
+        if (status == 0) {
+          status = reason;
+        }
+      }
+      return status;
+    }
+    status = mg_session_skip_reset_response(session);
+    if (status <= 0) {
+      return status;
+    }
+  }
+}
+
+// Checks whether the read buffer holds a complete message. The size of the
+// message, as far as it is known from the buffered chunk headers, is written
+// to `message_size`. Scanning continues from the chunk where the previous
+// call stopped, so a big message arriving in small pieces is framed in linear
+// time.
+static int mg_session_message_buffered(mg_session *session,
+                                       size_t *message_size) {
+  const size_t buffered = session->read_end - session->read_begin;
+  size_t pos = session->read_scanned;
+  while (pos + MG_BOLT_CHUNK_HEADER_SIZE <= buffered) {
+    uint16_t chunk_size;
+    memcpy(&chunk_size, session->read_buffer + session->read_begin + pos,
+           sizeof(chunk_size));
+    chunk_size = be16toh(chunk_size);
+    if (chunk_size == 0) {
+      *message_size = session->read_scanned_size;
+      return 1;
+    }
+    pos += MG_BOLT_CHUNK_HEADER_SIZE + chunk_size;
+    session->read_scanned = pos;
+    session->read_scanned_size += chunk_size;
+  }
+  *message_size = session->read_scanned_size;
+  return 0;
+}
+
+int mg_session_message_available(mg_session *session) {
+  size_t message_size;
+  while (!mg_session_message_buffered(session, &message_size)) {
+    if (session->sockfd < 0) {
+      return 0;
+    }
+    struct pollfd p;
+    p.fd = session->sockfd;
+    p.events = POLLIN;
+    p.revents = 0;
+    if (mg_socket_poll(&p, 1, 0) <= 0 || !(p.revents & POLLIN)) {
+      return 0;
+    }
+    if (session->read_begin > 0) {
+      memmove(session->read_buffer, session->read_buffer + session->read_begin,
+              session->read_end - session->read_begin);
+      session->read_end -= session->read_begin;
+      session->read_begin = 0;
+    }
+    if (session->read_end == session->read_capacity) {
+      // The message is bigger than the read buffer, it will be read directly.
+      return 0;
+    }
+    ssize_t now = mg_transport_recv_some(
+        session->transport, session->read_buffer + session->read_end,
+        session->read_capacity - session->read_end);
+    MG_SESSION_STATS_ADD(session, recv_calls, 1);
+    if (now < 0) {
+      mg_session_set_error(session, "failed to receive chunk data");
+      return MG_ERROR_RECV_FAILED;
+    }
+    MG_SESSION_STATS_ADD(session, bytes_received, (uint64_t)now);
+    session->read_end += (size_t)now;
+  }
+  return 1;
+}
+
+// Receives whatever is available without blocking until the read buffer holds
+// a complete message. The read buffer grows to fit messages bigger than it, up
+// to the maximum message size.
+static int mg_session_try_buffer_message(mg_session *session) {
+  size_t message_size;
+  while (!mg_session_message_buffered(session, &message_size)) {
+    if (session->max_message_size &&
+        message_size > session->max_message_size) {
+      mg_session_set_error(session,
+                           "message exceeds the maximum size of %zu bytes",
+                           session->max_message_size);
+      return MG_ERROR_SIZE_EXCEEDED;
+    }
+    if (session->read_begin > 0) {
+      memmove(session->read_buffer, session->read_buffer + session->read_begin,
+              session->read_end - session->read_begin);
+      session->read_end -= session->read_begin;
+      session->read_begin = 0;
+    }
+    if (session->read_end == session->read_capacity) {
+      char *new_read_buffer =
+          mg_allocator_realloc(session->allocator, session->read_buffer,
+                               2 * session->read_capacity);
+      if (!new_read_buffer) {
+        mg_session_set_error(session, "failed to enlarge read buffer");
+        return MG_ERROR_OOM;
+      }
+      session->read_buffer = new_read_buffer;
+      session->read_capacity = 2 * session->read_capacity;
+    }
+    ssize_t now = mg_transport_try_recv(
+        session->transport, session->read_buffer + session->read_end,
+        session->read_capacity - session->read_end);
+    MG_SESSION_STATS_ADD(session, recv_calls, 1);
+    if (now == MG_TRANSPORT_WANT_READ) {
+      return MG_WANT_READ;
+    }
+    if (now == MG_TRANSPORT_WANT_WRITE) {
+      return MG_WANT_WRITE;
+    }
+    if (now < 0) {
+      mg_session_set_error(session, "failed to receive chunk data");
+      return MG_ERROR_RECV_FAILED;
+    }
+    MG_SESSION_STATS_ADD(session, bytes_received, (uint64_t)now);
+    session->read_end += (size_t)now;
+  }
+  return 0;
+}
+
+int mg_session_try_receive_message(mg_session *session) {
+  if (!session->nonblocking) {
+    return mg_session_receive_message(session);
+  }
+  while (1) {
+    MG_RETURN_IF_FAILED(mg_session_flush(session));
+    int status = mg_session_try_buffer_message(session);
+    if (status == MG_WANT_READ &&
+        session->out_begin > MG_BOLT_CHUNK_HEADER_SIZE) {
+      // The server can't respond before it gets the rest of the request.
+      status = MG_WANT_WRITE;
+    }
+    if (status != 0) {
+      return status;
+    }
+    // The whole message is buffered, so this doesn't block.
+    MG_RETURN_IF_FAILED(mg_session_receive_message_now(session));
+    status = mg_session_skip_reset_response(session);
+    if (status <= 0) {
+      return status;
+    }
+  }
+}
@@ -20,6 +20,7 @@ extern "C" {
 #endif
 
 #include <stddef.h>
+#include <stdio.h>
 
 #include "mgconstants.h"
 #include "mgmessage.h"
@@ -28,32 +29,107 @@ extern "C" {
 
 #define MG_MAX_ERROR_SIZE 1024
 
+typedef struct mg_lazy_row {
+  mg_session *session;
+  uint32_t size;
+  // Offsets of fields within the session input buffer.
+  size_t *offsets;
+  // Decoded fields, NULL until accessed.
+  mg_value **values;
+} mg_lazy_row;
+
 typedef struct mg_result {
   int status;
   mg_session *session;
   mg_message *message;
+  mg_lazy_row *lazy_row;
+  // Row decoded into the arena of the session, which isn't destroyed with the
+  // result.
+  mg_list *arena_row;
   mg_list *columns;
 } mg_result;
 
+typedef struct mg_prepared_query {
+  // The statement, encoded as a PackStream string.
+  char *data;
+  size_t size;
+} mg_prepared_query;
+
+// Decoders of the graph structures whose layout depends on the protocol
+// version, see `mg_session_set_version`.
+typedef struct mg_structure_decoders {
+  int (*read_node)(mg_session *session, mg_node **node);
+  int (*read_relationship)(mg_session *session, mg_relationship **rel);
+  int (*read_unbound_relationship)(mg_session *session,
+                                   mg_unbound_relationship **rel);
+} mg_structure_decoders;
+
 typedef struct mg_session {
   int status;
 
   int explicit_transaction;
   int query_number;
+  // Number of pipelined queries whose responses haven't been read yet.
+  int pipeline_pending;
+
+  // Number of records requested by each PULL, if positive. Set when results
+  // of the current query are pulled in batches of this size.
+  int64_t fetch_size;
+  int pull_batched;
+  // Set while the rest of the current result is being discarded, see
+  // `mg_session_discard`.
+  int discarding;
+  // Open while the rest of the current result is being written to a file, see
+  // `mg_session_dump`. If writing fails, the rest is discarded instead and
+  // `dump_failed` is set.
+  FILE *dump_file;
+  int dump_failed;
 
   mg_transport *transport;
-
+  // Socket used by the transport, -1 if unknown.
+  int sockfd;
+  // When set, the socket is in non-blocking mode. Output that can't be sent
+  // right away stays in the output buffer, and responses are decoded only once
+  // they're received completely (see `mg_session_try_receive_message`).
+  int nonblocking;
+  // Set when a RESET was sent after a failure, but its response (and the
+  // IGNORED responses to requests sent before it) hasn't been received yet.
+  int reset_pending;
+
+  // Major and minor version of the protocol. Set by
+  // `mg_session_set_version`, together with the decoders for it.
   int version;
+  int minor_version;
+  const mg_structure_decoders *structure_decoders;
 
   char *out_buffer;
   size_t out_begin;
   size_t out_end;
   size_t out_capacity;
+  // When set, messages are kept in the output buffer until
+  // `mg_session_flush` is called (or the buffer fills up).
+  int buffer_messages;
 
   char *in_buffer;
   size_t in_end;
   size_t in_capacity;
   size_t in_cursor;
+  // Receiving a message bigger than this fails, if non-zero.
+  size_t max_message_size;
+  // Grown input and read buffers shrink after this many messages in a row
+  // that fit into their initial size, unless it's not positive.
+  int shrink_after;
+  int small_messages;
+
+  char *read_buffer;
+  size_t read_begin;
+  size_t read_end;
+  size_t read_capacity;
+  // How far the chunk headers of the next message were already scanned while
+  // waiting for all of it, relative to `read_begin`, and the size of the
+  // chunks found so far. Reset when a message is read.
+  size_t read_scanned;
+  size_t read_scanned_size;
 
   mg_result result;
 
@@ -61,20 +137,102 @@ typedef struct mg_session {
 
   mg_allocator *allocator;
   mg_allocator *decoder_allocator;
+  // Result rows are decoded with this allocator instead, if it's set (see
+  // `mg_session_set_arena`).
+  mg_allocator *arena;
+
+  // Threads decoding result rows ahead of `mg_session_fetch`, or NULL.
+  struct mg_decode_pool *decode_pool;
+
+  // Statistics are updated only when `collect_stats` is set.
+  int collect_stats;
+  mg_session_stats stats;
+
+  // Tracing callback, or NULL.
+  mg_trace_callback_type trace_callback;
+  void *trace_data;
+  // Number of RUN messages written, and the number of the query whose
+  // responses are being read.
+  int64_t trace_queries_sent;
+  int64_t trace_query_id;
+  // Set until the first row of the current query is fetched, if traced.
+  int trace_first_record;
+
+  // Waiting for the response to a query fails after `deadline_ns` (see
+  // `mg_clock_ns`) if it isn't 0. Set from `query_timeout`, in milliseconds,
+  // whenever a request is sent (see `mg_session_set_query_timeout`).
+  int query_timeout;
+  uint64_t deadline_ns;
+  // Incremented by `mg_session_cancel`, possibly from another thread. Requests
+  // up to `cancels_handled` were handled already, or made before the current
+  // query started.
+  volatile long cancel_requests;
+  long cancels_handled;
+  // Number of requests sent whose summary (SUCCESS, FAILURE or IGNORED)
+  // hasn't been received yet.
+  int responses_pending;
+  // Set once any part of the message being received was read.
+  int message_started;
+  // Set when waiting for a message was interrupted before any of it was read,
+  // so that the rest of the responses can still be skipped.
+  int interrupt_pending;
+  // Set while the responses are being skipped.
+  int draining;
+  // Set by `mg_session_receive_message` after the responses to an interrupted
+  // query were skipped, so that the failing call doesn't invalidate the
+  // session (see `mg_session_fail`). Cleared when the next message is read.
+  int interrupted;
 } mg_session;
 
+// Adds `value` to the `field` of session statistics, if they're collected.
+// `value` isn't evaluated otherwise.
+#define MG_SESSION_STATS_ADD(session, field, value) \
+  do {                                              \
+    if ((session)->collect_stats) {                 \
+      (session)->stats.field += (value);            \
+    }                                               \
+  } while (0)
+
+// Calls the tracing callback of the session.
+void mg_session_trace(mg_session *session, enum mg_trace_event event,
+                      int64_t query_id);
+
+// Reports a tracing event, if the session is traced.
+#define MG_SESSION_TRACE(session, event, query_id)      \
+  do {                                                  \
+    if ((session)->trace_callback) {                    \
+      mg_session_trace((session), (event), (query_id)); \
+    }                                                   \
+  } while (0)
+
 mg_session *mg_session_init(mg_allocator *allocator);
 
+// Sets the major protocol version of the session and picks the decoders for
+// it. Sessions are initialized with the decoders for Bolt 4.
+void mg_session_set_version(mg_session *session, int version);
+
 void mg_session_invalidate(mg_session *session);
 
+// Invalidates the session after a call failed with `status`, unless the call
+// was interrupted by a query timeout or cancellation and the responses still
+// owed were skipped, which leaves the session ready for the next query.
+void mg_session_fail(mg_session *session, int status);
+
 void mg_session_set_error(mg_session *session, const char *fmt, ...);
 
 void mg_session_destroy(mg_session *session);
 
+// Sends `data` as is, bypassing the output buffer.
+int mg_session_send_raw(mg_session *session, const char *data, size_t len);
+
+// Appends `data` to the current message. Data spanning more than a chunk is
+// sent right away, without copying it, if the transport supports that.
 int mg_session_write_raw(mg_session *session, const char *data, size_t len);
 
 int mg_session_flush_message(mg_session *session);
 
+int mg_session_flush(mg_session *session);
+
 int mg_session_write_uint8(mg_session *session, uint8_t val);
 
 int mg_session_write_uint16(mg_session *session, uint16_t val);
@@ -102,8 +260,27 @@ int mg_session_write_map(mg_session *session, const mg_map *map);
 
 int mg_session_write_value(mg_session *session, const mg_value *value);
 
+int mg_session_read_raw(mg_session *session, char *buf, size_t len);
+
 int mg_session_receive_message(mg_session *session);
 
+// Like `mg_session_receive_message`, but if the session is non-blocking and
+// the message hasn't been received completely yet, returns MG_WANT_READ or
+// MG_WANT_WRITE instead of waiting for it. Nothing is consumed in that case,
+// so the call can be repeated once the socket is ready.
+int mg_session_try_receive_message(mg_session *session);
+
+// Reads the chunks of the next message into the input buffer, without
+// releasing objects decoded from the previous one.
+int mg_session_read_message_chunks(mg_session *session);
+
+// Returns 1 if the next message has been received completely, or can be
+// received without waiting for the server, 0 if it can't.
+int mg_session_message_available(mg_session *session);
+
+// Releases all objects allocated by the decoder allocator.
+void mg_session_reset_decoder_allocator(mg_session *session);
+
 void *mg_session_allocate(mg_session *session, size_t size);
 
 int mg_session_read_integer(mg_session *session, int64_t *val);
@@ -151,6 +328,35 @@ int mg_session_read_value(mg_session *session, mg_value **value);
 
 int mg_session_read_bolt_message(mg_session *session, mg_message **message);
 
+int mg_session_skip_value(mg_session *session);
+
+// Reads the field offsets of a RECORD message without decoding the fields. If
+// the received message isn't a RECORD, `*row` is set to NULL and nothing is
+// read.
+int mg_session_read_lazy_row(mg_session *session, mg_lazy_row **row);
+
+int mg_session_read_lazy_row_value(mg_lazy_row *row, uint32_t pos);
+
+// Returns the type of a field of a lazily decoded row from its marker.
+enum mg_value_type mg_session_lazy_row_field_type(const mg_lazy_row *row,
+                                                  uint32_t pos);
+
+// Read a field of a lazily decoded row without creating an `mg_value`.
+// MG_ERROR_TYPE_MISMATCH is returned, without reading anything, if the field
+// has a different type.
+int mg_session_read_lazy_row_bool(mg_lazy_row *row, uint32_t pos, int *value);
+
+int mg_session_read_lazy_row_integer(mg_lazy_row *row, uint32_t pos,
+                                     int64_t *value);
+
+int mg_session_read_lazy_row_float(mg_lazy_row *row, uint32_t pos,
+                                   double *value);
+
+int mg_session_read_lazy_row_string(mg_lazy_row *row, uint32_t pos,
+                                    mg_string *str);
+
+void mg_lazy_row_destroy_ca(mg_lazy_row *row, mg_allocator *allocator);
+
 // Some of these message types are never sent by client, but send functions are
 // still here for testing.
 int mg_session_send_init_message(mg_session *session, const char *client_name,
@@ -158,11 +364,33 @@ int mg_session_send_init_message(mg_session *session, const char *client_name,
 
 int mg_session_send_hello_message(mg_session *session, const mg_map *extra);
 
+// Sends LOGON, which carries the authentication token since Bolt 5.1.
+int mg_session_send_logon_message(mg_session *session, const mg_map *auth);
+
 int mg_session_send_run_message(mg_session *session, const char *statement,
                                 const mg_map *parameters, const mg_map *extra);
 
+// Same as `mg_session_send_run_message`, with the statement encoded up front.
+int mg_session_send_prepared_run_message(mg_session *session,
+                                         const mg_prepared_query *statement,
+                                         const mg_map *parameters,
+                                         const mg_map *extra);
+
+// Same as `mg_session_send_run_message`, with the parameters written by
+// `write_params` and the statement given either as `statement` or, if it isn't
+// NULL, as `prepared`.
+int mg_session_send_streamed_run_message(mg_session *session,
+                                         const char *statement,
+                                         const mg_prepared_query *prepared,
+                                         mg_param_writer_callback write_params,
+                                         void *params_data,
+                                         const mg_map *extra);
+
 int mg_session_send_pull_message(mg_session *session, const mg_map *extra);
 
+// Sends DISCARD (DISCARD_ALL in Bolt v1, which takes no `extra`).
+int mg_session_send_discard_message(mg_session *session, const mg_map *extra);
+
 int mg_session_send_reset_message(mg_session *session);
 
 int mg_session_send_ack_failure_message(mg_session *session);
@@ -170,6 +398,8 @@ int mg_session_send_ack_failure_message(mg_session *session);
 int mg_session_send_failure_message(mg_session *session,
                                     const mg_map *metadata);
 
+int mg_session_send_ignored_message(mg_session *session);
+
 int mg_session_send_success_message(mg_session *session,
                                     const mg_map *metadata);
 
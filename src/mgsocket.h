@@ -21,22 +21,27 @@ extern "C" {
 
 #ifdef MGCLIENT_ON_APPLE
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
 #include <poll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif  // MGCLIENT_ON_APPLE
 
 #ifdef MGCLIENT_ON_LINUX
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
 #include <poll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif  // MGCLIENT_ON_LINUX
 
@@ -78,6 +83,20 @@ int mg_socket_create_handle_error(int sock, mg_session *session);
 /// error.
 int mg_socket_connect(int sock, const struct sockaddr *addr, socklen_t addrlen);
 
+/// Checks whether the last \ref mg_socket_connect call on a socket in
+/// non-blocking mode failed only because the connection couldn't be
+/// established immediately. Its result is then reported by \ref
+/// mg_socket_connect_result once the socket becomes writable. Has to be called
+/// immediately after the failed connect.
+int mg_socket_connect_in_progress(void);
+
+/// Returns the result of a connection started in non-blocking mode, after the
+/// socket became writable or reported an error.
+///
+/// \return \ref MG_ERROR_SOCKET if the connection failed, in which case the
+/// reason is returned by \ref mg_socket_error, or \ref MG_SUCCESS otherwise.
+int mg_socket_connect_result(int sock);
+
 /// Checks for errors after \ref mg_socket_connect call.
 ///
 /// \param[out] sock    Return value out of \ref mg_socket_create call.
@@ -96,9 +115,27 @@ int mg_socket_options(int sock, mg_session *session);
 /// Sends len bytes from buf to the socket referenced by the sock descriptor.
 ssize_t mg_socket_send(int sock, const void *buf, int len);
 
+/// Sends `count` buffers (at most MG_TRANSPORT_MAX_BUFFERS) to the socket
+/// referenced by the sock descriptor, in a single system call. Returns the
+/// number of bytes sent, which may be fewer than the total, or -1 on failure.
+ssize_t mg_socket_send_vector(int sock, const mg_transport_buffer *buffers,
+                              size_t count);
+
 /// Reads len bytes to buf from the socket referenced by the sock descriptor.
 ssize_t mg_socket_receive(int sock, void *buf, int len);
 
+/// Switches the socket referenced by the sock descriptor to non-blocking mode
+/// if nonblocking is set, or back to blocking mode otherwise.
+///
+/// \return \ref MG_ERROR_SOCKET in case of an error or \ref MG_SUCCESS if
+/// there is no error.
+int mg_socket_set_nonblocking(int sock, int nonblocking);
+
+/// Checks whether the last send or receive call failed only because the socket
+/// is in non-blocking mode and the call would have blocked. Has to be called
+/// immediately after the failed socket function.
+int mg_socket_would_block(void);
+
 /// Waits for one of a set of file descriptors to become ready to perform I/O.
 int mg_socket_poll(struct pollfd *fds, unsigned int nfds, int timeout);
 
@@ -116,6 +153,10 @@ char *mg_socket_error(void);
 /// \ref mg_socket_init function.
 void mg_socket_finalize(void);
 
+/// Returns the time of a monotonic clock, in nanoseconds from an arbitrary
+/// starting point.
+uint64_t mg_clock_ns(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,13 +15,15 @@
 #include "mgtransport.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
-#ifdef MGCLIENT_ON_LINUX
-#ifndef __EMSCRIPTEN__
+#include <sys/stat.h>
+#include <time.h>
+#if !defined(MGCLIENT_ON_WINDOWS) && !defined(__EMSCRIPTEN__)
 #include <pthread.h>
 #endif
-#endif  // MGCLIENT_ON_LINUX
 
 #include "mgallocator.h"
 #include "mgclient.h"
@@ -40,6 +42,34 @@ int mg_transport_recv(mg_transport *transport, char *buf, size_t len) {
   return transport->recv(transport, buf, len);
 }
 
+ssize_t mg_transport_recv_some(mg_transport *transport, char *buf, size_t len) {
+  return transport->recv_some(transport, buf, len);
+}
+
+ssize_t mg_transport_try_send(mg_transport *transport, const char *buf,
+                              size_t len) {
+  if (transport->try_send) {
+    return transport->try_send(transport, buf, len);
+  }
+  if (transport->send(transport, buf, len) != 0) {
+    return -1;
+  }
+  return (ssize_t)len;
+}
+
+ssize_t mg_transport_try_recv(mg_transport *transport, char *buf, size_t len) {
+  if (transport->try_recv) {
+    return transport->try_recv(transport, buf, len);
+  }
+  return mg_transport_recv_some(transport, buf, len);
+}
+
+int mg_transport_send_vector(mg_transport *transport,
+                             const mg_transport_buffer *buffers,
+                             size_t count) {
+  return transport->send_vector(transport, buffers, count);
+}
+
 void mg_transport_destroy(mg_transport *transport) {
   transport->destroy(transport);
 }
@@ -66,6 +96,10 @@ int mg_raw_transport_init(int sockfd, mg_raw_transport **transport,
   ttransport->sockfd = sockfd;
   ttransport->send = mg_raw_transport_send;
   ttransport->recv = mg_raw_transport_recv;
+  ttransport->recv_some = mg_raw_transport_recv_some;
+  ttransport->try_send = mg_raw_transport_try_send;
+  ttransport->try_recv = mg_raw_transport_try_recv;
+  ttransport->send_vector = mg_raw_transport_send_vector;
   ttransport->destroy = mg_raw_transport_destroy;
   ttransport->suspend_until_ready_to_read =
       mg_raw_transport_suspend_until_ready_to_read;
@@ -76,6 +110,16 @@ int mg_raw_transport_init(int sockfd, mg_raw_transport **transport,
   return 0;
 }
 
+// Blocking operations on a socket in non-blocking mode wait here until the
+// socket becomes ready.
+static int mg_socket_wait(int sockfd, short events) {
+  struct pollfd p;
+  p.fd = sockfd;
+  p.events = events;
+  p.revents = 0;
+  return mg_socket_poll(&p, 1, -1) < 0 ? -1 : 0;
+}
+
 int mg_raw_transport_send(struct mg_transport *transport, const char *buf,
                           size_t len) {
   int sockfd = ((mg_raw_transport *)transport)->sockfd;
@@ -85,6 +129,9 @@ int mg_raw_transport_send(struct mg_transport *transport, const char *buf,
     ssize_t sent_now =
         mg_socket_send(sockfd, buf + total_sent, len - total_sent);
     if (sent_now == -1) {
+      if (mg_socket_would_block() && mg_socket_wait(sockfd, POLLOUT) == 0) {
+        continue;
+      }
       perror("mg_raw_transport_send");
       return -1;
     }
@@ -106,6 +153,9 @@ int mg_raw_transport_recv(struct mg_transport *transport, char *buf,
       return -1;
     }
     if (received_now == -1) {
+      if (mg_socket_would_block() && mg_socket_wait(sockfd, POLLIN) == 0) {
+        continue;
+      }
       perror("mg_raw_transport_recv");
       return -1;
     }
@@ -114,6 +164,121 @@ int mg_raw_transport_recv(struct mg_transport *transport, char *buf,
   return 0;
 }
 
+ssize_t mg_raw_transport_recv_some(struct mg_transport *transport, char *buf,
+                                   size_t len) {
+  int sockfd = ((mg_raw_transport *)transport)->sockfd;
+  // Receive size is passed down as an int, so we cap it here.
+  int max_len = len > INT_MAX ? INT_MAX : (int)len;
+  while (1) {
+    ssize_t received = mg_socket_receive(sockfd, buf, max_len);
+    if (received == 0) {
+      // Server closed the connection.
+      fprintf(stderr,
+              "mg_raw_transport_recv_some: connection closed by server\n");
+      return -1;
+    }
+    if (received == -1) {
+      if (mg_socket_would_block() && mg_socket_wait(sockfd, POLLIN) == 0) {
+        continue;
+      }
+      perror("mg_raw_transport_recv_some");
+      return -1;
+    }
+#ifdef __EMSCRIPTEN__
+    // A receive returns at most one WebSocket message, so the others which
+    // have already arrived are taken along instead of suspending for each.
+    received += (ssize_t)mg_wasm_receive_queued(sockfd, buf + received,
+                                                (size_t)(max_len - received));
+#endif
+    return received;
+  }
+}
+
+ssize_t mg_raw_transport_try_send(struct mg_transport *transport,
+                                  const char *buf, size_t len) {
+  int sockfd = ((mg_raw_transport *)transport)->sockfd;
+  int max_len = len > INT_MAX ? INT_MAX : (int)len;
+  ssize_t sent = mg_socket_send(sockfd, buf, max_len);
+  if (sent == -1) {
+    if (mg_socket_would_block()) {
+      return MG_TRANSPORT_WANT_WRITE;
+    }
+    perror("mg_raw_transport_try_send");
+    return -1;
+  }
+  return sent;
+}
+
+ssize_t mg_raw_transport_try_recv(struct mg_transport *transport, char *buf,
+                                  size_t len) {
+  int sockfd = ((mg_raw_transport *)transport)->sockfd;
+  int max_len = len > INT_MAX ? INT_MAX : (int)len;
+  ssize_t received = mg_socket_receive(sockfd, buf, max_len);
+  if (received == 0) {
+    // Server closed the connection.
+    fprintf(stderr, "mg_raw_transport_try_recv: connection closed by server\n");
+    return -1;
+  }
+  if (received == -1) {
+    if (mg_socket_would_block()) {
+      return MG_TRANSPORT_WANT_READ;
+    }
+    perror("mg_raw_transport_try_recv");
+    return -1;
+  }
+  return received;
+}
+
+// Sends all of the buffers to `sockfd`, as few system calls as the socket
+// allows. Errors are reported on behalf of `caller`.
+static int mg_socket_send_all_vector(int sockfd,
+                                     const mg_transport_buffer *buffers,
+                                     size_t count, const char *caller) {
+  assert(count <= MG_TRANSPORT_MAX_BUFFERS);
+  mg_transport_buffer remaining[MG_TRANSPORT_MAX_BUFFERS];
+  memcpy(remaining, buffers, count * sizeof(mg_transport_buffer));
+  mg_transport_buffer *next = remaining;
+  while (count > 0) {
+    ssize_t sent_now = mg_socket_send_vector(sockfd, next, count);
+    if (sent_now == -1) {
+      if (mg_socket_would_block() && mg_socket_wait(sockfd, POLLOUT) == 0) {
+        continue;
+      }
+      perror(caller);
+      return -1;
+    }
+    size_t sent = (size_t)sent_now;
+    while (count > 0 && sent >= next->len) {
+      sent -= next->len;
+      ++next;
+      --count;
+    }
+    if (count > 0) {
+      next->data += sent;
+      next->len -= sent;
+    }
+  }
+  return 0;
+}
+
+int mg_raw_transport_send_vector(struct mg_transport *transport,
+                                 const mg_transport_buffer *buffers,
+                                 size_t count) {
+  return mg_socket_send_all_vector(((mg_raw_transport *)transport)->sockfd,
+                                   buffers, count,
+                                   "mg_raw_transport_send_vector");
+}
+
+#ifndef MGCLIENT_HAS_IO_URING
+int mg_io_uring_transport_init(int sockfd, mg_io_uring_transport **transport,
+                               mg_allocator *allocator) {
+  (void)sockfd;
+  (void)transport;
+  (void)allocator;
+  return MG_ERROR_UNIMPLEMENTED;
+}
+#endif
+
 void mg_raw_transport_destroy(struct mg_transport *transport) {
   mg_raw_transport *self = (mg_raw_transport *)transport;
   if (mg_socket_close(self->sockfd) != 0) {
@@ -174,51 +339,315 @@ static void mg_openssl_init(void) {
 #endif
 }
 
-int mg_secure_transport_init(int sockfd, const char *cert_file,
-                             const char *key_file,
-                             mg_secure_transport **transport,
-                             mg_allocator *allocator) {
-  mg_openssl_init();
+// SSL contexts are shared by all connections using the same client
+// certificate, so that the certificate files are loaded only once (and again
+// when they change), and each of them keeps the latest TLS session per server
+// so that reconnects resume it with an abbreviated handshake. They live until
+// `mg_finalize`.
+
+#define MG_SSL_MAX_CACHED_SESSIONS 64
+
+typedef struct mg_ssl_cached_session {
+  struct sockaddr_storage peer;
+  socklen_t peer_len;
+  SSL_SESSION *session;
+  struct mg_ssl_cached_session *next;
+} mg_ssl_cached_session;
+
+// Modification time and size of a certificate file, used to notice that it
+// was replaced.
+typedef struct mg_ssl_file_version {
+  time_t mtime;
+  long long size;
+} mg_ssl_file_version;
+
+typedef struct mg_ssl_context {
+  char *cert_file;
+  char *key_file;
+  mg_ssl_file_version cert_version;
+  mg_ssl_file_version key_version;
+  SSL_CTX *ctx;
+  // Most recently stored first.
+  mg_ssl_cached_session *sessions;
+  struct mg_ssl_context *next;
+} mg_ssl_context;
+
+static mg_ssl_context *mg_ssl_contexts = NULL;
+
+#ifdef MGCLIENT_ON_WINDOWS
+static SRWLOCK mg_ssl_contexts_lock = SRWLOCK_INIT;
+
+static void mg_ssl_contexts_acquire(void) {
+  AcquireSRWLockExclusive(&mg_ssl_contexts_lock);
+}
 
-  SSL_CTX *ctx = NULL;
-  SSL *ssl = NULL;
-  BIO *bio = NULL;
+static void mg_ssl_contexts_release(void) {
+  ReleaseSRWLockExclusive(&mg_ssl_contexts_lock);
+}
+#else
+static pthread_mutex_t mg_ssl_contexts_lock = PTHREAD_MUTEX_INITIALIZER;
 
-  int status = 0;
+static void mg_ssl_contexts_acquire(void) {
+  pthread_mutex_lock(&mg_ssl_contexts_lock);
+}
 
-  ERR_clear_error();
+static void mg_ssl_contexts_release(void) {
+  pthread_mutex_unlock(&mg_ssl_contexts_lock);
+}
+#endif
+
+static int mg_ssl_strings_equal(const char *lhs, const char *rhs) {
+  if (!lhs || !rhs) {
+    return lhs == rhs;
+  }
+  return strcmp(lhs, rhs) == 0;
+}
 
+static char *mg_ssl_strdup(const char *str) {
+  if (!str) {
+    return NULL;
+  }
+  size_t len = strlen(str) + 1;
+  char *copy = mg_allocator_malloc(&mg_process_allocator, len);
+  if (copy) {
+    memcpy(copy, str, len);
+  }
+  return copy;
+}
+
+static mg_ssl_file_version mg_ssl_get_file_version(const char *path) {
+  mg_ssl_file_version version = {0, -1};
+  struct stat info;
+  if (path && stat(path, &info) == 0) {
+    version.mtime = info.st_mtime;
+    version.size = (long long)info.st_size;
+  }
+  return version;
+}
+
+static int mg_ssl_file_versions_equal(mg_ssl_file_version lhs,
+                                      mg_ssl_file_version rhs) {
+  return lhs.mtime == rhs.mtime && lhs.size == rhs.size;
+}
+
+static void mg_ssl_context_destroy(mg_ssl_context *context) {
+  while (context->sessions) {
+    mg_ssl_cached_session *cached = context->sessions;
+    context->sessions = cached->next;
+    SSL_SESSION_free(cached->session);
+    mg_allocator_free(&mg_process_allocator, cached);
+  }
+  // Connections which still use the SSL_CTX hold their own references to it.
+  SSL_CTX_free(context->ctx);
+  mg_allocator_free(&mg_process_allocator, context->cert_file);
+  mg_allocator_free(&mg_process_allocator, context->key_file);
+  mg_allocator_free(&mg_process_allocator, context);
+}
+
+static int mg_ssl_get_peer(int sockfd, struct sockaddr_storage *peer,
+                           socklen_t *peer_len) {
+  *peer_len = sizeof(struct sockaddr_storage);
+  memset(peer, 0, sizeof(struct sockaddr_storage));
+  return getpeername(sockfd, (struct sockaddr *)peer, peer_len);
+}
+
+static mg_ssl_cached_session **mg_ssl_find_session(
+    mg_ssl_context *context, const struct sockaddr_storage *peer,
+    socklen_t peer_len) {
+  mg_ssl_cached_session **it = &context->sessions;
+  while (*it && ((*it)->peer_len != peer_len ||
+                 memcmp(&(*it)->peer, peer, (size_t)peer_len) != 0)) {
+    it = &(*it)->next;
+  }
+  return it;
+}
+
+// Called by OpenSSL whenever the server issues a new session, which for TLS
+// 1.3 happens after the handshake, when the session ticket is received.
+static int mg_ssl_new_session(SSL *ssl, SSL_SESSION *session) {
+  struct sockaddr_storage peer;
+  socklen_t peer_len;
+  if (mg_ssl_get_peer(SSL_get_fd(ssl), &peer, &peer_len) != 0) {
+    return 0;
+  }
+  mg_ssl_contexts_acquire();
+  // The context is gone if its certificate was replaced in the meantime.
+  SSL_CTX *ctx = SSL_get_SSL_CTX(ssl);
+  mg_ssl_context *context = mg_ssl_contexts;
+  while (context && context->ctx != ctx) {
+    context = context->next;
+  }
+  if (!context) {
+    mg_ssl_contexts_release();
+    return 0;
+  }
+  mg_ssl_cached_session **it = mg_ssl_find_session(context, &peer, peer_len);
+  mg_ssl_cached_session *cached = *it;
+  if (cached) {
+    *it = cached->next;
+    SSL_SESSION_free(cached->session);
+  } else {
+    cached = mg_allocator_malloc(&mg_process_allocator,
+                                 sizeof(mg_ssl_cached_session));
+    if (!cached) {
+      mg_ssl_contexts_release();
+      return 0;
+    }
+    memcpy(&cached->peer, &peer, sizeof(peer));
+    cached->peer_len = peer_len;
+  }
+  cached->session = session;
+  cached->next = context->sessions;
+  context->sessions = cached;
+
+  size_t count = 0;
+  for (it = &context->sessions; *it; it = &(*it)->next) {
+    if (++count > MG_SSL_MAX_CACHED_SESSIONS) {
+      SSL_SESSION_free((*it)->session);
+      mg_allocator_free(&mg_process_allocator, *it);
+      *it = NULL;
+      break;
+    }
+  }
+  mg_ssl_contexts_release();
+  // Returning 1 keeps the reference to the session.
+  return 1;
+}
+
+static mg_ssl_context *mg_ssl_context_make(const char *cert_file,
+                                           const char *key_file) {
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
-  ctx = SSL_CTX_new(SSLv23_client_method());
+  SSL_CTX *ctx = SSL_CTX_new(SSLv23_client_method());
 #else
-  ctx = SSL_CTX_new(TLS_client_method());
+  SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
 #endif
-
   if (!ctx) {
-    status = MG_ERROR_SSL_ERROR;
-    goto failure;
+    return NULL;
   }
 
   if (cert_file && key_file) {
     if (SSL_CTX_use_certificate_chain_file(ctx, cert_file) != 1 ||
         SSL_CTX_use_PrivateKey_file(ctx, key_file, SSL_FILETYPE_PEM) != 1) {
-      status = MG_ERROR_SSL_ERROR;
-      goto failure;
+      SSL_CTX_free(ctx);
+      return NULL;
     }
   }
 
   SSL_CTX_set_options(ctx, SSL_OP_NO_SSLv3);
-  ssl = SSL_new(ctx);
+  // Sessions are stored by the server they were established with rather than
+  // by session ID, which is what OpenSSL's internal cache would do.
+  SSL_CTX_set_session_cache_mode(
+      ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, mg_ssl_new_session);
+
+  mg_ssl_context *context =
+      mg_allocator_malloc(&mg_process_allocator, sizeof(mg_ssl_context));
+  if (!context) {
+    SSL_CTX_free(ctx);
+    return NULL;
+  }
+  context->cert_file = mg_ssl_strdup(cert_file);
+  context->key_file = mg_ssl_strdup(key_file);
+  if ((cert_file && !context->cert_file) || (key_file && !context->key_file)) {
+    mg_allocator_free(&mg_process_allocator, context->cert_file);
+    mg_allocator_free(&mg_process_allocator, context->key_file);
+    mg_allocator_free(&mg_process_allocator, context);
+    SSL_CTX_free(ctx);
+    return NULL;
+  }
+  context->cert_version = mg_ssl_get_file_version(cert_file);
+  context->key_version = mg_ssl_get_file_version(key_file);
+  context->ctx = ctx;
+  context->sessions = NULL;
+  context->next = NULL;
+  return context;
+}
+
+// Creates an SSL object for a new connection to the server on the other end
+// of `sockfd`, set up to resume the previous session with it if there is one.
+static SSL *mg_ssl_new(int sockfd, const char *cert_file,
+                       const char *key_file) {
+  mg_ssl_contexts_acquire();
+  mg_ssl_context **it = &mg_ssl_contexts;
+  while (*it && !(mg_ssl_strings_equal((*it)->cert_file, cert_file) &&
+                  mg_ssl_strings_equal((*it)->key_file, key_file))) {
+    it = &(*it)->next;
+  }
+  mg_ssl_context *context = *it;
+  if (context &&
+      (!mg_ssl_file_versions_equal(context->cert_version,
+                                   mg_ssl_get_file_version(cert_file)) ||
+       !mg_ssl_file_versions_equal(context->key_version,
+                                   mg_ssl_get_file_version(key_file)))) {
+    *it = context->next;
+    mg_ssl_context_destroy(context);
+    context = NULL;
+  }
+  if (!context) {
+    context = mg_ssl_context_make(cert_file, key_file);
+    if (!context) {
+      mg_ssl_contexts_release();
+      return NULL;
+    }
+    context->next = mg_ssl_contexts;
+    mg_ssl_contexts = context;
+  }
+
+  SSL *ssl = SSL_new(context->ctx);
+  struct sockaddr_storage peer;
+  socklen_t peer_len;
+  if (ssl && mg_ssl_get_peer(sockfd, &peer, &peer_len) == 0) {
+    mg_ssl_cached_session *cached =
+        *mg_ssl_find_session(context, &peer, peer_len);
+    if (cached) {
+      SSL_set_session(ssl, cached->session);
+    }
+  }
+  mg_ssl_contexts_release();
+  return ssl;
+}
 
+void mg_secure_transport_finalize(void) {
+  mg_ssl_contexts_acquire();
+  while (mg_ssl_contexts) {
+    mg_ssl_context *context = mg_ssl_contexts;
+    mg_ssl_contexts = context->next;
+    mg_ssl_context_destroy(context);
+  }
+  mg_ssl_contexts_release();
+}
+
+int mg_secure_transport_init(int sockfd, const char *cert_file,
+                             const char *key_file,
+                             mg_secure_transport **transport,
+                             mg_allocator *allocator, int ktls) {
+  mg_openssl_init();
+
+  SSL *ssl = NULL;
+  BIO *bio = NULL;
+
+  int status = 0;
+
+  ERR_clear_error();
+
+  ssl = mg_ssl_new(sockfd, cert_file, key_file);
   if (!ssl) {
     status = MG_ERROR_SSL_ERROR;
     goto failure;
   }
-
-  // SSL_CTX object is reference counted, we're destroying this local reference,
-  // but reference from SSL object stays.
-  SSL_CTX_free(ctx);
-  ctx = NULL;
+  // Non-blocking sends retry with whatever is left in the session output
+  // buffer, which may have moved or grown in the meantime.
+  SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                        SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SSL_OP_ENABLE_KTLS
+  if (ktls) {
+    // OpenSSL hands the keys over to the kernel once the handshake is done,
+    // if both the kernel and the negotiated cipher support it.
+    SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+  }
+#else
+  (void)ktls;
+#endif
 
   bio = BIO_new_socket(sockfd, BIO_NOCLOSE);
   if (!bio) {
@@ -268,10 +697,26 @@ int mg_secure_transport_init(int sockfd, const char *cert_file,
       hex_encode(peer_pubkey_fp, peer_pubkey_fp_len, allocator);
   ttransport->send = mg_secure_transport_send;
   ttransport->recv = mg_secure_transport_recv;
+  ttransport->recv_some = mg_secure_transport_recv_some;
+  ttransport->try_send = mg_secure_transport_try_send;
+  ttransport->try_recv = mg_secure_transport_try_recv;
+  ttransport->send_vector = NULL;
   ttransport->suspend_until_ready_to_read = NULL;
   ttransport->suspend_until_ready_to_write = NULL;
   ttransport->destroy = mg_secure_transport_destroy;
   ttransport->allocator = allocator;
+  ttransport->sockfd = sockfd;
+  ttransport->ktls_send = 0;
+  ttransport->ktls_recv = 0;
+#ifdef BIO_get_ktls_send
+  ttransport->ktls_send = BIO_get_ktls_send(SSL_get_wbio(ssl));
+  ttransport->ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+#endif
+  // Without kTLS the data is encrypted into OpenSSL's own buffers, so there
+  // is nothing to gain from sending it straight from the caller's memory.
+  if (ttransport->ktls_send) {
+    ttransport->send_vector = mg_secure_transport_send_vector;
+  }
   *transport = ttransport;
 
   return 0;
@@ -280,7 +725,6 @@ failure:
   if (status == MG_ERROR_SSL_ERROR) {
     ERR_print_errors_cb(print_ssl_error, "mg_secure_transport_init");
   }
-  SSL_CTX_free(ctx);
   if (ssl) {
     // If SSL object was successfuly created, it owns the BIO so we don't need
     // to destroy it.
@@ -292,23 +736,54 @@ failure:
   return status;
 }
 
+// Waits until the socket is ready for the operation OpenSSL asked for with
+// `ssl_error`.
+static int mg_secure_transport_wait(BIO *bio, int ssl_error) {
+  int sockfd;
+  if (BIO_get_fd(bio, &sockfd) < 0) {
+    abort();
+  }
+  return mg_socket_wait(sockfd,
+                        ssl_error == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT);
+}
+
+// With kernel TLS, application data is encrypted and decrypted by the kernel,
+// so it can go through plain socket calls, which also read data of several
+// records at once. A record of another type (alert, session ticket, key
+// update) makes a plain read fail with EIO and stays queued for SSL_read,
+// which knows how to handle it. Data already buffered by OpenSSL has to be
+// consumed through SSL_read as well.
+static int mg_secure_transport_ktls_readable(mg_secure_transport *self) {
+  return self->ktls_recv && SSL_pending(self->ssl) == 0;
+}
+
 int mg_secure_transport_send(mg_transport *transport, const char *buf,
                              size_t len) {
-  SSL *ssl = ((mg_secure_transport *)transport)->ssl;
-  BIO *bio = ((mg_secure_transport *)transport)->bio;
+  mg_secure_transport *self = (mg_secure_transport *)transport;
+  SSL *ssl = self->ssl;
+  BIO *bio = self->bio;
   size_t total_sent = 0;
   while (total_sent < len) {
+    if (self->ktls_send) {
+      ssize_t sent_now = mg_socket_send(self->sockfd, buf + total_sent,
+                                        (int)(len - total_sent));
+      if (sent_now == -1) {
+        if (mg_socket_would_block() &&
+            mg_socket_wait(self->sockfd, POLLOUT) == 0) {
+          continue;
+        }
+        perror("mg_secure_transport_send");
+        return -1;
+      }
+      total_sent += (size_t)sent_now;
+      continue;
+    }
     ERR_clear_error();
     int sent_now = SSL_write(ssl, buf + total_sent, (int)(len - total_sent));
     if (sent_now <= 0) {
       int err = SSL_get_error(ssl, sent_now);
-      if (err == SSL_ERROR_WANT_READ) {
-        struct pollfd p;
-        if (BIO_get_fd(bio, &p.fd) < 0) {
-          abort();
-        }
-        p.events = POLLIN;
-        if (mg_socket_poll(&p, 1, -1) < 0) {
+      if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+        if (mg_secure_transport_wait(bio, err) != 0) {
           return -1;
         }
         continue;
@@ -317,44 +792,160 @@ int mg_secure_transport_send(mg_transport *transport, const char *buf,
         return -1;
       }
     }
-    assert((size_t)sent_now == len);
     total_sent += (size_t)sent_now;
   }
   return 0;
 }
 
+int mg_secure_transport_send_vector(mg_transport *transport,
+                                    const mg_transport_buffer *buffers,
+                                    size_t count) {
+  // Only used with kTLS, where the kernel encrypts whatever is written to the
+  // socket.
+  mg_secure_transport *self = (mg_secure_transport *)transport;
+  assert(self->ktls_send);
+  return mg_socket_send_all_vector(self->sockfd, buffers, count,
+                                   "mg_secure_transport_send_vector");
+}
+
 int mg_secure_transport_recv(mg_transport *transport, char *buf, size_t len) {
-  SSL *ssl = ((mg_secure_transport *)transport)->ssl;
-  BIO *bio = ((mg_secure_transport *)transport)->bio;
   size_t total_received = 0;
   while (total_received < len) {
-    ERR_clear_error();
-    int received_now =
-        SSL_read(ssl, buf + total_received, (int)(len - total_received));
-    if (received_now <= 0) {
-      int err = SSL_get_error(ssl, received_now);
-      if (err == SSL_ERROR_WANT_READ) {
-        struct pollfd p;
-        if (BIO_get_fd(bio, &p.fd) < 0) {
-          abort();
-        }
-        p.events = POLLIN;
-        if (mg_socket_poll(&p, 1, -1) < 0) {
+    ssize_t received_now = mg_secure_transport_recv_some(
+        transport, buf + total_received, len - total_received);
+    if (received_now < 0) {
+      return -1;
+    }
+    total_received += (size_t)received_now;
+  }
+  return 0;
+}
+
+ssize_t mg_secure_transport_recv_some(mg_transport *transport, char *buf,
+                                      size_t len) {
+  mg_secure_transport *self = (mg_secure_transport *)transport;
+  SSL *ssl = self->ssl;
+  BIO *bio = self->bio;
+  int max_len = len > INT_MAX ? INT_MAX : (int)len;
+  while (1) {
+    if (mg_secure_transport_ktls_readable(self)) {
+      ssize_t received = mg_socket_receive(self->sockfd, buf, max_len);
+      if (received > 0) {
+        return received;
+      }
+      if (received == 0) {
+        // Server closed the connection.
+        fprintf(stderr,
+                "mg_secure_transport_recv_some: connection closed by server\n");
+        return -1;
+      }
+      if (mg_socket_would_block()) {
+        if (mg_socket_wait(self->sockfd, POLLIN) != 0) {
           return -1;
         }
         continue;
-      } else {
-        ERR_print_errors_cb(print_ssl_error, "mg_secure_transport_recv");
+      }
+      if (errno != EIO) {
+        perror("mg_secure_transport_recv_some");
         return -1;
       }
     }
-    total_received += (size_t)received_now;
+    ERR_clear_error();
+    int received = SSL_read(ssl, buf, max_len);
+    if (received > 0) {
+      return received;
+    }
+    int err = SSL_get_error(ssl, received);
+    if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+      if (mg_secure_transport_wait(bio, err) != 0) {
+        return -1;
+      }
+      continue;
+    }
+    ERR_print_errors_cb(print_ssl_error, "mg_secure_transport_recv_some");
+    return -1;
   }
-  return 0;
+}
+
+ssize_t mg_secure_transport_try_send(mg_transport *transport, const char *buf,
+                                     size_t len) {
+  mg_secure_transport *self = (mg_secure_transport *)transport;
+  SSL *ssl = self->ssl;
+  int max_len = len > INT_MAX ? INT_MAX : (int)len;
+  if (self->ktls_send) {
+    ssize_t sent = mg_socket_send(self->sockfd, buf, max_len);
+    if (sent == -1) {
+      if (mg_socket_would_block()) {
+        return MG_TRANSPORT_WANT_WRITE;
+      }
+      perror("mg_secure_transport_try_send");
+      return -1;
+    }
+    return sent;
+  }
+  ERR_clear_error();
+  int sent = SSL_write(ssl, buf, max_len);
+  if (sent > 0) {
+    return sent;
+  }
+  int err = SSL_get_error(ssl, sent);
+  if (err == SSL_ERROR_WANT_READ) {
+    return MG_TRANSPORT_WANT_READ;
+  }
+  if (err == SSL_ERROR_WANT_WRITE) {
+    return MG_TRANSPORT_WANT_WRITE;
+  }
+  ERR_print_errors_cb(print_ssl_error, "mg_secure_transport_try_send");
+  return -1;
+}
+
+ssize_t mg_secure_transport_try_recv(mg_transport *transport, char *buf,
+                                     size_t len) {
+  mg_secure_transport *self = (mg_secure_transport *)transport;
+  SSL *ssl = self->ssl;
+  int max_len = len > INT_MAX ? INT_MAX : (int)len;
+  if (mg_secure_transport_ktls_readable(self)) {
+    ssize_t received = mg_socket_receive(self->sockfd, buf, max_len);
+    if (received > 0) {
+      return received;
+    }
+    if (received == 0) {
+      // Server closed the connection.
+      fprintf(stderr,
+              "mg_secure_transport_try_recv: connection closed by server\n");
+      return -1;
+    }
+    if (mg_socket_would_block()) {
+      return MG_TRANSPORT_WANT_READ;
+    }
+    if (errno != EIO) {
+      perror("mg_secure_transport_try_recv");
+      return -1;
+    }
+  }
+  ERR_clear_error();
+  int received = SSL_read(ssl, buf, max_len);
+  if (received > 0) {
+    return received;
+  }
+  int err = SSL_get_error(ssl, received);
+  if (err == SSL_ERROR_WANT_READ) {
+    return MG_TRANSPORT_WANT_READ;
+  }
+  if (err == SSL_ERROR_WANT_WRITE) {
+    return MG_TRANSPORT_WANT_WRITE;
+  }
+  ERR_print_errors_cb(print_ssl_error, "mg_secure_transport_try_recv");
+  return -1;
 }
 
 void mg_secure_transport_destroy(mg_transport *transport) {
   mg_secure_transport *self = (mg_secure_transport *)transport;
+  // Freeing a connection which wasn't shut down makes OpenSSL discard its
+  // session. Quiet shutdown only marks the connection as such, without
+  // sending anything to a server which may be gone already.
+  SSL_set_quiet_shutdown(self->ssl, 1);
+  SSL_shutdown(self->ssl);
   SSL_free(self->ssl);
   self->bio = NULL;
   self->ssl = NULL;
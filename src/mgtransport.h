@@ -21,6 +21,11 @@ extern "C" {
 
 #include <stddef.h>
 #include <stdio.h>
+#if !defined(_WIN32) || !defined(_MSC_VER)
+#include <sys/types.h>
+#else
+typedef long ssize_t;
+#endif
 
 #ifndef __EMSCRIPTEN__
 #include <openssl/bio.h>
@@ -31,12 +36,31 @@ extern "C" {
 #include "mgallocator.h"
 #include "mgcommon.h"
 
+// Returned by non-blocking transport operations which can't make progress
+// until the socket becomes readable or writable.
+#define MG_TRANSPORT_WANT_READ (-2)
+#define MG_TRANSPORT_WANT_WRITE (-3)
+
+// Most buffers that can be passed to a single `mg_transport_send_vector` call.
+#define MG_TRANSPORT_MAX_BUFFERS 32
+
+// Data sent by `mg_transport_send_vector`, straight from the caller's memory.
+typedef struct mg_transport_buffer {
+  const char *data;
+  size_t len;
+} mg_transport_buffer;
+
 typedef struct mg_transport {
   int (*send)(struct mg_transport *, const char *buf, size_t len);
   int (*recv)(struct mg_transport *, char *buf, size_t len);
   void (*destroy)(struct mg_transport *);
   void (*suspend_until_ready_to_read)(struct mg_transport *);
   void (*suspend_until_ready_to_write)(struct mg_transport *);
+  ssize_t (*recv_some)(struct mg_transport *, char *buf, size_t len);
+  ssize_t (*try_send)(struct mg_transport *, const char *buf, size_t len);
+  ssize_t (*try_recv)(struct mg_transport *, char *buf, size_t len);
+  int (*send_vector)(struct mg_transport *, const mg_transport_buffer *buffers,
+                     size_t count);
 } mg_transport;
 
 typedef struct mg_raw_transport {
@@ -45,10 +69,62 @@ typedef struct mg_raw_transport {
   void (*destroy)(struct mg_transport *);
   void (*suspend_until_ready_to_read)(struct mg_transport *);
   void (*suspend_until_ready_to_write)(struct mg_transport *);
+  ssize_t (*recv_some)(struct mg_transport *, char *buf, size_t len);
+  ssize_t (*try_send)(struct mg_transport *, const char *buf, size_t len);
+  ssize_t (*try_recv)(struct mg_transport *, char *buf, size_t len);
+  int (*send_vector)(struct mg_transport *, const mg_transport_buffer *buffers,
+                     size_t count);
   int sockfd;
   mg_allocator *allocator;
 } mg_raw_transport;
 
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// Plain TCP transport which does its I/O through an io_uring instead of
+// separate send and recv system calls. Blocking sends are staged and
+// submitted together with the next receive, so a request and the wait for
+// its response take a single system call. Reads at least as big as the receive
+// buffer go directly to the destination, smaller ones through the buffer.
+typedef struct mg_io_uring_transport {
+  int (*send)(struct mg_transport *, const char *buf, size_t len);
+  int (*recv)(struct mg_transport *, char *buf, size_t len);
+  void (*destroy)(struct mg_transport *);
+  void (*suspend_until_ready_to_read)(struct mg_transport *);
+  void (*suspend_until_ready_to_write)(struct mg_transport *);
+  ssize_t (*recv_some)(struct mg_transport *, char *buf, size_t len);
+  ssize_t (*try_send)(struct mg_transport *, const char *buf, size_t len);
+  ssize_t (*try_recv)(struct mg_transport *, char *buf, size_t len);
+  int (*send_vector)(struct mg_transport *, const mg_transport_buffer *buffers,
+                     size_t count);
+  int sockfd;
+  int ring_fd;
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+  // Data accepted by `send` but not yet written to the socket.
+  char *send_buffer;
+  size_t send_capacity;
+  size_t send_pending;
+  // Data received from the socket but not yet returned by `recv`.
+  char *recv_buffer;
+  size_t recv_capacity;
+  size_t recv_begin;
+  size_t recv_end;
+  mg_allocator *allocator;
+} mg_io_uring_transport;
+
 #ifndef __EMSCRIPTEN__
 typedef struct mg_secure_transport {
   int (*send)(struct mg_transport *, const char *buf, size_t len);
@@ -56,11 +132,21 @@ typedef struct mg_secure_transport {
   void (*destroy)(struct mg_transport *);
   void (*suspend_until_ready_to_read)(struct mg_transport *);
   void (*suspend_until_ready_to_write)(struct mg_transport *);
+  ssize_t (*recv_some)(struct mg_transport *, char *buf, size_t len);
+  ssize_t (*try_send)(struct mg_transport *, const char *buf, size_t len);
+  ssize_t (*try_recv)(struct mg_transport *, char *buf, size_t len);
+  int (*send_vector)(struct mg_transport *, const mg_transport_buffer *buffers,
+                     size_t count);
   SSL *ssl;
   BIO *bio;
   const char *peer_pubkey_type;
   char *peer_pubkey_fp;
   mg_allocator *allocator;
+  int sockfd;
+  // Set when the kernel encrypts sent and decrypts received application data,
+  // which can then be written to and read from the socket directly.
+  int ktls_send;
+  int ktls_recv;
 } mg_secure_transport;
 #endif
 
@@ -68,6 +154,33 @@ int mg_transport_send(mg_transport *transport, const char *buf, size_t len);
 
 int mg_transport_recv(mg_transport *transport, char *buf, size_t len);
 
+/// Receives at most `len` bytes, blocking only until some data is available.
+/// Returns the number of bytes received or -1 on failure (including the peer
+/// closing the connection). Every transport has to implement `recv_some`, since
+/// the session reads ahead into buffers larger than most responses.
+ssize_t mg_transport_recv_some(mg_transport *transport, char *buf, size_t len);
+
+/// Sends at most `len` bytes without blocking. Returns the number of bytes
+/// sent, MG_TRANSPORT_WANT_READ or MG_TRANSPORT_WANT_WRITE if nothing could be
+/// sent right now, or -1 on failure. Transports that don't implement
+/// `try_send` get a fallback which blocks until all of the data is sent.
+ssize_t mg_transport_try_send(mg_transport *transport, const char *buf,
+                              size_t len);
+
+/// Receives at most `len` bytes without blocking. Returns the number of bytes
+/// received, MG_TRANSPORT_WANT_READ or MG_TRANSPORT_WANT_WRITE if nothing could
+/// be received right now, or -1 on failure (including the peer closing the
+/// connection). Transports that don't implement `try_recv` get a fallback which
+/// blocks like `mg_transport_recv_some`, until some data is available.
+ssize_t mg_transport_try_recv(mg_transport *transport, char *buf, size_t len);
+
+/// Sends `count` buffers, in order, blocking until all of them are sent.
+/// `count` is at most MG_TRANSPORT_MAX_BUFFERS. Only available if the
+/// transport implements `send_vector`, which is left out by transports that
+/// copy the data before sending it anyway.
+int mg_transport_send_vector(mg_transport *transport,
+                             const mg_transport_buffer *buffers, size_t count);
+
 void mg_transport_destroy(mg_transport *transport);
 
 void mg_transport_suspend_until_ready_to_read(struct mg_transport *);
@@ -81,27 +194,82 @@ int mg_raw_transport_send(struct mg_transport *, const char *buf, size_t len);
 
 int mg_raw_transport_recv(struct mg_transport *, char *buf, size_t len);
 
+ssize_t mg_raw_transport_recv_some(struct mg_transport *, char *buf,
+                                   size_t len);
+
+ssize_t mg_raw_transport_try_send(struct mg_transport *, const char *buf,
+                                  size_t len);
+
+ssize_t mg_raw_transport_try_recv(struct mg_transport *, char *buf,
+                                  size_t len);
+
+int mg_raw_transport_send_vector(struct mg_transport *,
+                                 const mg_transport_buffer *buffers,
+                                 size_t count);
+
 void mg_raw_transport_destroy(struct mg_transport *);
 
 void mg_raw_transport_suspend_until_ready_to_read(struct mg_transport *);
 
 void mg_raw_transport_suspend_until_ready_to_write(struct mg_transport *);
 
+/// Creates an io_uring transport over `sockfd`. Returns MG_ERROR_UNIMPLEMENTED
+/// if the library was built without io_uring support, or MG_ERROR_SOCKET if
+/// the kernel refuses to set up the ring. The socket is owned by the transport
+/// only if it is successfully created.
+int mg_io_uring_transport_init(int sockfd, mg_io_uring_transport **transport,
+                               mg_allocator *allocator);
+
+int mg_io_uring_transport_send(struct mg_transport *, const char *buf,
+                               size_t len);
+
+int mg_io_uring_transport_recv(struct mg_transport *, char *buf, size_t len);
+
+ssize_t mg_io_uring_transport_recv_some(struct mg_transport *, char *buf,
+                                        size_t len);
+
+ssize_t mg_io_uring_transport_try_send(struct mg_transport *, const char *buf,
+                                       size_t len);
+
+ssize_t mg_io_uring_transport_try_recv(struct mg_transport *, char *buf,
+                                       size_t len);
+
+void mg_io_uring_transport_destroy(struct mg_transport *);
+
 #ifndef __EMSCRIPTEN__
 // This function is mocked in tests during linking by using --wrap. ON_APPLE
 // there is no --wrap. An alternative is to use -alias but if a symbol is
 // strong linking fails.
+//
+// If `ktls` is set, kernel TLS offload is requested after the handshake. It
+// is only available on Linux with OpenSSL 3 built with kTLS support, the tls
+// kernel module loaded and a cipher supported by the kernel.
 MG_ATTRIBUTE_WEAK int mg_secure_transport_init(int sockfd,
                                                const char *cert_file,
                                                const char *key_file,
                                                mg_secure_transport **transport,
-                                               mg_allocator *allocator);
+                                               mg_allocator *allocator,
+                                               int ktls);
 
 int mg_secure_transport_send(mg_transport *, const char *buf, size_t len);
 
 int mg_secure_transport_recv(mg_transport *, char *buf, size_t len);
 
+ssize_t mg_secure_transport_recv_some(mg_transport *, char *buf, size_t len);
+
+ssize_t mg_secure_transport_try_send(mg_transport *, const char *buf,
+                                     size_t len);
+
+ssize_t mg_secure_transport_try_recv(mg_transport *, char *buf, size_t len);
+
+int mg_secure_transport_send_vector(mg_transport *,
+                                    const mg_transport_buffer *buffers,
+                                    size_t count);
+
 void mg_secure_transport_destroy(mg_transport *);
+
+/// Frees the SSL contexts and TLS sessions shared by secure transports.
+void mg_secure_transport_finalize(void);
 #endif
 
 #ifdef __cplusplus
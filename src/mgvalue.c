@@ -30,28 +30,48 @@ mg_string *mg_string_alloc(uint32_t size, mg_allocator *allocator) {
   return str;
 }
 
-mg_list *mg_list_alloc(uint32_t size, mg_allocator *allocator) {
+// Allocates a list with `packed_size` more bytes after the element pointers,
+// for a packed array of its elements.
+static mg_list *mg_list_alloc_packed(uint32_t size, size_t packed_size,
+                                     mg_allocator *allocator) {
   size_t elements_size = size * sizeof(mg_value *);
-  char *block = mg_allocator_malloc(allocator, sizeof(mg_list) + elements_size);
+  char *block = mg_allocator_malloc(
+      allocator, sizeof(mg_list) + elements_size + packed_size);
   if (!block) {
     return NULL;
   }
   mg_list *list = (mg_list *)block;
   list->elements = (mg_value **)(block + sizeof(mg_list));
+  list->integers = NULL;
+  list->floats = NULL;
   return list;
 }
 
+mg_list *mg_list_alloc(uint32_t size, mg_allocator *allocator) {
+  return mg_list_alloc_packed(size, 0, allocator);
+}
+
 mg_map *mg_map_alloc(uint32_t size, mg_allocator *allocator) {
   size_t keys_size = size * sizeof(mg_string *);
   size_t values_size = size * sizeof(mg_value *);
-  char *block =
-      mg_allocator_malloc(allocator, sizeof(mg_map) + keys_size + values_size);
+  uint32_t index_capacity = mg_map_index_capacity(size);
+  size_t index_size = index_capacity * sizeof(uint32_t);
+  char *block = mg_allocator_malloc(
+      allocator, sizeof(mg_map) + keys_size + values_size + index_size);
   if (!block) {
     return NULL;
   }
   mg_map *map = (mg_map *)block;
   map->keys = (mg_string **)(block + sizeof(mg_map));
   map->values = (mg_value **)(block + sizeof(mg_map) + keys_size);
+  map->index_capacity = index_capacity;
+  map->index = index_capacity
+                   ? (uint32_t *)(block + sizeof(mg_map) + keys_size +
+                                  values_size)
+                   : NULL;
+  if (index_capacity) {
+    memset(map->index, 0, index_size);
+  }
   return map;
 }
 
@@ -63,6 +83,7 @@ mg_node *mg_node_alloc(uint32_t label_count, mg_allocator *allocator) {
   }
   mg_node *node = (mg_node *)block;
   node->labels = (mg_string **)(block + sizeof(mg_node));
+  node->element_id = NULL;
   return node;
 }
 
@@ -572,7 +593,7 @@ mg_value *mg_value_copy_ca(const mg_value *val, mg_allocator *allocator) {
   return new_val;
 
 cleanup:
-  mg_allocator_free(&mg_system_allocator, new_val);
+  mg_allocator_free(allocator, new_val);
   return NULL;
 }
 
@@ -700,6 +721,13 @@ void mg_string_destroy(mg_string *str) {
   mg_string_destroy_ca(str, &mg_system_allocator);
 }
 
+// Copies an element ID, which may be missing. Returns 0 on success.
+static int mg_element_id_copy_ca(const mg_string *src, mg_string **dst,
+                                 mg_allocator *allocator) {
+  *dst = mg_string_copy_ca(src, allocator);
+  return src && !*dst ? MG_ERROR_OOM : 0;
+}
+
 static int mg_string_eq(uint32_t size1, const char *str1, uint32_t size2,
                         const char *str2) {
   if (size1 != size2) return 0;
@@ -735,14 +763,30 @@ const mg_value *mg_list_at(const mg_list *list, uint32_t pos) {
   }
 }
 
+const int64_t *mg_list_integers(const mg_list *list) { return list->integers; }
+
+const double *mg_list_floats(const mg_list *list) { return list->floats; }
+
 mg_list *mg_list_copy_ca(const mg_list *list, mg_allocator *allocator) {
   if (!list) {
     return NULL;
   }
-  mg_list *nlist = mg_list_alloc(list->size, allocator);
+  const void *packed = list->integers ? (const void *)list->integers
+                                       : (const void *)list->floats;
+  size_t packed_size = packed ? list->size * sizeof(int64_t) : 0;
+  mg_list *nlist = mg_list_alloc_packed(list->size, packed_size, allocator);
   if (!nlist) {
     return NULL;
   }
+  if (packed) {
+    void *npacked = (char *)nlist->elements + list->size * sizeof(mg_value *);
+    memcpy(npacked, packed, packed_size);
+    if (list->integers) {
+      nlist->integers = npacked;
+    } else {
+      nlist->floats = npacked;
+    }
+  }
   nlist->capacity = list->size;
   nlist->size = 0;
   for (uint32_t i = 0; i < list->size; ++i) {
@@ -756,7 +800,7 @@ mg_list *mg_list_copy_ca(const mg_list *list, mg_allocator *allocator) {
 
 cleanup:
   for (uint32_t i = 0; i < nlist->size; ++i) {
-    mg_value_destroy(nlist->elements[i]);
+    mg_value_destroy_ca(nlist->elements[i], allocator);
   }
   mg_allocator_free(allocator, nlist);
   return NULL;
@@ -790,8 +834,61 @@ mg_map *mg_map_make_empty(uint32_t capacity) {
   return map;
 }
 
+uint32_t mg_map_index_capacity(uint32_t capacity) {
+  if (capacity < MG_MAP_INDEX_THRESHOLD || capacity > UINT32_MAX / 4) {
+    return 0;
+  }
+  // Keep the load factor at most one half, so that probe sequences stay short.
+  uint32_t index_capacity = 2 * MG_MAP_INDEX_THRESHOLD;
+  while (index_capacity < 2 * capacity) {
+    index_capacity *= 2;
+  }
+  return index_capacity;
+}
+
+static uint32_t mg_map_hash_key(uint32_t key_size, const char *key_data) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (uint32_t i = 0; i < key_size; ++i) {
+    hash ^= (uint8_t)key_data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void mg_map_index_insert(mg_map *map, uint32_t pos) {
+  if (!map->index_capacity) {
+    return;
+  }
+  const mg_string *key = map->keys[pos];
+  uint32_t mask = map->index_capacity - 1;
+  uint32_t slot = mg_map_hash_key(key->size, key->data) & mask;
+  while (map->index[slot]) {
+    const mg_string *other = map->keys[map->index[slot] - 1];
+    if (mg_string_eq(other->size, other->data, key->size, key->data)) {
+      // Lookups return the first occurrence of a key, same as a linear scan.
+      return;
+    }
+    slot = (slot + 1) & mask;
+  }
+  map->index[slot] = pos + 1;
+}
+
 static uint32_t mg_map_find_key(const mg_map *map, uint32_t key_size,
                                 const char *key_data) {
+  if (map->index_capacity) {
+    uint32_t mask = map->index_capacity - 1;
+    uint32_t slot = mg_map_hash_key(key_size, key_data) & mask;
+    while (map->index[slot]) {
+      uint32_t pos = map->index[slot] - 1;
+      if (mg_string_eq(map->keys[pos]->size, map->keys[pos]->data, key_size,
+                       key_data)) {
+        return pos;
+      }
+      slot = (slot + 1) & mask;
+    }
+    return map->size;
+  }
   for (uint32_t i = 0; i < map->size; ++i) {
     if (mg_string_eq(map->keys[i]->size, map->keys[i]->data, key_size,
                      key_data)) {
@@ -804,6 +901,7 @@ static uint32_t mg_map_find_key(const mg_map *map, uint32_t key_size,
 static void mg_map_append(mg_map *map, mg_string *key, mg_value *value) {
   map->keys[map->size] = key;
   map->values[map->size] = value;
+  mg_map_index_insert(map, map->size);
   map->size++;
 }
 
@@ -878,6 +976,19 @@ const mg_value *mg_map_at2(const mg_map *map, uint32_t key_size,
   return NULL;
 }
 
+uint32_t mg_map_find(const mg_map *map, const char *key_str) {
+  size_t key_size = strlen(key_str);
+  if (key_size >= UINT32_MAX) {
+    return map->size;
+  }
+  return mg_map_find_key(map, (uint32_t)key_size, key_str);
+}
+
+uint32_t mg_map_find2(const mg_map *map, uint32_t key_size,
+                      const char *key_data) {
+  return mg_map_find_key(map, key_size, key_data);
+}
+
 uint32_t mg_map_size(const mg_map *map) { return map->size; }
 
 const mg_string *mg_map_key_at(const mg_map *map, uint32_t pos) {
@@ -913,6 +1024,7 @@ mg_map *mg_map_copy_ca(const mg_map *map, mg_allocator *allocator) {
     if (!nmap->keys[i]) {
       goto cleanup;
     }
+    mg_map_index_insert(nmap, i);
     keys_copied++;
     nmap->values[i] = mg_value_copy_ca(map->values[i], allocator);
     if (!nmap->values[i]) {
@@ -924,12 +1036,12 @@ mg_map *mg_map_copy_ca(const mg_map *map, mg_allocator *allocator) {
 
 cleanup:
   for (uint32_t i = 0; i < keys_copied; ++i) {
-    mg_string_destroy(map->keys[i]);
+    mg_string_destroy_ca(nmap->keys[i], allocator);
   }
   for (uint32_t i = 0; i < values_copied; ++i) {
-    mg_value_destroy(map->values[i]);
+    mg_value_destroy_ca(nmap->values[i], allocator);
   }
-  mg_allocator_free(&mg_system_allocator, nmap);
+  mg_allocator_free(allocator, nmap);
   return NULL;
 }
 
@@ -968,11 +1080,15 @@ const mg_map *mg_node_properties(const mg_node *node) {
   return node->properties;
 }
 
+const mg_string *mg_node_element_id(const mg_node *node) {
+  return node->element_id;
+}
+
 mg_node *mg_node_copy_ca(const mg_node *node, mg_allocator *allocator) {
   if (!node) {
     return NULL;
   }
-  mg_node *nnode = mg_node_alloc(node->label_count, &mg_system_allocator);
+  mg_node *nnode = mg_node_alloc(node->label_count, allocator);
   if (!nnode) {
     return NULL;
   }
@@ -989,13 +1105,20 @@ mg_node *mg_node_copy_ca(const mg_node *node, mg_allocator *allocator) {
   if (!nnode->properties) {
     goto cleanup;
   }
+  if (mg_element_id_copy_ca(node->element_id, &nnode->element_id,
+                            allocator) != 0) {
+    goto cleanup_properties;
+  }
   return nnode;
 
+cleanup_properties:
+  mg_map_destroy_ca(nnode->properties, allocator);
+
 cleanup:
   for (uint32_t i = 0; i < nnode->label_count; ++i) {
-    mg_string_destroy(nnode->labels[i]);
+    mg_string_destroy_ca(nnode->labels[i], allocator);
   }
-  mg_allocator_free(&mg_system_allocator, nnode);
+  mg_allocator_free(allocator, nnode);
   return NULL;
 }
 
@@ -1011,6 +1134,7 @@ void mg_node_destroy_ca(mg_node *node, mg_allocator *allocator) {
     mg_string_destroy_ca(node->labels[i], allocator);
   }
   mg_map_destroy_ca(node->properties, allocator);
+  mg_string_destroy_ca(node->element_id, allocator);
   mg_allocator_free(allocator, node);
 }
 
@@ -1036,19 +1160,34 @@ const mg_map *mg_relationship_properties(const mg_relationship *rel) {
   return rel->properties;
 }
 
+const mg_string *mg_relationship_element_id(const mg_relationship *rel) {
+  return rel->element_id;
+}
+
+const mg_string *mg_relationship_start_element_id(const mg_relationship *rel) {
+  return rel->start_element_id;
+}
+
+const mg_string *mg_relationship_end_element_id(const mg_relationship *rel) {
+  return rel->end_element_id;
+}
+
 mg_relationship *mg_relationship_copy_ca(const mg_relationship *rel,
                                          mg_allocator *allocator) {
   if (!rel) {
     return NULL;
   }
   mg_relationship *nrel =
-      mg_allocator_malloc(&mg_system_allocator, sizeof(mg_relationship));
+      mg_allocator_malloc(allocator, sizeof(mg_relationship));
   if (!nrel) {
     return NULL;
   }
   nrel->id = rel->id;
   nrel->start_id = rel->start_id;
   nrel->end_id = rel->end_id;
+  nrel->element_id = NULL;
+  nrel->start_element_id = NULL;
+  nrel->end_element_id = NULL;
   nrel->type = mg_string_copy_ca(rel->type, allocator);
   if (!nrel->type) {
     goto cleanup;
@@ -1057,13 +1196,27 @@ mg_relationship *mg_relationship_copy_ca(const mg_relationship *rel,
   if (!nrel->properties) {
     goto cleanup_type;
   }
+  if (mg_element_id_copy_ca(rel->element_id, &nrel->element_id, allocator) !=
+          0 ||
+      mg_element_id_copy_ca(rel->start_element_id, &nrel->start_element_id,
+                            allocator) != 0 ||
+      mg_element_id_copy_ca(rel->end_element_id, &nrel->end_element_id,
+                            allocator) != 0) {
+    goto cleanup_element_ids;
+  }
   return nrel;
 
+cleanup_element_ids:
+  mg_string_destroy_ca(nrel->element_id, allocator);
+  mg_string_destroy_ca(nrel->start_element_id, allocator);
+  mg_string_destroy_ca(nrel->end_element_id, allocator);
+  mg_map_destroy_ca(nrel->properties, allocator);
+
 cleanup_type:
-  mg_string_destroy(nrel->type);
+  mg_string_destroy_ca(nrel->type, allocator);
 
 cleanup:
-  mg_allocator_free(&mg_system_allocator, nrel);
+  mg_allocator_free(allocator, nrel);
   return NULL;
 }
 
@@ -1077,6 +1230,9 @@ void mg_relationship_destroy_ca(mg_relationship *rel, mg_allocator *allocator) {
   }
   mg_string_destroy_ca(rel->type, allocator);
   mg_map_destroy_ca(rel->properties, allocator);
+  mg_string_destroy_ca(rel->element_id, allocator);
+  mg_string_destroy_ca(rel->start_element_id, allocator);
+  mg_string_destroy_ca(rel->end_element_id, allocator);
   mg_allocator_free(allocator, rel);
 }
 
@@ -1098,10 +1254,15 @@ const mg_map *mg_unbound_relationship_properties(
   return rel->properties;
 }
 
+const mg_string *mg_unbound_relationship_element_id(
+    const mg_unbound_relationship *rel) {
+  return rel->element_id;
+}
+
 mg_unbound_relationship *mg_unbound_relationship_copy_ca(
     const mg_unbound_relationship *rel, mg_allocator *allocator) {
-  mg_unbound_relationship *nrel = mg_allocator_malloc(
-      &mg_system_allocator, sizeof(mg_unbound_relationship));
+  mg_unbound_relationship *nrel =
+      mg_allocator_malloc(allocator, sizeof(mg_unbound_relationship));
   if (!nrel) {
     return NULL;
   }
@@ -1114,13 +1275,20 @@ mg_unbound_relationship *mg_unbound_relationship_copy_ca(
   if (!nrel->properties) {
     goto cleanup_type;
   }
+  if (mg_element_id_copy_ca(rel->element_id, &nrel->element_id, allocator) !=
+      0) {
+    goto cleanup_properties;
+  }
   return nrel;
 
+cleanup_properties:
+  mg_map_destroy_ca(nrel->properties, allocator);
+
 cleanup_type:
-  mg_string_destroy(nrel->type);
+  mg_string_destroy_ca(nrel->type, allocator);
 
 cleanup:
-  mg_allocator_free(&mg_system_allocator, nrel);
+  mg_allocator_free(allocator, nrel);
   return NULL;
 }
 
@@ -1136,6 +1304,7 @@ void mg_unbound_relationship_destroy_ca(mg_unbound_relationship *rel,
   }
   mg_string_destroy_ca(rel->type, allocator);
   mg_map_destroy_ca(rel->properties, allocator);
+  mg_string_destroy_ca(rel->element_id, allocator);
   mg_allocator_free(allocator, rel);
 }
 
@@ -1186,7 +1355,7 @@ int mg_path_relationship_reversed_at(const mg_path *path, uint32_t pos) {
 
 mg_path *mg_path_copy_ca(const mg_path *path, mg_allocator *allocator) {
   mg_path *npath = mg_path_alloc(path->node_count, path->relationship_count,
-                                 path->sequence_length, &mg_system_allocator);
+                                 path->sequence_length, allocator);
   if (!npath) {
     return NULL;
   }
@@ -1214,12 +1383,12 @@ mg_path *mg_path_copy_ca(const mg_path *path, mg_allocator *allocator) {
 
 cleanup:
   for (uint32_t i = 0; i < npath->node_count; ++i) {
-    mg_node_destroy(npath->nodes[i]);
+    mg_node_destroy_ca(npath->nodes[i], allocator);
   }
   for (uint32_t i = 0; i < npath->relationship_count; ++i) {
-    mg_unbound_relationship_destroy(npath->relationships[i]);
+    mg_unbound_relationship_destroy_ca(npath->relationships[i], allocator);
   }
-  mg_allocator_free(&mg_system_allocator, npath);
+  mg_allocator_free(allocator, npath);
   return NULL;
 }
 
@@ -1603,6 +1772,9 @@ mg_relationship *mg_relationship_make(int64_t id, int64_t start_id,
   rel->end_id = end_id;
   rel->type = type;
   rel->properties = properties;
+  rel->element_id = NULL;
+  rel->start_element_id = NULL;
+  rel->end_element_id = NULL;
   return rel;
 }
 
@@ -1617,6 +1789,7 @@ mg_unbound_relationship *mg_unbound_relationship_make(int64_t id,
   rel->id = id;
   rel->type = type;
   rel->properties = properties;
+  rel->element_id = NULL;
   return rel;
 }
 
@@ -1725,8 +1898,17 @@ int mg_map_equal(const mg_map *lhs, const mg_map *rhs) {
   return 1;
 }
 
+// Element IDs are equal if both are missing.
+static int mg_element_id_equal(const mg_string *lhs, const mg_string *rhs) {
+  if (!lhs || !rhs) {
+    return !lhs && !rhs;
+  }
+  return mg_string_equal(lhs, rhs);
+}
+
 int mg_node_equal(const mg_node *lhs, const mg_node *rhs) {
-  if (lhs->id != rhs->id) {
+  if (lhs->id != rhs->id ||
+      !mg_element_id_equal(lhs->element_id, rhs->element_id)) {
     return 0;
   }
   if (lhs->label_count != rhs->label_count) {
@@ -1743,7 +1925,10 @@ int mg_node_equal(const mg_node *lhs, const mg_node *rhs) {
 int mg_relationship_equal(const mg_relationship *lhs,
                           const mg_relationship *rhs) {
   if (lhs->id != rhs->id || lhs->start_id != rhs->start_id ||
-      lhs->end_id != rhs->end_id) {
+      lhs->end_id != rhs->end_id ||
+      !mg_element_id_equal(lhs->element_id, rhs->element_id) ||
+      !mg_element_id_equal(lhs->start_element_id, rhs->start_element_id) ||
+      !mg_element_id_equal(lhs->end_element_id, rhs->end_element_id)) {
     return 0;
   }
   if (!mg_string_equal(lhs->type, rhs->type)) {
@@ -1754,7 +1939,8 @@ int mg_relationship_equal(const mg_relationship *lhs,
 
 int mg_unbound_relationship_equal(const mg_unbound_relationship *lhs,
                                   const mg_unbound_relationship *rhs) {
-  if (lhs->id != rhs->id) {
+  if (lhs->id != rhs->id ||
+      !mg_element_id_equal(lhs->element_id, rhs->element_id)) {
     return 0;
   }
   if (!mg_string_equal(lhs->type, rhs->type)) {
@@ -1898,4 +2084,4 @@ int mg_value_equal(const mg_value *lhs, const mg_value *rhs) {
 
 mg_map *mg_default_pull_extra_map;
 
-mg_map mg_empty_map = {0, 0, NULL, NULL};
+mg_map mg_empty_map = {0, 0, NULL, NULL, 0, NULL};
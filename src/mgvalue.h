@@ -33,20 +33,35 @@ typedef struct mg_list {
   uint32_t size;
   uint32_t capacity;
   mg_value **elements;
+  // Elements of a list of only integers or only floats, packed into an array.
+  // Only lists decoded by the client (and copies of them) have one, otherwise
+  // both are NULL.
+  const int64_t *integers;
+  const double *floats;
 } mg_list;
 
+// Maps with at least this capacity get a hash index of their keys, so that
+// lookups don't have to scan all of the keys.
+#define MG_MAP_INDEX_THRESHOLD 16
+
 typedef struct mg_map {
   uint32_t size;
   uint32_t capacity;
   mg_string **keys;
   mg_value **values;
+  // Open addressing hash table of key positions (offset by one, zero marks an
+  // empty slot). Its capacity is zero when the map isn't indexed.
+  uint32_t index_capacity;
+  uint32_t *index;
 } mg_map;
 
+// Element IDs are sent only since Bolt 5, and are NULL otherwise.
 typedef struct mg_node {
   int64_t id;
   uint32_t label_count;
   mg_string **labels;
   mg_map *properties;
+  mg_string *element_id;
 } mg_node;
 
 typedef struct mg_relationship {
@@ -55,12 +70,16 @@ typedef struct mg_relationship {
   int64_t end_id;
   mg_string *type;
   mg_map *properties;
+  mg_string *element_id;
+  mg_string *start_element_id;
+  mg_string *end_element_id;
 } mg_relationship;
 
 typedef struct mg_unbound_relationship {
   int64_t id;
   mg_string *type;
   mg_map *properties;
+  mg_string *element_id;
 } mg_unbound_relationship;
 
 typedef struct mg_path {
@@ -153,6 +172,13 @@ mg_list *mg_list_alloc(uint32_t size, mg_allocator *allocator);
 
 mg_map *mg_map_alloc(uint32_t size, mg_allocator *allocator);
 
+// Size of the key index for a map of the given capacity, zero if the map
+// shouldn't be indexed.
+uint32_t mg_map_index_capacity(uint32_t capacity);
+
+// Adds the key at position `pos` to the index of `map`, if it has one.
+void mg_map_index_insert(mg_map *map, uint32_t pos);
+
 mg_node *mg_node_alloc(uint32_t label_count, mg_allocator *allocator);
 
 mg_path *mg_path_alloc(uint32_t node_count, uint32_t relationship_count,
@@ -1,5 +1,6 @@
 #include "mgwasm.h"
 
+#include <limits.h>
 #include <stddef.h>
 #include <sys/select.h>
 #include <sys/socket.h>
@@ -44,7 +45,58 @@ int write_loop(const int sock) {
   return 1;
 }
 
-static const size_t DELAY_MS = 10;
+// Sockets are emulated with WebSockets, which report everything that happens
+// to them through `Module.websocket` events: a message was received, the
+// connection was opened or closed, or an error occurred. Waiting sessions are
+// woken up on each of them. Emscripten keeps a single callback per event, so
+// callbacks which were set before are still called after ours.
+EM_JS(void, mg_wasm_listen_to_socket_events, (void), {
+  var waiters = [];
+  Module['mgSocketWaiters'] = waiters;
+  ['message', 'open', 'close', 'error'].forEach(function(event) {
+    var previous = Module['websocket']._callbacks[event];
+    Module['websocket']['on'](event, function(param) {
+      waiters.splice(0).forEach(function(wake) { wake(); });
+      if (previous) {
+        previous.call(this, param);
+      }
+    });
+  });
+});
+
+// Suspends until the next socket event. If none comes in `timeout_ms`, e.g.
+// because the application replaced our callbacks, it returns anyway so that
+// the socket is checked again.
+EM_ASYNC_JS(void, mg_wasm_wait_for_socket_event, (int timeout_ms), {
+  var waiters = Module['mgSocketWaiters'];
+  await new Promise(function(resolve) {
+    var wake = function() {
+      clearTimeout(timer);
+      resolve();
+    };
+    var timer = setTimeout(function() {
+      var index = waiters.indexOf(wake);
+      if (index >= 0) {
+        waiters.splice(index, 1);
+      }
+      resolve();
+    }, timeout_ms);
+    waiters.push(wake);
+  });
+});
+
+static const int MAX_WAIT_MS = 1000;
+
+static void wait_for_socket_event(void) {
+  static int listening = 0;
+  if (!listening) {
+    mg_wasm_listen_to_socket_events();
+    listening = 1;
+  }
+  // JavaScript runs on a single thread, so no event can be missed between
+  // checking the socket and starting to wait.
+  mg_wasm_wait_for_socket_event(MAX_WAIT_MS);
+}
 
 int mg_wasm_suspend_until_ready_to_read(const int sock) {
   while (1) {
@@ -52,7 +104,7 @@ int mg_wasm_suspend_until_ready_to_read(const int sock) {
     if (res == 1 || res == -1) {
       return res;
     }
-    emscripten_sleep(DELAY_MS);
+    wait_for_socket_event();
   }
 }
 
@@ -62,9 +114,21 @@ int mg_wasm_suspend_until_ready_to_write(const int sock) {
     if (res == 1 || res == -1) {
       return res;
     }
-    if (res == -1) {
-      return -1;
+    wait_for_socket_event();
+  }
+}
+
+size_t mg_wasm_receive_queued(const int sock, char *buf, size_t len) {
+  size_t received = 0;
+  while (received < len) {
+    size_t left = len - received;
+    int max_len = left > INT_MAX ? INT_MAX : (int)left;
+    // Sockets never block, receiving fails with EAGAIN once nothing is left.
+    ssize_t now = recv(sock, buf + received, max_len, 0);
+    if (now <= 0) {
+      break;
     }
-    emscripten_sleep(DELAY_MS);
+    received += (size_t)now;
   }
+  return received;
 }
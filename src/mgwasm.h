@@ -1,7 +1,15 @@
 #ifndef MGCLIENT_MGWASM_H
 #define MGCLIENT_MGWASM_H
 
+#include <stddef.h>
+
 int mg_wasm_suspend_until_ready_to_read(int sock);
 int mg_wasm_suspend_until_ready_to_write(int sock);
 
+// Receives the WebSocket messages which have already arrived on `sock`, up to
+// `len` bytes, without waiting for more. Each receive returns at most one
+// message, so this is used to fill the read buffer after the first one.
+// Returns the number of bytes received.
+size_t mg_wasm_receive_queued(int sock, char *buf, size_t len);
+
 #endif /* MGCLIENT_MGWASM_H */
@@ -63,6 +63,23 @@ int mg_socket_connect(int sock, const struct sockaddr *addr,
   return MG_SUCCESS;
 }
 
+int mg_socket_connect_in_progress(void) {
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+int mg_socket_connect_result(int sock) {
+  int error = 0;
+  int error_len = sizeof(error);
+  if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&error, &error_len) != 0) {
+    return MG_ERROR_SOCKET;
+  }
+  if (error != 0) {
+    WSASetLastError(error);
+    return MG_ERROR_SOCKET;
+  }
+  return MG_SUCCESS;
+}
+
 int mg_socket_connect_handle_error(int *sock, int status, mg_session *session) {
   if (status != MG_SUCCESS) {
     mg_session_set_error(session, "couldn't connect to host: %s",
@@ -90,6 +107,21 @@ ssize_t mg_socket_send(int sock, const void *buf, int len) {
   return sent;
 }
 
+ssize_t mg_socket_send_vector(int sock, const mg_transport_buffer *buffers,
+                              size_t count) {
+  WSABUF wsa_buffers[MG_TRANSPORT_MAX_BUFFERS];
+  for (size_t i = 0; i < count; ++i) {
+    wsa_buffers[i].buf = (CHAR *)buffers[i].data;
+    wsa_buffers[i].len = (ULONG)buffers[i].len;
+  }
+  DWORD sent;
+  if (WSASend(sock, wsa_buffers, (DWORD)count, &sent, 0, NULL, NULL) ==
+      SOCKET_ERROR) {
+    return -1;
+  }
+  return (ssize_t)sent;
+}
+
 ssize_t mg_socket_receive(int sock, void *buf, int len) {
   int received = recv(sock, buf, len, 0);
   if (received == SOCKET_ERROR) {
@@ -98,6 +130,16 @@ ssize_t mg_socket_receive(int sock, void *buf, int len) {
   return received;
 }
 
+int mg_socket_set_nonblocking(int sock, int nonblocking) {
+  u_long mode = nonblocking ? 1 : 0;
+  if (ioctlsocket(sock, FIONBIO, &mode) != 0) {
+    return MG_ERROR_SOCKET;
+  }
+  return MG_SUCCESS;
+}
+
+int mg_socket_would_block(void) { return WSAGetLastError() == WSAEWOULDBLOCK; }
+
 int mg_socket_poll(struct pollfd *fds, unsigned int nfds, int timeout) {
   return WSAPoll(fds, nfds, timeout);
 }
@@ -330,3 +372,14 @@ void mg_socket_finalize() {
     fprintf(stderr, "WSACleanup failed: %s\n", mg_socket_error());
   }
 }
+
+uint64_t mg_clock_ns(void) {
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER now;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&now);
+  uint64_t ticks = (uint64_t)now.QuadPart;
+  uint64_t per_second = (uint64_t)frequency.QuadPart;
+  return ticks / per_second * 1000000000 +
+         ticks % per_second * 1000000000 / per_second;
+}
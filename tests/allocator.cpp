@@ -12,9 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include "mgallocator.h"
+#include "mgclient.h"
 
 #include "test-common.hpp"
 
@@ -79,3 +82,120 @@ TEST(LinearAllocatorTest, SeparateAllocations) {
   mg_linear_allocator_destroy(allocator);
   ASSERT_EQ(underlying_allocator.allocated.size(), 0u);
 }
+
+TEST(LinearAllocatorTest, AdaptiveBlockSize) {
+  tracking_allocator underlying_allocator;
+  mg_linear_allocator *allocator = mg_linear_allocator_init(
+      (mg_allocator *)&underlying_allocator, 4096, 2048);
+  mg_linear_allocator_set_limits(allocator, 16384, 0);
+
+  // Messages of 10 kB don't fit in a single block at first.
+  for (int i = 0; i < 10; ++i) {
+    mg_allocator_malloc((mg_allocator *)allocator, 1024);
+  }
+  ASSERT_EQ(underlying_allocator.allocated.size(), 4u);
+
+  mg_linear_allocator_reset(allocator);
+  ASSERT_EQ(mg_linear_allocator_block_size(allocator), 16384u);
+  ASSERT_EQ(underlying_allocator.allocated.size(), 2u);
+
+  // After that, a whole message fits in the first block.
+  for (int i = 0; i < 10; ++i) {
+    mg_allocator_malloc((mg_allocator *)allocator, 1024);
+  }
+  ASSERT_EQ(underlying_allocator.allocated.size(), 2u);
+
+  // Block size doesn't grow above the limit.
+  for (int i = 0; i < 20; ++i) {
+    mg_allocator_malloc((mg_allocator *)allocator, 1024);
+  }
+  mg_linear_allocator_reset(allocator);
+  ASSERT_EQ(mg_linear_allocator_block_size(allocator), 16384u);
+
+  mg_linear_allocator_destroy(allocator);
+  ASSERT_EQ(underlying_allocator.allocated.size(), 0u);
+}
+
+TEST(LinearAllocatorTest, SpareBlocks) {
+  tracking_allocator underlying_allocator;
+  mg_linear_allocator *allocator = mg_linear_allocator_init(
+      (mg_allocator *)&underlying_allocator, 4096, 2048);
+  mg_linear_allocator_set_limits(allocator, 4096, 2);
+
+  auto allocate_message = [allocator] {
+    for (int i = 0; i < 8; ++i) {
+      mg_allocator_malloc((mg_allocator *)allocator, 1024);
+    }
+    mg_allocator_malloc((mg_allocator *)allocator, 3000);
+  };
+
+  allocate_message();
+  ASSERT_EQ(underlying_allocator.allocated.size(), 4u);
+  mg_linear_allocator_reset(allocator);
+  ASSERT_EQ(underlying_allocator.allocated.size(), 4u);
+
+  // Spare blocks are reused, so no allocations happen in steady state.
+  for (int i = 0; i < 3; ++i) {
+    allocate_message();
+    ASSERT_EQ(underlying_allocator.allocated.size(), 4u);
+    mg_linear_allocator_reset(allocator);
+    ASSERT_EQ(underlying_allocator.allocated.size(), 4u);
+  }
+
+  mg_linear_allocator_set_limits(allocator, 4096, 0);
+  ASSERT_EQ(underlying_allocator.allocated.size(), 2u);
+
+  mg_linear_allocator_destroy(allocator);
+  ASSERT_EQ(underlying_allocator.allocated.size(), 0u);
+}
+
+TEST(SystemAllocatorTest, ThreadAllocator) {
+  tracking_allocator allocator;
+  mg_set_thread_allocator((mg_allocator *)&allocator);
+  mg_map *map = mg_map_make_empty(2);
+  mg_map_insert(map, "name", mg_value_make_string("value"));
+  mg_map_insert(map, "list", mg_value_make_list(mg_list_make_empty(0)));
+  size_t allocated = allocator.allocated.size();
+  EXPECT_GT(allocated, 0u);
+
+  // Other threads keep allocating through the allocator of the process.
+  std::thread([] {
+    mg_value_destroy(mg_value_make_string("other thread"));
+  }).join();
+  EXPECT_EQ(allocator.allocated.size(), allocated);
+
+  mg_map *copy = mg_map_copy(map);
+  EXPECT_GT(allocator.allocated.size(), allocated);
+  mg_map_destroy(copy);
+  mg_map_destroy(map);
+  mg_set_thread_allocator(nullptr);
+  ASSERT_MEMORY_OK();
+
+  mg_value_destroy(mg_value_make_integer(1));
+  ASSERT_MEMORY_OK();
+}
+
+TEST(SystemAllocatorTest, ProcessAllocator) {
+  tracking_allocator allocator;
+  tracking_allocator thread_allocator;
+  mg_set_allocator((mg_allocator *)&allocator);
+
+  std::thread([] {
+    mg_value_destroy(mg_value_make_string("other thread"));
+  }).join();
+  mg_value *value = mg_value_make_string("process");
+  EXPECT_EQ(allocator.allocated.size(), 2u);
+
+  // The allocator of the thread takes precedence.
+  mg_set_thread_allocator((mg_allocator *)&thread_allocator);
+  mg_value *thread_value = mg_value_make_string("thread");
+  EXPECT_EQ(allocator.allocated.size(), 2u);
+  EXPECT_EQ(thread_allocator.allocated.size(), 2u);
+  mg_value_destroy(thread_value);
+  EXPECT_TRUE(thread_allocator.allocated.empty());
+  mg_set_thread_allocator(nullptr);
+
+  mg_value_destroy(value);
+  mg_set_allocator(nullptr);
+  ASSERT_MEMORY_OK();
+}
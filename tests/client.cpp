@@ -14,12 +14,19 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <memory>
 #include <optional>
 #include <random>
 #include <thread>
+#include <tuple>
 
 #include "mgclient.h"
+#include "mgclient.hpp"
 #include "mgcommon.h"
+#include "mgdecodepool.h"
 #include "mgsession.h"
 #include "mgsocket.h"
 
@@ -72,6 +79,11 @@ struct test_transport {
   void (*destroy)(struct mg_transport *);
   void (*suspend_until_ready_to_read)(struct mg_transport *);
   void (*suspend_until_ready_to_write)(struct mg_transport *);
+  ssize_t (*recv_some)(struct mg_transport *, char *buf, size_t len);
+  ssize_t (*try_send)(struct mg_transport *, const char *buf, size_t len);
+  ssize_t (*try_recv)(struct mg_transport *, char *buf, size_t len);
+  int (*send_vector)(struct mg_transport *, const mg_transport_buffer *buffers,
+                     size_t count);
   union {
     struct {
       SSL *ssl;
@@ -99,6 +111,10 @@ int __wrap_mg_secure_transport_init(int sockfd, const char *cert,
   ttransport->sockfd = sockfd;
   ttransport->send = mg_raw_transport_send;
   ttransport->recv = mg_raw_transport_recv;
+  ttransport->recv_some = mg_raw_transport_recv_some;
+  ttransport->try_send = mg_raw_transport_try_send;
+  ttransport->try_recv = mg_raw_transport_try_recv;
+  ttransport->send_vector = mg_raw_transport_send_vector;
   ttransport->destroy = test_transport_destroy;
   ttransport->suspend_until_ready_to_read = nullptr;
   ttransport->suspend_until_ready_to_write = nullptr;
@@ -140,6 +156,18 @@ int RecvData(int sockfd, char *buf, size_t len) {
   return 0;
 }
 
+struct TraceRecord {
+  mg_trace_event event;
+  int64_t query_id;
+  uint64_t timestamp_ns;
+};
+
+void RecordTrace(mg_trace_event event, int64_t query_id,
+                 uint64_t timestamp_ns, void *trace_data) {
+  static_cast<std::vector<TraceRecord> *>(trace_data)->push_back(
+      {event, query_id, timestamp_ns});
+}
+
 class ConnectTest : public ::testing::Test {
  protected:
   virtual void SetUp() override {
@@ -256,9 +284,9 @@ TEST_F(ConnectTest, HandshakeFail) {
     char handshake[20];
     ASSERT_EQ(RecvData(sockfd, handshake, 20), 0);
     ASSERT_EQ(std::string(handshake, 4), "\x60\x60\xB0\x17"s);
-    ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x00\x01\x04"s);
-    ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x00\x01"s);
-    ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x00"s);
+    ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x02\x02\x05"s);
+    ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x01\x04"s);
+    ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x01"s);
     ASSERT_EQ(std::string(handshake + 16, 4), "\x00\x00\x00\x00"s);
 
     // Send unsupported version to client.
@@ -286,9 +314,9 @@ TEST_F(ConnectTest, InitFail) {
       char handshake[20];
       ASSERT_EQ(RecvData(sockfd, handshake, 20), 0);
       ASSERT_EQ(std::string(handshake, 4), "\x60\x60\xB0\x17"s);
-      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x00\x01\x04"s);
-      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x00\x01"s);
-      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x00"s);
+      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x02\x02\x05"s);
+      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x01\x04"s);
+      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x01"s);
       ASSERT_EQ(std::string(handshake + 16, 4), "\x00\x00\x00\x00"s);
 
       uint32_t version = htobe32(1);
@@ -359,9 +387,9 @@ TEST_F(ConnectTest, InitFail_v4) {
       char handshake[20];
       ASSERT_EQ(RecvData(sockfd, handshake, 20), 0);
       ASSERT_EQ(std::string(handshake, 4), "\x60\x60\xB0\x17"s);
-      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x00\x01\x04"s);
-      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x00\x01"s);
-      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x00"s);
+      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x02\x02\x05"s);
+      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x01\x04"s);
+      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x01"s);
       ASSERT_EQ(std::string(handshake + 16, 4), "\x00\x00\x00\x00"s);
 
       uint32_t version = htobe32(0x0104);
@@ -437,9 +465,9 @@ TEST_F(ConnectTest, Success) {
       char handshake[20];
       ASSERT_EQ(RecvData(sockfd, handshake, 20), 0);
       ASSERT_EQ(std::string(handshake, 4), "\x60\x60\xB0\x17"s);
-      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x00\x01\x04"s);
-      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x00\x01"s);
-      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x00"s);
+      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x02\x02\x05"s);
+      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x01\x04"s);
+      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x01"s);
       ASSERT_EQ(std::string(handshake + 16, 4), "\x00\x00\x00\x00"s);
 
       uint32_t version = htobe32(1);
@@ -515,9 +543,9 @@ TEST_F(ConnectTest, Success_v4) {
       char handshake[20];
       ASSERT_EQ(RecvData(sockfd, handshake, 20), 0);
       ASSERT_EQ(std::string(handshake, 4), "\x60\x60\xB0\x17"s);
-      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x00\x01\x04"s);
-      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x00\x01"s);
-      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x00"s);
+      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x02\x02\x05"s);
+      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x01\x04"s);
+      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x01"s);
       ASSERT_EQ(std::string(handshake + 16, 4), "\x00\x00\x00\x00"s);
 
       uint32_t version = htobe32(0x0104);
@@ -583,9 +611,100 @@ TEST_F(ConnectTest, Success_v4) {
   mg_session_params_set_port(params, port);
   mg_session_params_set_username(params, "user");
   mg_session_params_set_password(params, "pass");
+  std::vector<TraceRecord> trace;
+  mg_session_params_set_trace_callback(params, RecordTrace);
+  mg_session_params_set_trace_data(params, &trace);
+  mg_session *session;
+  ASSERT_EQ(mg_connect_ca(params, &session, (mg_allocator *)&allocator), 0);
+  EXPECT_EQ(mg_session_status(session), MG_SESSION_READY);
+  ASSERT_EQ(trace.size(), 2u);
+  EXPECT_EQ(trace[0].event, MG_TRACE_EVENT_CONNECT);
+  EXPECT_EQ(trace[1].event, MG_TRACE_EVENT_HANDSHAKE);
+  EXPECT_EQ(trace[1].query_id, 0);
+  mg_session_params_destroy(params);
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(ConnectTest, Success_v5_2) {
+  RunServer([](int sockfd) {
+    // Perform handshake.
+    {
+      char handshake[20];
+      ASSERT_EQ(RecvData(sockfd, handshake, 20), 0);
+      ASSERT_EQ(std::string(handshake, 4), "\x60\x60\xB0\x17"s);
+      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x02\x02\x05"s);
+
+      uint32_t version = htobe32(0x0205);
+      ASSERT_EQ(SendData(sockfd, (char *)&version, 4), 0);
+    }
+
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    ASSERT_TRUE(session);
+    mg_session_set_version(session, 5);
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    // Read HELLO message, which carries no authentication since Bolt 5.1.
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_HELLO);
+
+      mg_message_hello *msg_hello = message->hello_v;
+      ASSERT_EQ(mg_map_size(msg_hello->extra), 1u);
+      const mg_value *user_agent_val =
+          mg_map_at(msg_hello->extra, "user_agent");
+      ASSERT_TRUE(user_agent_val);
+      ASSERT_EQ(mg_value_get_type(user_agent_val), MG_VALUE_TYPE_STRING);
+
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    // Read LOGON message.
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_LOGON);
+
+      mg_message_logon *msg_logon = message->logon_v;
+      {
+        ASSERT_EQ(mg_map_size(msg_logon->auth), 3u);
+
+        const mg_value *scheme_val = mg_map_at(msg_logon->auth, "scheme");
+        ASSERT_TRUE(scheme_val);
+        ASSERT_EQ(mg_value_get_type(scheme_val), MG_VALUE_TYPE_STRING);
+        const mg_string *scheme = mg_value_string(scheme_val);
+        ASSERT_EQ(std::string(scheme->data, scheme->size), "basic");
+
+        const mg_value *principal_val = mg_map_at(msg_logon->auth, "principal");
+        ASSERT_TRUE(principal_val);
+        ASSERT_EQ(mg_value_get_type(principal_val), MG_VALUE_TYPE_STRING);
+        const mg_string *principal = mg_value_string(principal_val);
+        ASSERT_EQ(std::string(principal->data, principal->size), "user");
+      }
+
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    // Send SUCCESS messages for both of them.
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+
+    mg_session_destroy(session);
+  });
+  mg_session_params *params = mg_session_params_make();
+  mg_session_params_set_host(params, "127.0.0.1");
+  mg_session_params_set_port(params, port);
+  mg_session_params_set_username(params, "user");
+  mg_session_params_set_password(params, "pass");
   mg_session *session;
   ASSERT_EQ(mg_connect_ca(params, &session, (mg_allocator *)&allocator), 0);
   EXPECT_EQ(mg_session_status(session), MG_SESSION_READY);
+  EXPECT_EQ(session->version, 5);
+  EXPECT_EQ(session->minor_version, 2);
   mg_session_params_destroy(params);
   mg_session_destroy(session);
   ASSERT_MEMORY_OK();
@@ -598,9 +717,9 @@ TEST_F(ConnectTest, SuccessWithSSL) {
       char handshake[20];
       ASSERT_EQ(RecvData(sockfd, handshake, 20), 0);
       ASSERT_EQ(std::string(handshake, 4), "\x60\x60\xB0\x17"s);
-      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x00\x01\x04"s);
-      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x00\x01"s);
-      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x00"s);
+      ASSERT_EQ(std::string(handshake + 4, 4), "\x00\x02\x02\x05"s);
+      ASSERT_EQ(std::string(handshake + 8, 4), "\x00\x00\x01\x04"s);
+      ASSERT_EQ(std::string(handshake + 12, 4), "\x00\x00\x00\x01"s);
       ASSERT_EQ(std::string(handshake + 16, 4), "\x00\x00\x00\x00"s);
 
       uint32_t version = htobe32(1);
@@ -720,6 +839,10 @@ class RunTest : public ::testing::Test {
   void QueryRuntimeError(int version);
   void QueryDatabaseError(int version);
   void RunWithParams(int version);
+  void RunAndPull(int version);
+  void RunAndPullFailure(int version);
+  void Pipeline(int version);
+  void PreparedQuery(int version);
 };
 
 bool CheckColumns(const mg_result *result,
@@ -1514,32 +1637,15 @@ TEST_F(RunTest, RunWithParams_v1) { RunWithParams(1); }
 
 TEST_F(RunTest, RunWithParams_v4) { RunWithParams(4); }
 
-/////////// Tests for Bolt v4 ///////////
-
-mg_map *CreatePullInfo(int n = -1, std::optional<int> qid = std::nullopt) {
-  int capacity = qid ? 2 : 1;
-  mg_map *pull_info = mg_map_make_empty(capacity);
-  if (!pull_info) {
-    return nullptr;
-  }
-
-  mg_map_insert_unsafe(pull_info, "n", mg_value_make_integer(n));
-
-  if (qid) {
-    mg_map_insert_unsafe(pull_info, "qid", mg_value_make_integer(*qid));
-  }
-
-  return pull_info;
-}
-
-TEST_F(RunTest, MultipleResultPull) {
-  RunServer([](int sockfd) {
+void RunTest::RunAndPull(int version) {
+  RunServer([version](int sockfd) {
     mg_session *session = mg_session_init(&mg_system_allocator);
-    session->version = 4;
+    session->version = version;
     mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
                           &mg_system_allocator);
 
-    // Read RUN message.
+    // Both RUN and PULL must arrive before the server responds to any of
+    // them.
     {
       mg_message *message;
       ASSERT_EQ(mg_session_receive_message(session), 0);
@@ -1547,80 +1653,38 @@ TEST_F(RunTest, MultipleResultPull) {
       ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
       mg_message_run *msg_run = message->run_v;
       EXPECT_EQ(std::string(msg_run->statement->data, msg_run->statement->size),
-                "UNWIND [1, 2, 3] AS n RETURN n, n + 5 AS m");
-      ASSERT_EQ(mg_map_size(msg_run->parameters), 0u);
-      ASSERT_EQ(mg_map_size(msg_run->extra), 0u);
+                "UNWIND [1, 2, 3] AS n RETURN n");
       mg_message_destroy_ca(message, session->decoder_allocator);
     }
-
-    // Send SUCCESS to client.
-    {
-      mg_map *summary = mg_map_make_empty(2);
-      mg_list *fields = mg_list_make_empty(2);
-      mg_list_append(fields, mg_value_make_string("n"));
-      mg_list_append(fields, mg_value_make_string("m"));
-      mg_map_insert_unsafe(summary, "fields", mg_value_make_list(fields));
-      mg_map_insert_unsafe(summary, "result_available_after",
-                           mg_value_make_float(0.01));
-
-      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
-      mg_map_destroy(summary);
-    }
-
-    // Read PULL 1 message.
     {
       mg_message *message;
       ASSERT_EQ(mg_session_receive_message(session), 0);
       ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
       ASSERT_EQ(message->type, MG_MESSAGE_TYPE_PULL);
-      mg_message_pull *msg_pull = message->pull_v;
-      ASSERT_EQ(mg_map_size(msg_pull->extra), 1u);
-      const mg_value *n_val = mg_map_at(msg_pull->extra, "n");
-      ASSERT_TRUE(n_val);
-      ASSERT_EQ(n_val->type, MG_VALUE_TYPE_INTEGER);
-      ASSERT_EQ(mg_value_integer(n_val), 1);
+      if (version == 4) {
+        mg_message_pull *pull_message = message->pull_v;
+        ASSERT_TRUE(pull_message->extra);
+        ASSERT_EQ(mg_map_size(pull_message->extra), 1u);
+      }
       mg_message_destroy_ca(message, session->decoder_allocator);
     }
 
-    const auto send_record = [&](int i) {
-      mg_list *fields = mg_list_make_empty(2);
-      mg_list_append(fields, mg_value_make_integer(i));
-      mg_list_append(fields, mg_value_make_integer(i + 5));
-      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
-      mg_list_destroy(fields);
-    };
-
-    // Send 1 RECORD message to client
-    send_record(1);
-
-    // Send SUCCESS with has_more set to true.
-    {
-      mg_map *metadata = mg_map_make_empty(1);
-      mg_map_insert_unsafe(metadata, "has_more", mg_value_make_bool(true));
-      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
-      mg_map_destroy(metadata);
-    }
-
-    // Read PULL rest of messages.
+    // Send SUCCESS for RUN.
     {
-      mg_message *message;
-      ASSERT_EQ(mg_session_receive_message(session), 0);
-      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
-      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_PULL);
-      mg_message_pull *msg_pull = message->pull_v;
-      ASSERT_EQ(mg_map_size(msg_pull->extra), 1u);
-      const mg_value *n_val = mg_map_at(msg_pull->extra, "n");
-      ASSERT_TRUE(n_val);
-      ASSERT_EQ(n_val->type, MG_VALUE_TYPE_INTEGER);
-      ASSERT_EQ(mg_value_integer(n_val), -1);
-      mg_message_destroy_ca(message, session->decoder_allocator);
+      mg_map *summary = mg_map_make_empty(1);
+      mg_list *fields = mg_list_make_empty(1);
+      mg_list_append(fields, mg_value_make_string("n"));
+      mg_map_insert_unsafe(summary, "fields", mg_value_make_list(fields));
+      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
+      mg_map_destroy(summary);
     }
 
-    // Send 2 RECORD messages to client.
-    {
-      for (int i = 2; i <= 3; ++i) {
-        send_record(i);
-      }
+    // Send 3 RECORD messages to client.
+    for (int i = 1; i <= 3; ++i) {
+      mg_list *fields = mg_list_make_empty(1);
+      mg_list_append(fields, mg_value_make_integer(i));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
     }
 
     // Send SUCCESS with execution summary.
@@ -1635,510 +1699,2856 @@ TEST_F(RunTest, MultipleResultPull) {
     mg_session_destroy(session);
   });
 
-  session->version = 4;
-
-  ASSERT_EQ(
-      mg_session_run(session, "UNWIND [1, 2, 3] AS n RETURN n, n + 5 AS m",
-                     nullptr, nullptr, nullptr, nullptr),
-      0);
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+  session->version = version;
 
-  {
-    mg_map *pull_info = CreatePullInfo(1);
-    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
-    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
-    mg_map_destroy(pull_info);
-  }
+  const mg_list *columns;
+  ASSERT_EQ(mg_session_run_and_pull(session, "UNWIND [1, 2, 3] AS n RETURN n",
+                                    nullptr, nullptr, nullptr, &columns,
+                                    nullptr),
+            0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+  ASSERT_EQ(mg_list_size(columns), 1u);
 
   mg_result *result;
-  const auto checkResults = [&](const int i) {
+  for (int i = 1; i <= 3; ++i) {
     ASSERT_EQ(mg_session_fetch(session, &result), 1);
-    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
-
-    ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
-
     const mg_list *row = mg_result_row(result);
-    EXPECT_EQ(mg_list_size(row), 2u);
-    EXPECT_EQ(mg_value_get_type(mg_list_at(row, 0)), MG_VALUE_TYPE_INTEGER);
+    ASSERT_EQ(mg_list_size(row), 1u);
     EXPECT_EQ(mg_value_integer(mg_list_at(row, 0)), i);
-
-    EXPECT_EQ(mg_value_get_type(mg_list_at(row, 1)), MG_VALUE_TYPE_INTEGER);
-    EXPECT_EQ(mg_value_integer(mg_list_at(row, 1)), i + 5);
-  };
-
-  // Check first result
-  checkResults(1);
-
-  ASSERT_EQ(mg_session_fetch(session, &result), 0);
-  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
-  const mg_map *summary = mg_result_summary(result);
-  ASSERT_TRUE(summary);
-  const mg_value *has_more = mg_map_at(summary, "has_more");
-  ASSERT_TRUE(has_more);
-  ASSERT_EQ(mg_value_get_type(has_more), MG_VALUE_TYPE_BOOL);
-  ASSERT_TRUE(mg_value_bool(has_more));
-
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
-
-  // Pull rest of the results
-  {
-    mg_map *pull_info = CreatePullInfo(-1);
-    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
-    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
-    mg_map_destroy(pull_info);
-  }
-
-  // Check results.
-  for (int i = 2; i <= 3; ++i) {
-    checkResults(i);
   }
 
   ASSERT_EQ(mg_session_fetch(session, &result), 0);
-  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n"}));
   ASSERT_TRUE(CheckSummary(result, 0.01));
   ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
 
-  ASSERT_EQ(mg_session_fetch(session, &result), MG_ERROR_BAD_CALL);
-  ASSERT_EQ(mg_session_pull(session, nullptr), MG_ERROR_BAD_CALL);
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
-
   mg_session_destroy(session);
   StopServer();
   ASSERT_MEMORY_OK();
 }
 
-TEST_F(RunTest, TransactionBasic) {
-  RunServer([](int sockfd) {
+TEST_F(RunTest, RunAndPull_v1) { RunAndPull(1); }
+
+TEST_F(RunTest, RunAndPull_v4) { RunAndPull(4); }
+
+void RunTest::RunAndPullFailure(int version) {
+  RunServer([version](int sockfd) {
     mg_session *session = mg_session_init(&mg_system_allocator);
-    session->version = 4;
+    session->version = version;
     mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
                           &mg_system_allocator);
 
-    // Read BEGIN message
+    // Read RUN and PULL.
     {
       mg_message *message;
       ASSERT_EQ(mg_session_receive_message(session), 0);
       ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
-      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_BEGIN);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
       mg_message_destroy_ca(message, session->decoder_allocator);
     }
-
-    // Send SUCCESS to client
-    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
-
-    // Read RUN message.
     {
       mg_message *message;
       ASSERT_EQ(mg_session_receive_message(session), 0);
       ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
-      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
-      mg_message_run *msg_run = message->run_v;
-      EXPECT_EQ(std::string(msg_run->statement->data, msg_run->statement->size),
-                "MATCH (n) RETURN n");
-      ASSERT_EQ(mg_map_size(msg_run->parameters), 0u);
-      ASSERT_TRUE(msg_run->extra);
-      ASSERT_EQ(mg_map_size(msg_run->extra), 0u);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_PULL);
       mg_message_destroy_ca(message, session->decoder_allocator);
     }
 
-    // Send SUCCESS to client.
+    // Send FAILURE for RUN, and IGNORED for PULL.
     {
       mg_map *summary = mg_map_make_empty(2);
-      mg_list *fields = mg_list_make_empty(1);
-      mg_list_append(fields, mg_value_make_string("n"));
-      mg_map_insert_unsafe(summary, "fields", mg_value_make_list(fields));
-      mg_map_insert_unsafe(summary, "qid", mg_value_make_integer(0));
-      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
+      mg_map_insert_unsafe(
+          summary, "code",
+          mg_value_make_string("Memgraph.ClientError.Statement.SyntaxError"));
+      mg_map_insert_unsafe(summary, "message",
+                           mg_value_make_string("Unbound variable: m"));
+      ASSERT_EQ(mg_session_send_failure_message(session, summary), 0);
       mg_map_destroy(summary);
     }
+    ASSERT_EQ(mg_session_send_ignored_message(session), 0);
 
-    // Read PULL_ALL.
+    // Client must send ACK_FAILURE or RESET now.
     {
       mg_message *message;
       ASSERT_EQ(mg_session_receive_message(session), 0);
       ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
-      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_PULL);
-      mg_message_pull *pull_message = message->pull_v;
-      ASSERT_TRUE(pull_message->extra);
-      ASSERT_EQ(mg_map_size(pull_message->extra), 1u);
+      ASSERT_EQ(message->type, version == 1 ? MG_MESSAGE_TYPE_ACK_FAILURE
+                                            : MG_MESSAGE_TYPE_RESET);
       mg_message_destroy_ca(message, session->decoder_allocator);
     }
 
-    // Send SUCCESS again because there are no results.
-    {
-      mg_map *metadata = mg_map_make_empty(1);
-      mg_map_insert_unsafe(metadata, "execution_time",
-                           mg_value_make_float(0.01));
-      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
-      mg_map_destroy(metadata);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = version;
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN m", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            MG_ERROR_CLIENT_ERROR);
+  ASSERT_THAT(std::string(mg_session_error(session)),
+              HasSubstr("Unbound variable: m"));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, RunAndPullFailure_v1) { RunAndPullFailure(1); }
+
+TEST_F(RunTest, RunAndPullFailure_v4) { RunAndPullFailure(4); }
+
+void ExpectMessage(mg_session *session, enum mg_message_type type) {
+  mg_message *message;
+  ASSERT_EQ(mg_session_receive_message(session), 0);
+  ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+  ASSERT_EQ(message->type, type);
+  mg_message_destroy_ca(message, session->decoder_allocator);
+}
+
+void SendRunSuccess(mg_session *session) {
+  mg_map *summary = mg_map_make_empty(1);
+  mg_list *fields = mg_list_make_empty(1);
+  mg_list_append(fields, mg_value_make_string("n"));
+  mg_map_insert_unsafe(summary, "fields", mg_value_make_list(fields));
+  ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
+  mg_map_destroy(summary);
+}
+
+void SendRecordsAndSummary(mg_session *session, int count) {
+  for (int i = 1; i <= count; ++i) {
+    mg_list *fields = mg_list_make_empty(1);
+    mg_list_append(fields, mg_value_make_integer(i));
+    ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+    mg_list_destroy(fields);
+  }
+  mg_map *metadata = mg_map_make_empty(1);
+  mg_map_insert_unsafe(metadata, "execution_time", mg_value_make_float(0.01));
+  ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
+  mg_map_destroy(metadata);
+}
+
+void RunTest::Pipeline(int version) {
+  RunServer([version](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = version;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    // All of the queries must arrive before the server responds to any of
+    // them.
+    for (int i = 0; i < 3; ++i) {
+      ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+      ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    }
+    for (int i = 1; i <= 3; ++i) {
+      SendRunSuccess(session);
+      SendRecordsAndSummary(session, i);
     }
 
-    {
+    mg_session_destroy(session);
+  });
+
+  session->version = version;
+
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(mg_session_pipeline_run(session, "UNWIND range(1, $n) AS n "
+                                               "RETURN n",
+                                      nullptr, nullptr),
+              0);
+  }
+  ASSERT_EQ(mg_session_pipeline_pending(session), 3);
+  ASSERT_EQ(mg_session_run(session, "RETURN 1", nullptr, nullptr, nullptr,
+                           nullptr),
+            MG_ERROR_BAD_CALL);
+
+  for (int i = 1; i <= 3; ++i) {
+    const mg_list *columns;
+    ASSERT_EQ(mg_session_pipeline_next(session, &columns, nullptr), 0);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+    ASSERT_EQ(mg_session_pipeline_pending(session), 3 - i);
+    ASSERT_EQ(mg_list_size(columns), 1u);
+
+    mg_result *result;
+    for (int j = 1; j <= i; ++j) {
+      ASSERT_EQ(mg_session_fetch(session, &result), 1);
+      EXPECT_EQ(mg_value_integer(mg_list_at(mg_result_row(result), 0)), j);
+    }
+    ASSERT_EQ(mg_session_fetch(session, &result), 0);
+    ASSERT_TRUE(CheckSummary(result, 0.01));
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+  }
+  ASSERT_EQ(mg_session_pipeline_next(session, nullptr, nullptr),
+            MG_ERROR_BAD_CALL);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, Pipeline_v1) { Pipeline(1); }
+
+TEST_F(RunTest, Pipeline_v4) { Pipeline(4); }
+
+void RunTest::PreparedQuery(int version) {
+  // Lengths around each of the string header sizes.
+  std::vector<std::string> statements;
+  for (size_t length : {15, 16, 300, 70000}) {
+    statements.push_back("RETURN $n" + std::string(length - 9, ' '));
+  }
+
+  RunServer([version, statements](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = version;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    auto expect_run = [session](const std::string &statement, int64_t n) {
       mg_message *message;
       ASSERT_EQ(mg_session_receive_message(session), 0);
       ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
-      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_ROLLBACK);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
+      mg_message_run *msg_run = message->run_v;
+      EXPECT_EQ(std::string(msg_run->statement->data, msg_run->statement->size),
+                statement);
+      ASSERT_EQ(mg_map_size(msg_run->parameters), 1u);
+      const mg_value *param = mg_map_at(msg_run->parameters, "n");
+      ASSERT_TRUE(param);
+      EXPECT_EQ(mg_value_integer(param), n);
       mg_message_destroy_ca(message, session->decoder_allocator);
-    }
+    };
 
-    {
-      mg_map *metadata = mg_map_make_empty(1);
-      mg_map_insert_unsafe(metadata, "execution_time",
-                           mg_value_make_float(0.01));
-      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
-      mg_map_destroy(metadata);
+    for (size_t i = 0; i < statements.size(); ++i) {
+      expect_run(statements[i], (int64_t)i);
+      ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    }
+    for (size_t i = 0; i < statements.size(); ++i) {
+      SendRunSuccess(session);
+      SendRecordsAndSummary(session, 1);
     }
 
+    expect_run(statements[0], 10);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 1);
+
+    expect_run(statements[0], 20);
+    SendRunSuccess(session);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRecordsAndSummary(session, 1);
+
     mg_session_destroy(session);
   });
 
-  session->version = 4;
-
-  ASSERT_EQ(mg_session_begin_transaction(session, nullptr), 0);
+  session->version = version;
 
-  ASSERT_EQ(mg_session_run(session, "MATCH (n) RETURN n", nullptr, nullptr,
-                           nullptr, nullptr),
-            0);
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+  auto fetch_all = [this] {
+    mg_result *result;
+    ASSERT_EQ(mg_session_fetch(session, &result), 1);
+    ASSERT_EQ(mg_session_fetch(session, &result), 0);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+  };
+  auto make_params = [](int64_t n) {
+    mg_map *params = mg_map_make_empty(1);
+    mg_map_insert_unsafe(params, "n", mg_value_make_integer(n));
+    return params;
+  };
 
-  mg_result *result;
-  ASSERT_EQ(mg_session_rollback_transaction(session, &result),
-            MG_ERROR_BAD_CALL);
+  std::vector<mg_prepared_query *> prepared;
+  for (const std::string &statement : statements) {
+    prepared.push_back(mg_prepared_query_make(statement.c_str()));
+    ASSERT_TRUE(prepared.back());
+  }
 
-  ASSERT_EQ(mg_session_pull(session, nullptr), 0);
-  ASSERT_EQ(mg_session_fetch(session, &result), 0);
-  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n"}));
-  ASSERT_TRUE(CheckSummary(result, 0.01));
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+  for (size_t i = 0; i < prepared.size(); ++i) {
+    mg_map *params = make_params((int64_t)i);
+    ASSERT_EQ(mg_session_pipeline_run_prepared(session, prepared[i], params,
+                                               nullptr),
+              0);
+    mg_map_destroy(params);
+  }
+  for (size_t i = 0; i < prepared.size(); ++i) {
+    ASSERT_EQ(mg_session_pipeline_next(session, nullptr, nullptr), 0);
+    fetch_all();
+  }
 
-  ASSERT_EQ(mg_session_fetch(session, &result), MG_ERROR_BAD_CALL);
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+  {
+    mg_map *params = make_params(10);
+    const mg_list *columns;
+    ASSERT_EQ(mg_session_run_and_pull_prepared(session, prepared[0], params,
+                                               nullptr, nullptr, &columns,
+                                               nullptr),
+              0);
+    mg_map_destroy(params);
+    ASSERT_EQ(mg_list_size(columns), 1u);
+    fetch_all();
+  }
 
-  ASSERT_EQ(mg_session_rollback_transaction(session, &result), 0);
+  {
+    mg_map *params = make_params(20);
+    ASSERT_EQ(mg_session_run_prepared(session, prepared[0], params, nullptr,
+                                      nullptr, nullptr),
+              0);
+    mg_map_destroy(params);
+    ASSERT_EQ(mg_session_pull(session, nullptr), 0);
+    fetch_all();
+  }
 
+  for (mg_prepared_query *query : prepared) {
+    mg_prepared_query_destroy(query);
+  }
   mg_session_destroy(session);
   StopServer();
   ASSERT_MEMORY_OK();
 }
 
-TEST_F(RunTest, TransactionWithMultipleRuns) {
-  RunServer([](int sockfd) {
+TEST_F(RunTest, PreparedQuery_v1) { PreparedQuery(1); }
+
+TEST_F(RunTest, PreparedQuery_v4) { PreparedQuery(4); }
+
+int WriteRowsParam(mg_param_writer *writer, void *data) {
+  int64_t rows = *(int64_t *)data;
+  MG_RETURN_IF_FAILED(mg_param_writer_begin_map(writer, 1));
+  MG_RETURN_IF_FAILED(mg_param_writer_write_string(writer, 4, "rows"));
+  MG_RETURN_IF_FAILED(mg_param_writer_begin_list(writer, (uint32_t)rows));
+  for (int64_t i = 0; i < rows; ++i) {
+    MG_RETURN_IF_FAILED(mg_param_writer_begin_list(writer, 2));
+    MG_RETURN_IF_FAILED(mg_param_writer_write_integer(writer, i));
+    MG_RETURN_IF_FAILED(mg_param_writer_write_string(writer, 3, "row"));
+  }
+  return 0;
+}
+
+TEST_F(RunTest, RunWithWriter) {
+  const int64_t rows = 10000;
+  RunServer([rows](int sockfd) {
     mg_session *session = mg_session_init(&mg_system_allocator);
     session->version = 4;
     mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
                           &mg_system_allocator);
 
-    const auto read_run_message =
-        [&](const std::string_view expected_statement) {
-          mg_message *message;
-          ASSERT_EQ(mg_session_receive_message(session), 0);
-          ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
-          ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
-          mg_message_run *msg_run = message->run_v;
-          EXPECT_EQ(std::string_view(msg_run->statement->data,
-                                     msg_run->statement->size),
-                    expected_statement);
-          ASSERT_EQ(mg_map_size(msg_run->parameters), 0u);
-          ASSERT_EQ(mg_map_size(msg_run->extra), 0u);
-          mg_message_destroy_ca(message, session->decoder_allocator);
-        };
+    for (int query = 0; query < 2; ++query) {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
+      const mg_map *params = message->run_v->parameters;
+      ASSERT_EQ(mg_map_size(params), 1u);
+      const mg_list *list = mg_value_list(mg_map_at(params, "rows"));
+      ASSERT_EQ(mg_list_size(list), (uint32_t)rows);
+      for (uint32_t i = 0; i < mg_list_size(list); ++i) {
+        const mg_list *row = mg_value_list(mg_list_at(list, i));
+        ASSERT_EQ(mg_list_size(row), 2u);
+        ASSERT_EQ(mg_value_integer(mg_list_at(row, 0)), i);
+        const mg_string *name = mg_value_string(mg_list_at(row, 1));
+        ASSERT_EQ(std::string(mg_string_data(name), mg_string_size(name)),
+                  "row");
+      }
+      mg_message_destroy_ca(message, session->decoder_allocator);
+      ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+      SendRunSuccess(session);
+      SendRecordsAndSummary(session, 0);
+    }
 
-    const auto send_success_run = [&](const int qid) {
-      mg_map *summary = mg_map_make_empty(2);
-      mg_list *fields = mg_list_make_empty(2);
-      mg_list_append(fields, mg_value_make_string("n"));
-      mg_list_append(fields, mg_value_make_string("m"));
-      mg_map_insert_unsafe(summary, "fields", mg_value_make_list(fields));
-      mg_map_insert_unsafe(summary, "qid", mg_value_make_integer(qid));
-      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
-      mg_map_destroy(summary);
-    };
+    mg_session_destroy(session);
+  });
 
-    const auto read_pull_message = [&](const int expected_n,
-                                       const std::optional<int> expected_qid =
-                                           std::nullopt) {
+  session->version = 4;
+
+  int64_t data = rows;
+  ASSERT_EQ(mg_session_pipeline_run_with_writer(
+                session, "UNWIND $rows AS row RETURN row", WriteRowsParam,
+                &data, nullptr),
+            0);
+  ASSERT_EQ(mg_session_run_and_pull_with_writer(
+                session, "UNWIND $rows AS row RETURN row", WriteRowsParam,
+                &data, nullptr, nullptr, nullptr, nullptr),
+            MG_ERROR_BAD_CALL);
+  for (int query = 0; query < 2; ++query) {
+    mg_result *result;
+    if (query == 0) {
+      ASSERT_EQ(mg_session_pipeline_next(session, nullptr, nullptr), 0);
+    } else {
+      ASSERT_EQ(mg_session_run_and_pull_with_writer(
+                    session, "UNWIND $rows AS row RETURN row", WriteRowsParam,
+                    &data, nullptr, nullptr, nullptr, nullptr),
+                0);
+    }
+    ASSERT_EQ(mg_session_fetch(session, &result), 0);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+  }
+
+  // A failed callback leaves the query partially sent.
+  ASSERT_EQ(mg_session_run_and_pull_with_writer(
+                session, "RETURN 1",
+                [](mg_param_writer *, void *) { return MG_ERROR_CLIENT_ERROR; },
+                nullptr, nullptr, nullptr, nullptr, nullptr),
+            MG_ERROR_CLIENT_ERROR);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_BAD);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, BatchedPull) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    auto expect_pull = [session](int64_t n) {
       mg_message *message;
       ASSERT_EQ(mg_session_receive_message(session), 0);
       ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
       ASSERT_EQ(message->type, MG_MESSAGE_TYPE_PULL);
-      mg_message_pull *msg_pull = message->pull_v;
-
-      const uint32_t extra_size = expected_qid ? 2u : 1u;
-      ASSERT_EQ(mg_map_size(msg_pull->extra), extra_size);
-      const mg_value *n_val = mg_map_at(msg_pull->extra, "n");
+      const mg_value *n_val = mg_map_at(message->pull_v->extra, "n");
       ASSERT_TRUE(n_val);
-      ASSERT_EQ(n_val->type, MG_VALUE_TYPE_INTEGER);
-      ASSERT_EQ(mg_value_integer(n_val), expected_n);
-
-      if (expected_qid) {
-        const mg_value *qid_val = mg_map_at(msg_pull->extra, "qid");
-        ASSERT_TRUE(qid_val);
-        ASSERT_EQ(qid_val->type, MG_VALUE_TYPE_INTEGER);
-        ASSERT_EQ(mg_value_integer(qid_val), *expected_qid);
-      }
+      ASSERT_EQ(mg_value_integer(n_val), n);
       mg_message_destroy_ca(message, session->decoder_allocator);
     };
-
-    const auto send_record = [&](const int run_idx, const int result_idx) {
-      mg_list *fields = mg_list_make_empty(2);
-      const int n = 2 * run_idx + 1 + result_idx;
-      mg_list_append(fields, mg_value_make_integer(n));
-      mg_list_append(fields, mg_value_make_integer(n + 5));
-      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
-      mg_list_destroy(fields);
+    auto send_records = [session](int from, int to) {
+      for (int i = from; i <= to; ++i) {
+        mg_list *fields = mg_list_make_empty(1);
+        mg_list_append(fields, mg_value_make_integer(i));
+        ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+        mg_list_destroy(fields);
+      }
     };
 
-    const auto send_has_more_success = [&]() {
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    expect_pull(2);
+    SendRunSuccess(session);
+
+    send_records(1, 2);
+    {
       mg_map *metadata = mg_map_make_empty(1);
-      mg_map_insert_unsafe(metadata, "has_more", mg_value_make_bool(true));
+      mg_map_insert_unsafe(metadata, "has_more", mg_value_make_bool(1));
       ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
       mg_map_destroy(metadata);
-    };
+    }
 
-    const auto send_success_with_summary = [&]() {
-      mg_map *metadata = mg_map_make_empty(1);
+    expect_pull(2);
+    send_records(3, 3);
+    {
+      mg_map *metadata = mg_map_make_empty(2);
+      mg_map_insert_unsafe(metadata, "has_more", mg_value_make_bool(0));
       mg_map_insert_unsafe(metadata, "execution_time",
                            mg_value_make_float(0.01));
       ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
       mg_map_destroy(metadata);
-    };
-
-    // Read BEGIN message
-    {
-      mg_message *message;
-      ASSERT_EQ(mg_session_receive_message(session), 0);
-      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
-      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_BEGIN);
-      mg_message_destroy_ca(message, session->decoder_allocator);
     }
 
-    // Send SUCCESS to client
-    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
-
-    // Read first RUN message.
-    read_run_message("UNWIND [1, 2] AS n RETURN n, n + 5 AS m");
+    mg_session_destroy(session);
+  });
 
-    const int r1_qid = 0;
-    // Send SUCCESS to client.
-    send_success_run(r1_qid);
+  session->version = 4;
+  session->fetch_size = 2;
 
-    // Read second RUN message
-    read_run_message("UNWIND [3, 4] AS n RETURN n, n + 5 AS m");
+  ASSERT_EQ(mg_session_run_and_pull(session, "UNWIND [1, 2, 3] AS n RETURN n",
+                                    nullptr, nullptr, nullptr, nullptr,
+                                    nullptr),
+            0);
+  ASSERT_EQ(mg_session_pipeline_run(session, "RETURN 1", nullptr, nullptr),
+            MG_ERROR_BAD_CALL);
 
-    const int r2_qid = 1;
-    // Send SUCCESS to client.
-    send_success_run(r2_qid);
+  mg_result *result;
+  for (int i = 1; i <= 3; ++i) {
+    ASSERT_EQ(mg_session_fetch(session, &result), 1);
+    EXPECT_EQ(mg_value_integer(mg_list_at(mg_result_row(result), 0)), i);
+  }
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
 
-    // Read PULL 1 message from first run
-    read_pull_message(1, r1_qid);
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
 
-    // Send 1 RECORD message to client
-    send_record(0, 0);
+TEST_F(RunTest, Discard) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
 
-    // Send SUCCESS with has_more set to true.
-    send_has_more_success();
+    auto expect_request = [session](enum mg_message_type type, int64_t n) {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, type);
+      const mg_map *extra = type == MG_MESSAGE_TYPE_PULL
+                                ? message->pull_v->extra
+                                : message->discard_v->extra;
+      const mg_value *n_val = mg_map_at(extra, "n");
+      ASSERT_TRUE(n_val);
+      ASSERT_EQ(mg_value_integer(n_val), n);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    };
+    auto send_summary = [session](int has_more) {
+      mg_map *metadata = mg_map_make_empty(2);
+      mg_map_insert_unsafe(metadata, "has_more", mg_value_make_bool(has_more));
+      mg_map_insert_unsafe(metadata, "execution_time",
+                           mg_value_make_float(0.01));
+      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
+      mg_map_destroy(metadata);
+    };
 
-    // Read third RUN
-    read_run_message("UNWIND [5, 6] AS n RETURN n, n + 5 AS m");
+    // Results that weren't pulled aren't sent at all.
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    SendRunSuccess(session);
+    expect_request(MG_MESSAGE_TYPE_DISCARD, -1);
+    send_summary(0);
+
+    // The rest of the batch is skipped, and the next one isn't pulled.
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    expect_request(MG_MESSAGE_TYPE_PULL, 2);
+    SendRunSuccess(session);
+    for (int i = 1; i <= 2; ++i) {
+      mg_list *fields = mg_list_make_empty(1);
+      mg_list_append(fields, mg_value_make_integer(i));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
+    }
+    send_summary(1);
+    expect_request(MG_MESSAGE_TYPE_DISCARD, -1);
+    send_summary(0);
 
-    const int r3_qid = 2;
-    // Send SUCCESS to client
-    send_success_run(r3_qid);
+    mg_session_destroy(session);
+  });
 
-    // Read PULL all messages from second run
-    read_pull_message(-1, r2_qid);
+  session->version = 4;
+  session->fetch_size = 2;
+  mg_result *result;
+  ASSERT_EQ(mg_session_discard(session, nullptr, &result), MG_ERROR_BAD_CALL);
 
-    // Send records from second run
-    send_record(1, 0);
-    send_record(1, 1);
+  ASSERT_EQ(mg_session_run(session, "UNWIND range(1, 1000000) AS n RETURN n",
+                           nullptr, nullptr, nullptr, nullptr),
+            0);
+  ASSERT_EQ(mg_session_discard(session, nullptr, &result), 0);
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
 
-    // Send SUCCESS with execution summary for second run
-    send_success_with_summary();
+  ASSERT_EQ(mg_session_run_and_pull(session,
+                                    "UNWIND range(1, 1000000) AS n RETURN n",
+                                    nullptr, nullptr, nullptr, nullptr,
+                                    nullptr),
+            0);
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  ASSERT_EQ(mg_session_discard(session, nullptr, &result), 0);
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
 
-    // Read PULL 1 message from third run
-    read_pull_message(1, r3_qid);
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
 
-    // Send first record from third run
-    send_record(2, 0);
+TEST_F(RunTest, DumpAndReplay) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
 
-    // Send SUCCESS with has more in third run
-    send_has_more_success();
+    auto send_row = [session](int i) {
+      mg_list *nested = mg_list_make_empty(2);
+      mg_list_append(nested, mg_value_make_integer(i));
+      mg_list_append(nested, mg_value_make_string("nested"));
+      std::string text(100, (char)('a' + i));
+      mg_list *fields = mg_list_make_empty(3);
+      mg_list_append(fields, mg_value_make_integer(i));
+      mg_list_append(fields, mg_value_make_string(text.c_str()));
+      mg_list_append(fields, mg_value_make_list(nested));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
+    };
+    auto send_batch_end = [session]() {
+      mg_map *metadata = mg_map_make_empty(1);
+      mg_map_insert_unsafe(metadata, "has_more", mg_value_make_bool(1));
+      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
+      mg_map_destroy(metadata);
+    };
 
-    // Read PULL all messages from first run
-    read_pull_message(-1, r1_qid);
+    // Rows of both batches are written, the first one isn't.
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    for (int i = 0; i < 3; ++i) {
+      send_row(i);
+    }
+    send_batch_end();
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    send_row(3);
+    SendRecordsAndSummary(session, 0);
 
-    // Send record from first run
-    send_record(0, 1);
+    mg_session_destroy(session);
+  });
 
-    // Send SUCCESS with execution summary for first run
-    send_success_with_summary();
+  const std::string path = testing::TempDir() + "mgclient_dump_test";
+  session->version = 4;
+  session->fetch_size = 3;
+  mg_result *result;
+  ASSERT_EQ(mg_session_dump(session, path.c_str(), &result),
+            MG_ERROR_BAD_CALL);
 
-    // Read PULL all messages from third run
-    read_pull_message(-1);
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            0);
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  ASSERT_EQ(mg_session_dump(session, path.c_str(), &result), 0);
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
 
-    // Send record from third run
-    send_record(2, 1);
+  mg_replay *replay;
+  ASSERT_EQ(mg_replay_open(path.c_str(), &replay), 0);
+  const mg_list *columns = mg_replay_columns(replay);
+  ASSERT_EQ(mg_list_size(columns), 1u);
+  const mg_string *column = mg_value_string(mg_list_at(columns, 0));
+  EXPECT_EQ(std::string(mg_string_data(column), mg_string_size(column)), "n");
+  for (int pass = 0; pass < 2; ++pass) {
+    const mg_list *row;
+    for (int i = 1; i <= 3; ++i) {
+      ASSERT_EQ(mg_replay_fetch(replay, &row), 1);
+      ASSERT_EQ(mg_list_size(row), 3u);
+      EXPECT_EQ(mg_value_integer(mg_list_at(row, 0)), i);
+      const mg_string *str = mg_value_string(mg_list_at(row, 1));
+      EXPECT_EQ(std::string(mg_string_data(str), mg_string_size(str)),
+                std::string(100, (char)('a' + i)));
+      const mg_list *nested = mg_value_list(mg_list_at(row, 2));
+      ASSERT_EQ(mg_list_size(nested), 2u);
+      EXPECT_EQ(mg_value_integer(mg_list_at(nested, 0)), i);
+    }
+    ASSERT_EQ(mg_replay_fetch(replay, &row), 0);
+    mg_replay_rewind(replay);
+  }
+  mg_replay_destroy(replay);
+
+  // A truncated dump fails when the missing row is fetched.
+  std::ifstream in(path, std::ios::binary);
+  std::string data((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  in.close();
+  std::ofstream(path, std::ios::binary | std::ios::trunc)
+      .write(data.data(), (std::streamsize)data.size() - 1);
+  ASSERT_EQ(mg_replay_open(path.c_str(), &replay), 0);
+  const mg_list *row;
+  ASSERT_EQ(mg_replay_fetch(replay, &row), 1);
+  ASSERT_EQ(mg_replay_fetch(replay, &row), 1);
+  ASSERT_EQ(mg_replay_fetch(replay, &row), MG_ERROR_DECODING_FAILED);
+  EXPECT_EQ(std::string(mg_replay_error(replay)), "unexpected end of dump");
+  mg_replay_destroy(replay);
+
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << "MATCH (n)";
+  ASSERT_EQ(mg_replay_open(path.c_str(), &replay), MG_ERROR_DECODING_FAILED);
+  std::remove(path.c_str());
+  ASSERT_EQ(mg_replay_open(path.c_str(), &replay), MG_ERROR_FILE_FAILURE);
+}
 
-    // Send SUCCESS with execution summary for third run
-    send_success_with_summary();
+TEST_F(RunTest, FetchLazy) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
 
-    // Read COMMIT transaction
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
     {
-      mg_message *message;
-      ASSERT_EQ(mg_session_receive_message(session), 0);
-      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
-      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_COMMIT);
-      mg_message_destroy_ca(message, session->decoder_allocator);
+      mg_list *nested = mg_list_make_empty(2);
+      mg_list_append(nested, mg_value_make_string("ignored"));
+      mg_list_append(nested, mg_value_make_float(3.14));
+      mg_map *properties = mg_map_make_empty(1);
+      mg_map_insert_unsafe(properties, "list", mg_value_make_list(nested));
+      mg_list *fields = mg_list_make_empty(3);
+      mg_list_append(fields, mg_value_make_map(properties));
+      mg_list_append(fields, mg_value_make_integer(42));
+      mg_list_append(fields, mg_value_make_string("hello"));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
     }
-
-    send_success_with_summary();
+    SendRecordsAndSummary(session, 0);
 
     mg_session_destroy(session);
   });
 
   session->version = 4;
 
-  ASSERT_EQ(mg_session_begin_transaction(session, nullptr), 0);
+  ASSERT_EQ(mg_session_run_and_pull(session, "RETURN {}, 42, 'hello'", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            0);
+
+  mg_result *result;
+  ASSERT_EQ(mg_session_fetch_lazy(session, &result), 1);
+  EXPECT_FALSE(mg_result_row(result));
+  mg_lazy_row *row = mg_result_row_lazy(result);
+  ASSERT_TRUE(row);
+  ASSERT_EQ(mg_lazy_row_size(row), 3u);
+
+  // Only the accessed fields get decoded.
+  const mg_value *value;
+  ASSERT_EQ(mg_lazy_row_at(row, 2, &value), 0);
+  ASSERT_EQ(mg_value_get_type(value), MG_VALUE_TYPE_STRING);
+  EXPECT_EQ(std::string(mg_string_data(mg_value_string(value)),
+                        mg_string_size(mg_value_string(value))),
+            "hello");
+  ASSERT_EQ(mg_lazy_row_at(row, 1, &value), 0);
+  EXPECT_EQ(mg_value_integer(value), 42);
+  EXPECT_FALSE(row->values[0]);
+
+  const mg_value *again;
+  ASSERT_EQ(mg_lazy_row_at(row, 1, &again), 0);
+  EXPECT_EQ(again, value);
+  ASSERT_EQ(mg_lazy_row_at(row, 3, &value), MG_ERROR_BAD_CALL);
+
+  ASSERT_EQ(mg_session_fetch_lazy(session, &result), 0);
+  EXPECT_FALSE(mg_result_row_lazy(result));
+  ASSERT_TRUE(CheckSummary(result, 0.01));
   ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
 
-  int64_t r1_qid;
-  ASSERT_EQ(mg_session_run(session, "UNWIND [1, 2] AS n RETURN n, n + 5 AS m",
-                           nullptr, nullptr, nullptr, &r1_qid),
-            0);
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
 
-  int64_t r2_qid;
-  ASSERT_EQ(mg_session_run(session, "UNWIND [3, 4] AS n RETURN n, n + 5 AS m",
-                           nullptr, nullptr, nullptr, &r2_qid),
-            0);
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+TEST_F(RunTest, FetchLazyTyped) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
 
-  // Pull first result from first run
-  {
-    mg_map *pull_info = CreatePullInfo(1, r1_qid);
-    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
-    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
-    mg_map_destroy(pull_info);
-  }
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    {
+      mg_list *fields = mg_list_make_empty(6);
+      mg_list_append(fields, mg_value_make_null());
+      mg_list_append(fields, mg_value_make_bool(1));
+      mg_list_append(fields, mg_value_make_integer(-300));
+      mg_list_append(fields, mg_value_make_float(2.5));
+      mg_list_append(fields, mg_value_make_string("hello"));
+      mg_list_append(fields, mg_value_make_list(mg_list_make_empty(0)));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
+    }
+    SendRecordsAndSummary(session, 0);
 
-  mg_result *result;
-  const auto check_result = [&](const int run_idx, const int result_idx) {
-    ASSERT_EQ(mg_session_fetch(session, &result), 1);
-    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+    mg_session_destroy(session);
+  });
 
-    ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+  session->version = 4;
 
-    const int n = 2 * run_idx + 1 + result_idx;
-    const mg_list *row = mg_result_row(result);
-    EXPECT_EQ(mg_list_size(row), 2u);
-    EXPECT_EQ(mg_value_get_type(mg_list_at(row, 0)), MG_VALUE_TYPE_INTEGER);
-    EXPECT_EQ(mg_value_integer(mg_list_at(row, 0)), n);
+  ASSERT_EQ(mg_session_run_and_pull(session, "RETURN null, true, -300, 2.5, "
+                                             "'hello', []",
+                                    nullptr, nullptr, nullptr, nullptr,
+                                    nullptr),
+            0);
 
-    EXPECT_EQ(mg_value_get_type(mg_list_at(row, 1)), MG_VALUE_TYPE_INTEGER);
-    EXPECT_EQ(mg_value_integer(mg_list_at(row, 1)), n + 5);
-  };
+  mg_result *result;
+  ASSERT_EQ(mg_session_fetch_lazy(session, &result), 1);
+  mg_lazy_row *row = mg_result_row_lazy(result);
+  ASSERT_TRUE(row);
+  ASSERT_EQ(mg_lazy_row_size(row), 6u);
+
+  EXPECT_EQ(mg_lazy_row_type_at(row, 0), MG_VALUE_TYPE_NULL);
+  EXPECT_EQ(mg_lazy_row_type_at(row, 1), MG_VALUE_TYPE_BOOL);
+  EXPECT_EQ(mg_lazy_row_type_at(row, 2), MG_VALUE_TYPE_INTEGER);
+  EXPECT_EQ(mg_lazy_row_type_at(row, 3), MG_VALUE_TYPE_FLOAT);
+  EXPECT_EQ(mg_lazy_row_type_at(row, 4), MG_VALUE_TYPE_STRING);
+  EXPECT_EQ(mg_lazy_row_type_at(row, 5), MG_VALUE_TYPE_LIST);
+  EXPECT_EQ(mg_lazy_row_type_at(row, 6), MG_VALUE_TYPE_UNKNOWN);
+
+  int bool_value;
+  ASSERT_EQ(mg_lazy_row_bool_at(row, 1, &bool_value), 0);
+  EXPECT_EQ(bool_value, 1);
+  int64_t integer_value;
+  ASSERT_EQ(mg_lazy_row_integer_at(row, 2, &integer_value), 0);
+  EXPECT_EQ(integer_value, -300);
+  double float_value;
+  ASSERT_EQ(mg_lazy_row_float_at(row, 3, &float_value), 0);
+  EXPECT_EQ(float_value, 2.5);
+  const char *data;
+  uint32_t size;
+  ASSERT_EQ(mg_lazy_row_string_at(row, 4, &data, &size), 0);
+  EXPECT_EQ(std::string(data, size), "hello");
+
+  // Mismatches don't affect the row.
+  EXPECT_EQ(mg_lazy_row_integer_at(row, 0, &integer_value),
+            MG_ERROR_TYPE_MISMATCH);
+  EXPECT_EQ(mg_lazy_row_string_at(row, 5, &data, &size),
+            MG_ERROR_TYPE_MISMATCH);
+  EXPECT_EQ(mg_lazy_row_float_at(row, 2, &float_value),
+            MG_ERROR_TYPE_MISMATCH);
+  EXPECT_EQ(mg_lazy_row_bool_at(row, 6, &bool_value), MG_ERROR_BAD_CALL);
+  const mg_value *value;
+  ASSERT_EQ(mg_lazy_row_at(row, 2, &value), 0);
+  EXPECT_EQ(mg_value_integer(value), -300);
+  ASSERT_EQ(mg_lazy_row_integer_at(row, 2, &integer_value), 0);
+  EXPECT_EQ(integer_value, -300);
+
+  ASSERT_EQ(mg_session_fetch_lazy(session, &result), 0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
 
-  // Check first result
-  check_result(0, 0);
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
 
-  // First run should have more results
-  {
-    ASSERT_EQ(mg_session_fetch(session, &result), 0);
-    ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
-    const mg_map *summary = mg_result_summary(result);
-    ASSERT_TRUE(summary);
-    const mg_value *has_more = mg_map_at(summary, "has_more");
-    ASSERT_TRUE(has_more);
-    ASSERT_EQ(mg_value_get_type(has_more), MG_VALUE_TYPE_BOOL);
-    ASSERT_TRUE(mg_value_bool(has_more));
+TEST_F(RunTest, DecodeThreads) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
 
-    ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
-  }
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 1000);
 
-  // Send third RUN
-  int64_t r3_qid;
-  ASSERT_EQ(mg_session_run(session, "UNWIND [5, 6] AS n RETURN n, n + 5 AS m",
-                           nullptr, nullptr, nullptr, &r3_qid),
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 3);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+  // The decoding threads allocate through the allocator of the process, never
+  // through the tracking allocator of the session.
+  ASSERT_EQ(mg_decode_pool_init(session, 3, &session->decode_pool), 0);
+
+  ASSERT_EQ(mg_session_run_and_pull(session, "UNWIND range(1, 1000) AS n "
+                                             "RETURN n",
+                                    nullptr, nullptr, nullptr, nullptr,
+                                    nullptr),
             0);
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
 
-  // Pull all of the results from second run
+  auto check_row = [](mg_result *result, int64_t expected) {
+    const mg_list *row = mg_result_row(result);
+    ASSERT_TRUE(row);
+    ASSERT_EQ(mg_list_size(row), 1u);
+    EXPECT_EQ(mg_value_integer(mg_list_at(row, 0)), expected);
+  };
+
+  mg_result *result;
+  for (int64_t i = 1; i <= 500; ++i) {
+    ASSERT_EQ(mg_session_fetch(session, &result), 1);
+    check_row(result, i);
+  }
+  // A row read ahead can still be fetched lazily.
+  ASSERT_EQ(mg_session_fetch_lazy(session, &result), 1);
+  EXPECT_FALSE(mg_result_row(result));
   {
-    mg_map *pull_info = CreatePullInfo(-1, r2_qid);
-    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
-    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
-    mg_map_destroy(pull_info);
+    const mg_value *value;
+    ASSERT_EQ(mg_lazy_row_at(mg_result_row_lazy(result), 0, &value), 0);
+    EXPECT_EQ(mg_value_integer(value), 501);
+  }
+  for (int64_t i = 502; i <= 1000; ++i) {
+    ASSERT_EQ(mg_session_fetch(session, &result), 1);
+    check_row(result, i);
   }
-
-  check_result(1, 0);
-  check_result(1, 1);
-
-  // Second run shouldn't have more results
   ASSERT_EQ(mg_session_fetch(session, &result), 0);
-  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
   ASSERT_TRUE(CheckSummary(result, 0.01));
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
 
-  // Pull one result from third run
-  {
-    mg_map *pull_info = CreatePullInfo(1, r3_qid);
-    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
+  // Lazy fetches don't go through the pool.
+  ASSERT_EQ(mg_session_run_and_pull(session, "UNWIND range(1, 3) AS n "
+                                             "RETURN n",
+                                    nullptr, nullptr, nullptr, nullptr,
+                                    nullptr),
+            0);
+  for (int64_t i = 1; i <= 3; ++i) {
+    ASSERT_EQ(mg_session_fetch_lazy(session, &result), 1);
+    const mg_value *value;
+    ASSERT_EQ(mg_lazy_row_at(mg_result_row_lazy(result), 0, &value), 0);
+    EXPECT_EQ(mg_value_integer(value), i);
+  }
+  ASSERT_EQ(mg_session_fetch_lazy(session, &result), 0);
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, Stats) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    {
+      mg_map *summary = mg_map_make_empty(2);
+      mg_list *fields = mg_list_make_empty(1);
+      mg_list_append(fields, mg_value_make_string("n"));
+      mg_map_insert_unsafe(summary, "fields", mg_value_make_list(fields));
+      mg_map_insert_unsafe(summary, "t_first", mg_value_make_integer(3));
+      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
+      mg_map_destroy(summary);
+    }
+    for (int i = 1; i <= 5; ++i) {
+      mg_list *fields = mg_list_make_empty(1);
+      mg_list_append(fields, mg_value_make_integer(i));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
+    }
+    {
+      mg_map *summary = mg_map_make_empty(1);
+      mg_map_insert_unsafe(summary, "t_last", mg_value_make_integer(7));
+      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
+      mg_map_destroy(summary);
+    }
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 100);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+  mg_session_stats stats;
+  ASSERT_EQ(mg_session_get_stats(session, &stats), MG_ERROR_BAD_CALL);
+  session->collect_stats = 1;
+  ASSERT_EQ(mg_session_get_stats(session, &stats), 0);
+  EXPECT_EQ(stats.bytes_sent, 0u);
+  EXPECT_EQ(stats.t_first, -1);
+  EXPECT_EQ(stats.t_last, -1);
+
+  ASSERT_EQ(mg_session_run_and_pull(session, "UNWIND range(1, 5) AS n "
+                                             "RETURN n",
+                                    nullptr, nullptr, nullptr, nullptr,
+                                    nullptr),
+            0);
+  mg_result *result;
+  ASSERT_EQ(mg_session_fetch_lazy(session, &result), 1);
+  while (mg_session_fetch(session, &result) == 1) {
+  }
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  ASSERT_EQ(mg_session_get_stats(session, &stats), 0);
+  EXPECT_EQ(stats.rows_fetched, 5u);
+  EXPECT_EQ(stats.t_first, 3);
+  EXPECT_EQ(stats.t_last, 7);
+  // RUN and PULL are sent together.
+  EXPECT_EQ(stats.chunks_sent, 2u);
+  EXPECT_EQ(stats.send_calls, 1u);
+  EXPECT_GT(stats.bytes_sent, 0u);
+  EXPECT_EQ(stats.chunks_received, 7u);
+  EXPECT_GE(stats.recv_calls, 1u);
+  EXPECT_GT(stats.bytes_received, 7 * 2u);
+  EXPECT_GT(stats.decoder_bytes_allocated, 0u);
+  EXPECT_GT(stats.decode_ns, 0u);
+  EXPECT_GT(stats.read_wait_ns, 0u);
+
+  // Rows decoded by the pool are counted too.
+  ASSERT_EQ(mg_decode_pool_init(session, 2, &session->decode_pool), 0);
+  ASSERT_EQ(mg_session_run_and_pull(session, "UNWIND range(1, 100) AS n "
+                                             "RETURN n",
+                                    nullptr, nullptr, nullptr, nullptr,
+                                    nullptr),
+            0);
+  while (mg_session_fetch(session, &result) == 1) {
+  }
+  mg_session_stats after;
+  ASSERT_EQ(mg_session_get_stats(session, &after), 0);
+  EXPECT_EQ(after.rows_fetched, 105u);
+  EXPECT_EQ(after.chunks_received, stats.chunks_received + 102);
+  EXPECT_GT(after.decode_ns, stats.decode_ns);
+  EXPECT_GT(after.decoder_bytes_allocated, stats.decoder_bytes_allocated);
+  EXPECT_EQ(after.t_first, -1);
+  EXPECT_EQ(after.t_last, -1);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, RowCopy) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    for (int i = 0; i < 2; ++i) {
+      mg_map *properties = mg_map_make_empty(MG_MAP_INDEX_THRESHOLD);
+      for (int j = 0; j < MG_MAP_INDEX_THRESHOLD; ++j) {
+        std::string key = "key" + std::to_string(j);
+        mg_map_insert_unsafe(properties, key.c_str(),
+                             mg_value_make_string(key.c_str()));
+      }
+      mg_list *fields = mg_list_make_empty(2);
+      mg_list_append(fields, mg_value_make_integer(i));
+      mg_list_append(fields, mg_value_make_map(properties));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
+    }
+    SendRecordsAndSummary(session, 0);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN id(n), n",
+                                    nullptr, nullptr, nullptr, nullptr,
+                                    nullptr),
+            0);
+
+  std::vector<mg_row *> rows;
+  mg_result *result;
+  while (mg_session_fetch(session, &result) == 1) {
+    mg_row *row = mg_result_row_copy(result);
+    ASSERT_TRUE(row);
+    for (uint32_t i = 0; i < mg_list_size(mg_result_row(result)); ++i) {
+      EXPECT_TRUE(mg_value_equal(mg_list_at(mg_row_values(row), i),
+                                 mg_list_at(mg_result_row(result), i)));
+    }
+    rows.push_back(row);
+  }
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  EXPECT_FALSE(mg_result_row_copy(result));
+
+  // Copied rows outlive the messages they were decoded from.
+  ASSERT_EQ(rows.size(), 2u);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const mg_list *values = mg_row_values(rows[i]);
+    ASSERT_EQ(mg_list_size(values), 2u);
+    EXPECT_EQ(mg_value_integer(mg_list_at(values, 0)), (int64_t)i);
+    const mg_map *properties = mg_value_map(mg_list_at(values, 1));
+    const mg_string *value = mg_value_string(mg_map_at(properties, "key7"));
+    EXPECT_EQ(std::string(mg_string_data(value), mg_string_size(value)),
+              "key7");
+    mg_row_destroy(rows[i]);
+  }
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+void SendStringRecord(mg_session *session, size_t size) {
+  std::string data(size, 'x');
+  mg_list *fields = mg_list_make_empty(1);
+  mg_list_append(fields, mg_value_make_string2(
+                             mg_string_make2((uint32_t)size, data.data())));
+  ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+  mg_list_destroy(fields);
+}
+
+TEST_F(RunTest, MessageLimits) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendStringRecord(session, 200000);
+    for (int i = 0; i < 3; ++i) {
+      SendStringRecord(session, 10);
+    }
+    SendStringRecord(session, 2000);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+  session->shrink_after = 2;
+
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            0);
+  mg_result *result;
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  const size_t initial_capacity = MG_BOLT_MAX_CHUNK_SIZE;
+  EXPECT_GT(session->in_capacity, initial_capacity);
+  // The buffer shrinks when the third small message is received, after two
+  // of them fit into its initial size.
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  EXPECT_GT(session->in_capacity, initial_capacity);
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  EXPECT_EQ(session->in_capacity, initial_capacity);
+  const mg_string *value =
+      mg_value_string(mg_list_at(mg_result_row(result), 0));
+  EXPECT_EQ(std::string(mg_string_data(value), mg_string_size(value)),
+            std::string(10, 'x'));
+
+  session->max_message_size = 1000;
+  ASSERT_EQ(mg_session_fetch(session, &result), MG_ERROR_SIZE_EXCEEDED);
+  EXPECT_EQ(mg_session_status(session), MG_SESSION_BAD);
+  EXPECT_EQ(std::string(mg_session_error(session)),
+            "message exceeds the maximum size of 1000 bytes");
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, Arena) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendStringRecord(session, 10);
+    SendStringRecord(session, 5000);
+    SendStringRecord(session, 20);
+    SendRecordsAndSummary(session, 0);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+
+  mg_set_thread_allocator((mg_allocator *)&allocator);
+  mg_arena *arena = mg_arena_make(256);
+  mg_set_thread_allocator(nullptr);
+  ASSERT_TRUE(arena);
+  ASSERT_EQ(mg_session_set_arena(session, arena), 0);
+
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            0);
+  std::vector<const mg_list *> rows;
+  mg_result *result;
+  while (mg_session_fetch(session, &result) == 1) {
+    rows.push_back(mg_result_row(result));
+  }
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  EXPECT_FALSE(mg_result_row(result));
+
+  // Rows decoded into the arena outlive the messages they were decoded from.
+  const size_t sizes[] = {10, 5000, 20};
+  ASSERT_EQ(rows.size(), 3u);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    ASSERT_EQ(mg_list_size(rows[i]), 1u);
+    const mg_string *value = mg_value_string(mg_list_at(rows[i], 0));
+    EXPECT_EQ(std::string(mg_string_data(value), mg_string_size(value)),
+              std::string(sizes[i], 'x'));
+  }
+
+  mg_arena_reset(arena);
+  ASSERT_EQ(mg_session_set_arena(session, nullptr), 0);
+  mg_arena_destroy(arena);
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, PipelineFailure) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    for (int i = 0; i < 3; ++i) {
+      ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+      ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    }
+
+    // First query succeeds.
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 1);
+
+    // Second query fails and everything after it is ignored.
+    {
+      mg_map *summary = mg_map_make_empty(2);
+      mg_map_insert_unsafe(
+          summary, "code",
+          mg_value_make_string("Memgraph.ClientError.Statement.SyntaxError"));
+      mg_map_insert_unsafe(summary, "message",
+                           mg_value_make_string("Unbound variable: m"));
+      ASSERT_EQ(mg_session_send_failure_message(session, summary), 0);
+      mg_map_destroy(summary);
+    }
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_EQ(mg_session_send_ignored_message(session), 0);
+    }
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RESET);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+
+  ASSERT_EQ(mg_session_pipeline_run(session, "RETURN 1 AS n", nullptr, nullptr),
+            0);
+  ASSERT_EQ(mg_session_pipeline_run(session, "RETURN m", nullptr, nullptr), 0);
+  ASSERT_EQ(mg_session_pipeline_run(session, "RETURN 3 AS n", nullptr, nullptr),
+            0);
+
+  mg_result *result;
+  ASSERT_EQ(mg_session_pipeline_next(session, nullptr, nullptr), 0);
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+
+  ASSERT_EQ(mg_session_pipeline_next(session, nullptr, nullptr),
+            MG_ERROR_CLIENT_ERROR);
+  ASSERT_THAT(std::string(mg_session_error(session)),
+              HasSubstr("Unbound variable: m"));
+  ASSERT_EQ(mg_session_pipeline_pending(session), 0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, Trace) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    for (int i = 0; i < 3; ++i) {
+      ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+      ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    }
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 2);
+    {
+      mg_map *summary = mg_map_make_empty(2);
+      mg_map_insert_unsafe(
+          summary, "code",
+          mg_value_make_string("Memgraph.ClientError.Statement.SyntaxError"));
+      mg_map_insert_unsafe(summary, "message",
+                           mg_value_make_string("Unbound variable: m"));
+      ASSERT_EQ(mg_session_send_failure_message(session, summary), 0);
+      mg_map_destroy(summary);
+    }
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_EQ(mg_session_send_ignored_message(session), 0);
+    }
+    ExpectMessage(session, MG_MESSAGE_TYPE_RESET);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 0);
+
+    mg_session_destroy(session);
+  });
+
+  std::vector<TraceRecord> trace;
+  session->version = 4;
+  session->trace_callback = RecordTrace;
+  session->trace_data = &trace;
+
+  ASSERT_EQ(mg_session_pipeline_run(session, "RETURN 1 AS n", nullptr, nullptr),
+            0);
+  ASSERT_EQ(mg_session_pipeline_run(session, "RETURN m", nullptr, nullptr), 0);
+  ASSERT_EQ(mg_session_pipeline_run(session, "RETURN 3 AS n", nullptr, nullptr),
+            0);
+  mg_result *result;
+  ASSERT_EQ(mg_session_pipeline_next(session, nullptr, nullptr), 0);
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+  ASSERT_EQ(mg_session_pipeline_next(session, nullptr, nullptr),
+            MG_ERROR_CLIENT_ERROR);
+
+  // The third query was dropped with the second one.
+  ASSERT_EQ(mg_session_run_and_pull(session, "RETURN 4 AS n", nullptr, nullptr,
+                                    nullptr, nullptr, nullptr),
+            0);
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+
+  std::vector<std::pair<mg_trace_event, int64_t>> expected = {
+      {MG_TRACE_EVENT_RUN_SENT, 1},     {MG_TRACE_EVENT_RUN_SENT, 2},
+      {MG_TRACE_EVENT_RUN_SENT, 3},     {MG_TRACE_EVENT_RUN_SUCCESS, 1},
+      {MG_TRACE_EVENT_FIRST_RECORD, 1}, {MG_TRACE_EVENT_SUCCESS, 1},
+      {MG_TRACE_EVENT_FAILURE, 2},      {MG_TRACE_EVENT_RUN_SENT, 4},
+      {MG_TRACE_EVENT_RUN_SUCCESS, 4},  {MG_TRACE_EVENT_SUCCESS, 4}};
+  ASSERT_EQ(trace.size(), expected.size());
+  for (size_t i = 0; i < trace.size(); ++i) {
+    EXPECT_EQ(trace[i].event, expected[i].first);
+    EXPECT_EQ(trace[i].query_id, expected[i].second);
+    if (i > 0) {
+      EXPECT_GE(trace[i].timestamp_ns, trace[i - 1].timestamp_ns);
+    }
+  }
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+/////////// Tests for Bolt v4 ///////////
+
+mg_map *CreatePullInfo(int n = -1, std::optional<int> qid = std::nullopt) {
+  int capacity = qid ? 2 : 1;
+  mg_map *pull_info = mg_map_make_empty(capacity);
+  if (!pull_info) {
+    return nullptr;
+  }
+
+  mg_map_insert_unsafe(pull_info, "n", mg_value_make_integer(n));
+
+  if (qid) {
+    mg_map_insert_unsafe(pull_info, "qid", mg_value_make_integer(*qid));
+  }
+
+  return pull_info;
+}
+
+TEST_F(RunTest, MultipleResultPull) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    // Read RUN message.
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
+      mg_message_run *msg_run = message->run_v;
+      EXPECT_EQ(std::string(msg_run->statement->data, msg_run->statement->size),
+                "UNWIND [1, 2, 3] AS n RETURN n, n + 5 AS m");
+      ASSERT_EQ(mg_map_size(msg_run->parameters), 0u);
+      ASSERT_EQ(mg_map_size(msg_run->extra), 0u);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    // Send SUCCESS to client.
+    {
+      mg_map *summary = mg_map_make_empty(2);
+      mg_list *fields = mg_list_make_empty(2);
+      mg_list_append(fields, mg_value_make_string("n"));
+      mg_list_append(fields, mg_value_make_string("m"));
+      mg_map_insert_unsafe(summary, "fields", mg_value_make_list(fields));
+      mg_map_insert_unsafe(summary, "result_available_after",
+                           mg_value_make_float(0.01));
+
+      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
+      mg_map_destroy(summary);
+    }
+
+    // Read PULL 1 message.
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_PULL);
+      mg_message_pull *msg_pull = message->pull_v;
+      ASSERT_EQ(mg_map_size(msg_pull->extra), 1u);
+      const mg_value *n_val = mg_map_at(msg_pull->extra, "n");
+      ASSERT_TRUE(n_val);
+      ASSERT_EQ(n_val->type, MG_VALUE_TYPE_INTEGER);
+      ASSERT_EQ(mg_value_integer(n_val), 1);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    const auto send_record = [&](int i) {
+      mg_list *fields = mg_list_make_empty(2);
+      mg_list_append(fields, mg_value_make_integer(i));
+      mg_list_append(fields, mg_value_make_integer(i + 5));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
+    };
+
+    // Send 1 RECORD message to client
+    send_record(1);
+
+    // Send SUCCESS with has_more set to true.
+    {
+      mg_map *metadata = mg_map_make_empty(1);
+      mg_map_insert_unsafe(metadata, "has_more", mg_value_make_bool(true));
+      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
+      mg_map_destroy(metadata);
+    }
+
+    // Read PULL rest of messages.
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_PULL);
+      mg_message_pull *msg_pull = message->pull_v;
+      ASSERT_EQ(mg_map_size(msg_pull->extra), 1u);
+      const mg_value *n_val = mg_map_at(msg_pull->extra, "n");
+      ASSERT_TRUE(n_val);
+      ASSERT_EQ(n_val->type, MG_VALUE_TYPE_INTEGER);
+      ASSERT_EQ(mg_value_integer(n_val), -1);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    // Send 2 RECORD messages to client.
+    {
+      for (int i = 2; i <= 3; ++i) {
+        send_record(i);
+      }
+    }
+
+    // Send SUCCESS with execution summary.
+    {
+      mg_map *metadata = mg_map_make_empty(1);
+      mg_map_insert_unsafe(metadata, "execution_time",
+                           mg_value_make_float(0.01));
+      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
+      mg_map_destroy(metadata);
+    }
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+
+  ASSERT_EQ(
+      mg_session_run(session, "UNWIND [1, 2, 3] AS n RETURN n, n + 5 AS m",
+                     nullptr, nullptr, nullptr, nullptr),
+      0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+
+  {
+    mg_map *pull_info = CreatePullInfo(1);
+    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+    mg_map_destroy(pull_info);
+  }
+
+  mg_result *result;
+  const auto checkResults = [&](const int i) {
+    ASSERT_EQ(mg_session_fetch(session, &result), 1);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+
+    ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+
+    const mg_list *row = mg_result_row(result);
+    EXPECT_EQ(mg_list_size(row), 2u);
+    EXPECT_EQ(mg_value_get_type(mg_list_at(row, 0)), MG_VALUE_TYPE_INTEGER);
+    EXPECT_EQ(mg_value_integer(mg_list_at(row, 0)), i);
+
+    EXPECT_EQ(mg_value_get_type(mg_list_at(row, 1)), MG_VALUE_TYPE_INTEGER);
+    EXPECT_EQ(mg_value_integer(mg_list_at(row, 1)), i + 5);
+  };
+
+  // Check first result
+  checkResults(1);
+
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+  const mg_map *summary = mg_result_summary(result);
+  ASSERT_TRUE(summary);
+  const mg_value *has_more = mg_map_at(summary, "has_more");
+  ASSERT_TRUE(has_more);
+  ASSERT_EQ(mg_value_get_type(has_more), MG_VALUE_TYPE_BOOL);
+  ASSERT_TRUE(mg_value_bool(has_more));
+
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+
+  // Pull rest of the results
+  {
+    mg_map *pull_info = CreatePullInfo(-1);
+    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+    mg_map_destroy(pull_info);
+  }
+
+  // Check results.
+  for (int i = 2; i <= 3; ++i) {
+    checkResults(i);
+  }
+
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  ASSERT_EQ(mg_session_fetch(session, &result), MG_ERROR_BAD_CALL);
+  ASSERT_EQ(mg_session_pull(session, nullptr), MG_ERROR_BAD_CALL);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, TransactionBasic) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    // Read BEGIN message
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_BEGIN);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    // Send SUCCESS to client
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+
+    // Read RUN message.
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
+      mg_message_run *msg_run = message->run_v;
+      EXPECT_EQ(std::string(msg_run->statement->data, msg_run->statement->size),
+                "MATCH (n) RETURN n");
+      ASSERT_EQ(mg_map_size(msg_run->parameters), 0u);
+      ASSERT_TRUE(msg_run->extra);
+      ASSERT_EQ(mg_map_size(msg_run->extra), 0u);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    // Send SUCCESS to client.
+    {
+      mg_map *summary = mg_map_make_empty(2);
+      mg_list *fields = mg_list_make_empty(1);
+      mg_list_append(fields, mg_value_make_string("n"));
+      mg_map_insert_unsafe(summary, "fields", mg_value_make_list(fields));
+      mg_map_insert_unsafe(summary, "qid", mg_value_make_integer(0));
+      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
+      mg_map_destroy(summary);
+    }
+
+    // Read PULL_ALL.
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_PULL);
+      mg_message_pull *pull_message = message->pull_v;
+      ASSERT_TRUE(pull_message->extra);
+      ASSERT_EQ(mg_map_size(pull_message->extra), 1u);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    // Send SUCCESS again because there are no results.
+    {
+      mg_map *metadata = mg_map_make_empty(1);
+      mg_map_insert_unsafe(metadata, "execution_time",
+                           mg_value_make_float(0.01));
+      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
+      mg_map_destroy(metadata);
+    }
+
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_ROLLBACK);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    {
+      mg_map *metadata = mg_map_make_empty(1);
+      mg_map_insert_unsafe(metadata, "execution_time",
+                           mg_value_make_float(0.01));
+      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
+      mg_map_destroy(metadata);
+    }
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+
+  ASSERT_EQ(mg_session_begin_transaction(session, nullptr), 0);
+
+  ASSERT_EQ(mg_session_run(session, "MATCH (n) RETURN n", nullptr, nullptr,
+                           nullptr, nullptr),
+            0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+
+  mg_result *result;
+  ASSERT_EQ(mg_session_rollback_transaction(session, &result),
+            MG_ERROR_BAD_CALL);
+
+  ASSERT_EQ(mg_session_pull(session, nullptr), 0);
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n"}));
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  ASSERT_EQ(mg_session_fetch(session, &result), MG_ERROR_BAD_CALL);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  ASSERT_EQ(mg_session_rollback_transaction(session, &result), 0);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, TransactionWithMultipleRuns) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    const auto read_run_message =
+        [&](const std::string_view expected_statement) {
+          mg_message *message;
+          ASSERT_EQ(mg_session_receive_message(session), 0);
+          ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+          ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
+          mg_message_run *msg_run = message->run_v;
+          EXPECT_EQ(std::string_view(msg_run->statement->data,
+                                     msg_run->statement->size),
+                    expected_statement);
+          ASSERT_EQ(mg_map_size(msg_run->parameters), 0u);
+          ASSERT_EQ(mg_map_size(msg_run->extra), 0u);
+          mg_message_destroy_ca(message, session->decoder_allocator);
+        };
+
+    const auto send_success_run = [&](const int qid) {
+      mg_map *summary = mg_map_make_empty(2);
+      mg_list *fields = mg_list_make_empty(2);
+      mg_list_append(fields, mg_value_make_string("n"));
+      mg_list_append(fields, mg_value_make_string("m"));
+      mg_map_insert_unsafe(summary, "fields", mg_value_make_list(fields));
+      mg_map_insert_unsafe(summary, "qid", mg_value_make_integer(qid));
+      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
+      mg_map_destroy(summary);
+    };
+
+    const auto read_pull_message = [&](const int expected_n,
+                                       const std::optional<int> expected_qid =
+                                           std::nullopt) {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_PULL);
+      mg_message_pull *msg_pull = message->pull_v;
+
+      const uint32_t extra_size = expected_qid ? 2u : 1u;
+      ASSERT_EQ(mg_map_size(msg_pull->extra), extra_size);
+      const mg_value *n_val = mg_map_at(msg_pull->extra, "n");
+      ASSERT_TRUE(n_val);
+      ASSERT_EQ(n_val->type, MG_VALUE_TYPE_INTEGER);
+      ASSERT_EQ(mg_value_integer(n_val), expected_n);
+
+      if (expected_qid) {
+        const mg_value *qid_val = mg_map_at(msg_pull->extra, "qid");
+        ASSERT_TRUE(qid_val);
+        ASSERT_EQ(qid_val->type, MG_VALUE_TYPE_INTEGER);
+        ASSERT_EQ(mg_value_integer(qid_val), *expected_qid);
+      }
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    };
+
+    const auto send_record = [&](const int run_idx, const int result_idx) {
+      mg_list *fields = mg_list_make_empty(2);
+      const int n = 2 * run_idx + 1 + result_idx;
+      mg_list_append(fields, mg_value_make_integer(n));
+      mg_list_append(fields, mg_value_make_integer(n + 5));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
+    };
+
+    const auto send_has_more_success = [&]() {
+      mg_map *metadata = mg_map_make_empty(1);
+      mg_map_insert_unsafe(metadata, "has_more", mg_value_make_bool(true));
+      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
+      mg_map_destroy(metadata);
+    };
+
+    const auto send_success_with_summary = [&]() {
+      mg_map *metadata = mg_map_make_empty(1);
+      mg_map_insert_unsafe(metadata, "execution_time",
+                           mg_value_make_float(0.01));
+      ASSERT_EQ(mg_session_send_success_message(session, metadata), 0);
+      mg_map_destroy(metadata);
+    };
+
+    // Read BEGIN message
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_BEGIN);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    // Send SUCCESS to client
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+
+    // Read first RUN message.
+    read_run_message("UNWIND [1, 2] AS n RETURN n, n + 5 AS m");
+
+    const int r1_qid = 0;
+    // Send SUCCESS to client.
+    send_success_run(r1_qid);
+
+    // Read second RUN message
+    read_run_message("UNWIND [3, 4] AS n RETURN n, n + 5 AS m");
+
+    const int r2_qid = 1;
+    // Send SUCCESS to client.
+    send_success_run(r2_qid);
+
+    // Read PULL 1 message from first run
+    read_pull_message(1, r1_qid);
+
+    // Send 1 RECORD message to client
+    send_record(0, 0);
+
+    // Send SUCCESS with has_more set to true.
+    send_has_more_success();
+
+    // Read third RUN
+    read_run_message("UNWIND [5, 6] AS n RETURN n, n + 5 AS m");
+
+    const int r3_qid = 2;
+    // Send SUCCESS to client
+    send_success_run(r3_qid);
+
+    // Read PULL all messages from second run
+    read_pull_message(-1, r2_qid);
+
+    // Send records from second run
+    send_record(1, 0);
+    send_record(1, 1);
+
+    // Send SUCCESS with execution summary for second run
+    send_success_with_summary();
+
+    // Read PULL 1 message from third run
+    read_pull_message(1, r3_qid);
+
+    // Send first record from third run
+    send_record(2, 0);
+
+    // Send SUCCESS with has more in third run
+    send_has_more_success();
+
+    // Read PULL all messages from first run
+    read_pull_message(-1, r1_qid);
+
+    // Send record from first run
+    send_record(0, 1);
+
+    // Send SUCCESS with execution summary for first run
+    send_success_with_summary();
+
+    // Read PULL all messages from third run
+    read_pull_message(-1);
+
+    // Send record from third run
+    send_record(2, 1);
+
+    // Send SUCCESS with execution summary for third run
+    send_success_with_summary();
+
+    // Read COMMIT transaction
+    {
+      mg_message *message;
+      ASSERT_EQ(mg_session_receive_message(session), 0);
+      ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+      ASSERT_EQ(message->type, MG_MESSAGE_TYPE_COMMIT);
+      mg_message_destroy_ca(message, session->decoder_allocator);
+    }
+
+    send_success_with_summary();
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+
+  ASSERT_EQ(mg_session_begin_transaction(session, nullptr), 0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  int64_t r1_qid;
+  ASSERT_EQ(mg_session_run(session, "UNWIND [1, 2] AS n RETURN n, n + 5 AS m",
+                           nullptr, nullptr, nullptr, &r1_qid),
+            0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+
+  int64_t r2_qid;
+  ASSERT_EQ(mg_session_run(session, "UNWIND [3, 4] AS n RETURN n, n + 5 AS m",
+                           nullptr, nullptr, nullptr, &r2_qid),
+            0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+
+  // Pull first result from first run
+  {
+    mg_map *pull_info = CreatePullInfo(1, r1_qid);
+    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+    mg_map_destroy(pull_info);
+  }
+
+  mg_result *result;
+  const auto check_result = [&](const int run_idx, const int result_idx) {
+    ASSERT_EQ(mg_session_fetch(session, &result), 1);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+
+    ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+
+    const int n = 2 * run_idx + 1 + result_idx;
+    const mg_list *row = mg_result_row(result);
+    EXPECT_EQ(mg_list_size(row), 2u);
+    EXPECT_EQ(mg_value_get_type(mg_list_at(row, 0)), MG_VALUE_TYPE_INTEGER);
+    EXPECT_EQ(mg_value_integer(mg_list_at(row, 0)), n);
+
+    EXPECT_EQ(mg_value_get_type(mg_list_at(row, 1)), MG_VALUE_TYPE_INTEGER);
+    EXPECT_EQ(mg_value_integer(mg_list_at(row, 1)), n + 5);
+  };
+
+  // Check first result
+  check_result(0, 0);
+
+  // First run should have more results
+  {
+    ASSERT_EQ(mg_session_fetch(session, &result), 0);
+    ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+    const mg_map *summary = mg_result_summary(result);
+    ASSERT_TRUE(summary);
+    const mg_value *has_more = mg_map_at(summary, "has_more");
+    ASSERT_TRUE(has_more);
+    ASSERT_EQ(mg_value_get_type(has_more), MG_VALUE_TYPE_BOOL);
+    ASSERT_TRUE(mg_value_bool(has_more));
+
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+  }
+
+  // Send third RUN
+  int64_t r3_qid;
+  ASSERT_EQ(mg_session_run(session, "UNWIND [5, 6] AS n RETURN n, n + 5 AS m",
+                           nullptr, nullptr, nullptr, &r3_qid),
+            0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+
+  // Pull all of the results from second run
+  {
+    mg_map *pull_info = CreatePullInfo(-1, r2_qid);
+    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+    mg_map_destroy(pull_info);
+  }
+
+  check_result(1, 0);
+  check_result(1, 1);
+
+  // Second run shouldn't have more results
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+
+  // Pull one result from third run
+  {
+    mg_map *pull_info = CreatePullInfo(1, r3_qid);
+    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+    mg_map_destroy(pull_info);
+  }
+
+  check_result(2, 0);
+
+  // Third run should have more results
+  {
+    ASSERT_EQ(mg_session_fetch(session, &result), 0);
+    ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+    const mg_map *summary = mg_result_summary(result);
+    ASSERT_TRUE(summary);
+    const mg_value *has_more = mg_map_at(summary, "has_more");
+    ASSERT_TRUE(has_more);
+    ASSERT_EQ(mg_value_get_type(has_more), MG_VALUE_TYPE_BOOL);
+    ASSERT_TRUE(mg_value_bool(has_more));
+  }
+
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+
+  // Pull rest of the results from first run
+  {
+    mg_map *pull_info = CreatePullInfo(-1, r1_qid);
+    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
+    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+    mg_map_destroy(pull_info);
+  }
+
+  check_result(0, 1);
+
+  // First run shouldn't have more results
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+
+  // Pull rest of the results from third run
+  {
+    // If no qid is used, results from last run should be pulled
+    mg_map *pull_info = CreatePullInfo(-1);
+    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
     ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
     mg_map_destroy(pull_info);
   }
 
-  check_result(2, 0);
+  check_result(2, 1);
+
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
+  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  ASSERT_EQ(mg_session_fetch(session, &result), MG_ERROR_BAD_CALL);
+  ASSERT_EQ(mg_session_pull(session, nullptr), MG_ERROR_BAD_CALL);
+
+  ASSERT_EQ(mg_session_commit_transaction(session, &result), 0);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, Reset) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_BEGIN);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+    ExpectMessage(session, MG_MESSAGE_TYPE_RESET);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+    ExpectMessage(session, MG_MESSAGE_TYPE_RESET);
+    ASSERT_EQ(mg_session_send_failure_message(session, &mg_empty_map), 0);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+
+  ASSERT_EQ(mg_session_begin_transaction(session, nullptr), 0);
+  ASSERT_EQ(mg_session_reset(session), 0);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+  // The transaction was rolled back by the server.
+  mg_result *result;
+  ASSERT_EQ(mg_session_commit_transaction(session, &result),
+            MG_ERROR_BAD_CALL);
+
+  ASSERT_EQ(mg_session_reset(session), MG_ERROR_PROTOCOL_VIOLATION);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_BAD);
+  ASSERT_EQ(mg_session_reset(session), MG_ERROR_BAD_CALL);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+// Waits until the socket becomes readable (or writable, if `status` says so).
+void WaitForSocket(int sockfd, int status) {
+  struct pollfd p;
+  p.fd = sockfd;
+  p.events = status == MG_WANT_WRITE ? POLLOUT : POLLIN;
+  p.revents = 0;
+  ASSERT_EQ(mg_socket_poll(&p, 1, -1), 1);
+}
+
+TEST_F(RunTest, NonBlocking) {
+  std::promise<void> send_run_response;
+  std::promise<void> send_record_rest;
+  std::future<void> run_response_sent = send_run_response.get_future();
+  std::future<void> record_rest_sent = send_record_rest.get_future();
+  RunServer([&](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    run_response_sent.wait();
+    SendRunSuccess(session);
+
+    // RECORD with a single integer, sent in two parts.
+    const char record[] = {0x00,       0x04, (char)0xB1, 0x71,
+                           (char)0x91, 0x2A, 0x00,       0x00};
+    ASSERT_EQ(SendData(sockfd, record, 3), 0);
+    record_rest_sent.wait();
+    ASSERT_EQ(SendData(sockfd, record + 3, sizeof(record) - 3), 0);
+    SendRecordsAndSummary(session, 0);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+  session->sockfd = sc;
+  ASSERT_EQ(mg_session_socket(session), sc);
+  ASSERT_EQ(mg_session_set_nonblocking(session, 1), 0);
+
+  ASSERT_EQ(mg_session_pipeline_run(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr),
+            0);
+  const mg_list *columns;
+  ASSERT_EQ(mg_session_pipeline_next(session, &columns, nullptr),
+            MG_WANT_READ);
+  ASSERT_EQ(mg_session_pipeline_pending(session), 1);
+  send_run_response.set_value();
+
+  int status;
+  while ((status = mg_session_pipeline_next(session, &columns, nullptr)) ==
+         MG_WANT_READ) {
+    WaitForSocket(sc, status);
+  }
+  ASSERT_EQ(status, 0);
+  ASSERT_EQ(mg_list_size(columns), 1u);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
+
+  // At most a part of the record has arrived by now.
+  mg_result *result;
+  ASSERT_EQ(mg_session_fetch(session, &result), MG_WANT_READ);
+  send_record_rest.set_value();
+
+  while ((status = mg_session_fetch(session, &result)) == MG_WANT_READ) {
+    WaitForSocket(sc, status);
+  }
+  ASSERT_EQ(status, 1);
+  const mg_list *row = mg_result_row(result);
+  ASSERT_EQ(mg_list_size(row), 1u);
+  ASSERT_EQ(mg_value_integer(mg_list_at(row, 0)), 42);
+  // Framing of the next message starts over.
+  EXPECT_EQ(session->read_scanned, 0u);
+  EXPECT_EQ(session->read_scanned_size, 0u);
+
+  while ((status = mg_session_fetch(session, &result)) == MG_WANT_READ) {
+    WaitForSocket(sc, status);
+  }
+  ASSERT_EQ(status, 0);
+  ASSERT_TRUE(CheckSummary(result, 0.01));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, NonBlockingFailure) {
+  RunServer([](int sockfd) {
+    mg_session *session = mg_session_init(&mg_system_allocator);
+    session->version = 4;
+    mg_raw_transport_init(sockfd, (mg_raw_transport **)&session->transport,
+                          &mg_system_allocator);
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    {
+      mg_map *summary = mg_map_make_empty(2);
+      mg_map_insert_unsafe(
+          summary, "code",
+          mg_value_make_string("Memgraph.ClientError.Statement.SyntaxError"));
+      mg_map_insert_unsafe(summary, "message",
+                           mg_value_make_string("Unbound variable: m"));
+      ASSERT_EQ(mg_session_send_failure_message(session, summary), 0);
+      mg_map_destroy(summary);
+    }
+    ASSERT_EQ(mg_session_send_ignored_message(session), 0);
+    ExpectMessage(session, MG_MESSAGE_TYPE_RESET);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 1);
+
+    mg_session_destroy(session);
+  });
+
+  session->version = 4;
+  session->sockfd = sc;
+  ASSERT_EQ(mg_session_set_nonblocking(session, 1), 0);
+
+  int status;
+  ASSERT_EQ(mg_session_pipeline_run(session, "MATCH (n) RETURN m", nullptr,
+                                    nullptr),
+            0);
+  while ((status = mg_session_pipeline_next(session, nullptr, nullptr)) ==
+         MG_WANT_READ) {
+    WaitForSocket(sc, status);
+  }
+  ASSERT_EQ(status, MG_ERROR_CLIENT_ERROR);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  // Responses to the PULL and the RESET sent after the failure are skipped.
+  ASSERT_EQ(mg_session_pipeline_run(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr),
+            0);
+  while ((status = mg_session_pipeline_next(session, nullptr, nullptr)) ==
+         MG_WANT_READ) {
+    WaitForSocket(sc, status);
+  }
+  ASSERT_EQ(status, 0);
 
-  // Third run should have more results
+  mg_result *result;
+  int rows = 0;
+  while ((status = mg_session_fetch(session, &result)) != 0) {
+    if (status == MG_WANT_READ || status == MG_WANT_WRITE) {
+      WaitForSocket(sc, status);
+      continue;
+    }
+    ASSERT_EQ(status, 1);
+    ++rows;
+  }
+  ASSERT_EQ(rows, 1);
+  ASSERT_EQ(session->reset_pending, 0);
+
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+// Accepts a Bolt v4 connection on `sockfd`, which has to be logged in without
+// credentials.
+void AcceptBoltSession(int sockfd, mg_session **session) {
+  char handshake[20];
+  ASSERT_EQ(RecvData(sockfd, handshake, 20), 0);
+  uint32_t version = htobe32(0x0104);
+  ASSERT_EQ(SendData(sockfd, (char *)&version, 4), 0);
+
+  *session = mg_session_init(&mg_system_allocator);
+  ASSERT_TRUE(*session);
+  (*session)->version = 4;
+  mg_raw_transport_init(sockfd, (mg_raw_transport **)&(*session)->transport,
+                        &mg_system_allocator);
+  ExpectMessage(*session, MG_MESSAGE_TYPE_HELLO);
+  ASSERT_EQ(mg_session_send_success_message(*session, &mg_empty_map), 0);
+}
+
+// Receives a batch sent by `mg::BulkWriter` and checks that it holds the
+// `size` rows following `first`.
+void ExpectBatch(mg_session *session, int64_t first, uint32_t size) {
+  mg_message *message;
+  ASSERT_EQ(mg_session_receive_message(session), 0);
+  ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+  ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
+  const mg_string *statement = message->run_v->statement;
+  EXPECT_EQ(std::string(statement->data, statement->size),
+            "UNWIND $batch AS row CREATE (:Node {id: row[0]})");
+  const mg_value *batch = mg_map_at(message->run_v->parameters, "batch");
+  ASSERT_TRUE(batch);
+  const mg_list *rows = mg_value_list(batch);
+  ASSERT_EQ(mg_list_size(rows), size);
+  for (uint32_t i = 0; i < size; ++i) {
+    const mg_list *row = mg_value_list(mg_list_at(rows, i));
+    EXPECT_EQ(mg_value_integer(mg_list_at(row, 0)), first + i);
+  }
+  mg_message_destroy_ca(message, session->decoder_allocator);
+  ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+}
+
+using BulkRow = std::tuple<int64_t, std::string>;
+
+std::unique_ptr<mg::Client> ConnectClient(int port) {
+  mg::Client::Init();
+  mg::Client::Params params;
+  params.port = (uint16_t)port;
+  return mg::Client::Connect(params);
+}
+
+TEST_F(ConnectTest, CachedHostName) {
+  RunServer([this](int sockfd) {
+    for (int i = 0; i < 2; ++i) {
+      if (i > 0) {
+        sockfd = accept(ss, nullptr, nullptr);
+        ASSERT_GE(sockfd, 0);
+      }
+      mg_session *session;
+      ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+      mg_session_destroy(session);
+    }
+  });
+  mg_session_params *params = mg_session_params_make();
+  // "localhost" might resolve to IPv6 first, where nothing listens, in which
+  // case the IPv4 attempt starts as soon as that one is refused.
+  mg_session_params_set_host(params, "localhost");
+  mg_session_params_set_port(params, port);
+  mg_session_params_set_connect_timeout(params, 5000);
+  mg_session_params_set_dns_cache_ttl(params, 60000);
+  EXPECT_EQ(mg_session_params_get_connect_timeout(params), 5000);
+  EXPECT_EQ(mg_session_params_get_dns_cache_ttl(params), 60000);
+  for (int i = 0; i < 2; ++i) {
+    mg_session *session;
+    ASSERT_EQ(mg_connect_ca(params, &session, (mg_allocator *)&allocator), 0)
+        << mg_session_error(session);
+    EXPECT_EQ(mg_session_status(session), MG_SESSION_READY);
+    mg_session_destroy(session);
+  }
+  mg_session_params_destroy(params);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(ConnectTest, BulkWriter) {
+  RunServer([](int sockfd) {
+    mg_session *session;
+    ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+    // Rows are split by count, and then by size.
+    for (auto [first, size] : {std::pair<int64_t, uint32_t>{0, 3},
+                               {3, 3},
+                               {6, 2},
+                               {10, 2},
+                               {12, 1}}) {
+      ExpectBatch(session, first, size);
+      SendRunSuccess(session);
+      SendRecordsAndSummary(session, 0);
+    }
+    mg_session_destroy(session);
+  });
+
+  std::unique_ptr<mg::Client> client = ConnectClient(port);
+  ASSERT_TRUE(client);
+  mg::BulkWriter<BulkRow>::Params params;
+  params.batch_rows = 3;
+  params.max_pending = 2;
   {
-    ASSERT_EQ(mg_session_fetch(session, &result), 0);
-    ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
-    const mg_map *summary = mg_result_summary(result);
-    ASSERT_TRUE(summary);
-    const mg_value *has_more = mg_map_at(summary, "has_more");
-    ASSERT_TRUE(has_more);
-    ASSERT_EQ(mg_value_get_type(has_more), MG_VALUE_TYPE_BOOL);
-    ASSERT_TRUE(mg_value_bool(has_more));
+    mg::BulkWriter<BulkRow> writer(
+        *client, "UNWIND $batch AS row CREATE (:Node {id: row[0]})", params);
+    for (int64_t i = 0; i < 8; ++i) {
+      writer.Add({i, "node"});
+    }
+    writer.Finish();
+    EXPECT_EQ(writer.rows_written(), 8u);
   }
 
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+  // Each row takes 7 bytes: a list header, the id and a 4-byte string.
+  params.batch_bytes = 14;
+  {
+    mg::BulkWriter<BulkRow> writer(
+        *client, "UNWIND $batch AS row CREATE (:Node {id: row[0]})", params);
+    for (int64_t i = 10; i < 13; ++i) {
+      writer.Add({i, "node"});
+    }
+    writer.Finish();
+    EXPECT_EQ(writer.rows_written(), 3u);
+  }
+
+  client.reset();
+  StopServer();
+}
+
+TEST_F(ConnectTest, BulkWriterFailure) {
+  RunServer([](int sockfd) {
+    mg_session *session;
+    ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+    for (int64_t first = 0; first < 6; first += 2) {
+      ExpectBatch(session, first, 2);
+    }
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 0);
+    {
+      mg_map *summary = mg_map_make_empty(2);
+      mg_map_insert_unsafe(
+          summary, "code",
+          mg_value_make_string("Memgraph.ClientError.Schema.ConstraintError"));
+      mg_map_insert_unsafe(summary, "message",
+                           mg_value_make_string("duplicate id"));
+      ASSERT_EQ(mg_session_send_failure_message(session, summary), 0);
+      mg_map_destroy(summary);
+    }
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_EQ(mg_session_send_ignored_message(session), 0);
+    }
+    ExpectMessage(session, MG_MESSAGE_TYPE_RESET);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+    mg_session_destroy(session);
+  });
+
+  std::unique_ptr<mg::Client> client = ConnectClient(port);
+  ASSERT_TRUE(client);
+  mg::BulkWriter<BulkRow>::Params params;
+  params.batch_rows = 2;
+  mg::BulkWriter<BulkRow> writer(
+      *client, "UNWIND $batch AS row CREATE (:Node {id: row[0]})", params);
+  for (int64_t i = 0; i < 6; ++i) {
+    writer.Add({i, "node"});
+  }
+  ASSERT_THROW(writer.Finish(), mg::ClientException);
+  EXPECT_EQ(writer.rows_written(), 2u);
+  ASSERT_THROW(writer.Add({6, "node"}), mg::MgException);
+
+  StopServer();
+}
+
+TEST(BulkWriterTest, InvalidClients) {
+  mg::BulkWriter<BulkRow>::Params params;
+  const std::string statement =
+      "UNWIND $batch AS row CREATE (:Node {id: row[0]})";
+  EXPECT_THROW(mg::BulkWriter<BulkRow>({}, statement, params),
+               mg::ClientException);
+  EXPECT_THROW(mg::BulkWriter<BulkRow>({nullptr}, statement, params),
+               mg::ClientException);
+}
+
+struct Person {
+  std::string name;
+  int8_t age = 0;
+  std::optional<double> score;
+};
+
+template <>
+struct mg::RowBinding<Person> {
+  static constexpr auto fields =
+      std::make_tuple(mg::Field("name", &Person::name),
+                      mg::Field("age", &Person::age),
+                      mg::Field("score", &Person::score));
+};
+
+struct UnknownColumn {
+  int64_t id = 0;
+};
+
+template <>
+struct mg::RowBinding<UnknownColumn> {
+  static constexpr auto fields =
+      std::make_tuple(mg::Field("id", &UnknownColumn::id));
+};
+
+TEST_F(ConnectTest, FetchAs) {
+  RunServer([](int sockfd) {
+    mg_session *session;
+    ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    {
+      // Columns are in a different order than the fields.
+      mg_list *columns = mg_list_make_empty(3);
+      mg_list_append(columns, mg_value_make_string("score"));
+      mg_list_append(columns, mg_value_make_string("age"));
+      mg_list_append(columns, mg_value_make_string("name"));
+      mg_map *summary = mg_map_make_empty(1);
+      mg_map_insert_unsafe(summary, "fields", mg_value_make_list(columns));
+      ASSERT_EQ(mg_session_send_success_message(session, summary), 0);
+      mg_map_destroy(summary);
+    }
+    auto send_row = [session](mg_value *score, mg_value *age,
+                              const char *name) {
+      mg_list *fields = mg_list_make_empty(3);
+      mg_list_append(fields, score);
+      mg_list_append(fields, age);
+      mg_list_append(fields, mg_value_make_string(name));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
+    };
+    send_row(mg_value_make_float(0.5), mg_value_make_integer(30), "Alice");
+    send_row(mg_value_make_null(), mg_value_make_integer(40), "Bob");
+    send_row(mg_value_make_float(1.0), mg_value_make_string("50"), "Carol");
+    send_row(mg_value_make_float(1.0), mg_value_make_integer(300), "Dave");
+    send_row(mg_value_make_null(), mg_value_make_integer(60), "Eve");
+    SendRecordsAndSummary(session, 0);
+    mg_session_destroy(session);
+  });
+
+  std::unique_ptr<mg::Client> client = ConnectClient(port);
+  ASSERT_TRUE(client);
+  ASSERT_TRUE(client->Execute("MATCH (p:Person) "
+                              "RETURN p.score AS score, p.age AS age, "
+                              "p.name AS name"));
+  ASSERT_THROW(client->FetchAs<UnknownColumn>(), mg::ClientException);
+
+  auto alice = client->FetchAs<Person>();
+  ASSERT_TRUE(alice);
+  EXPECT_EQ(alice->name, "Alice");
+  EXPECT_EQ(alice->age, 30);
+  EXPECT_EQ(alice->score, 0.5);
+  auto bob = client->FetchAs<Person>();
+  ASSERT_TRUE(bob);
+  EXPECT_EQ(bob->name, "Bob");
+  EXPECT_EQ(bob->age, 40);
+  EXPECT_FALSE(bob->score);
+
+  // Rows that don't fit are skipped, and the following ones can still be
+  // fetched.
+  EXPECT_THROW(client->FetchAs<Person>(), mg::ClientException);
+  EXPECT_THROW(client->FetchAs<Person>(), mg::ClientException);
+  auto rest = client->FetchAllAs<Person>();
+  ASSERT_TRUE(rest);
+  ASSERT_EQ(rest->size(), 1u);
+  EXPECT_EQ((*rest)[0].name, "Eve");
+  EXPECT_EQ((*rest)[0].age, 60);
+
+  client.reset();
+  StopServer();
+}
+
+// Listens on a loopback port, which is stored to `port`.
+int ListenOnLoopback(int *port) {
+  int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  if (sockfd < 0 || bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+      listen(sockfd, 1) ||
+      getsockname(sockfd, (struct sockaddr *)&addr, &addr_len)) {
+    abort();
+  }
+  *port = ntohs(addr.sin_port);
+  return sockfd;
+}
+
+TEST(ConnectTimeoutTest, Timeout) {
+  // The listener doesn't accept connections, so once its backlog is full,
+  // connection requests to it get no response.
+  int port;
+  int listener = ListenOnLoopback(&port);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons((uint16_t)port);
+  std::vector<int> backlog;
+  for (int i = 0; i < 4; ++i) {
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    ASSERT_GE(sockfd, 0);
+    connect(sockfd, (struct sockaddr *)&addr, sizeof(addr));
+    backlog.push_back(sockfd);
+  }
+
+  tracking_allocator allocator;
+  mg_session_params *params = mg_session_params_make();
+  mg_session_params_set_address(params, "127.0.0.1");
+  mg_session_params_set_port(params, (uint16_t)port);
+  mg_session_params_set_connect_timeout(params, 100);
+  mg_session *session;
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(mg_connect_ca(params, &session, (mg_allocator *)&allocator),
+            MG_ERROR_NETWORK_FAILURE);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_GE(elapsed, std::chrono::milliseconds(100));
+  EXPECT_LT(elapsed, std::chrono::seconds(5));
+  EXPECT_THAT(std::string(mg_session_error(session)), HasSubstr("timed out"));
+  mg_session_params_destroy(params);
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+
+  for (int sockfd : backlog) {
+    close(sockfd);
+  }
+  close(listener);
+}
+
+// Serves a single connection accepted on `listener` as a replication
+// instance of the given `role`, and closes it after `queries` queries, as soon
+// as the next one arrives or the client disconnects.
+void ServeReplicationInstance(int listener, const std::string &role,
+                              int queries) {
+  int sockfd = accept(listener, nullptr, nullptr);
+  ASSERT_GE(sockfd, 0);
+  mg_session *session;
+  ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+  for (int i = 0; i < queries; ++i) {
+    mg_message *message;
+    ASSERT_EQ(mg_session_receive_message(session), 0);
+    ASSERT_EQ(mg_session_read_bolt_message(session, &message), 0);
+    ASSERT_EQ(message->type, MG_MESSAGE_TYPE_RUN);
+    const mg_string *statement = message->run_v->statement;
+    bool discovery = std::string(statement->data, statement->size) ==
+                     "SHOW REPLICATION ROLE";
+    mg_message_destroy_ca(message, session->decoder_allocator);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    if (discovery) {
+      mg_list *fields = mg_list_make_empty(1);
+      mg_list_append(fields, mg_value_make_string(role.c_str()));
+      ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+      mg_list_destroy(fields);
+    }
+    SendRecordsAndSummary(session, 0);
+  }
+  mg_session_receive_message(session);
+  mg_session_destroy(session);
+}
+
+TEST(RouterTest, RoutingAndFailover) {
+  mg::Client::Init();
+  int ports[3];
+  int listeners[3];
+  for (int i = 0; i < 3; ++i) {
+    listeners[i] = ListenOnLoopback(&ports[i]);
+  }
+  // Replicas fail on their second query after discovery. MAIN gets a write, a
+  // read and discovery three times.
+  std::thread main(ServeReplicationInstance, listeners[0], "main", 5);
+  std::thread replica1(ServeReplicationInstance, listeners[1], "replica", 2);
+  std::thread replica2(ServeReplicationInstance, listeners[2], "replica", 2);
+
+  mg::Router::Params params;
+  for (int port : ports) {
+    params.endpoints.push_back({"127.0.0.1", (uint16_t)port});
+  }
+  params.pool.reset_on_acquire = false;
+  params.down_interval = std::chrono::minutes(1);
+  auto router = std::make_unique<mg::Router>(params);
 
-  // Pull rest of the results from first run
   {
-    mg_map *pull_info = CreatePullInfo(-1, r1_qid);
-    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
-    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
-    mg_map_destroy(pull_info);
+    mg::Router::Handle handle = router->Acquire(mg::Router::Access::Write);
+    ASSERT_TRUE(handle);
+    EXPECT_EQ(handle.endpoint(), 0u);
+    EXPECT_EQ(router->role(0), mg::Router::Role::Main);
+    EXPECT_EQ(router->role(1), mg::Router::Role::Replica);
+    EXPECT_EQ(router->role(2), mg::Router::Role::Replica);
+    ASSERT_TRUE(handle->Execute("CREATE ()"));
+    ASSERT_TRUE(handle->FetchAll());
   }
 
-  check_result(0, 1);
+  {
+    // Reads are spread by the number of clients in use.
+    mg::Router::Handle first = router->Acquire(mg::Router::Access::Read);
+    mg::Router::Handle second = router->Acquire(mg::Router::Access::Read);
+    ASSERT_TRUE(first && second);
+    EXPECT_EQ(first.endpoint(), 1u);
+    EXPECT_EQ(second.endpoint(), 2u);
+    EXPECT_EQ(router->in_use(1), 1u);
+    ASSERT_TRUE(first->Execute("MATCH (n) RETURN n"));
+    ASSERT_TRUE(first->FetchAll());
+  }
+  EXPECT_EQ(router->in_use(1), 0u);
 
-  // First run shouldn't have more results
-  ASSERT_EQ(mg_session_fetch(session, &result), 0);
-  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
-  ASSERT_TRUE(CheckSummary(result, 0.01));
-  ASSERT_EQ(mg_session_status(session), MG_SESSION_EXECUTING);
+  {
+    mg::Router::Handle handle = router->Acquire(mg::Router::Access::Read);
+    ASSERT_TRUE(handle);
+    ASSERT_EQ(handle.endpoint(), 1u);
+    EXPECT_FALSE(handle->Execute("MATCH (n) RETURN n"));
+  }
+  replica1.join();
 
-  // Pull rest of the results from third run
+  // The broken replica is avoided, and the roles are discovered again.
   {
-    // If no qid is used, results from last run should be pulled
-    mg_map *pull_info = CreatePullInfo(-1);
-    ASSERT_EQ(mg_session_pull(session, pull_info), 0);
-    ASSERT_EQ(mg_session_status(session), MG_SESSION_FETCHING);
-    mg_map_destroy(pull_info);
+    mg::Router::Handle handle = router->Acquire(mg::Router::Access::Read);
+    ASSERT_TRUE(handle);
+    ASSERT_EQ(handle.endpoint(), 2u);
+    EXPECT_FALSE(handle->Execute("MATCH (n) RETURN n"));
   }
+  replica2.join();
+  {
+    // Both replicas are gone, so reads go to MAIN.
+    mg::Router::Handle handle = router->Acquire(mg::Router::Access::Read);
+    ASSERT_TRUE(handle);
+    EXPECT_EQ(handle.endpoint(), 0u);
+    ASSERT_TRUE(handle->Execute("MATCH (n) RETURN n"));
+    ASSERT_TRUE(handle->FetchAll());
+  }
+  EXPECT_EQ(router->role(1), mg::Router::Role::Unknown);
 
-  check_result(2, 1);
+  router.reset();
+  main.join();
+  for (int listener : listeners) {
+    close(listener);
+  }
+}
+
+// Serves a transaction of a single query on `session`. Unless `failure` is
+// empty, the query fails with it and the transaction is rolled back.
+void ServeTransaction(mg_session *session, const std::string &failure) {
+  ExpectMessage(session, MG_MESSAGE_TYPE_BEGIN);
+  ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+  ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+  ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+  if (failure.empty()) {
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 1);
+    ExpectMessage(session, MG_MESSAGE_TYPE_COMMIT);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+    return;
+  }
+  mg_map *summary = mg_map_make_empty(2);
+  mg_map_insert_unsafe(summary, "code", mg_value_make_string(failure.c_str()));
+  mg_map_insert_unsafe(summary, "message", mg_value_make_string("conflict"));
+  ASSERT_EQ(mg_session_send_failure_message(session, summary), 0);
+  mg_map_destroy(summary);
+  ASSERT_EQ(mg_session_send_ignored_message(session), 0);
+  // RESET after the failure, and another one to roll back the transaction.
+  for (int i = 0; i < 2; ++i) {
+    ExpectMessage(session, MG_MESSAGE_TYPE_RESET);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+  }
+}
+
+// Runs a query in a managed transaction, counting the attempts in `calls`.
+auto CreateNode(int *calls) {
+  return [calls](mg::Client &client) {
+    ++*calls;
+    if (!client.Execute("CREATE (n) RETURN n")) {
+      return size_t{0};
+    }
+    return client.FetchAll()->size();
+  };
+}
+
+mg::RetryPolicy FastRetries() {
+  mg::RetryPolicy policy;
+  policy.max_attempts = 3;
+  policy.initial_delay = std::chrono::milliseconds(1);
+  return policy;
+}
+
+TEST_F(ConnectTest, RetryTransientError) {
+  RunServer([](int sockfd) {
+    mg_session *session;
+    ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+    ServeTransaction(session, "Memgraph.TransientError.MemgraphError.Conflict");
+    ServeTransaction(session, "");
+    // Other failures aren't retried.
+    ServeTransaction(session, "Memgraph.ClientError.Statement.SyntaxError");
+    for (int i = 0; i < 3; ++i) {
+      ServeTransaction(session,
+                       "Memgraph.TransientError.MemgraphError.Conflict");
+    }
+    mg_session_destroy(session);
+  });
+
+  std::unique_ptr<mg::Client> client = ConnectClient(port);
+  ASSERT_TRUE(client);
+  int calls = 0;
+  EXPECT_EQ(client->ExecuteWriteTransaction(CreateNode(&calls), FastRetries()),
+            1u);
+  EXPECT_EQ(calls, 2);
+
+  calls = 0;
+  EXPECT_THROW(
+      client->ExecuteWriteTransaction(CreateNode(&calls), FastRetries()),
+      mg::ClientException);
+  EXPECT_EQ(calls, 1);
+
+  // Retries run out.
+  calls = 0;
+  EXPECT_THROW(
+      client->ExecuteWriteTransaction(CreateNode(&calls), FastRetries()),
+      mg::TransientException);
+  EXPECT_EQ(calls, 3);
+
+  client.reset();
+  StopServer();
+}
+
+TEST(ClientPoolTest, RetryBrokenConnection) {
+  mg::Client::Init();
+  int port;
+  int listener = ListenOnLoopback(&port);
+  std::thread server([listener] {
+    // The first connection breaks in the middle of the transaction.
+    int sockfd = accept(listener, nullptr, nullptr);
+    ASSERT_GE(sockfd, 0);
+    mg_session *session;
+    ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+    ExpectMessage(session, MG_MESSAGE_TYPE_BEGIN);
+    ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    mg_session_destroy(session);
+
+    sockfd = accept(listener, nullptr, nullptr);
+    ASSERT_GE(sockfd, 0);
+    ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+    ServeTransaction(session, "");
+    mg_session_receive_message(session);
+    mg_session_destroy(session);
+  });
+
+  mg::ClientPool::Params params;
+  params.client.port = (uint16_t)port;
+  auto pool = std::make_unique<mg::ClientPool>(params);
+  int calls = 0;
+  EXPECT_EQ(pool->ExecuteWriteTransaction(CreateNode(&calls), FastRetries()),
+            1u);
+  EXPECT_EQ(calls, 2);
+  EXPECT_EQ(pool->size(), 1u);
+
+  pool.reset();
+  server.join();
+  close(listener);
+}
+
+// Connects to the test server with the given query timeout.
+mg_session *ConnectWithQueryTimeout(int port, int query_timeout,
+                                    mg_allocator *allocator) {
+  mg_init();
+  mg_session_params *params = mg_session_params_make();
+  mg_session_params_set_host(params, "127.0.0.1");
+  mg_session_params_set_port(params, (uint16_t)port);
+  mg_session_params_set_query_timeout(params, query_timeout);
+  EXPECT_EQ(mg_session_params_get_query_timeout(params), query_timeout);
+  mg_session *session;
+  int status = mg_connect_ca(params, &session, allocator);
+  mg_session_params_destroy(params);
+  EXPECT_EQ(status, 0) << mg_session_error(session);
+  return session;
+}
+
+// Expects the RESET sent after interrupting a query, and answers it after the
+// responses to `pending` requests sent before it.
+void ServeInterruptedQuery(mg_session *session, int pending) {
+  ExpectMessage(session, MG_MESSAGE_TYPE_RESET);
+  mg_map *summary = mg_map_make_empty(2);
+  mg_map_insert_unsafe(summary, "code",
+                       mg_value_make_string("Memgraph.TransientError.Query"));
+  mg_map_insert_unsafe(summary, "message", mg_value_make_string("stopped"));
+  ASSERT_EQ(mg_session_send_failure_message(session, summary), 0);
+  mg_map_destroy(summary);
+  for (int i = 1; i < pending; ++i) {
+    ASSERT_EQ(mg_session_send_ignored_message(session), 0);
+  }
+  ASSERT_EQ(mg_session_send_success_message(session, &mg_empty_map), 0);
+}
+
+TEST_F(ConnectTest, QueryTimeout) {
+  RunServer([](int sockfd) {
+    mg_session *session;
+    ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+    // The query runs for longer than the timeout.
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    ServeInterruptedQuery(session, 2);
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 1);
+    // Results stop in the middle of a message.
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    const char partial_success[] = {0x00, 0x03, (char)0xB1, 0x70};
+    ASSERT_EQ(SendData(sockfd, partial_success, sizeof(partial_success)), 0);
+    mg_session_receive_message(session);
+    mg_session_destroy(session);
+  });
+
+  mg_session *session =
+      ConnectWithQueryTimeout(port, 200, (mg_allocator *)&allocator);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            MG_ERROR_TIMEOUT);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_GE(elapsed, std::chrono::milliseconds(150));
+  EXPECT_LT(elapsed, std::chrono::seconds(5));
+  EXPECT_THAT(std::string(mg_session_error(session)),
+              HasSubstr("query timed out"));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
 
+  // The next query gets the whole timeout again.
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            0);
+  mg_result *result;
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
   ASSERT_EQ(mg_session_fetch(session, &result), 0);
-  ASSERT_TRUE(CheckColumns(result, std::vector<std::string>{"n", "m"}));
-  ASSERT_TRUE(CheckSummary(result, 0.01));
   ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
 
-  ASSERT_EQ(mg_session_fetch(session, &result), MG_ERROR_BAD_CALL);
-  ASSERT_EQ(mg_session_pull(session, nullptr), MG_ERROR_BAD_CALL);
+  // A partial response can't be skipped.
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            MG_ERROR_TIMEOUT);
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_BAD);
 
-  ASSERT_EQ(mg_session_commit_transaction(session, &result), 0);
+  mg_session_destroy(session);
+  StopServer();
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(RunTest, FailAfterInterrupt) {
+  // Only a failure caused by the interruption leaves the session usable.
+  session->interrupted = 1;
+  mg_session_fail(session, MG_ERROR_CANCELLED);
+  EXPECT_EQ(mg_session_status(session), MG_SESSION_READY);
+  EXPECT_FALSE(session->interrupted);
+
+  session->interrupted = 1;
+  mg_session_fail(session, MG_ERROR_SEND_FAILED);
+  EXPECT_EQ(mg_session_status(session), MG_SESSION_BAD);
+
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(ConnectTest, CancelQuery) {
+  RunServer([](int sockfd) {
+    mg_session *session;
+    ASSERT_NO_FATAL_FAILURE(AcceptBoltSession(sockfd, &session));
+    // The first row arrives, then the server keeps working on the rest.
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    mg_list *fields = mg_list_make_empty(1);
+    mg_list_append(fields, mg_value_make_integer(1));
+    ASSERT_EQ(mg_session_send_record_message(session, fields), 0);
+    mg_list_destroy(fields);
+    ServeInterruptedQuery(session, 1);
+    // Cancelling between queries has no effect.
+    ExpectMessage(session, MG_MESSAGE_TYPE_RUN);
+    ExpectMessage(session, MG_MESSAGE_TYPE_PULL);
+    SendRunSuccess(session);
+    SendRecordsAndSummary(session, 2);
+    mg_session_receive_message(session);
+    mg_session_destroy(session);
+  });
+
+  // The timeout is only there to let the cancellation interrupt the wait.
+  mg_session *session =
+      ConnectWithQueryTimeout(port, 60000, (mg_allocator *)&allocator);
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            0);
+  mg_result *result;
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread canceller([session] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    mg_session_cancel(session);
+  });
+  ASSERT_EQ(mg_session_fetch(session, &result), MG_ERROR_CANCELLED);
+  canceller.join();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  EXPECT_THAT(std::string(mg_session_error(session)),
+              HasSubstr("query cancelled"));
+  ASSERT_EQ(mg_session_status(session), MG_SESSION_READY);
+  // Nothing is left over to keep a later failure from invalidating the
+  // session.
+  EXPECT_FALSE(session->interrupted);
+
+  mg_session_cancel(session);
+  ASSERT_EQ(mg_session_run_and_pull(session, "MATCH (n) RETURN n", nullptr,
+                                    nullptr, nullptr, nullptr, nullptr),
+            0);
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  ASSERT_EQ(mg_session_fetch(session, &result), 1);
+  ASSERT_EQ(mg_session_fetch(session, &result), 0);
 
   mg_session_destroy(session);
   StopServer();
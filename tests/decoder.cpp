@@ -244,6 +244,46 @@ TEST_F(MessageChunkingTest, ManyMessages) {
   ASSERT_MEMORY_OK();
 }
 
+int recv_some_calls = 0;
+
+ssize_t counting_recv_some(struct mg_transport *transport, char *buf,
+                           size_t len) {
+  ++recv_some_calls;
+  return mg_raw_transport_recv_some(transport, buf, len);
+}
+
+TEST_F(MessageChunkingTest, ReadAhead) {
+  session = mg_session_init((mg_allocator *)&allocator);
+  mg_raw_transport_init(sc, (mg_raw_transport **)&session->transport,
+                        (mg_allocator *)&allocator);
+  ASSERT_TRUE(session);
+  session->transport->recv_some = counting_recv_some;
+  recv_some_calls = 0;
+
+  std::string data;
+  for (int i = 0; i < 100; ++i) {
+    data += "\x00\x03"s + "abc" + "\x00\x02"s + "de" + "\x00\x00"s;
+  }
+  client.Write(ss, data);
+  client.Stop();
+  close(ss);
+  ASSERT_FALSE(client.error);
+
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(mg_session_receive_message(session), 0);
+    std::string message(session->in_buffer, session->in_end);
+    ASSERT_EQ(message, "abcde");
+  }
+  // All of the messages fit into the read-ahead buffer, so they should be
+  // received in one go.
+  EXPECT_EQ(recv_some_calls, 1);
+
+  EXPECT_NE(mg_session_receive_message(session), 0);
+
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+}
+
 class ValueTest : public DecoderTest,
                   public ::testing::WithParamInterface<ValueTestParam> {
  protected:
@@ -276,6 +316,248 @@ TEST_P(ValueTest, Decoding) {
   ASSERT_MEMORY_OK();
 }
 
+TEST_P(ValueTest, Skipping) {
+  session = mg_session_init((mg_allocator *)&allocator);
+  mg_raw_transport_init(sc, (mg_raw_transport **)&session->transport,
+                        (mg_allocator *)&allocator);
+  ASSERT_TRUE(session);
+
+  client.WriteInChunks(ss, GetParam().encoded);
+  ASSERT_EQ(mg_session_receive_message(session), 0);
+
+  ASSERT_EQ(mg_session_skip_value(session), 0);
+  EXPECT_EQ(session->in_cursor, session->in_end);
+
+  client.Stop();
+  close(ss);
+  ASSERT_FALSE(client.error);
+
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(DecoderTest, SkipRunsOfTinyValues) {
+  session = mg_session_init((mg_allocator *)&allocator);
+  mg_raw_transport_init(sc, (mg_raw_transport **)&session->transport,
+                        (mg_allocator *)&allocator);
+  ASSERT_TRUE(session);
+
+  // A list of 40 values, mostly a byte each, followed by more tiny integers
+  // which aren't part of it.
+  std::string list = "\xD4\x28"s + std::string(20, '\x01') +
+                     "\xC0\xC3\xC2\xF0\x7F\x82" "ab\xC8\x80"s +
+                     std::string(13, '\x02');
+  client.WriteInChunks(ss, list + std::string(20, '\x03'));
+  ASSERT_EQ(mg_session_receive_message(session), 0);
+
+  ASSERT_EQ(mg_session_skip_value(session), 0);
+  EXPECT_EQ(session->in_cursor, list.size());
+
+  // Every truncation of the list is detected.
+  for (size_t end = 0; end < list.size(); ++end) {
+    session->in_cursor = 0;
+    session->in_end = end;
+    EXPECT_EQ(mg_session_skip_value(session), MG_ERROR_DECODING_FAILED);
+  }
+
+  client.Stop();
+  close(ss);
+  ASSERT_FALSE(client.error);
+
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(DecoderTest, StringPointsIntoInputBuffer) {
+  session = mg_session_init((mg_allocator *)&allocator);
+  mg_raw_transport_init(sc, (mg_raw_transport **)&session->transport,
+                        (mg_allocator *)&allocator);
+  ASSERT_TRUE(session);
+
+  client.WriteInChunks(ss, "\x85hello"s);
+  ASSERT_EQ(mg_session_receive_message(session), 0);
+
+  mg_value *value;
+  ASSERT_EQ(mg_session_read_value(session, &value), 0);
+  ASSERT_EQ(mg_value_get_type(value), MG_VALUE_TYPE_STRING);
+  const mg_string *str = mg_value_string(value);
+  EXPECT_EQ(std::string(str->data, str->size), "hello");
+  EXPECT_EQ(str->data, session->in_buffer + 1);
+  mg_value_destroy_ca(value, session->decoder_allocator);
+
+  client.Stop();
+  close(ss);
+  ASSERT_FALSE(client.error);
+
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(DecoderTest, PackedScalarLists) {
+  session = mg_session_init((mg_allocator *)&allocator);
+  mg_raw_transport_init(sc, (mg_raw_transport **)&session->transport,
+                        (mg_allocator *)&allocator);
+  ASSERT_TRUE(session);
+
+  // [[1, -16, -128, 32767, -2^31, 2^63 - 1], [1.0, -2.0], [1, "a"]]
+  client.WriteInChunks(
+      ss, "\x93\x96\x01\xF0\xC8\x80\xC9\x7F\xFF\xCA\x80\x00\x00\x00"
+          "\xCB\x7F\xFF\xFF\xFF\xFF\xFF\xFF\xFF"
+          "\x92\xC1\x3F\xF0\x00\x00\x00\x00\x00\x00"
+          "\xC1\xC0\x00\x00\x00\x00\x00\x00\x00"
+          "\x92\x01\x81\x61"s);
+  ASSERT_EQ(mg_session_receive_message(session), 0);
+
+  mg_value *value;
+  ASSERT_EQ(mg_session_read_value(session, &value), 0);
+  const mg_list *lists = mg_value_list(value);
+  ASSERT_EQ(mg_list_size(lists), 3u);
+
+  const mg_list *integers = mg_value_list(mg_list_at(lists, 0));
+  const int64_t expected_integers[] = {
+      1, -16, -128, 32767, INT32_MIN, INT64_MAX};
+  ASSERT_TRUE(mg_list_integers(integers));
+  EXPECT_FALSE(mg_list_floats(integers));
+  ASSERT_EQ(mg_list_size(integers), 6u);
+  for (uint32_t i = 0; i < 6; ++i) {
+    EXPECT_EQ(mg_list_integers(integers)[i], expected_integers[i]);
+    EXPECT_EQ(mg_value_integer(mg_list_at(integers, i)), expected_integers[i]);
+  }
+
+  const mg_list *floats = mg_value_list(mg_list_at(lists, 1));
+  ASSERT_TRUE(mg_list_floats(floats));
+  EXPECT_FALSE(mg_list_integers(floats));
+  ASSERT_EQ(mg_list_size(floats), 2u);
+  EXPECT_EQ(mg_list_floats(floats)[0], 1.0);
+  EXPECT_EQ(mg_list_floats(floats)[1], -2.0);
+  EXPECT_EQ(mg_value_float(mg_list_at(floats, 1)), -2.0);
+
+  // Mixed lists are decoded as usual.
+  const mg_list *mixed = mg_value_list(mg_list_at(lists, 2));
+  EXPECT_FALSE(mg_list_integers(mixed));
+  EXPECT_FALSE(mg_list_floats(mixed));
+  ASSERT_EQ(mg_list_size(mixed), 2u);
+  EXPECT_EQ(mg_value_integer(mg_list_at(mixed, 0)), 1);
+  EXPECT_EQ(mg_value_get_type(mg_list_at(mixed, 1)), MG_VALUE_TYPE_STRING);
+
+  // Copies have their own packed array.
+  mg_list *copy = mg_list_copy(integers);
+  ASSERT_TRUE(mg_list_integers(copy));
+  EXPECT_NE(mg_list_integers(copy), mg_list_integers(integers));
+  EXPECT_EQ(mg_list_integers(copy)[5], INT64_MAX);
+  mg_list_destroy(copy);
+
+  mg_value_destroy_ca(value, session->decoder_allocator);
+
+  mg_list *made = mg_list_make_empty(1);
+  mg_list_append(made, mg_value_make_integer(1));
+  EXPECT_FALSE(mg_list_integers(made));
+  mg_list_destroy(made);
+
+  client.Stop();
+  close(ss);
+  ASSERT_FALSE(client.error);
+
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(DecoderTest, ContainerElementsStoredInline) {
+  session = mg_session_init((mg_allocator *)&allocator);
+  mg_raw_transport_init(sc, (mg_raw_transport **)&session->transport,
+                        (mg_allocator *)&allocator);
+  ASSERT_TRUE(session);
+
+  // [1, 2, {"a": 3, "b": 4}]
+  client.WriteInChunks(ss, "\x93\x01\x02\xA2\x81\x61\x03\x81\x62\x04"s);
+  ASSERT_EQ(mg_session_receive_message(session), 0);
+
+  mg_value *value;
+  ASSERT_EQ(mg_session_read_value(session, &value), 0);
+  const mg_list *list = mg_value_list(value);
+  ASSERT_EQ(mg_list_size(list), 3u);
+  EXPECT_EQ(list->elements[1], list->elements[0] + 1);
+  EXPECT_EQ(list->elements[2], list->elements[0] + 2);
+  const mg_map *map = mg_value_map(list->elements[2]);
+  ASSERT_EQ(mg_map_size(map), 2u);
+  EXPECT_EQ(map->values[1], map->values[0] + 1);
+  EXPECT_EQ(map->keys[1], map->keys[0] + 1);
+  EXPECT_EQ(mg_value_integer(mg_map_at(map, "b")), 4);
+  mg_value_destroy_ca(value, session->decoder_allocator);
+
+  client.Stop();
+  close(ss);
+  ASSERT_FALSE(client.error);
+
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(DecoderTest, ElementIdsSinceBolt5) {
+  session = mg_session_init((mg_allocator *)&allocator);
+  mg_raw_transport_init(sc, (mg_raw_transport **)&session->transport,
+                        (mg_allocator *)&allocator);
+  ASSERT_TRUE(session);
+  mg_session_set_version(session, 5);
+
+  // A list of a node, a relationship and an unbound relationship with
+  // element IDs, followed by a node without them.
+  client.WriteInChunks(
+      ss, "\x93\xB4\x4E\x01\x91\x82L1\xA0\x82n1"
+          "\xB8\x52\x02\x01\x03\x84type\xA0\x82r2\x82n1\x82n3"
+          "\xB4\x72\x04\x84type\xA0\x82r4"
+          "\xB3\x4E\x01\x90\xA0"s);
+  ASSERT_EQ(mg_session_receive_message(session), 0);
+
+  auto element_id = [](const mg_string *str) {
+    return str ? std::string(str->data, str->size) : "<null>"s;
+  };
+
+  mg_value *value;
+  ASSERT_EQ(mg_session_read_value(session, &value), 0);
+  const mg_list *list = mg_value_list(value);
+  ASSERT_EQ(mg_list_size(list), 3u);
+
+  const mg_node *node = mg_value_node(mg_list_at(list, 0));
+  EXPECT_EQ(mg_node_id(node), 1);
+  EXPECT_EQ(mg_node_label_count(node), 1u);
+  EXPECT_EQ(element_id(mg_node_element_id(node)), "n1");
+
+  const mg_relationship *rel = mg_value_relationship(mg_list_at(list, 1));
+  EXPECT_EQ(mg_relationship_id(rel), 2);
+  EXPECT_EQ(mg_relationship_end_id(rel), 3);
+  EXPECT_EQ(element_id(mg_relationship_element_id(rel)), "r2");
+  EXPECT_EQ(element_id(mg_relationship_start_element_id(rel)), "n1");
+  EXPECT_EQ(element_id(mg_relationship_end_element_id(rel)), "n3");
+
+  const mg_unbound_relationship *urel =
+      mg_value_unbound_relationship(mg_list_at(list, 2));
+  EXPECT_EQ(mg_unbound_relationship_id(urel), 4);
+  EXPECT_EQ(element_id(mg_unbound_relationship_element_id(urel)), "r4");
+
+  // Element IDs are copied and compared along with the rest.
+  mg_node *copy = mg_node_copy(node);
+  EXPECT_EQ(element_id(mg_node_element_id(copy)), "n1");
+  EXPECT_TRUE(mg_node_equal(copy, node));
+  mg_string_destroy(copy->element_id);
+  copy->element_id = NULL;
+  EXPECT_FALSE(mg_node_equal(copy, node));
+  mg_node_destroy(copy);
+
+  mg_value_destroy_ca(value, session->decoder_allocator);
+
+  // Nodes without element IDs aren't accepted from Bolt 5 servers.
+  mg_node *legacy;
+  EXPECT_EQ(mg_session_read_node(session, &legacy), MG_ERROR_DECODING_FAILED);
+
+  client.Stop();
+  close(ss);
+  ASSERT_FALSE(client.error);
+
+  mg_session_destroy(session);
+  ASSERT_MEMORY_OK();
+}
+
 INSTANTIATE_TEST_CASE_P(Null, ValueTest,
                         ::testing::ValuesIn(NullTestCases()), );
 
@@ -12,12 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <limits>
+#include <map>
+#include <optional>
 #include <string>
 #include <thread>
+#include <tuple>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "mgclient.h"
+#include "mgclient.hpp"
 #include "mgcommon.h"
 #include "mgconstants.h"
 #include "mgsession.h"
@@ -76,6 +82,8 @@ class EncoderTest : public ::testing::Test {
     session.out_capacity = MG_BOLT_CHUNK_HEADER_SIZE + MG_BOLT_MAX_CHUNK_SIZE;
     session.out_begin = MG_BOLT_CHUNK_HEADER_SIZE;
     session.out_end = session.out_begin;
+    session.buffer_messages = 0;
+    session.nonblocking = 0;
     {
       int tmp[2];
       ASSERT_EQ(mg_socket_pair(AF_UNIX, SOCK_STREAM, 0, tmp), 0);
@@ -247,6 +255,93 @@ TEST_F(MessageChunkingTest, ManyMessages) {
   ASSERT_MEMORY_OK();
 }
 
+int send_calls = 0;
+
+int counting_send(struct mg_transport *transport, const char *buf,
+                  size_t len) {
+  ++send_calls;
+  return mg_raw_transport_send(transport, buf, len);
+}
+
+TEST_F(MessageChunkingTest, SingleSend) {
+  // Leave room for the end marker, same as `mg_session_init` does.
+  session.out_buffer = (char *)realloc(session.out_buffer,
+                                       session.out_capacity + 2);
+  session.out_capacity += 2;
+  session.transport->send = counting_send;
+  send_calls = 0;
+
+  std::string data(65535, 'x');
+  mg_session_write_raw(&session, "abc", 3);
+  mg_session_flush_message(&session);
+  EXPECT_EQ(send_calls, 1);
+  mg_session_write_raw(&session, data.data(), data.size());
+  mg_session_flush_message(&session);
+  EXPECT_EQ(send_calls, 2);
+  mg_raw_transport_destroy(session.transport);
+
+  server.Stop();
+  ASSERT_FALSE(server.error);
+  std::stringstream sstr(server.data);
+
+  ASSERT_READ_RAW(sstr, "\x00\x03"s);
+  ASSERT_READ_RAW(sstr, "abc"s);
+  ASSERT_READ_RAW(sstr, "\x00\x00"s);
+  ASSERT_READ_RAW(sstr, "\xFF\xFF"s);
+  ASSERT_READ_RAW(sstr, data);
+  ASSERT_READ_RAW(sstr, "\x00\x00"s);
+  ASSERT_END(sstr);
+  ASSERT_MEMORY_OK();
+}
+
+int send_vector_calls = 0;
+
+int counting_send_vector(struct mg_transport *transport,
+                         const mg_transport_buffer *buffers, size_t count) {
+  ++send_vector_calls;
+  return mg_raw_transport_send_vector(transport, buffers, count);
+}
+
+TEST_F(MessageChunkingTest, DirectSend) {
+  session.out_buffer = (char *)realloc(session.out_buffer,
+                                       session.out_capacity + 2);
+  session.out_capacity += 2;
+  session.transport->send = counting_send;
+  session.transport->send_vector = counting_send_vector;
+  send_calls = 0;
+  send_vector_calls = 0;
+
+  const size_t chunks = 40;
+  std::string data(chunks * 65535 + 10, '\0');
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (char)((i * 7) & 0xFF);
+  }
+  mg_session_write_raw(&session, "abc", 3);
+  mg_session_write_raw(&session, data.data(), data.size());
+  mg_session_flush_message(&session);
+  // Full chunks are sent with the buffered data in front of them, as many at
+  // a time as fit into a single call. The rest is sent with the end marker.
+  EXPECT_EQ(send_vector_calls, 3);
+  EXPECT_EQ(send_calls, 1);
+  mg_raw_transport_destroy(session.transport);
+
+  server.Stop();
+  ASSERT_FALSE(server.error);
+  std::stringstream sstr(server.data);
+
+  ASSERT_READ_RAW(sstr, "\x00\x03"s);
+  ASSERT_READ_RAW(sstr, "abc"s);
+  for (size_t i = 0; i < chunks; ++i) {
+    ASSERT_READ_RAW(sstr, "\xFF\xFF"s);
+    ASSERT_READ_RAW(sstr, data.substr(i * 65535, 65535));
+  }
+  ASSERT_READ_RAW(sstr, "\x00\x0A"s);
+  ASSERT_READ_RAW(sstr, data.substr(chunks * 65535));
+  ASSERT_READ_RAW(sstr, "\x00\x00"s);
+  ASSERT_END(sstr);
+  ASSERT_MEMORY_OK();
+}
+
 class ValueTest : public EncoderTest,
                   public ::testing::WithParamInterface<ValueTestParam> {
  protected:
@@ -302,3 +397,139 @@ INSTANTIATE_TEST_CASE_P(Duration, ValueTest,
                         ::testing::ValuesIn((DurationTestCases())), );
 
 INSTANTIATE_TEST_CASE_P(Map, ValueTest, ::testing::ValuesIn(MapTestCases()), );
+
+namespace {
+struct Point {
+  int64_t id;
+  std::string name;
+  std::optional<double> weight;
+};
+
+void WriteParam(mg::ParamWriter &writer, const Point &point) {
+  writer.BeginMap(3);
+  writer.Write("id");
+  writer.Write(point.id);
+  writer.Write("name");
+  writer.Write(point.name);
+  writer.Write("weight");
+  writer.Write(point.weight);
+}
+
+std::string ReadMessage(std::stringstream &sstr) {
+  std::string message;
+  while (true) {
+    uint16_t chunk_size;
+    if (sstr.readsome((char *)&chunk_size, 2) != 2) {
+      ADD_FAILURE() << "Not enough chunks in stream";
+      return message;
+    }
+    chunk_size = be16toh(chunk_size);
+    if (chunk_size == 0) {
+      return message;
+    }
+    std::string chunk(chunk_size, '\0');
+    if (sstr.readsome(chunk.data(), chunk_size) != chunk_size) {
+      ADD_FAILURE() << "Failed to read entire chunk from stream";
+      return message;
+    }
+    message += chunk;
+  }
+}
+}  // namespace
+
+// Values written by `mg::ParamWriter` are encoded exactly like the matching
+// `mg_value`s.
+TEST_F(EncoderTest, ParamWriter) {
+  std::vector<Point> points{{1, "first", 0.5}, {2, "second", std::nullopt}};
+  std::map<std::string, std::vector<int>> groups{{"a", {1, 2}}, {"b", {}}};
+  std::tuple<bool, std::nullptr_t, uint8_t, std::string_view> tuple{
+      true, nullptr, 200, "tuple"};
+  std::vector<std::pair<int, std::string>> pairs{{-20, "x"}, {70000, "y"}};
+  mg::Value value(std::string(300, 'v'));
+
+  auto write = [&](mg::ParamWriter &writer) {
+    writer.BeginMap(5);
+    writer.Write("points");
+    writer.Write(points);
+    writer.Write("groups");
+    writer.Write(groups);
+    writer.Write("tuple");
+    writer.Write(tuple);
+    writer.Write("pairs");
+    writer.Write(pairs);
+    writer.Write(std::string("value"));
+    writer.Write(value);
+  };
+  {
+    mg::ParamWriter writer((mg_param_writer *)&session);
+    write(writer);
+    ASSERT_EQ(writer.status(), 0);
+    ASSERT_EQ(mg_session_flush_message(&session), 0);
+  }
+  mg::ParamWriter sizer;
+  write(sizer);
+
+  {
+    mg::Map expected(5);
+    mg::List points_list(2);
+    for (const Point &point : points) {
+      mg::Map point_map(3);
+      point_map.InsertUnsafe("id", mg::Value(point.id));
+      point_map.InsertUnsafe("name", mg::Value(point.name));
+      point_map.InsertUnsafe(
+          "weight", point.weight ? mg::Value(*point.weight) : mg::Value());
+      points_list.Append(mg::Value(std::move(point_map)));
+    }
+    expected.InsertUnsafe("points", mg::Value(std::move(points_list)));
+    mg::Map groups_map(2);
+    for (const auto &[key, group] : groups) {
+      mg::List group_list(group.size());
+      for (int element : group) {
+        group_list.Append(mg::Value(element));
+      }
+      groups_map.InsertUnsafe(key, mg::Value(std::move(group_list)));
+    }
+    expected.InsertUnsafe("groups", mg::Value(std::move(groups_map)));
+    mg::List tuple_list(4);
+    tuple_list.Append(mg::Value(true));
+    tuple_list.Append(mg::Value());
+    tuple_list.Append(mg::Value(200));
+    tuple_list.Append(mg::Value("tuple"));
+    expected.InsertUnsafe("tuple", mg::Value(std::move(tuple_list)));
+    mg::List pairs_list(2);
+    for (const auto &[first, second] : pairs) {
+      mg::List pair_list(2);
+      pair_list.Append(mg::Value(first));
+      pair_list.Append(mg::Value(second));
+      pairs_list.Append(mg::Value(std::move(pair_list)));
+    }
+    expected.InsertUnsafe("pairs", mg::Value(std::move(pairs_list)));
+    expected.InsertUnsafe("value", value);
+    ASSERT_EQ(mg_session_write_map(&session, expected.ptr()), 0);
+    ASSERT_EQ(mg_session_flush_message(&session), 0);
+  }
+  mg_raw_transport_destroy(session.transport);
+
+  server.Stop();
+  ASSERT_FALSE(server.error);
+  std::stringstream sstr(server.data);
+  std::string written = ReadMessage(sstr);
+  std::string expected = ReadMessage(sstr);
+  ASSERT_EQ(written, expected);
+  // Every value here is sized exactly.
+  ASSERT_EQ(sizer.size(), written.size());
+  ASSERT_END(sstr);
+  ASSERT_MEMORY_OK();
+}
+
+TEST_F(EncoderTest, ParamWriterFailure) {
+  mg::ParamWriter writer((mg_param_writer *)&session);
+  writer.Write(std::numeric_limits<uint64_t>::max());
+  EXPECT_EQ(writer.status(), MG_ERROR_INVALID_VALUE);
+  // Nothing is written after the first failure.
+  writer.Write(1);
+  EXPECT_EQ(writer.status(), MG_ERROR_INVALID_VALUE);
+  EXPECT_EQ(session.out_end, session.out_begin);
+  mg_raw_transport_destroy(session.transport);
+  server.Stop();
+}
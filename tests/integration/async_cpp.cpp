@@ -0,0 +1,159 @@
+// Copyright (c) 2016-2020 Memgraph Ltd. [https://memgraph.com]
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <poll.h>
+
+#include <gtest/gtest.h>
+
+#include "mgclient-async.hpp"
+
+template <typename T>
+T GetEnvOrDefault(const std::string &value_name, const T &default_value) {
+  const char *char_value = std::getenv(value_name.c_str());
+  if (!char_value) return default_value;
+  T value;
+  std::stringstream env_value_stream(char_value);
+  env_value_stream >> value;
+  return value;
+}
+
+// A minimal single-threaded executor: the client parks its coroutine here and
+// `Run` polls the socket and resumes it until the spawned task is done.
+class PollExecutor {
+ public:
+  mg::AsyncClient::WaitFunction WaitFunction() {
+    return [this](int socket, mg::IoEvent event, std::coroutine_handle<> h) {
+      socket_ = socket;
+      event_ = event == mg::IoEvent::Read ? POLLIN : POLLOUT;
+      waiting_ = h;
+    };
+  }
+
+  template <typename T>
+  T Run(mg::Task<T> task) {
+    std::optional<T> result;
+    std::exception_ptr exception;
+    bool done = false;
+    mg::Spawn(std::move(task),
+              [&](std::exception_ptr e, std::optional<T> r) {
+                exception = std::move(e);
+                result = std::move(r);
+                done = true;
+              });
+    while (!done) {
+      EXPECT_TRUE(waiting_);
+      pollfd fd{socket_, event_, 0};
+      EXPECT_EQ(poll(&fd, 1, 10000), 1);
+      std::exchange(waiting_, nullptr).resume();
+    }
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+    return std::move(*result);
+  }
+
+ private:
+  int socket_{-1};
+  short event_{0};
+  std::coroutine_handle<> waiting_;
+};
+
+class MemgraphAsyncConnection : public ::testing::Test {
+ protected:
+  virtual void SetUp() override {
+    mg::Client::Init();
+
+    client = mg::AsyncClient::Connect(
+        {GetEnvOrDefault<std::string>("MEMGRAPH_HOST", "127.0.0.1"),
+         GetEnvOrDefault<uint16_t>("MEMGRAPH_PORT", 7687), "", "",
+         GetEnvOrDefault<bool>("MEMGRAPH_SSLMODE", false), ""},
+        executor.WaitFunction());
+
+    ASSERT_TRUE(client);
+  }
+
+  virtual void TearDown() override {
+    // Deallocate the client because mg_finalize has to be called globally.
+    client.reset(nullptr);
+
+    mg::Client::Finalize();
+  }
+
+  PollExecutor executor;
+  std::unique_ptr<mg::AsyncClient> client;
+};
+
+TEST_F(MemgraphAsyncConnection, FetchAll) {
+  auto query = [](mg::AsyncClient *client)
+      -> mg::Task<std::vector<std::vector<mg::Value>>> {
+    if (!co_await client->Execute("UNWIND range(1, 3) AS x RETURN x")) {
+      co_return std::vector<std::vector<mg::Value>>{};
+    }
+    co_return *co_await client->FetchAll();
+  };
+  auto rows = executor.Run(query(client.get()));
+  ASSERT_EQ(rows.size(), 3U);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    ASSERT_EQ(rows[i].size(), 1U);
+    EXPECT_EQ(rows[i][0].ValueInt(), static_cast<int64_t>(i + 1));
+  }
+  EXPECT_EQ(client->GetColumns(), std::vector<std::string>{"x"});
+}
+
+TEST_F(MemgraphAsyncConnection, Rows) {
+  auto query = [](mg::AsyncClient *client) -> mg::Task<int64_t> {
+    mg::Map params(1);
+    params.Insert("n", mg::Value(static_cast<int64_t>(100)));
+    if (!co_await client->Execute("UNWIND range(1, $n) AS x RETURN x",
+                                  params.AsConstMap())) {
+      co_return -1;
+    }
+    int64_t sum = 0;
+    auto rows = client->Rows();
+    while (auto row = co_await rows.Next()) {
+      sum += (*row)[0].ValueInt();
+    }
+    co_return sum;
+  };
+  EXPECT_EQ(executor.Run(query(client.get())), 5050);
+}
+
+TEST_F(MemgraphAsyncConnection, QueryError) {
+  // Depending on when the server evaluates the query, the error is reported
+  // either by `Execute` or by fetching.
+  auto query = [](mg::AsyncClient *client) -> mg::Task<bool> {
+    try {
+      if (!co_await client->Execute("RETURN 1 / 0")) {
+        co_return true;
+      }
+      co_await client->FetchOne();
+    } catch (const mg::MgException &) {
+      co_return true;
+    }
+    co_return false;
+  };
+  EXPECT_TRUE(executor.Run(query(client.get())));
+
+  auto retry = [](mg::AsyncClient *client) -> mg::Task<int64_t> {
+    if (!co_await client->Execute("RETURN 1")) {
+      co_return -1;
+    }
+    auto row = co_await client->FetchOne();
+    if (!row || co_await client->FetchOne()) {
+      co_return -1;
+    }
+    co_return (*row)[0].ValueInt();
+  };
+  EXPECT_EQ(executor.Run(retry(client.get())), 1);
+}
@@ -173,3 +173,123 @@ TEST_F(MemgraphConnection, ThrowClientException) {
   ASSERT_TRUE(client->Execute("CREATE(n {name: assert(false)})"));
   ASSERT_THROW(client->DiscardAll(), mg::ClientException);
 }
+
+TEST_F(MemgraphConnection, FetchAllColumns) {
+  ASSERT_NE(client, nullptr);
+  ASSERT_TRUE(client->Execute(
+      "UNWIND range(1, 10) AS x RETURN x, toString(x) AS s, "
+      "CASE WHEN x % 2 = 0 THEN null ELSE x * 0.5 END AS f, "
+      "CASE WHEN x < 5 THEN x ELSE 'big' END AS mixed;"));
+  auto maybe_columns = client->FetchAllColumns();
+  ASSERT_TRUE(maybe_columns);
+  const auto &columns = *maybe_columns;
+  ASSERT_EQ(columns.size(), 4u);
+
+  ASSERT_EQ(columns[0].name(), "x");
+  ASSERT_EQ(columns[0].type(), mg::Column::Type::Int);
+  ASSERT_EQ(columns[0].size(), 10u);
+  for (size_t i = 0; i < 10; ++i) {
+    ASSERT_FALSE(columns[0].IsNull(i));
+    ASSERT_EQ(columns[0].ints()[i], static_cast<int64_t>(i + 1));
+  }
+
+  ASSERT_EQ(columns[1].type(), mg::Column::Type::String);
+  ASSERT_EQ(columns[1].StringAt(0), "1");
+  ASSERT_EQ(columns[1].StringAt(9), "10");
+  ASSERT_EQ(columns[1].string_data(), "12345678910");
+
+  ASSERT_EQ(columns[2].type(), mg::Column::Type::Double);
+  for (size_t i = 0; i < 10; ++i) {
+    ASSERT_EQ(columns[2].IsNull(i), i % 2 == 1);
+  }
+  ASSERT_DOUBLE_EQ(columns[2].doubles()[2], 1.5);
+
+  ASSERT_EQ(columns[3].type(), mg::Column::Type::Value);
+  ASSERT_EQ(columns[3].values().size(), 10u);
+  ASSERT_EQ(columns[3].values()[0].ValueInt(), 1);
+  ASSERT_EQ(columns[3].values()[9].ValueString(), "big");
+}
+
+TEST_F(MemgraphConnection, Stats) {
+  // The default client doesn't collect any.
+  ASSERT_FALSE(client->Stats());
+
+  mg::Client::Params params;
+  params.host = GetEnvOrDefault<std::string>("MEMGRAPH_HOST", "127.0.0.1");
+  params.port = GetEnvOrDefault<uint16_t>("MEMGRAPH_PORT", 7687);
+  params.use_ssl = GetEnvOrDefault<bool>("MEMGRAPH_SSLMODE", false);
+  params.collect_stats = true;
+  auto stats_client = mg::Client::Connect(params);
+  ASSERT_TRUE(stats_client);
+
+  ASSERT_TRUE(stats_client->Execute("UNWIND range(1, 10) AS n RETURN n;"));
+  auto rows = stats_client->FetchAll();
+  ASSERT_TRUE(rows);
+  ASSERT_EQ(rows->size(), 10u);
+
+  auto stats = stats_client->Stats();
+  ASSERT_TRUE(stats);
+  ASSERT_EQ(stats->rows_fetched, 10u);
+  ASSERT_GT(stats->bytes_sent, 0u);
+  ASSERT_GT(stats->bytes_received, 0u);
+  ASSERT_GT(stats->decode_ns, 0u);
+}
+
+TEST_F(MemgraphConnection, ExecuteWithParamWriter) {
+  std::vector<std::tuple<int64_t, std::string>> rows;
+  for (int64_t i = 0; i < 1000; ++i) {
+    rows.emplace_back(i, "node_" + std::to_string(i));
+  }
+  mg::PreparedQuery query(
+      "UNWIND $rows AS row RETURN sum(row[0]) AS total, $limit AS limit;");
+  ASSERT_TRUE(client->Execute(query, mg::Param("rows", rows),
+                              mg::Param("limit", std::optional<int>())));
+  auto result = client->FetchAll();
+  ASSERT_TRUE(result);
+  ASSERT_EQ(result->size(), 1u);
+  ASSERT_EQ((*result)[0][0].ValueInt(), 999 * 1000 / 2);
+  ASSERT_EQ((*result)[0][1].type(), mg::Value::Type::Null);
+}
+
+TEST_F(MemgraphConnection, ClientPool) {
+  mg::ClientPool::Params params;
+  params.client.host =
+      GetEnvOrDefault<std::string>("MEMGRAPH_HOST", "127.0.0.1");
+  params.client.port = GetEnvOrDefault<uint16_t>("MEMGRAPH_PORT", 7687);
+  params.client.use_ssl = GetEnvOrDefault<bool>("MEMGRAPH_SSLMODE", false);
+  params.max_connections = 2;
+  mg::ClientPool pool(params);
+
+  mg::Client *first_client = nullptr;
+  {
+    auto handle = pool.Acquire();
+    ASSERT_TRUE(handle);
+    first_client = handle.get();
+    // Leave a transaction open, it is rolled back before the client is reused.
+    ASSERT_TRUE(handle->BeginTransaction());
+    ASSERT_TRUE(handle->Execute("CREATE ();"));
+    handle->DiscardAll();
+  }
+  ASSERT_EQ(pool.size(), 1u);
+  ASSERT_EQ(pool.idle(), 1u);
+
+  auto first = pool.Acquire();
+  ASSERT_EQ(first.get(), first_client);
+  ASSERT_TRUE(first->Execute("MATCH (n) RETURN count(n);"));
+  auto count = first->FetchOne();
+  ASSERT_TRUE(count);
+  ASSERT_EQ((*count)[0].ValueInt(), 0);
+  ASSERT_FALSE(first->FetchOne());
+
+  auto second = pool.Acquire();
+  ASSERT_TRUE(second);
+  ASSERT_EQ(pool.size(), 2u);
+  ASSERT_FALSE(pool.Acquire(std::chrono::milliseconds(10)));
+
+  // A client released in the middle of a query is closed.
+  ASSERT_TRUE(second->Execute("UNWIND range(1, 10) AS x RETURN x;"));
+  second.Release();
+  ASSERT_EQ(pool.size(), 1u);
+  ASSERT_EQ(pool.idle(), 0u);
+  ASSERT_TRUE(pool.Acquire(std::chrono::milliseconds(10)));
+}
@@ -131,6 +131,9 @@ class SecureTransportTest : public ::testing::Test {
   }
 
   virtual void TearDown() override {
+    // SSL contexts are cached for the whole process, and certificates are
+    // regenerated for every test.
+    mg_secure_transport_finalize();
     X509_free(server_cert);
     X509_free(ca_cert);
     EVP_PKEY_free(server_key);
@@ -189,7 +192,7 @@ TEST_F(SecureTransportTest, NoCertificate) {
   mg_transport *transport;
   ASSERT_EQ(mg_secure_transport_init(sc, nullptr, nullptr,
                                      (mg_secure_transport **)&transport,
-                                     (mg_allocator *)&allocator),
+                                     (mg_allocator *)&allocator, 0),
             0);
   ASSERT_EQ(mg_transport_send((mg_transport *)transport, "hello", 5), 0);
 
@@ -242,7 +245,7 @@ TEST_F(SecureTransportTest, WithCertificate) {
   ASSERT_EQ(mg_secure_transport_init(sc, client_cert_path.string().c_str(),
                                      client_key_path.string().c_str(),
                                      (mg_secure_transport **)&transport,
-                                     (mg_allocator *)&allocator),
+                                     (mg_allocator *)&allocator, 0),
             0);
   ASSERT_EQ(mg_transport_send((mg_transport *)transport, "hello", 5), 0);
 
@@ -254,3 +257,261 @@ TEST_F(SecureTransportTest, WithCertificate) {
 
   StopServer();
 }
+
+TEST_F(SecureTransportTest, SessionResumption) {
+  SSL_CTX *ctx;
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+  ctx = SSL_CTX_new(SSLv23_server_method());
+#else
+  ctx = SSL_CTX_new(TLS_server_method());
+#endif
+  ASSERT_TRUE(ctx);
+  SSL_CTX_use_certificate(ctx, server_cert);
+  SSL_CTX_use_PrivateKey(ctx, server_key);
+
+  for (int i = 0; i < 3; ++i) {
+    if (i > 0) {
+      int sv[2];
+      ASSERT_EQ(mg_socket_pair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+      sc = sv[0];
+      ss = sv[1];
+    }
+    int reused = -1;
+    RunServer([this, ctx, &reused] {
+      SSL *ssl = SSL_new(ctx);
+      ASSERT_TRUE(ssl);
+      SSL_set_fd(ssl, ss);
+      ASSERT_EQ(SSL_accept(ssl), 1);
+      reused = SSL_session_reused(ssl);
+
+      char request[5];
+      ASSERT_GT(SSL_read(ssl, request, 5), 0);
+      ASSERT_EQ(strncmp(request, "hello", 5), 0);
+      ASSERT_GT(SSL_write(ssl, "hello", 5), 0);
+
+      SSL_free(ssl);
+      mg_socket_close(ss);
+    });
+
+    mg_transport *transport;
+    ASSERT_EQ(mg_secure_transport_init(sc, nullptr, nullptr,
+                                       (mg_secure_transport **)&transport,
+                                       (mg_allocator *)&allocator, 0),
+              0);
+    ASSERT_EQ(mg_transport_send(transport, "hello", 5), 0);
+    char response[5];
+    ASSERT_EQ(mg_transport_recv(transport, response, 5), 0);
+    ASSERT_EQ(strncmp(response, "hello", 5), 0);
+    mg_transport_destroy(transport);
+
+    StopServer();
+    // Only the first connection needs a full handshake.
+    EXPECT_EQ(reused, i > 0 ? 1 : 0);
+  }
+
+  SSL_CTX_free(ctx);
+}
+
+TEST_F(SecureTransportTest, KernelTls) {
+  // Kernel TLS needs a TCP connection.
+  mg_socket_close(sc);
+  mg_socket_close(ss);
+  int listener = mg_socket_create(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  ASSERT_EQ(bind(listener, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  ASSERT_EQ(listen(listener, 1), 0);
+  socklen_t addr_len = sizeof(addr);
+  ASSERT_EQ(getsockname(listener, (struct sockaddr *)&addr, &addr_len), 0);
+  sc = mg_socket_create(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(sc, 0);
+  ASSERT_EQ(mg_socket_connect(sc, (struct sockaddr *)&addr, addr_len), 0);
+  ss = accept(listener, nullptr, nullptr);
+  ASSERT_GE(ss, 0);
+  mg_socket_close(listener);
+
+  std::string payload(1 << 20, '\0');
+  std::mt19937 gen(42);
+  for (auto &c : payload) {
+    c = (char)(gen() & 0xff);
+  }
+
+  RunServer([this, &payload] {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    ASSERT_TRUE(ctx);
+    SSL_CTX_use_certificate(ctx, server_cert);
+    SSL_CTX_use_PrivateKey(ctx, server_key);
+    SSL *ssl = SSL_new(ctx);
+    ASSERT_TRUE(ssl);
+    SSL_set_fd(ssl, ss);
+    ASSERT_EQ(SSL_accept(ssl), 1);
+
+    char request[5];
+    ASSERT_GT(SSL_read(ssl, request, 5), 0);
+    ASSERT_EQ(strncmp(request, "hello", 5), 0);
+    size_t sent = 0;
+    while (sent < payload.size()) {
+      int now = SSL_write(ssl, payload.data() + sent,
+                          (int)std::min<size_t>(payload.size() - sent, 10000));
+      ASSERT_GT(now, 0);
+      sent += (size_t)now;
+    }
+    // Wait for the client to receive everything before closing.
+    ASSERT_GT(SSL_read(ssl, request, 5), 0);
+
+    SSL_free(ssl);
+    SSL_CTX_free(ctx);
+    mg_socket_close(ss);
+  });
+
+  mg_transport *transport;
+  ASSERT_EQ(mg_secure_transport_init(sc, nullptr, nullptr,
+                                     (mg_secure_transport **)&transport,
+                                     (mg_allocator *)&allocator, 1),
+            0);
+  // Whether kernel TLS is used depends on the kernel and the OpenSSL build,
+  // the data has to arrive either way.
+  RecordProperty("ktls_send",
+                 ((mg_secure_transport *)transport)->ktls_send);
+  RecordProperty("ktls_recv",
+                 ((mg_secure_transport *)transport)->ktls_recv);
+  ASSERT_EQ(mg_transport_send(transport, "hello", 5), 0);
+
+  std::string received(payload.size(), '\0');
+  ASSERT_EQ(mg_transport_recv(transport, received.data(), 3), 0);
+  size_t total = 3;
+  while (total < received.size()) {
+    ssize_t now = mg_transport_recv_some(transport, received.data() + total,
+                                         received.size() - total);
+    ASSERT_GT(now, 0);
+    total += (size_t)now;
+  }
+  EXPECT_EQ(received, payload);
+  ASSERT_EQ(mg_transport_send(transport, "done!", 5), 0);
+
+  mg_transport_destroy(transport);
+
+  StopServer();
+}
+
+class IoUringTransportTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() override {
+    int sv[2];
+    ASSERT_EQ(mg_socket_pair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    sc = sv[0];
+    ss = sv[1];
+    int status = mg_io_uring_transport_init(
+        sc, (mg_io_uring_transport **)&transport, (mg_allocator *)&allocator);
+    if (status == MG_ERROR_UNIMPLEMENTED || status == MG_ERROR_SOCKET) {
+      mg_socket_close(sc);
+      transport = nullptr;
+      GTEST_SKIP() << "io_uring is not available";
+    }
+    ASSERT_EQ(status, 0);
+  }
+
+  virtual void TearDown() override {
+    if (server_thread.joinable()) {
+      server_thread.join();
+    }
+    if (transport) {
+      mg_transport_destroy(transport);
+    }
+    mg_socket_close(ss);
+    ASSERT_EQ(allocator.allocated.size(), 0U);
+  }
+
+  static std::string ReceiveAll(int sock, size_t len) {
+    std::string data(len, '\0');
+    size_t received = 0;
+    while (received < len) {
+      ssize_t now = mg_socket_receive(sock, data.data() + received,
+                                      (int)(len - received));
+      if (now <= 0) {
+        break;
+      }
+      received += (size_t)now;
+    }
+    data.resize(received);
+    return data;
+  }
+
+  static std::string RandomData(size_t len) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::string data(len, '\0');
+    for (auto &c : data) {
+      c = (char)dist(gen);
+    }
+    return data;
+  }
+
+  int sc;
+  int ss;
+  mg_transport *transport{nullptr};
+  std::thread server_thread;
+
+  tracking_allocator allocator;
+};
+
+TEST_F(IoUringTransportTest, SendIsSubmittedWithReceive) {
+  const std::string response = RandomData(300000);
+  server_thread = std::thread([this, &response] {
+    ASSERT_EQ(ReceiveAll(ss, 5), "hello");
+    ASSERT_EQ(mg_socket_send(ss, response.data(), (int)response.size()),
+              (ssize_t)response.size());
+  });
+
+  ASSERT_EQ(mg_transport_send(transport, "hello", 5), 0);
+  // Small reads are buffered, big ones go directly to the destination.
+  std::string received(response.size(), '\0');
+  ASSERT_EQ(mg_transport_recv(transport, received.data(), 3), 0);
+  ASSERT_EQ(mg_transport_recv(transport, received.data() + 3,
+                              received.size() - 3),
+            0);
+  EXPECT_EQ(received, response);
+}
+
+TEST_F(IoUringTransportTest, SendBiggerThanBuffer) {
+  const std::string request = RandomData(300000);
+  server_thread = std::thread([this, &request] {
+    ASSERT_EQ(ReceiveAll(ss, request.size()), request);
+    ASSERT_EQ(mg_socket_send(ss, "ok", 2), 2);
+  });
+
+  ASSERT_EQ(mg_transport_send(transport, request.data(), request.size()), 0);
+  char response[2];
+  ASSERT_EQ(mg_transport_recv(transport, response, 2), 0);
+  EXPECT_EQ(std::string(response, 2), "ok");
+}
+
+TEST_F(IoUringTransportTest, DestroyFlushesStagedData) {
+  ASSERT_EQ(mg_transport_send(transport, "bye", 3), 0);
+  mg_transport_destroy(transport);
+  transport = nullptr;
+  EXPECT_EQ(ReceiveAll(ss, 3), "bye");
+}
+
+TEST_F(IoUringTransportTest, NonBlocking) {
+  ASSERT_EQ(mg_socket_set_nonblocking(sc, 1), 0);
+  char buf[16];
+  EXPECT_EQ(mg_transport_try_recv(transport, buf, sizeof(buf)),
+            MG_TRANSPORT_WANT_READ);
+
+  ASSERT_EQ(mg_transport_try_send(transport, "hello", 5), 5);
+  ASSERT_EQ(ReceiveAll(ss, 5), "hello");
+
+  ASSERT_EQ(mg_socket_send(ss, "world", 5), 5);
+  struct pollfd p;
+  p.fd = sc;
+  p.events = POLLIN;
+  p.revents = 0;
+  ASSERT_EQ(mg_socket_poll(&p, 1, 10000), 1);
+  EXPECT_EQ(mg_transport_try_recv(transport, buf, sizeof(buf)), 5);
+  EXPECT_EQ(std::string(buf, 5), "world");
+}
@@ -15,10 +15,14 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <optional>
+#include <type_traits>
+
 #include <gtest/gtest.h>
 
 #include "mgclient-value.hpp"
 #include "mgclient.h"
+#include "mgclient.hpp"
 
 using namespace std;
 
@@ -334,4 +338,89 @@ TEST(ValueTest, ValueFromMap) {
   ASSERT_EQ((*it).second, Value(13));
 }
 
+TEST(ValueTest, Visit) {
+  auto describe = [](const auto &v) -> std::string {
+    using T = std::decay_t<decltype(v)>;
+    if constexpr (std::is_same_v<T, std::nullptr_t>) {
+      return "null";
+    } else if constexpr (std::is_same_v<T, bool>) {
+      return v ? "true" : "false";
+    } else if constexpr (std::is_same_v<T, int64_t>) {
+      return "int " + std::to_string(v);
+    } else if constexpr (std::is_same_v<T, std::string_view>) {
+      return "string " + std::string(v);
+    } else if constexpr (std::is_same_v<T, ConstList>) {
+      return "list of " + std::to_string(v.size());
+    } else {
+      return "other";
+    }
+  };
+
+  List list(2);
+  list.Append(Value(1));
+  list.Append(Value("a"));
+  ASSERT_EQ(Visit(describe, Value()), "null");
+  ASSERT_EQ(Visit(describe, Value(true)), "true");
+  ASSERT_EQ(Visit(describe, Value(-13)), "int -13");
+  ASSERT_EQ(Visit(describe, Value("test").AsConstValue()), "string test");
+  ASSERT_EQ(Visit(describe, Value(std::move(list))), "list of 2");
+  ASSERT_EQ(Visit(describe, Value(3.5)), "other");
+}
+
+TEST(ValueTest, GetIf) {
+  Value value_int(7);
+  Value value_string("test");
+
+  ASSERT_EQ(GetIf<Value::Type::Int>(value_int), std::optional<int64_t>(7));
+  ASSERT_FALSE(GetIf<Value::Type::Double>(value_int));
+  ASSERT_FALSE(GetIf<Value::Type::Null>(value_int));
+  ASSERT_EQ(GetIf<Value::Type::String>(value_string.AsConstValue()),
+            std::optional<std::string_view>("test"));
+  ASSERT_FALSE(GetIf<Value::Type::Int>(value_string));
+  ASSERT_TRUE(GetIf<Value::Type::Null>(Value()));
+}
+
+TEST(ColumnTest, TypedColumn) {
+  Column column("c");
+  column.Append(Value().AsConstValue());
+  column.Append(Value(7).AsConstValue());
+  column.Append(Value().AsConstValue());
+  column.Append(Value(9).AsConstValue());
+
+  ASSERT_EQ(column.type(), Column::Type::Int);
+  ASSERT_EQ(column.size(), 4u);
+  ASSERT_EQ(column.ints(), (std::vector<int64_t>{0, 7, 0, 9}));
+  ASSERT_EQ(column.validity(), (std::vector<uint8_t>{0b1010}));
+  ASSERT_TRUE(column.IsNull(0));
+  ASSERT_FALSE(column.IsNull(1));
+
+  Column strings("s");
+  strings.Append(Value("ab").AsConstValue());
+  strings.Append(Value().AsConstValue());
+  strings.Append(Value("cde").AsConstValue());
+  ASSERT_EQ(strings.type(), Column::Type::String);
+  ASSERT_EQ(strings.string_offsets(), (std::vector<size_t>{0, 2, 2, 5}));
+  ASSERT_EQ(strings.StringAt(2), "cde");
+  ASSERT_TRUE(strings.IsNull(1));
+}
+
+TEST(ColumnTest, MixedColumn) {
+  Column column("c");
+  column.Append(Value(1.5).AsConstValue());
+  column.Append(Value().AsConstValue());
+  column.Append(Value("x").AsConstValue());
+
+  ASSERT_EQ(column.type(), Column::Type::Value);
+  ASSERT_EQ(column.size(), 3u);
+  ASSERT_EQ(column.values().size(), 3u);
+  ASSERT_EQ(column.values()[0], Value(1.5));
+  ASSERT_TRUE(column.IsNull(1));
+  ASSERT_EQ(column.values()[2], Value("x"));
+
+  List list(1);
+  list.Append(Value(1));
+  column.Append(Value(std::move(list)).AsConstValue());
+  ASSERT_EQ(column.values()[3].type(), Value::Type::List);
+}
+
 }  // namespace mg
@@ -283,6 +283,54 @@ TEST(Value, Map) {
   mg_value_destroy(val2);
 }
 
+TEST(Value, LargeMap) {
+  const uint32_t size = 1000;
+  auto check_map = [size](const mg_map *map) {
+    ASSERT_EQ(mg_map_size(map), size);
+    for (uint32_t i = 0; i < size; ++i) {
+      std::string key = "key" + std::to_string(i);
+      EXPECT_TRUE(Equal(mg_map_at(map, key.c_str()), (int64_t)i));
+      EXPECT_EQ(mg_map_find2(map, key.size(), key.data()), i);
+    }
+    EXPECT_EQ(mg_map_at(map, "key"), nullptr);
+    EXPECT_EQ(mg_map_find(map, "key1000"), size);
+  };
+
+  mg_map *map = mg_map_make_empty(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    std::string key = "key" + std::to_string(i);
+    ASSERT_EQ(mg_map_insert(map, key.c_str(), mg_value_make_integer(i)), 0);
+  }
+  {
+    mg_value *value = mg_value_make_null();
+    EXPECT_EQ(mg_map_insert(map, "key500", value), MG_ERROR_CONTAINER_FULL);
+    mg_value_destroy(value);
+  }
+  check_map(map);
+
+  mg_map *map2 = mg_map_copy(map);
+  mg_map_destroy(map);
+  check_map(map2);
+  mg_map_destroy(map2);
+}
+
+TEST(Value, LargeMapDuplicateKey) {
+  mg_map *map = mg_map_make_empty(MG_MAP_INDEX_THRESHOLD + 1);
+  for (uint32_t i = 0; i < MG_MAP_INDEX_THRESHOLD; ++i) {
+    std::string key = "key" + std::to_string(i);
+    ASSERT_EQ(mg_map_insert(map, key.c_str(), mg_value_make_integer(i)), 0);
+  }
+  {
+    mg_value *value = mg_value_make_null();
+    EXPECT_EQ(mg_map_insert(map, "key3", value), MG_ERROR_DUPLICATE_KEY);
+    mg_value_destroy(value);
+  }
+  // The first occurrence of a key is found, same as in small maps.
+  ASSERT_EQ(mg_map_insert_unsafe(map, "key3", mg_value_make_null()), 0);
+  EXPECT_TRUE(Equal(mg_map_at(map, "key3"), (int64_t)3));
+  mg_map_destroy(map);
+}
+
 TEST(Value, Node) {
   auto check_node = [](const mg_node *node) {
     EXPECT_EQ(mg_node_id(node), 1234);